@@ -365,10 +365,13 @@ void LoadParameters(char* pszParamsFile,
       {"equal_I_and_L",                { [&]() { parse_int("equal_I_and_L"); }}},
       {"explicit_deltacn",             { [&]() { parse_int("explicit_deltacn"); }}},
       {"export_additional_pepxml_scores", { [&]() { parse_int("export_additional_pepxml_scores"); }}},
+      {"fragindex_cache",              { [&]() { parse_int("fragindex_cache"); }}},
+      {"fragindex_compress",           { [&]() { parse_int("fragindex_compress"); }}},
       {"fragindex_min_ions_report",    { [&]() { parse_int("fragindex_min_ions_report"); }}},
       {"fragindex_min_ions_score",     { [&]() { parse_int("fragindex_min_ions_score"); }}},
       {"fragindex_num_spectrumpeaks",  { [&]() { parse_int("fragindex_num_spectrumpeaks"); }}},
       {"fragindex_skipreadprecursors" ,{ [&]() { parse_int("fragindex_skipreadprecursors"); }}},
+      {"gzindex_cache",                { [&]() { parse_int("gzindex_cache"); }}},
       {"isotope_error",                { [&]() { parse_int("isotope_error"); }}},
       {"mango_search",                 { [&]() { parse_int("mango_search"); }}},
       {"mass_type_fragment",           { [&]() { parse_int("mass_type_fragment"); }}},
@@ -395,6 +398,7 @@ void LoadParameters(char* pszParamsFile,
       {"override_charge",              { [&]() { parse_int("override_charge"); }}},
       {"peff_format",                  { [&]() { parse_int("peff_format"); }}},
       {"peff_verbose_output",          { [&]() { parse_int("peff_verbose_output"); }}},
+      {"peptide_centric_search",       { [&]() { parse_int("peptide_centric_search"); }}},
       {"peptide_mass_units",           { [&]() { parse_int("peptide_mass_units"); }}},
       {"precursor_tolerance_type",     { [&]() { parse_int("precursor_tolerance_type"); }}},
       {"print_expect_score",           { [&]() { parse_int("print_expect_score"); }}},
@@ -407,6 +411,8 @@ void LoadParameters(char* pszParamsFile,
       {"search_enzyme2_number",        { [&]() { parse_int("search_enzyme2_number"); sscanf(szParamVal, "%d", &iSearchEnzyme2Number); }}},
       {"search_enzyme_number",         { [&]() { parse_int("search_enzyme_number"); sscanf(szParamVal, "%d", &iSearchEnzymeNumber); }}},
       {"speclib_ms_level",             { [&]() { parse_int("speclib_ms_level"); }}},
+      {"spectrum_batch_files",         { [&]() { parse_int("spectrum_batch_files"); }}},
+      {"spectrum_batch_pipeline",      { [&]() { parse_int("spectrum_batch_pipeline"); }}},
       {"spectrum_batch_size",          { [&]() { parse_int("spectrum_batch_size"); }}},
       {"theoretical_fragment_ions",    { [&]() { parse_int("theoretical_fragment_ions"); }}},
       {"use_A_ions",                   { [&]() { parse_int("use_A_ions"); }}},
@@ -451,6 +457,7 @@ void LoadParameters(char* pszParamsFile,
       {"add_Z_user_amino_acid",        { [&]() { parse_double("add_Z_user_amino_acid"); }}},
       {"fragindex_max_fragmentmass",   { [&]() { parse_double("fragindex_max_fragmentmass"); }}},
       {"fragindex_min_fragmentmass",   { [&]() { parse_double("fragindex_min_fragmentmass"); }}},
+      {"fragindex_slab_width",         { [&]() { parse_double("fragindex_slab_width"); }}},
       {"fragment_bin_offset",          { [&]() { parse_double("fragment_bin_offset"); }}},
       {"fragment_bin_tol",             { [&]() { parse_double("fragment_bin_tol"); }}},
       {"minimum_intensity",            { [&]() { parse_double("minimum_intensity"); }}},
@@ -944,7 +951,10 @@ fragindex_min_ions_report = 3          # minimum number of matched fragment ion
 fragindex_num_spectrumpeaks = 150      # number of peaks from spectrum to use for fragment ion index matching\n\
 fragindex_min_fragmentmass = 200.0     # low mass cutoff for fragment ions\n\
 fragindex_max_fragmentmass = 2000.0    # high mass cutoff for fragment ions\n\
-fragindex_skipreadprecursors = 1       # 0=read precursors to limit fragment ion index, 1=skip reading precursors (default)\n\n");
+fragindex_skipreadprecursors = 1       # 0=read precursors to limit fragment ion index, 1=skip reading precursors (default)\n\
+fragindex_cache = 0                    # 0=no (default), 1=save fragment ion index to .fidx file next to the .idx file and reuse it; file can be several GB; requires fragindex_skipreadprecursors = 1\n\
+fragindex_slab_width = 0.0             # 0.0=single fragment ion index (default), else partition index into precursor mass slabs of this width (Da)\n\
+fragindex_compress = 0                 # 0=no (default), 1=store fragment ion index compressed; about 2.3x smaller (13.4 bits/entry), list decoding is slower but search time is about the same\n\n");
    }
 
    fprintf(fp,
@@ -1083,6 +1093,10 @@ max_precursor_charge = 6               # set maximum precursor charge state to a
 fprintf(fp,
 "clip_nterm_methionine = 0              # 0=leave protein sequences as-is; 1=also consider sequence w/o N-term methionine\n\
 spectrum_batch_size = 15000            # max. # of spectra to search at a time; 0 to search the entire scan range in one loop\n\
+spectrum_batch_pipeline = 0            # 0=load, search and write each batch in turn; 1=load the next batch on num_threads/2 threads and write the previous one while a batch is searched (up to 3 batches in memory)\n\
+spectrum_batch_files = 1               # max. # of input files searched together; >1 fills a batch from the next file when one file runs out and writes separate output per file (files are read in order, not concurrently; spectrum_batch_pipeline is ignored; mzIdentML SIR/SII ids are numbered by the shared batches)\n\
+peptide_centric_search = 0             # 0=score peptides as each protein is digested; 1=digest the database once per run into a mass-sorted peptide list and score each batch from its mass range (FASTA only; not PEFF, nucleotide or compound mod searches)\n\
+gzindex_cache = 1                      # 0=no, 1=save the random access index of .mzML.gz/.mzXML.gz input to a .gzidx file next to it and reuse it (default); without a saved index .gz input is read on one thread\n\
 decoy_prefix = DECOY_                  # decoy entries are denoted by this string which is pre-pended to each protein accession\n\
 equal_I_and_L = 1                      # 0=treat I and L as different; 1=treat I and L as same\n\
 mass_offsets =                         # one or more mass offsets to search (values substracted from deconvoluted precursor mass)\n\
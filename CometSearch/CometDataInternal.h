@@ -16,8 +16,13 @@
 #ifndef _COMETDATAINTERNAL_H_
 #define _COMETDATAINTERNAL_H_
 
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
 #include <string>
+#include <thread>
 #include "CometData.h"
 #include "Threading.h"
 #include "AScoreOptions.h"
@@ -120,6 +125,10 @@ struct Options
    int iNumStored;               // # of search results to store for xcorr analysis
    int iMaxDuplicateProteins;    // maximum number of duplicate proteins to report or store in idx file
    int iSpectrumBatchSize;       // # of spectra to search at a time within the scan range
+   int iSpectrumBatchPipeline;   // if true, load the next batch and write the previous one while a batch is searched
+   int iSpectrumBatchFiles;      // max # of input files whose spectra can share a batch
+   int iPeptideCentricSearch;    // if true, digest the database once and score each batch from the mass-sorted peptides
+   int iGZIndexCache;            // if true, save/reuse the access point index of .gz input in a .gzidx file
    int iStartCharge;
    int iEndCharge;
    int iMaxFragmentCharge;
@@ -157,6 +166,8 @@ struct Options
    int iFragIndexMinIonsReport;  // minimum matched fragment index ions for reporting
    int iFragIndexNumSpectrumPeaks;   // # of peaks from spectrum to use for querying fragment index
    int iFragIndexSkipReadPrecursors; // if true, skips reading precursors step
+   int iFragIndexCache;          // if true, save/reuse fragment index in .fidx file; off by default
+   int iFragIndexCompress;       // if true, store fragment index posting lists compressed
    int iOverrideCharge;
    long lMaxIterations;          // max # of modification permutations for each iStart position
    double dMinIntensity;         // intensity cutoff for each peak
@@ -167,6 +178,7 @@ struct Options
    double dMinimumXcorr;         // set the minimum xcorr to report (default is 1e-8)
    double dFragIndexMaxMass;     // fragment index maximum fragment mass
    double dFragIndexMinMass;     // fragment index minimum fragment mass
+   double dFragIndexSlabWidth;   // fragment index precursor mass slab width; 0 = single index
    double dMS1MinMass;           // low mass cutoff in MS1 query/library spectra
    double dMS1MaxMass;           // high mass cutoff in MS1 query/library spectra
    IntRange scanRange;
@@ -183,6 +195,10 @@ struct Options
       iNumStored = a.iNumStored;
       iMaxDuplicateProteins = a.iMaxDuplicateProteins;
       iSpectrumBatchSize = a.iSpectrumBatchSize;
+      iSpectrumBatchPipeline = a.iSpectrumBatchPipeline;
+      iSpectrumBatchFiles = a.iSpectrumBatchFiles;
+      iPeptideCentricSearch = a.iPeptideCentricSearch;
+      iGZIndexCache = a.iGZIndexCache;
       iStartCharge = a.iStartCharge;
       iEndCharge = a.iEndCharge;
       iMaxFragmentCharge = a.iMaxFragmentCharge;
@@ -230,10 +246,13 @@ struct Options
 
       dFragIndexMinMass = a.dFragIndexMinMass;
       dFragIndexMaxMass = a.dFragIndexMaxMass;
+      dFragIndexSlabWidth = a.dFragIndexSlabWidth;
       iFragIndexMinIonsScore = a.iFragIndexMinIonsScore;    
       iFragIndexMinIonsReport = a.iFragIndexMinIonsReport ;  
       iFragIndexNumSpectrumPeaks = a.iFragIndexNumSpectrumPeaks;
       iFragIndexSkipReadPrecursors = a.iFragIndexSkipReadPrecursors;
+      iFragIndexCache = a.iFragIndexCache;
+      iFragIndexCompress = a.iFragIndexCompress;
 
       dMS1MinMass = a.dMS1MinMass;
       dMS1MaxMass = a.dMS1MaxMass;
@@ -242,6 +261,12 @@ struct Options
    }
 };
 
+struct PeffModSite                           // PEFF mod of one negative piVarModSites entry
+{
+   int  iPosition;                            // index into piVarModSites
+   char szMod[MAX_PEFFMOD_LEN];
+};
+
 struct Results
 {
    double dPepMass;
@@ -260,7 +285,6 @@ struct Results
    long   lWhichProtein;                      // which entry in g_pvProteinsList[] contains the matched proteins
    int    piVarModSites[MAX_PEPTIDE_LEN_P2];  // store variable mods encoding, +2 to accomodate N/C-term
    double pdVarModSites[MAX_PEPTIDE_LEN_P2];  // store variable mods mass diffs, +2 to accomodate N/C-term
-   char   pszMod[MAX_PEPTIDE_LEN][MAX_PEFFMOD_LEN];    // store PEFF mod string
    char   szPeptide[MAX_PEPTIDE_LEN];
    char   cPrevAA;                            // stores prev flanking AA
    char   cNextAA;                            // stores following flanking AA
@@ -272,6 +296,28 @@ struct Results
    int    iPeffNewResidueCount;               // more than 0 new residues is a substitution (if iPeffOrigResidueCount=1) or insertion (if iPeffOrigResidueCount>1)
    vector<struct ProteinEntryStruct> pWhichProtein;       // file positions of matched protein entries
    vector<struct ProteinEntryStruct> pWhichDecoyProtein;  // keep separate decoy list (used for separate decoy matches and combined results)
+   vector<PeffModSite> vPeffMods;             // PEFF mod strings, stored only for the modified positions
+
+   // PEFF mod string at piVarModSites position iPosition; "" if none stored
+   const char* PeffMod(int iPosition) const
+   {
+      for (size_t i = 0; i < vPeffMods.size(); ++i)
+      {
+         if (vPeffMods[i].iPosition == iPosition)
+            return vPeffMods[i].szMod;
+      }
+      return "";
+   }
+
+   void AddPeffMod(int iPosition,
+                   const char* szMod)
+   {
+      PeffModSite site;
+
+      site.iPosition = iPosition;
+      strcpy(site.szMod, szMod);
+      vPeffMods.push_back(site);
+   }
 };
 
 struct SpecLibResults // MS2 spec lib
@@ -457,6 +503,8 @@ struct DBIndex
    unsigned short siVarModProteinFilter;                 // bitwise representation of mmapProtein
    char cPrevAA;
    char cNextAA;
+   bool bClippedM = false;                               // from the sequence without its N-term Met
+   int iStartResidue = 0;                                // 0-based start in the sequence it was digested from
 
    bool operator==(const DBIndex& rhs) const
    {
@@ -568,8 +616,14 @@ struct RetentionMatch
 extern std::deque<RetentionMatch> RetentionMatchHistory;
 
 extern unsigned int* g_iFragmentIndex;            // CSR flat data: all posting lists concatenated [g_iFragmentIndexOffset[bin]..g_iFragmentIndexOffset[bin+1])
-extern unsigned int* g_iFragmentIndexOffset;      // CSR offsets [uiMaxFragmentArrayIndex+1]: g_iFragmentIndexOffset[b] = start of bin b in g_iFragmentIndex
-extern vector<struct FragmentPeptidesStruct> g_vFragmentPeptides;
+extern unsigned int* g_iFragmentIndexOffset;      // CSR offsets [g_uiNumFragmentSlabs*uiMaxFragmentArrayIndex+1]: g_iFragmentIndexOffset[slab*uiMaxFragmentArrayIndex + b] = start of bin b of slab in g_iFragmentIndex
+extern unsigned int g_uiNumFragmentSlabs;         // number of precursor mass slabs in the fragment index; 1 = single index over all peptides
+extern unsigned int* g_uiFragmentSlabPeptide;     // [g_uiNumFragmentSlabs+1] first g_vFragmentPeptides entry of each slab
+extern unsigned char* g_ucFragmentIndexPacked;    // compressed posting lists (fragindex_compress); g_iFragmentIndex is NULL when set
+extern unsigned long long* g_ullFragmentIndexPackedOffset;  // [g_uiNumFragmentSlabs*uiMaxFragmentArrayIndex+1] byte offset of each posting list in g_ucFragmentIndexPacked
+extern vector<struct FragmentPeptidesStruct> g_vFragmentPeptides;   // built in memory; empty when mapped from a .fidx file
+extern const FragmentPeptidesStruct* g_pFragmentPeptides;          // mass sorted peptides searched: g_vFragmentPeptides or the .fidx mapping
+extern size_t g_tNumFragmentPeptides;
 extern vector<PlainPeptideIndexStruct> g_vRawPeptides;
 extern bool* g_bIndexPrecursors;     // allocate an array of BIN(max_precursor, protonated) and use a bool to indicate if that precursor is present in input file(s)
 extern vector<SpecLibStruct> g_vSpecLib;
@@ -997,6 +1051,10 @@ struct StaticParams
       options.scanRange.iStart = 0;
       options.scanRange.iEnd = 0;
       options.iSpectrumBatchSize = 0;
+      options.iSpectrumBatchPipeline = 0;
+      options.iSpectrumBatchFiles = 1;
+      options.iPeptideCentricSearch = 0;
+      options.iGZIndexCache = 1;
       options.iMinPeaks = 10;
       options.iStartCharge = 0;
       options.iEndCharge = 0;
@@ -1018,10 +1076,13 @@ struct StaticParams
 
       options.dFragIndexMinMass = FRAGINDEX_MIN_MASS;
       options.dFragIndexMaxMass = FRAGINDEX_MAX_MASS;
+      options.dFragIndexSlabWidth = 0.0;
       options.iFragIndexMinIonsScore = FRAGINDEX_MIN_IONS_SCORE;
       options.iFragIndexMinIonsReport = FRAGINDEX_MIN_IONS_REPORT;
       options.iFragIndexNumSpectrumPeaks = FRAGINDEX_MAX_NUMPEAKS;
       options.iFragIndexSkipReadPrecursors = 1;   // skip reading precursors by default
+      options.iFragIndexCache = 0;
+      options.iFragIndexCompress = 0;
 
       options.dMS1MinMass = MS1_MIN_MASS;
       options.dMS1MaxMass = MS1_MAX_MASS;
@@ -1057,6 +1118,41 @@ extern map<long long, IndexProteinStruct>  g_pvProteinNames;   // indexed databa
 
 extern vector<vector<comet_fileoffset_t>> g_pvProteinsList;
 
+// g_pvProteinsList of a fragment index mapped from a .fidx file:  the file positions
+// of entry i are g_plMappedProteinList[g_pullMappedProteinListOffset[i] .. [i+1]).
+extern const unsigned long long* g_pullMappedProteinListOffset;
+extern const comet_fileoffset_t* g_plMappedProteinList;
+
+struct ProteinListView
+{
+   const comet_fileoffset_t* pBegin;
+   const comet_fileoffset_t* pEnd;
+
+   const comet_fileoffset_t* begin() const { return pBegin; }
+   const comet_fileoffset_t* end() const { return pEnd; }
+   size_t size() const { return (size_t)(pEnd - pBegin); }
+};
+
+// Protein file positions of index protein list lEntry.
+inline ProteinListView GetIndexProteinList(comet_fileoffset_t lEntry)
+{
+   ProteinListView view;
+
+   if (g_pullMappedProteinListOffset != NULL)
+   {
+      view.pBegin = g_plMappedProteinList + g_pullMappedProteinListOffset[lEntry];
+      view.pEnd = g_plMappedProteinList + g_pullMappedProteinListOffset[lEntry + 1];
+   }
+   else
+   {
+      const vector<comet_fileoffset_t>& vList = g_pvProteinsList.at(lEntry);
+      view.pBegin = vList.data();
+      view.pEnd = vList.data() + vList.size();
+   }
+
+   return view;
+}
+
 extern AScoreProCpp::AScoreOptions g_AScoreOptions;  // AScore options
 extern AScoreProCpp::AScoreDllInterface* g_AScoreInterface;
 
@@ -1092,6 +1188,373 @@ extern bool g_bCometSearchMemoryAllocated;        // set to true when memory has
 extern bool g_bIdxNoFasta;   // set to true when .idx file being search but corresponding .fasta not present
                              // used in mzid output to skip sequence retrieval
 
+// Monotonic allocator for memory whose lifetime is a whole search batch
+// (g_batchArena) or a single RTS spectrum (RtsScratch).  Requests are carved
+// from large blocks and are never freed individually; Reset() just rewinds
+// to the first block so the next batch reuses the same pages.  Anything with
+// non-trivial members (Query, Results) must still have its destructor run.
+//
+// A thread safe arena hands each thread a COMET_ARENA_CHUNK sized sub-arena
+// under the lock and the thread then bumps through it without locking.  A
+// thread's chunk is tagged with the epoch of the arena it came from; Reset()
+// and Swap() give the arena a new, never reused epoch so stale chunks are
+// dropped on the next Allocate().
+#define COMET_ARENA_ALIGN           64       // cache line; keeps sparse rows SIMD friendly
+#define COMET_ARENA_CHUNK           (1024 * 1024)   // per-thread sub-arena of a thread safe arena
+#define COMET_ARENA_THREAD_CHUNKS   4        // thread safe arenas a thread keeps a chunk of at once
+
+class CometArena
+{
+public:
+   CometArena(size_t tBlockSize,
+              bool bThreadSafe)
+      : _tBlockSize(tBlockSize), _bThreadSafe(bThreadSafe),
+        _tBlock(0), _tOffset(0), _tBytesUsed(0), _tPeakBytesUsed(0), _ullNumAllocs(0),
+        _ullEpoch(NewEpoch())
+   {
+      Threading::InitMutex(&_mutex);
+   }
+
+   ~CometArena()
+   {
+      Release();
+      Threading::DestroyMutex(_mutex);
+   }
+
+   // Returns COMET_ARENA_ALIGN aligned, uninitialized storage; throws std::bad_alloc.
+   void* Allocate(size_t tBytes)
+   {
+      tBytes = (tBytes + COMET_ARENA_ALIGN - 1) & ~((size_t)COMET_ARENA_ALIGN - 1);
+
+      // Requests over a quarter chunk go straight to the shared blocks.
+      if (!_bThreadSafe || tBytes > COMET_ARENA_CHUNK / 4)
+         return AllocateShared(tBytes);
+
+      ThreadChunk &chunk = LocalChunk();
+
+      if (chunk.tFree < tBytes)
+      {
+         chunk.pNext = (char*)AllocateShared(COMET_ARENA_CHUNK);
+         chunk.tFree = COMET_ARENA_CHUNK;
+      }
+
+      char *pAlloc = chunk.pNext;
+      chunk.pNext += tBytes;
+      chunk.tFree -= tBytes;
+
+      return pAlloc;
+   }
+
+   template<typename T> T* AllocateArray(size_t tCount)
+   {
+      return (T*)Allocate(tCount * sizeof(T));
+   }
+
+   // O(1): keeps every block for reuse by the next batch.  Must not run while
+   // other threads allocate.
+   void Reset()
+   {
+      _tBlock = 0;
+      _tOffset = 0;
+      _tBytesUsed = 0;
+      _ullEpoch = NewEpoch();
+   }
+
+   // Returns all blocks to the heap.
+   void Release()
+   {
+      for (size_t i = 0; i < _vBlocks.size(); ++i)
+         ::operator delete(_vBlocks[i].first, std::align_val_t(COMET_ARENA_ALIGN));
+      _vBlocks.clear();
+      Reset();
+   }
+
+   size_t BytesReserved() const
+   {
+      size_t tTotal = 0;
+      for (size_t i = 0; i < _vBlocks.size(); ++i)
+         tTotal += _vBlocks[i].second;
+      return tTotal;
+   }
+
+   // Exchanges the blocks of two idle arenas; used to double buffer batches.
+   void Swap(CometArena &other)
+   {
+      std::swap(_vBlocks, other._vBlocks);
+      std::swap(_tBlockSize, other._tBlockSize);
+      std::swap(_tBlock, other._tBlock);
+      std::swap(_tOffset, other._tOffset);
+      std::swap(_tBytesUsed, other._tBytesUsed);
+      std::swap(_tPeakBytesUsed, other._tPeakBytesUsed);
+      std::swap(_ullNumAllocs, other._ullNumAllocs);
+      _ullEpoch = NewEpoch();
+      other._ullEpoch = NewEpoch();
+   }
+
+   size_t PeakBytesUsed() const            { return _tPeakBytesUsed; }
+   unsigned long long NumAllocs() const    { return _ullNumAllocs; }   // block carves; a thread's chunk counts once
+   size_t NumBlocks() const                { return _vBlocks.size(); }
+
+private:
+   CometArena(const CometArena&);
+   CometArena& operator=(const CometArena&);
+
+   struct ThreadChunk
+   {
+      unsigned long long ullEpoch;          // epoch of the arena the chunk was carved from; 0 = none
+      char  *pNext;
+      size_t tFree;
+   };
+
+   static unsigned long long NewEpoch()
+   {
+      static std::atomic<unsigned long long> s_ullNextEpoch(1);
+      return s_ullNextEpoch.fetch_add(1, std::memory_order_relaxed);
+   }
+
+   // This thread's chunk of the arena, empty if it has none yet.  The thread's
+   // oldest chunk is dropped to make room.
+   ThreadChunk& LocalChunk()
+   {
+      static thread_local ThreadChunk s_chunks[COMET_ARENA_THREAD_CHUNKS] = {};
+
+      ThreadChunk *pOldest = s_chunks;
+      for (int i = 0; i < COMET_ARENA_THREAD_CHUNKS; ++i)
+      {
+         if (s_chunks[i].ullEpoch == _ullEpoch)
+            return s_chunks[i];
+         if (s_chunks[i].ullEpoch < pOldest->ullEpoch)
+            pOldest = s_chunks + i;
+      }
+
+      pOldest->ullEpoch = _ullEpoch;
+      pOldest->pNext = NULL;
+      pOldest->tFree = 0;
+      return *pOldest;
+   }
+
+   // Carves tBytes from the current block, taking the lock of a thread safe arena.
+   void* AllocateShared(size_t tBytes)
+   {
+      if (_bThreadSafe)
+         Threading::LockMutex(_mutex);
+
+      char *pAlloc = NULL;
+
+      while (_tBlock < _vBlocks.size())
+      {
+         if (_tOffset + tBytes <= _vBlocks[_tBlock].second)
+         {
+            pAlloc = _vBlocks[_tBlock].first + _tOffset;
+            _tOffset += tBytes;
+            break;
+         }
+         _tBlock++;
+         _tOffset = 0;
+      }
+
+      if (pAlloc == NULL)
+      {
+         size_t tSize = (tBytes > _tBlockSize ? tBytes : _tBlockSize);
+
+         try
+         {
+            pAlloc = (char*)::operator new(tSize, std::align_val_t(COMET_ARENA_ALIGN));
+            _vBlocks.push_back(std::make_pair(pAlloc, tSize));
+         }
+         catch (...)
+         {
+            if (_bThreadSafe)
+               Threading::UnlockMutex(_mutex);
+            throw;
+         }
+
+         _tBlock = _vBlocks.size() - 1;
+         _tOffset = tBytes;
+      }
+
+      _tBytesUsed += tBytes;
+      if (_tBytesUsed > _tPeakBytesUsed)
+         _tPeakBytesUsed = _tBytesUsed;
+      _ullNumAllocs++;
+
+      if (_bThreadSafe)
+         Threading::UnlockMutex(_mutex);
+
+      return pAlloc;
+   }
+
+   vector<pair<char*, size_t>> _vBlocks;   // block start, block size
+   size_t _tBlockSize;
+   bool   _bThreadSafe;
+   size_t _tBlock;                          // block currently being carved
+   size_t _tOffset;                         // next free byte in _vBlocks[_tBlock]
+   size_t _tBytesUsed;
+   size_t _tPeakBytesUsed;
+   unsigned long long _ullNumAllocs;
+   unsigned long long _ullEpoch;           // changes whenever the blocks are rewound or swapped
+   Mutex  _mutex;
+};
+
+// Lock-free free list of the per-thread scratch buffer slots 0..n-1 used by the
+// preprocessing and search memory pools.  A Treiber stack whose head packs the
+// top slot (index + 1, 0 = empty) in the low 32 bits and an ABA counter in the
+// high 32 bits, so Acquire() and Release() are a single CAS when uncontended.
+// Pool jobs never outnumber the slots so Acquire() does not normally wait.
+class CometSlotPool
+{
+public:
+   CometSlotPool()
+      : _ullHead(0), _piNext(NULL), _iNumSlots(0), _iNumWaiters(0)
+   {
+   }
+
+   ~CometSlotPool()
+   {
+      Free();
+   }
+
+   // Creates iNumSlots slots, all free.
+   void Init(int iNumSlots)
+   {
+      Free();
+      _iNumSlots = iNumSlots;
+      _piNext = new std::atomic<unsigned int>[iNumSlots];
+      for (int i = 0; i < iNumSlots; ++i)
+         _piNext[i].store((unsigned int)(i + 2 <= iNumSlots ? i + 2 : 0), std::memory_order_relaxed);
+      _ullHead.store(iNumSlots > 0 ? 1 : 0, std::memory_order_release);
+   }
+
+   void Free()
+   {
+      delete[] _piNext;
+      _piNext = NULL;
+      _iNumSlots = 0;
+      _ullHead.store(0, std::memory_order_relaxed);
+   }
+
+   // Returns a free slot index.  If every slot is held (a caller outside the
+   // thread pool competing with pool jobs) it sleeps until Release() signals a
+   // free slot; returns -1 if that takes longer than tTimeout.
+   int Acquire(std::chrono::seconds tTimeout = std::chrono::seconds(240))
+   {
+      int iSlot = TryAcquire();
+      if (iSlot >= 0)
+         return iSlot;
+
+      std::unique_lock<std::mutex> lock(_waitMutex);
+
+      // Registered before checking again, so a Release() that this check misses
+      // sees the waiter and signals once the wait has started.
+      _iNumWaiters.fetch_add(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+
+      bool bAcquired = _waitCond.wait_for(lock, tTimeout, [this, &iSlot]() { return (iSlot = TryAcquire()) >= 0; });
+
+      _iNumWaiters.fetch_sub(1, std::memory_order_relaxed);
+
+      return (bAcquired ? iSlot : -1);
+   }
+
+   int TryAcquire()
+   {
+      unsigned long long ullHead = _ullHead.load(std::memory_order_acquire);
+
+      while ((ullHead & 0xFFFFFFFFULL) != 0)
+      {
+         unsigned int uiTop = (unsigned int)(ullHead & 0xFFFFFFFFULL);
+         unsigned long long ullNew = (((ullHead >> 32) + 1) << 32)
+            | _piNext[uiTop - 1].load(std::memory_order_relaxed);
+
+         if (_ullHead.compare_exchange_weak(ullHead, ullNew, std::memory_order_acquire, std::memory_order_acquire))
+            return (int)uiTop - 1;
+      }
+
+      return -1;
+   }
+
+   void Release(int iSlot)
+   {
+      unsigned long long ullHead = _ullHead.load(std::memory_order_relaxed);
+      unsigned long long ullNew;
+
+      do
+      {
+         _piNext[iSlot].store((unsigned int)(ullHead & 0xFFFFFFFFULL), std::memory_order_relaxed);
+         ullNew = (((ullHead >> 32) + 1) << 32) | (unsigned int)(iSlot + 1);
+      } while (!_ullHead.compare_exchange_weak(ullHead, ullNew, std::memory_order_release, std::memory_order_relaxed));
+
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (_iNumWaiters.load(std::memory_order_relaxed) > 0)
+      {
+         std::lock_guard<std::mutex> lock(_waitMutex);
+         _waitCond.notify_one();
+      }
+   }
+
+   int NumSlots() const                    { return _iNumSlots; }
+
+private:
+   CometSlotPool(const CometSlotPool&);
+   CometSlotPool& operator=(const CometSlotPool&);
+
+   std::atomic<unsigned long long> _ullHead;
+   std::atomic<unsigned int>* _piNext;      // next free slot + 1 below each slot on the stack
+   int _iNumSlots;
+
+   // Acquire() calls sleeping until a slot is released; only used when the pool is empty
+   std::atomic<int> _iNumWaiters;
+   std::mutex _waitMutex;
+   std::condition_variable _waitCond;
+};
+
+// Search-time order of one _pResults or _pDecoys array, maintained by StorePeptide.
+// piHeap is a binary min-heap of entry indices whose root is the next entry to be
+// replaced; stored peptides are also chained by sequence hash, in index order, so
+// CheckDuplicate only compares entries that can hold the same sequence.
+struct StoredResultsOrder
+{
+   int *piHeap;        // iNumStored entry indices; start of the one allocation
+   int *piHeapPos;     // position of each entry in piHeap
+   int *piHashNext;    // next entry in the same hash bucket, -1 terminated
+   int *piHashHead;    // first entry of each hash bucket, -1 if empty
+   int  iHashMask;     // number of hash buckets - 1
+
+   StoredResultsOrder()
+   {
+      piHeap = NULL;
+      piHeapPos = NULL;
+      piHashNext = NULL;
+      piHashHead = NULL;
+      iHashMask = 0;
+   }
+
+   // Number of ints needed for iNumStored entries.
+   static size_t BlockSize(int iNumStored,
+                           int *piNumBuckets)
+   {
+      int iNumBuckets = 1;
+
+      while (iNumBuckets < 2 * iNumStored)
+         iNumBuckets <<= 1;
+
+      *piNumBuckets = iNumBuckets;
+      return 3 * (size_t)iNumStored + iNumBuckets;
+   }
+
+   // Carves the tables out of one block of BlockSize() ints.
+   void SetBlock(int *piBlock,
+                 int iNumStored,
+                 int iNumBuckets)
+   {
+      piHeap = piBlock;
+      piHeapPos = piHeap + iNumStored;
+      piHashNext = piHeapPos + iNumStored;
+      piHashHead = piHashNext + iNumStored;
+      iHashMask = iNumBuckets - 1;
+   }
+};
+
 // Query stores information for peptide scoring and results
 // This struct is allocated for each spectrum/charge combination
 struct Query
@@ -1117,13 +1580,19 @@ struct Query
 
    double dMangoIndex;      // scan number decimal precursor value i.e. 2401.001 for scan 2401, first precursor/z pair
 
+   int iWhichInputFile;     // index into g_pvInputFiles when spectra of several input files share a batch
+
    unsigned long int  _uliNumMatchedPeptides;  // # of peptides that get scored
    unsigned long int  _uliNumMatchedDecoyPeptides;
 
-   // When true, sparse child arrays (float[SPARSE_MATRIX_SIZE]) belong to the
-   // thread-local RtsScratch pool and must NOT be delete[]'d by the destructor.
-   // Set only by PreprocessSingleSpectrumThreadLocal via PreprocessSingleSpectrumCore.
-   bool bSparseFromPool;
+   // When true, the sparse rows and row pointer tables were carved from a
+   // CometArena (g_batchArena or the RTS thread-local arena) and must NOT be
+   // delete[]'d by the destructor.
+   bool bSparseFromArena;
+
+   // When true, this Query and its _pResults/_pDecoys arrays live in
+   // g_batchArena:  release with DestroyQuery() instead of delete.
+   bool bInBatchArena;
 
    // Sparse matrix representation of data
    int iSpScoreData;    //size of sparse matrix
@@ -1131,6 +1600,9 @@ struct Query
    float **ppfSparseSpScoreData;
    float **ppfSparseFastXcorrData;
    float **ppfSparseFastXcorrDataNL;  // ppfSparseFastXcorrData with NH3, H2O contributions
+   float *pfSparseRows;               // when set, one block holding every row of the three sparse matrices
+   float *pfDenseFastXcorrData;       // when set, ppfSparseFastXcorrData rows point into this dense array
+   float *pfDenseFastXcorrDataNL;     // same for ppfSparseFastXcorrDataNL; both live in the sparse row block
 
    // Store raw peaks for AScorePro
 
@@ -1145,6 +1617,8 @@ struct Query
    SpectrumInfoInternal _spectrumInfoInternal;
    Results*             _pResults;
    Results*             _pDecoys;
+   StoredResultsOrder   _resultsOrder;
+   StoredResultsOrder   _decoysOrder;
    SpecLibResults*      _pSpecLibResults;
 
    std::chrono::high_resolution_clock::time_point tSearchStart;  // per-query search start time for iMaxIndexRunTime timeout
@@ -1176,14 +1650,20 @@ struct Query
 
       dMangoIndex = 0.0;
 
+      iWhichInputFile = 0;
+
       _uliNumMatchedPeptides = 0;
       _uliNumMatchedDecoyPeptides = 0;
 
-      bSparseFromPool = false;
+      bSparseFromArena = false;
+      bInBatchArena = false;
 
       ppfSparseSpScoreData = NULL;
       ppfSparseFastXcorrData = NULL;
       ppfSparseFastXcorrDataNL = NULL;          // ppfSparseFastXcorrData with NH3, H2O contributions
+      pfSparseRows = NULL;
+      pfDenseFastXcorrData = NULL;
+      pfDenseFastXcorrDataNL = NULL;
 
       vfRawFragmentPeakMass.clear();
       vRawFragmentPeakMassIntensity.clear();
@@ -1211,7 +1691,16 @@ struct Query
    ~Query()
    {
       int i;
-      if (!bSparseFromPool)
+      bool bDeleteRows = (!bSparseFromArena && pfSparseRows == NULL);  // rows allocated one at a time
+
+      if (bSparseFromArena)
+      {
+         ppfSparseSpScoreData = NULL;
+         ppfSparseFastXcorrData = NULL;
+         ppfSparseFastXcorrDataNL = NULL;
+      }
+
+      if (bDeleteRows)
       {
          for (i = 0; i < iSpScoreData; ++i)
          {
@@ -1227,7 +1716,7 @@ struct Query
                || g_staticParams.ionInformation.iIonVal[ION_SERIES_B]
                || g_staticParams.ionInformation.iIonVal[ION_SERIES_Y]))
       {
-         if (!bSparseFromPool)
+         if (bDeleteRows)
          {
             for (i = 0; i < iFastXcorrDataSize; ++i)
             {
@@ -1242,7 +1731,7 @@ struct Query
       }
       else
       {
-         if (!bSparseFromPool)
+         if (bDeleteRows)
          {
             for (i = 0; i < iFastXcorrDataSize; ++i)
             {
@@ -1254,18 +1743,31 @@ struct Query
       delete[] ppfSparseFastXcorrData;
       ppfSparseFastXcorrData = NULL;
 
-      _pResults->pWhichProtein.clear();
-      if (g_staticParams.options.iDecoySearch == 1)
-         _pResults->pWhichDecoyProtein.clear();
-      delete[] _pResults;
-      _pResults = NULL;
+      delete[] pfSparseRows;
+      pfSparseRows = NULL;
 
-      if (g_staticParams.options.iDecoySearch == 2)
+      if (bInBatchArena)
       {
-         _pDecoys->pWhichDecoyProtein.clear();
+         // arena storage is reclaimed by g_batchArena.Reset(); only run the destructors
+         for (i = 0; i < g_staticParams.options.iNumStored; ++i)
+         {
+            if (_pResults != NULL)
+               _pResults[i].~Results();
+            if (_pDecoys != NULL)
+               _pDecoys[i].~Results();
+         }
+      }
+      else
+      {
+         delete[] _pResults;
          delete[] _pDecoys;
-         _pDecoys = NULL;
+         delete[] _resultsOrder.piHeap;
+         delete[] _decoysOrder.piHeap;
       }
+      _pResults = NULL;
+      _pDecoys = NULL;
+      _resultsOrder.piHeap = NULL;
+      _decoysOrder.piHeap = NULL;
 
       Threading::DestroyMutex(accessMutex);
    }
@@ -1307,12 +1809,21 @@ struct QueryMS1
 };
 
 extern vector<Query*>          g_pvQuery;
+extern CometArena              g_batchArena;   // Query objects, results and sparse rows of the current batch
+
+// Deletes a Query from either the heap or g_batchArena.
+inline void DestroyQuery(Query *pQuery)
+{
+   if (pQuery->bInBatchArena)
+      pQuery->~Query();
+   else
+      delete pQuery;
+}
+
 extern vector<QueryMS1*>       g_pvQueryMS1;
 extern vector<InputFileInfo*>  g_pvInputFiles;
 extern Mutex                   g_pvQueryMutex;
 extern Mutex                   g_pvDBIndexMutex;
-extern Mutex                   g_preprocessMemoryPoolMutex;
-extern Mutex                   g_searchMemoryPoolMutex;
 extern Mutex                   g_dbIndexMutex;
 extern Mutex                   g_vSpecLibMutex;
 
@@ -19,12 +19,21 @@
 #include "CometStatus.h"
 #include "CometMassSpecUtils.h"
 #include "CometModificationsPermuter.h"
+#include "CometSearchBench.h"
 
 #include <cstdio>
 #include <iostream>
 #include <sstream>
 #include <bitset>
 #include <limits>
+#include <cstddef>
+#include <cerrno>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
 
 
 vector<ModificationNumber> MOD_NUMBERS;
@@ -35,11 +44,55 @@ int* PEPTIDE_MOD_SEQ_IDXS;  // Index into the MOD_SEQS vector; -1 for peptides t
 int MOD_NUM = 0;
 size_t tTmp;
 
-Mutex CometFragmentIndex::_vFragmentPeptidesMutex;
-
-// Temporary write-position array used only during the index fill pass.
-// Initialized to g_iFragmentIndexOffset[0..n-1] before filling, freed after.
-static unsigned int* s_iWritePos = nullptr;
+char* CometFragmentIndex::_pcFragmentIndexMap = NULL;
+size_t CometFragmentIndex::_tFragmentIndexMapSize = 0;
+const FragmentIndexRawPeptide* CometFragmentIndex::_pRawPeptideMap = NULL;
+const char* CometFragmentIndex::_pcRawSequenceMap = NULL;
+const unsigned long long* CometFragmentIndex::_pullModSeqOffset = NULL;
+const char* CometFragmentIndex::_pcModSeqMap = NULL;
+const unsigned long long* CometFragmentIndex::_pullModNumberOffset = NULL;
+const char* CometFragmentIndex::_pcModNumberMap = NULL;
+
+// .fidx fragment index file:  header, then g_iFragmentIndexOffset, g_iFragmentIndex
+// (or g_ullFragmentIndexPackedOffset and g_ucFragmentIndexPacked if compressed),
+// g_uiFragmentSlabPeptide (slab layout only) and the fragment peptides.  These are
+// followed by the tables of the .idx file that scoring needs:  the raw peptides and
+// their sequences, PEPTIDE_MOD_SEQ_IDXS, MOD_SEQS, MOD_NUMBERS and g_pvProteinsList,
+// each variable length table as an offset array plus its data.  Every section
+// starts on an 8 byte boundary.
+#define FIDX_MAGIC   "CometFI"
+#define FIDX_VERSION 5
+
+struct FragmentIndexCacheHeader
+{
+   char szMagic[8];
+   unsigned int uiVersion;
+   unsigned int uiSizeFragmentPeptide;    // sizeof(FragmentPeptidesStruct) of the writer
+   long long llIdxFileSize;               // size and modification time of the .idx file
+   long long llIdxFileTime;
+   double dInverseBinWidth;
+   double dOneMinusBinOffset;
+   double dFragIndexMinMass;
+   double dFragIndexMaxMass;
+   double dMinMass;                       // g_massRange peptide mass range
+   double dMaxMass;
+   double dFragIndexSlabWidth;
+   uint64_t ulParamsHash;                 // hash of residue masses and variable mod settings
+   unsigned int uiMaxFragmentArrayIndex;
+   unsigned int uiCompress;               // fragindex_compress
+   uint64_t ulNumEntries;                 // number of g_iFragmentIndex entries
+   uint64_t ulNumFragmentPeptides;        // number of g_vFragmentPeptides entries
+   uint64_t ulNumSlabs;                   // g_uiNumFragmentSlabs
+   uint64_t ulNumPackedBytes;             // size of g_ucFragmentIndexPacked including padding; 0 if not compressed
+   uint64_t ulNumRawPeptides;             // g_vRawPeptides
+   uint64_t ulRawSequenceBytes;
+   uint64_t ulNumModSeqs;                 // MOD_SEQS
+   uint64_t ulModSeqBytes;
+   uint64_t ulNumModNumbers;              // MOD_NUMBERS
+   uint64_t ulModNumberBytes;
+   uint64_t ulNumProteinLists;            // g_pvProteinsList
+   uint64_t ulNumProteinEntries;
+};
 
 
 #ifdef _WIN32
@@ -64,20 +117,545 @@ CometFragmentIndex::~CometFragmentIndex()
 
 bool CometFragmentIndex::CreateFragmentIndex(ThreadPool *tp)
 {
+   // The fragment index only depends on the .idx file and search parameters when it
+   // is not restricted to the precursors read from the input files.  In that case
+   // reuse (or create) the .fidx sidecar file.
+   bool bUseCache = g_staticParams.options.iFragIndexCache && g_staticParams.options.iFragIndexSkipReadPrecursors;
+
    if (!g_bPlainPeptideIndexRead)
+   {
+      // A valid .fidx file holds everything the search needs from the .idx file
+      // except the search settings in its header, so nothing else is parsed.
+      if (bUseCache && ReadFragmentIndexCache())
+      {
+         g_bPlainPeptideIndexRead = true;
+         return true;
+      }
+
+      auto tStartTime = chrono::steady_clock::now();
+      if (!g_staticParams.options.bOutputSqtStream)
+      {
+         cout <<  " - read .idx ... ";
+         fflush(stdout);
+      }
+
       ReadPlainPeptideIndex();
 
+      if (!g_staticParams.options.bOutputSqtStream)
+         cout << CometMassSpecUtils::ElapsedTime(tStartTime) << endl;
+   }
+
    // vFragmentPeptides is vector of modified peptides
    // - raw peptide via iWhichPeptide referencing entry in g_vRawPeptides to access peptide and protein(s)
    // - modification encoding index
    // - modification mass
 
-   // CSR layout: allocate offset array now (size+1 for sentinel); flat data allocated after counting.
-   g_iFragmentIndexOffset = new unsigned int[g_massRange.uiMaxFragmentArrayIndex + 1]();
-
    // generate the modified peptides to calculate the fragment index
    GenerateFragmentIndex(tp);
 
+   if (bUseCache)
+      WriteFragmentIndexCache();
+
+   return true;
+}
+
+
+void CometFragmentIndex::DeleteFragmentIndex(void)
+{
+   if (_pcFragmentIndexMap != NULL)
+   {
+#ifdef _WIN32
+      UnmapViewOfFile(_pcFragmentIndexMap);
+#else
+      munmap(_pcFragmentIndexMap, _tFragmentIndexMapSize);
+#endif
+      _pcFragmentIndexMap = NULL;
+      _tFragmentIndexMapSize = 0;
+
+      // the .idx tables were in the mapping too so the .idx has to be read again
+      PEPTIDE_MOD_SEQ_IDXS = NULL;
+      g_bPlainPeptideIndexRead = false;
+   }
+   else
+   {
+      delete[] g_iFragmentIndex;
+      delete[] g_iFragmentIndexOffset;
+      delete[] g_uiFragmentSlabPeptide;
+      delete[] g_ucFragmentIndexPacked;
+      delete[] g_ullFragmentIndexPackedOffset;
+   }
+
+   g_iFragmentIndex = NULL;
+   g_iFragmentIndexOffset = NULL;
+   g_uiFragmentSlabPeptide = NULL;
+   g_ucFragmentIndexPacked = NULL;
+   g_ullFragmentIndexPackedOffset = NULL;
+   g_uiNumFragmentSlabs = 1;
+   g_pFragmentPeptides = g_vFragmentPeptides.data();
+   g_tNumFragmentPeptides = g_vFragmentPeptides.size();
+   g_pullMappedProteinListOffset = NULL;
+   g_plMappedProteinList = NULL;
+   _pRawPeptideMap = NULL;
+   _pcRawSequenceMap = NULL;
+   _pullModSeqOffset = NULL;
+   _pcModSeqMap = NULL;
+   _pullModNumberOffset = NULL;
+   _pcModNumberMap = NULL;
+}
+
+
+// .fidx sidecar file name:  "db.fasta.idx" -> "db.fasta.fidx"
+string CometFragmentIndex::FragmentIndexCacheFile(void)
+{
+   string strIndexFile = g_staticParams.databaseInfo.szDatabase;
+
+   if (strIndexFile.length() >= 4 && !strIndexFile.compare(strIndexFile.length() - 4, 4, ".idx"))
+      strIndexFile.erase(strIndexFile.length() - 4);
+
+   return strIndexFile + ".fidx";
+}
+
+
+// Fingerprint of the .idx file and every parameter that changes the content of the
+// fragment index.  Anything that does not match forces a rebuild of the .fidx file.
+static void SetFragmentIndexCacheHeader(FragmentIndexCacheHeader *pHeader,
+                                        const string& strIndexFile)
+{
+   memset(pHeader, 0, sizeof(FragmentIndexCacheHeader));
+
+   memcpy(pHeader->szMagic, FIDX_MAGIC, sizeof(pHeader->szMagic));
+   pHeader->uiVersion = FIDX_VERSION;
+   pHeader->uiSizeFragmentPeptide = (unsigned int)sizeof(FragmentPeptidesStruct);
+
+#ifdef _WIN32
+   struct _stat64 statIdx;
+   if (_stat64(strIndexFile.c_str(), &statIdx) == 0)
+#else
+   struct stat statIdx;
+   if (stat(strIndexFile.c_str(), &statIdx) == 0)
+#endif
+   {
+      pHeader->llIdxFileSize = (long long)statIdx.st_size;
+      pHeader->llIdxFileTime = (long long)statIdx.st_mtime;
+   }
+
+   pHeader->dInverseBinWidth = g_staticParams.dInverseBinWidth;
+   pHeader->dOneMinusBinOffset = g_staticParams.dOneMinusBinOffset;
+   pHeader->dFragIndexMinMass = g_staticParams.options.dFragIndexMinMass;
+   pHeader->dFragIndexMaxMass = g_staticParams.options.dFragIndexMaxMass;
+   pHeader->dMinMass = g_massRange.dMinMass;
+   pHeader->dMaxMass = g_massRange.dMaxMass;
+   pHeader->dFragIndexSlabWidth = g_staticParams.options.dFragIndexSlabWidth;
+   pHeader->uiMaxFragmentArrayIndex = g_massRange.uiMaxFragmentArrayIndex;
+   pHeader->uiCompress = (g_staticParams.options.iFragIndexCompress ? 1 : 0);
+
+   // FNV-1a hash of the mass and modification settings used in PermuteIndexPeptideMods()
+   // and AddFragments()
+   uint64_t ulHash = 14695981039346656037ULL;
+   auto HashBytes = [&ulHash](const void *pData, size_t tLen)
+   {
+      const unsigned char *p = (const unsigned char *)pData;
+      for (size_t i = 0; i < tLen; ++i)
+      {
+         ulHash ^= p[i];
+         ulHash *= 1099511628211ULL;
+      }
+   };
+
+   HashBytes(g_staticParams.massUtility.pdAAMassFragment, sizeof(g_staticParams.massUtility.pdAAMassFragment));
+   HashBytes(&g_staticParams.precalcMasses.dNtermProton, sizeof(double));
+   HashBytes(&g_staticParams.precalcMasses.dCtermOH2Proton, sizeof(double));
+   HashBytes(&g_staticParams.precalcMasses.dOH2ProtonCtermNterm, sizeof(double));
+   HashBytes(&g_staticParams.variableModParameters.bVarTermModSearch, sizeof(bool));
+   HashBytes(&g_staticParams.variableModParameters.bVarModProteinFilter, sizeof(bool));
+   HashBytes(&g_staticParams.variableModParameters.iRequireVarMod, sizeof(int));
+   HashBytes(&g_staticParams.variableModParameters.iMaxVarModPerPeptide, sizeof(int));
+   HashBytes(&g_staticParams.options.peptideLengthRange.iStart, sizeof(int));
+   HashBytes(&g_staticParams.options.peptideLengthRange.iEnd, sizeof(int));
+   for (int i = 0; i < FRAGINDEX_VMODS; ++i)
+   {
+      HashBytes(&g_staticParams.variableModParameters.varModList[i].dVarModMass, sizeof(double));
+      HashBytes(&g_staticParams.variableModParameters.varModList[i].bNtermMod, sizeof(bool));
+      HashBytes(&g_staticParams.variableModParameters.varModList[i].bCtermMod, sizeof(bool));
+      HashBytes(&g_staticParams.variableModParameters.varModList[i].iMaxNumVarModAAPerMod, sizeof(int));
+      HashBytes(&g_staticParams.variableModParameters.varModList[i].iRequireThisMod, sizeof(int));
+      HashBytes(g_staticParams.variableModParameters.varModList[i].szVarModChar,
+         strlen(g_staticParams.variableModParameters.varModList[i].szVarModChar));
+   }
+   pHeader->ulParamsHash = ulHash;
+}
+
+
+// Start of each .fidx section, derived from the counts in the header.
+struct FragmentIndexCacheLayout
+{
+   size_t tNumOffsets;             // entries of g_iFragmentIndexOffset
+   size_t tPosOffsets;
+   size_t tPosEntries;             // g_iFragmentIndex, or g_ullFragmentIndexPackedOffset if compressed
+   size_t tPosPacked;
+   size_t tPosSlabPeptide;
+   size_t tPosPeptides;
+   size_t tPosRawPeptides;
+   size_t tPosRawSequences;
+   size_t tPosModSeqIdx;
+   size_t tPosModSeqOffset;
+   size_t tPosModSeq;
+   size_t tPosModNumberOffset;
+   size_t tPosModNumber;
+   size_t tPosProteinListOffset;
+   size_t tPosProteinList;
+   size_t tPosEnd;
+};
+
+
+// Section offsets are rounded up to 8 bytes so the mapped arrays are aligned.
+static size_t FragmentIndexCacheAlign(size_t tPos)
+{
+   return (tPos + 7) & ~((size_t)7);
+}
+
+
+static void SetFragmentIndexCacheLayout(const FragmentIndexCacheHeader *pHeader,
+                                        FragmentIndexCacheLayout *pLayout)
+{
+   size_t tNumSlabs = (size_t)pHeader->ulNumSlabs;
+   size_t tPos = sizeof(FragmentIndexCacheHeader);
+
+   // each section starts at the aligned end of the previous one
+   auto NextSection = [&tPos](size_t tLen)
+   {
+      size_t tStart = FragmentIndexCacheAlign(tPos);
+      tPos = tStart + tLen;
+      return tStart;
+   };
+
+   pLayout->tNumOffsets = tNumSlabs * pHeader->uiMaxFragmentArrayIndex + 1;
+   pLayout->tPosOffsets = NextSection(sizeof(unsigned int) * pLayout->tNumOffsets);
+   if (pHeader->uiCompress)
+   {
+      pLayout->tPosEntries = NextSection(sizeof(unsigned long long) * pLayout->tNumOffsets);
+      pLayout->tPosPacked = NextSection((size_t)pHeader->ulNumPackedBytes);
+   }
+   else
+   {
+      pLayout->tPosEntries = NextSection(sizeof(unsigned int) * (size_t)pHeader->ulNumEntries);
+      pLayout->tPosPacked = 0;
+   }
+   pLayout->tPosSlabPeptide = NextSection(tNumSlabs > 1 ? sizeof(unsigned int) * (tNumSlabs + 1) : 0);
+   pLayout->tPosPeptides = NextSection(sizeof(FragmentPeptidesStruct) * (size_t)pHeader->ulNumFragmentPeptides);
+   pLayout->tPosRawPeptides = NextSection(sizeof(FragmentIndexRawPeptide) * (size_t)pHeader->ulNumRawPeptides);
+   pLayout->tPosRawSequences = NextSection((size_t)pHeader->ulRawSequenceBytes);
+   pLayout->tPosModSeqIdx = NextSection(sizeof(int) * (size_t)pHeader->ulNumRawPeptides);
+   pLayout->tPosModSeqOffset = NextSection(sizeof(unsigned long long) * ((size_t)pHeader->ulNumModSeqs + 1));
+   pLayout->tPosModSeq = NextSection((size_t)pHeader->ulModSeqBytes);
+   pLayout->tPosModNumberOffset = NextSection(sizeof(unsigned long long) * ((size_t)pHeader->ulNumModNumbers + 1));
+   pLayout->tPosModNumber = NextSection((size_t)pHeader->ulModNumberBytes);
+   pLayout->tPosProteinListOffset = NextSection(sizeof(unsigned long long) * ((size_t)pHeader->ulNumProteinLists + 1));
+   pLayout->tPosProteinList = NextSection(sizeof(comet_fileoffset_t) * (size_t)pHeader->ulNumProteinEntries);
+   pLayout->tPosEnd = tPos;
+}
+
+
+// Map the .fidx file read-only and point the CSR arrays, the fragment peptides and
+// the .idx tables directly into the mapping.  Only the header of the .idx file is
+// read, for the search settings.  The pages are shared by all processes searching
+// against the same index and are only read in as the search touches them.
+bool CometFragmentIndex::ReadFragmentIndexCache(void)
+{
+   string strCacheFile = FragmentIndexCacheFile();
+   string strIndexFile = g_staticParams.databaseInfo.szDatabase;
+
+   auto tStartTime = chrono::steady_clock::now();
+
+   char *pcMap = NULL;
+   size_t tMapSize = 0;
+
+#ifdef _WIN32
+   HANDLE hFile = CreateFileA(strCacheFile.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+   if (hFile == INVALID_HANDLE_VALUE)
+      return false;
+
+   LARGE_INTEGER liSize;
+   if (GetFileSizeEx(hFile, &liSize))
+      tMapSize = (size_t)liSize.QuadPart;
+
+   if (tMapSize >= sizeof(FragmentIndexCacheHeader))
+   {
+      HANDLE hMap = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+      if (hMap != NULL)
+      {
+         pcMap = (char *)MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, 0);
+         CloseHandle(hMap);  // view keeps the mapping alive
+      }
+   }
+   CloseHandle(hFile);
+#else
+   int fd = open(strCacheFile.c_str(), O_RDONLY);
+   if (fd < 0)
+      return false;
+
+   struct stat statCache;
+   if (fstat(fd, &statCache) == 0)
+      tMapSize = (size_t)statCache.st_size;
+
+   if (tMapSize >= sizeof(FragmentIndexCacheHeader))
+   {
+      void *pMap = mmap(NULL, tMapSize, PROT_READ, MAP_SHARED, fd, 0);
+      if (pMap != MAP_FAILED)
+         pcMap = (char *)pMap;
+   }
+   close(fd);
+#endif
+
+   if (pcMap == NULL)
+      return false;
+
+   auto UnmapCache = [pcMap, tMapSize]()
+   {
+#ifdef _WIN32
+      UnmapViewOfFile(pcMap);
+#else
+      munmap(pcMap, tMapSize);
+#endif
+   };
+
+   // The fingerprint covers the search settings, which come from the .idx header.
+   FILE *fp;
+   if ((fp = fopen(strIndexFile.c_str(), "rb")) == NULL)
+   {
+      UnmapCache();
+      return false;
+   }
+
+   // The header adds its static mods to the residue masses.  If the cache is rejected,
+   // ReadPlainPeptideIndex() reads the header again so put the settings back first.
+   StaticParams savedStaticParams;
+   savedStaticParams = g_staticParams;
+
+   bool bHeaderRead = ReadPlainPeptideIndexHeader(fp);
+   fclose(fp);
+
+   if (!bHeaderRead)
+   {
+      g_staticParams = savedStaticParams;
+      UnmapCache();
+      return false;
+   }
+
+   FragmentIndexCacheHeader sExpected;
+   SetFragmentIndexCacheHeader(&sExpected, strIndexFile);
+
+   const FragmentIndexCacheHeader *pHeader = (const FragmentIndexCacheHeader *)pcMap;
+   FragmentIndexCacheLayout sLayout;
+
+   // compare everything except the counts which are only known after building the index
+   bool bValid = !memcmp(pHeader, &sExpected, offsetof(FragmentIndexCacheHeader, ulNumEntries)) && pHeader->ulNumSlabs >= 1;
+   if (bValid)
+   {
+      SetFragmentIndexCacheLayout(pHeader, &sLayout);
+      bValid = (sLayout.tPosEnd == tMapSize);
+   }
+
+   if (!bValid)
+   {
+      g_staticParams = savedStaticParams;
+      UnmapCache();
+      if (!g_staticParams.options.bOutputSqtStream)
+         cout << " - fragment ion index file " << strCacheFile << " is stale; regenerating" << endl;
+      return false;
+   }
+
+   if (!g_staticParams.options.bOutputSqtStream)
+   {
+      cout << " - map fragment ion index " << strCacheFile << " ... ";
+      fflush(stdout);
+   }
+
+   _pcFragmentIndexMap = pcMap;
+   _tFragmentIndexMapSize = tMapSize;
+
+   g_iFragmentIndexOffset = (unsigned int *)(pcMap + sLayout.tPosOffsets);
+   if (pHeader->uiCompress)
+   {
+      g_ullFragmentIndexPackedOffset = (unsigned long long *)(pcMap + sLayout.tPosEntries);
+      g_ucFragmentIndexPacked = (unsigned char *)(pcMap + sLayout.tPosPacked);
+   }
+   else
+      g_iFragmentIndex = (unsigned int *)(pcMap + sLayout.tPosEntries);
+   g_uiNumFragmentSlabs = (unsigned int)pHeader->ulNumSlabs;
+   if (g_uiNumFragmentSlabs > 1)
+      g_uiFragmentSlabPeptide = (unsigned int *)(pcMap + sLayout.tPosSlabPeptide);
+
+   g_pFragmentPeptides = (const FragmentPeptidesStruct *)(pcMap + sLayout.tPosPeptides);
+   g_tNumFragmentPeptides = (size_t)pHeader->ulNumFragmentPeptides;
+
+   _pRawPeptideMap = (const FragmentIndexRawPeptide *)(pcMap + sLayout.tPosRawPeptides);
+   _pcRawSequenceMap = pcMap + sLayout.tPosRawSequences;
+   PEPTIDE_MOD_SEQ_IDXS = (int *)(pcMap + sLayout.tPosModSeqIdx);
+   _pullModSeqOffset = (const unsigned long long *)(pcMap + sLayout.tPosModSeqOffset);
+   _pcModSeqMap = pcMap + sLayout.tPosModSeq;
+   _pullModNumberOffset = (const unsigned long long *)(pcMap + sLayout.tPosModNumberOffset);
+   _pcModNumberMap = pcMap + sLayout.tPosModNumber;
+   g_pullMappedProteinListOffset = (const unsigned long long *)(pcMap + sLayout.tPosProteinListOffset);
+   g_plMappedProteinList = (const comet_fileoffset_t *)(pcMap + sLayout.tPosProteinList);
+
+   if (!g_staticParams.options.bOutputSqtStream)
+   {
+      cout << CometMassSpecUtils::ElapsedTime(tStartTime) << endl;
+
+      if (g_tNumFragmentPeptides > 1e6)
+         printf("   - %0.3e total peptides, ", (double)g_tNumFragmentPeptides);
+      else
+         printf("   - %zu total peptides, ", g_tNumFragmentPeptides);
+      if (pHeader->ulNumEntries > 1e6)
+         printf("%0.3e FI entries\n", (double)pHeader->ulNumEntries);
+      else
+         printf("%llu FI entries\n", (unsigned long long)pHeader->ulNumEntries);
+   }
+
+   return true;
+}
+
+
+// Write the freshly generated fragment index to the .fidx file.  The file is written
+// to a temporary name and renamed so concurrent processes never map a partial file.
+// Failure to write (e.g. read-only database directory) is reported as a warning but
+// is not an error; the index is simply rebuilt next time.
+bool CometFragmentIndex::WriteFragmentIndexCache(void)
+{
+   string strCacheFile = FragmentIndexCacheFile();
+   string strTmpFile = strCacheFile + ".tmp" + std::to_string((long long)chrono::steady_clock::now().time_since_epoch().count());
+   FILE *fp;
+
+   // .idx tables flattened to the mapped layout
+   vector<FragmentIndexRawPeptide> vRawPeptides(g_vRawPeptides.size());
+   string strRawSequences;
+   for (size_t i = 0; i < g_vRawPeptides.size(); ++i)
+   {
+      FragmentIndexRawPeptide& rawPeptide = vRawPeptides[i];
+
+      memset(&rawPeptide, 0, sizeof(FragmentIndexRawPeptide));
+      rawPeptide.ulSequence = strRawSequences.size();
+      rawPeptide.lIndexProteinFilePosition = g_vRawPeptides[i].lIndexProteinFilePosition;
+      rawPeptide.cPrevAA = g_vRawPeptides[i].cPrevAA;
+      rawPeptide.cNextAA = g_vRawPeptides[i].cNextAA;
+      strRawSequences.append(g_vRawPeptides[i].sPeptide.c_str(), g_vRawPeptides[i].sPeptide.size() + 1);
+   }
+
+   vector<unsigned long long> vullModSeqOffset;
+   string strModSeqs;
+   for (size_t i = 0; i < MOD_SEQS.size(); ++i)
+   {
+      vullModSeqOffset.push_back(strModSeqs.size());
+      strModSeqs.append(MOD_SEQS[i].c_str(), MOD_SEQS[i].size() + 1);
+   }
+   vullModSeqOffset.push_back(strModSeqs.size());
+
+   vector<unsigned long long> vullModNumberOffset;
+   string strModNumbers;
+   for (size_t i = 0; i < MOD_NUMBERS.size(); ++i)
+   {
+      vullModNumberOffset.push_back(strModNumbers.size());
+      strModNumbers.append(MOD_NUMBERS[i].modifications, MOD_NUMBERS[i].modStringLen);
+   }
+   vullModNumberOffset.push_back(strModNumbers.size());
+
+   vector<unsigned long long> vullProteinListOffset;
+   size_t tNumProteinEntries = 0;
+   for (size_t i = 0; i < g_pvProteinsList.size(); ++i)
+   {
+      vullProteinListOffset.push_back(tNumProteinEntries);
+      tNumProteinEntries += g_pvProteinsList[i].size();
+   }
+   vullProteinListOffset.push_back(tNumProteinEntries);
+
+   FragmentIndexCacheHeader sHeader;
+   SetFragmentIndexCacheHeader(&sHeader, g_staticParams.databaseInfo.szDatabase);
+   size_t tNumOffsets = (size_t)g_uiNumFragmentSlabs * g_massRange.uiMaxFragmentArrayIndex + 1;
+   sHeader.ulNumEntries = g_iFragmentIndexOffset[tNumOffsets - 1];
+   sHeader.ulNumFragmentPeptides = g_tNumFragmentPeptides;
+   sHeader.ulNumSlabs = g_uiNumFragmentSlabs;
+   if (g_ucFragmentIndexPacked != NULL)
+      sHeader.ulNumPackedBytes = g_ullFragmentIndexPackedOffset[tNumOffsets - 1] + FRAGINDEX_PACK_PAD;
+   sHeader.ulNumRawPeptides = vRawPeptides.size();
+   sHeader.ulRawSequenceBytes = strRawSequences.size();
+   sHeader.ulNumModSeqs = MOD_SEQS.size();
+   sHeader.ulModSeqBytes = strModSeqs.size();
+   sHeader.ulNumModNumbers = MOD_NUMBERS.size();
+   sHeader.ulModNumberBytes = strModNumbers.size();
+   sHeader.ulNumProteinLists = g_pvProteinsList.size();
+   sHeader.ulNumProteinEntries = tNumProteinEntries;
+
+   FragmentIndexCacheLayout sLayout;
+   SetFragmentIndexCacheLayout(&sHeader, &sLayout);
+
+   if ((fp = fopen(strTmpFile.c_str(), "wb")) == NULL)
+   {
+      string strErrorMsg = " Warning - cannot write fragment ion index file " + strCacheFile + ": " + strerror(errno) + "\n";
+      logerr(strErrorMsg);
+      return false;
+   }
+
+   char szPad[8] = {0};
+   size_t tPos = 0;
+   bool bOK = true;
+
+   // write each section padded to its start position in the layout
+   auto WriteSection = [&](size_t tStart, const void *pData, size_t tLen)
+   {
+      if (tStart > tPos)
+         bOK &= (fwrite(szPad, 1, tStart - tPos, fp) == tStart - tPos);
+      if (tLen > 0)
+         bOK &= (fwrite(pData, 1, tLen, fp) == tLen);
+      tPos = tStart + tLen;
+   };
+
+   WriteSection(0, &sHeader, sizeof(FragmentIndexCacheHeader));
+   WriteSection(sLayout.tPosOffsets, g_iFragmentIndexOffset, sizeof(unsigned int) * tNumOffsets);
+   if (g_ucFragmentIndexPacked != NULL)
+   {
+      WriteSection(sLayout.tPosEntries, g_ullFragmentIndexPackedOffset, sizeof(unsigned long long) * tNumOffsets);
+      WriteSection(sLayout.tPosPacked, g_ucFragmentIndexPacked, (size_t)sHeader.ulNumPackedBytes);
+   }
+   else
+      WriteSection(sLayout.tPosEntries, g_iFragmentIndex, sizeof(unsigned int) * (size_t)sHeader.ulNumEntries);
+   if (g_uiNumFragmentSlabs > 1)
+      WriteSection(sLayout.tPosSlabPeptide, g_uiFragmentSlabPeptide, sizeof(unsigned int) * ((size_t)g_uiNumFragmentSlabs + 1));
+   WriteSection(sLayout.tPosPeptides, g_pFragmentPeptides, sizeof(FragmentPeptidesStruct) * g_tNumFragmentPeptides);
+   WriteSection(sLayout.tPosRawPeptides, vRawPeptides.data(), sizeof(FragmentIndexRawPeptide) * vRawPeptides.size());
+   WriteSection(sLayout.tPosRawSequences, strRawSequences.data(), strRawSequences.size());
+   WriteSection(sLayout.tPosModSeqIdx, PEPTIDE_MOD_SEQ_IDXS, sizeof(int) * vRawPeptides.size());
+   WriteSection(sLayout.tPosModSeqOffset, vullModSeqOffset.data(), sizeof(unsigned long long) * vullModSeqOffset.size());
+   WriteSection(sLayout.tPosModSeq, strModSeqs.data(), strModSeqs.size());
+   WriteSection(sLayout.tPosModNumberOffset, vullModNumberOffset.data(), sizeof(unsigned long long) * vullModNumberOffset.size());
+   WriteSection(sLayout.tPosModNumber, strModNumbers.data(), strModNumbers.size());
+   WriteSection(sLayout.tPosProteinListOffset, vullProteinListOffset.data(), sizeof(unsigned long long) * vullProteinListOffset.size());
+   for (size_t i = 0; i < g_pvProteinsList.size(); ++i)
+   {
+      WriteSection(i == 0 ? sLayout.tPosProteinList : tPos, g_pvProteinsList[i].data(), sizeof(comet_fileoffset_t) * g_pvProteinsList[i].size());
+   }
+
+   if (fclose(fp) != 0)
+      bOK = false;
+
+   if (bOK)
+   {
+      remove(strCacheFile.c_str());  // rename() does not overwrite on Windows
+      bOK = (rename(strTmpFile.c_str(), strCacheFile.c_str()) == 0);
+   }
+
+   if (!bOK)
+   {
+      int iErrno = errno;
+      remove(strTmpFile.c_str());
+      string strErrorMsg = " Warning - cannot write fragment ion index file " + strCacheFile + ": " + strerror(iErrno) + "\n";
+      logerr(strErrorMsg);
+      return false;
+   }
+
+   if (!g_staticParams.options.bOutputSqtStream)
+      printf(" - wrote fragment ion index %s (%0.1f MB)\n", strCacheFile.c_str(), tPos / (1024.0 * 1024.0));
+
    return true;
 }
 
@@ -151,39 +729,51 @@ void CometFragmentIndex::GenerateFragmentIndex(ThreadPool *tp)
 
    auto tFIGlobalStartTime = chrono::steady_clock::now();
 
-   Threading::InitMutex(&_vFragmentPeptidesMutex);
-
    ThreadPool *pFragmentIndexPool = tp;
 
-   // Create N number of threads, each of which will iterate through
-   // a subset of peptides to calculate their fragment ions
-
-   // Sort the peptides by mass
+   // Each pass splits its input into contiguous chunks processed by the thread pool.
+   // Chunk results are always combined in chunk order so the index is identical to
+   // one built on a single thread.
+   size_t iNumThreads = pFragmentIndexPool->get_thread_count();
+   if (iNumThreads < 1)
+      iNumThreads = 1;
 
    cout <<  "   - store peptide list and reserve memory ... "; fflush(stdout);
    auto tStartTime = chrono::steady_clock::now();
-   // stupid workaround for Windows/Visual Studio performance ... first calculate all
-   // fragments to find size of each fragment on index vector
-   AddFragmentsThreadProc(1, pFragmentIndexPool);
-   pFragmentIndexPool->wait_on_threads();
 
-   // Convert per-bin counts (stored in g_iFragmentIndexOffset[0..n-1] during count pass)
-   // to CSR prefix-sum offsets, then allocate the single flat data array.
+   // Generate all modified peptides; each chunk of g_vRawPeptides gets its own list
+   // which are then concatenated in order into g_vFragmentPeptides.
    {
-      unsigned int uiTotal = 0;
-      for (unsigned int iMass = 0; iMass < g_massRange.uiMaxFragmentArrayIndex; ++iMass)
+      size_t iNumChunks = iNumThreads * 4;   // more chunks than threads to balance load
+      if (iNumChunks > g_vRawPeptides.size())
+         iNumChunks = (g_vRawPeptides.size() > 0 ? g_vRawPeptides.size() : 1);
+
+      vector<vector<FragmentPeptidesStruct>> vChunkPeptides(iNumChunks);
+
+      for (size_t iChunk = 0; iChunk < iNumChunks; ++iChunk)
       {
-         unsigned int uiCnt = g_iFragmentIndexOffset[iMass];
-         g_iFragmentIndexOffset[iMass] = uiTotal;
-         uiTotal += uiCnt;
+         size_t iStart = g_vRawPeptides.size() * iChunk / iNumChunks;
+         size_t iEnd = g_vRawPeptides.size() * (iChunk + 1) / iNumChunks;
+         vector<FragmentPeptidesStruct>* pvChunk = &vChunkPeptides[iChunk];
+
+         pFragmentIndexPool->doJob([iStart, iEnd, pvChunk]() {
+            AddFragmentsThreadProc(iStart, iEnd, pvChunk);
+         });
       }
-      g_iFragmentIndexOffset[g_massRange.uiMaxFragmentArrayIndex] = uiTotal;  // sentinel
-      g_iFragmentIndex = new unsigned int[uiTotal];
-   }
+      pFragmentIndexPool->wait_on_threads();
+
+      size_t iTotal = 0;
+      for (size_t iChunk = 0; iChunk < iNumChunks; ++iChunk)
+         iTotal += vChunkPeptides[iChunk].size();
 
-   // Initialize per-bin write positions as a copy of the base offsets.
-   s_iWritePos = new unsigned int[g_massRange.uiMaxFragmentArrayIndex];
-   memcpy(s_iWritePos, g_iFragmentIndexOffset, sizeof(unsigned int) * g_massRange.uiMaxFragmentArrayIndex);
+      g_vFragmentPeptides.clear();
+      g_vFragmentPeptides.reserve(iTotal);
+      for (size_t iChunk = 0; iChunk < iNumChunks; ++iChunk)
+      {
+         g_vFragmentPeptides.insert(g_vFragmentPeptides.end(), vChunkPeptides[iChunk].begin(), vChunkPeptides[iChunk].end());
+         vector<FragmentPeptidesStruct>().swap(vChunkPeptides[iChunk]);
+      }
+   }
 
    cout << CometMassSpecUtils::ElapsedTime(tStartTime) << endl;
 
@@ -194,6 +784,8 @@ void CometFragmentIndex::GenerateFragmentIndex(ThreadPool *tp)
       {
          return a.dPepMass < b.dPepMass;
       });
+   g_pFragmentPeptides = g_vFragmentPeptides.data();
+   g_tNumFragmentPeptides = g_vFragmentPeptides.size();
    cout << CometMassSpecUtils::ElapsedTime(tStartTime) << endl;
 
    // In the for loop below, peptide references (iWhichFragmentPeptide) are stored in the FI.
@@ -209,22 +801,144 @@ void CometFragmentIndex::GenerateFragmentIndex(ThreadPool *tp)
    // now populate the fragment index vector
    tStartTime = chrono::steady_clock::now();
    cout <<  "   - populate index ... "; fflush(stdout);
-   for (size_t iWhichFragmentPeptide = 0; iWhichFragmentPeptide < g_vFragmentPeptides.size(); ++iWhichFragmentPeptide)
+
+   SetFragmentSlabs();
+
+   if (g_uiNumFragmentSlabs == 1)
    {
-      auto& fp = g_vFragmentPeptides[iWhichFragmentPeptide];
-      AddFragments(g_vRawPeptides, fp.iWhichPeptide, iWhichFragmentPeptide, fp.modNumIdx, fp.cNtermMod, fp.cCtermMod, 0);
+      size_t iNumBins = g_massRange.uiMaxFragmentArrayIndex;
+      size_t iNumChunks = iNumThreads;
+      if (iNumChunks > g_vFragmentPeptides.size())
+         iNumChunks = (g_vFragmentPeptides.size() > 0 ? g_vFragmentPeptides.size() : 1);
+
+      // CSR layout: offset array has one extra entry for the sentinel
+      g_iFragmentIndexOffset = new unsigned int[iNumBins + 1]();
+
+      // piChunkBins holds a fragment bin histogram for each chunk of g_vFragmentPeptides
+      // during the count pass; it is then converted in place to each chunk's write
+      // cursor into g_iFragmentIndex.
+      unsigned int *piChunkBins = new unsigned int[iNumChunks * iNumBins]();
+
+      for (size_t iChunk = 0; iChunk < iNumChunks; ++iChunk)
+      {
+         size_t iStart = g_vFragmentPeptides.size() * iChunk / iNumChunks;
+         size_t iEnd = g_vFragmentPeptides.size() * (iChunk + 1) / iNumChunks;
+         unsigned int *piBins = piChunkBins + iChunk * iNumBins;
+
+         pFragmentIndexPool->doJob([iStart, iEnd, piBins]() {
+            for (size_t iWhichFragmentPeptide = iStart; iWhichFragmentPeptide < iEnd; ++iWhichFragmentPeptide)
+            {
+               auto& fp = g_vFragmentPeptides[iWhichFragmentPeptide];
+               AddFragments(g_vRawPeptides, fp.iWhichPeptide, iWhichFragmentPeptide, fp.modNumIdx, fp.cNtermMod, fp.cCtermMod,
+                  FRAGINDEX_PASS_COUNT, NULL, piBins);
+            }
+         });
+      }
+      pFragmentIndexPool->wait_on_threads();
+
+      // Prefix sum over bins, and over chunks within each bin, gives the CSR offsets and
+      // the first write position of each chunk.  Entries within a bin stay sorted by
+      // iWhichFragmentPeptide as chunks are consecutive ranges of g_vFragmentPeptides.
+      unsigned long long ullTotal = 0;
+      for (size_t iBin = 0; iBin < iNumBins; ++iBin)
+      {
+         g_iFragmentIndexOffset[iBin] = (unsigned int)ullTotal;
+
+         for (size_t iChunk = 0; iChunk < iNumChunks; ++iChunk)
+         {
+            unsigned int uiCnt = piChunkBins[iChunk * iNumBins + iBin];
+            piChunkBins[iChunk * iNumBins + iBin] = (unsigned int)ullTotal;
+            ullTotal += uiCnt;
+         }
+      }
+
+      if (ullTotal > (std::numeric_limits<unsigned int>::max)())
+      {
+         delete[] piChunkBins;
+         throw std::overflow_error(" Error: fragment index entries too large for unsigned int");
+      }
+
+      g_iFragmentIndexOffset[iNumBins] = (unsigned int)ullTotal;  // sentinel
+      g_iFragmentIndex = new unsigned int[ullTotal];
+
+      for (size_t iChunk = 0; iChunk < iNumChunks; ++iChunk)
+      {
+         size_t iStart = g_vFragmentPeptides.size() * iChunk / iNumChunks;
+         size_t iEnd = g_vFragmentPeptides.size() * (iChunk + 1) / iNumChunks;
+         unsigned int *piWritePos = piChunkBins + iChunk * iNumBins;
+
+         pFragmentIndexPool->doJob([iStart, iEnd, piWritePos]() {
+            for (size_t iWhichFragmentPeptide = iStart; iWhichFragmentPeptide < iEnd; ++iWhichFragmentPeptide)
+            {
+               auto& fp = g_vFragmentPeptides[iWhichFragmentPeptide];
+               AddFragments(g_vRawPeptides, fp.iWhichPeptide, iWhichFragmentPeptide, fp.modNumIdx, fp.cNtermMod, fp.cCtermMod,
+                  FRAGINDEX_PASS_FILL, NULL, piWritePos);
+            }
+         });
+      }
+      pFragmentIndexPool->wait_on_threads();
+
+      delete[] piChunkBins;
    }
-   pFragmentIndexPool->wait_on_threads();
-   cout << CometMassSpecUtils::ElapsedTime(tStartTime) << endl;
+   else
+   {
+      // Slab layout:  each precursor mass slab has its own CSR over the fragment bins,
+      // stored one after another.  Slabs are independent so each is counted and filled
+      // by a single job; offsets of slab iSlab are at iSlab*iNumBins.
+      size_t iNumBins = g_massRange.uiMaxFragmentArrayIndex;
+      size_t iNumOffsets = (size_t)g_uiNumFragmentSlabs * iNumBins;
 
-   // Write positions no longer needed after fill.
-   delete[] s_iWritePos;
-   s_iWritePos = nullptr;
+      g_iFragmentIndexOffset = new unsigned int[iNumOffsets + 1]();
 
-   Threading::DestroyMutex(_vFragmentPeptidesMutex);
+      for (unsigned int iSlab = 0; iSlab < g_uiNumFragmentSlabs; ++iSlab)
+      {
+         pFragmentIndexPool->doJob([iSlab, iNumBins]() {
+            unsigned int *piBins = g_iFragmentIndexOffset + (size_t)iSlab * iNumBins;
+
+            for (size_t iWhichFragmentPeptide = g_uiFragmentSlabPeptide[iSlab]; iWhichFragmentPeptide < g_uiFragmentSlabPeptide[iSlab + 1]; ++iWhichFragmentPeptide)
+            {
+               auto& fp = g_vFragmentPeptides[iWhichFragmentPeptide];
+               AddFragments(g_vRawPeptides, fp.iWhichPeptide, iWhichFragmentPeptide, fp.modNumIdx, fp.cNtermMod, fp.cCtermMod,
+                  FRAGINDEX_PASS_COUNT, NULL, piBins);
+            }
+         });
+      }
+      pFragmentIndexPool->wait_on_threads();
+
+      unsigned long long ullTotal = 0;
+      for (size_t i = 0; i < iNumOffsets; ++i)
+      {
+         unsigned int uiCnt = g_iFragmentIndexOffset[i];
+         g_iFragmentIndexOffset[i] = (unsigned int)ullTotal;
+         ullTotal += uiCnt;
+      }
+
+      if (ullTotal > (std::numeric_limits<unsigned int>::max)())
+         throw std::overflow_error(" Error: fragment index entries too large for unsigned int");
+
+      g_iFragmentIndexOffset[iNumOffsets] = (unsigned int)ullTotal;  // sentinel
+      g_iFragmentIndex = new unsigned int[ullTotal];
+
+      for (unsigned int iSlab = 0; iSlab < g_uiNumFragmentSlabs; ++iSlab)
+      {
+         pFragmentIndexPool->doJob([iSlab, iNumBins]() {
+            size_t iSlabBase = (size_t)iSlab * iNumBins;
+            vector<unsigned int> vWritePos(g_iFragmentIndexOffset + iSlabBase, g_iFragmentIndexOffset + iSlabBase + iNumBins);
+
+            for (size_t iWhichFragmentPeptide = g_uiFragmentSlabPeptide[iSlab]; iWhichFragmentPeptide < g_uiFragmentSlabPeptide[iSlab + 1]; ++iWhichFragmentPeptide)
+            {
+               auto& fp = g_vFragmentPeptides[iWhichFragmentPeptide];
+               AddFragments(g_vRawPeptides, fp.iWhichPeptide, iWhichFragmentPeptide, fp.modNumIdx, fp.cNtermMod, fp.cCtermMod,
+                  FRAGINDEX_PASS_FILL, NULL, vWritePos.data());
+            }
+         });
+      }
+      pFragmentIndexPool->wait_on_threads();
+   }
+   cout << CometMassSpecUtils::ElapsedTime(tStartTime) << endl;
 
    // Total entry count is the CSR sentinel value.
-   unsigned long long ullCount = g_iFragmentIndexOffset[g_massRange.uiMaxFragmentArrayIndex];
+   unsigned long long ullCount = g_iFragmentIndexOffset[(size_t)g_uiNumFragmentSlabs * g_massRange.uiMaxFragmentArrayIndex];
 
    if (g_vFragmentPeptides.size() > 1e6)
       printf("   - %0.3e total peptides, ", (double)g_vFragmentPeptides.size());
@@ -237,20 +951,230 @@ void CometFragmentIndex::GenerateFragmentIndex(ThreadPool *tp)
 
    cout << " ... " << CometMassSpecUtils::ElapsedTime(tFIGlobalStartTime) << endl;
 
+   if (g_staticParams.options.iFragIndexCompress)
+      CompressFragmentIndex(pFragmentIndexPool);
+}
+
+
+// Bit width needed for the largest delta in a block of sorted posting entries.
+static unsigned int PackedBlockBits(const unsigned int* puiEntries,
+                                    size_t tCount)
+{
+   unsigned int uiMaxDelta = 0;
+
+   for (size_t i = 1; i < tCount; ++i)
+   {
+      if (puiEntries[i] - puiEntries[i - 1] > uiMaxDelta)
+         uiMaxDelta = puiEntries[i] - puiEntries[i - 1];
+   }
+
+   unsigned int uiBits = 0;
+   while (uiMaxDelta)
+   {
+      uiBits++;
+      uiMaxDelta >>= 1;
+   }
+
+   return uiBits;
+}
+
+
+// Size in bytes of a posting list of tCount entries once compressed.
+static size_t PackedListSize(const unsigned int* puiEntries,
+                             size_t tCount)
+{
+   size_t tSize = 0;
+
+   for (size_t i = 0; i < tCount; i += FRAGINDEX_PACK_BLOCK)
+   {
+      size_t tBlock = (std::min)((size_t)FRAGINDEX_PACK_BLOCK, tCount - i);
+      tSize += FRAGINDEX_PACK_HEADER + (((tBlock - 1) * PackedBlockBits(puiEntries + i, tBlock) + 7) >> 3);
+   }
+
+   return tSize;
+}
+
+
+// Compress a posting list of tCount entries into pOut; see FRAGINDEX_PACK_BLOCK.
+static void PackList(const unsigned int* puiEntries,
+                     size_t tCount,
+                     unsigned char* pOut)
+{
+   for (size_t i = 0; i < tCount; i += FRAGINDEX_PACK_BLOCK)
+   {
+      size_t tBlock = (std::min)((size_t)FRAGINDEX_PACK_BLOCK, tCount - i);
+      const unsigned int* puiBlock = puiEntries + i;
+      unsigned int uiBits = PackedBlockBits(puiBlock, tBlock);
+
+      memcpy(pOut, puiBlock, sizeof(unsigned int));
+      pOut[4] = (unsigned char)uiBits;
+      pOut += FRAGINDEX_PACK_HEADER;
+
+      // deltas are written least significant bit first
+      unsigned long long ullAccum = 0;
+      unsigned int uiAccumBits = 0;
+
+      for (size_t j = 1; j < tBlock; ++j)
+      {
+         ullAccum |= (unsigned long long)(puiBlock[j] - puiBlock[j - 1]) << uiAccumBits;
+         uiAccumBits += uiBits;
+
+         while (uiAccumBits >= 8)
+         {
+            *pOut++ = (unsigned char)ullAccum;
+            ullAccum >>= 8;
+            uiAccumBits -= 8;
+         }
+      }
+
+      if (uiAccumBits > 0)
+         *pOut++ = (unsigned char)ullAccum;
+   }
+}
+
+
+// Replace g_iFragmentIndex with delta encoded, bit-packed posting lists.  Entries
+// within a list are sorted peptide indices so the deltas are small.  Lists are sized
+// and then packed in parallel; g_iFragmentIndexOffset is kept for the entry counts.
+void CometFragmentIndex::CompressFragmentIndex(ThreadPool *tp)
+{
+   auto tStartTime = chrono::steady_clock::now();
+   cout <<  "   - compress index ... "; fflush(stdout);
+
+   size_t iNumLists = (size_t)g_uiNumFragmentSlabs * g_massRange.uiMaxFragmentArrayIndex;
+   size_t iNumChunks = (std::max)((size_t)tp->get_thread_count(), (size_t)1) * 4;
+   if (iNumChunks > iNumLists)
+      iNumChunks = (iNumLists > 0 ? iNumLists : 1);
+
+   delete[] g_ullFragmentIndexPackedOffset;
+   g_ullFragmentIndexPackedOffset = new unsigned long long[iNumLists + 1];
+
+   for (size_t iChunk = 0; iChunk < iNumChunks; ++iChunk)
+   {
+      size_t iStart = iNumLists * iChunk / iNumChunks;
+      size_t iEnd = iNumLists * (iChunk + 1) / iNumChunks;
+
+      tp->doJob([iStart, iEnd]() {
+         for (size_t i = iStart; i < iEnd; ++i)
+         {
+            g_ullFragmentIndexPackedOffset[i] = PackedListSize(g_iFragmentIndex + g_iFragmentIndexOffset[i],
+               g_iFragmentIndexOffset[i + 1] - g_iFragmentIndexOffset[i]);
+         }
+      });
+   }
+   tp->wait_on_threads();
+
+   unsigned long long ullTotal = 0;
+   for (size_t i = 0; i < iNumLists; ++i)
+   {
+      unsigned long long ullSize = g_ullFragmentIndexPackedOffset[i];
+      g_ullFragmentIndexPackedOffset[i] = ullTotal;
+      ullTotal += ullSize;
+   }
+   g_ullFragmentIndexPackedOffset[iNumLists] = ullTotal;
+
+   delete[] g_ucFragmentIndexPacked;
+   g_ucFragmentIndexPacked = new unsigned char[ullTotal + FRAGINDEX_PACK_PAD];
+   memset(g_ucFragmentIndexPacked + ullTotal, 0, FRAGINDEX_PACK_PAD);
+
+   for (size_t iChunk = 0; iChunk < iNumChunks; ++iChunk)
+   {
+      size_t iStart = iNumLists * iChunk / iNumChunks;
+      size_t iEnd = iNumLists * (iChunk + 1) / iNumChunks;
+
+      tp->doJob([iStart, iEnd]() {
+         for (size_t i = iStart; i < iEnd; ++i)
+         {
+            PackList(g_iFragmentIndex + g_iFragmentIndexOffset[i], g_iFragmentIndexOffset[i + 1] - g_iFragmentIndexOffset[i],
+               g_ucFragmentIndexPacked + g_ullFragmentIndexPackedOffset[i]);
+         }
+      });
+   }
+   tp->wait_on_threads();
+
+   double dRawMB = sizeof(unsigned int) * (double)g_iFragmentIndexOffset[iNumLists] / (1024.0 * 1024.0);
+   double dPackedMB = (double)(ullTotal + FRAGINDEX_PACK_PAD + sizeof(unsigned long long) * (iNumLists + 1)) / (1024.0 * 1024.0);
+
+#ifdef FRAGINDEX_BENCH
+   BenchPackedDecode(iNumLists);
+#endif
+
+   delete[] g_iFragmentIndex;
+   g_iFragmentIndex = NULL;
+
+   printf("%0.1f MB to %0.1f MB (%0.1fx) ... ", dRawMB, dPackedMB, dPackedMB > 0.0 ? dRawMB / dPackedMB : 0.0);
+   cout << CometMassSpecUtils::ElapsedTime(tStartTime) << endl;
 }
 
 
-void CometFragmentIndex::AddFragmentsThreadProc(bool bCountOnly,
-                                                ThreadPool *tp)
+// Partition the mass sorted g_vFragmentPeptides into precursor mass slabs of
+// dFragIndexSlabWidth.  Each slab stores a full set of bin offsets so the slab width
+// is increased if the offsets would take more memory than the peptide list itself.
+void CometFragmentIndex::SetFragmentSlabs(void)
 {
-   size_t iWhichFragmentPeptide = 0;  // unused here for counting only
+   delete[] g_uiFragmentSlabPeptide;
+   g_uiFragmentSlabPeptide = NULL;
+   g_uiNumFragmentSlabs = 1;
+
+   double dSlabWidth = g_staticParams.options.dFragIndexSlabWidth;
+   size_t iNumPeptides = g_vFragmentPeptides.size();
+   size_t iMaxOffsets = (std::max)((size_t)g_massRange.uiMaxFragmentArrayIndex, iNumPeptides * sizeof(FragmentPeptidesStruct) / sizeof(unsigned int));
+
+   if (dSlabWidth <= 0.0 || iNumPeptides == 0)
+      return;
+
+   vector<unsigned int> vSlabPeptide;
+
+   while (true)
+   {
+      vSlabPeptide.clear();
+      vSlabPeptide.push_back(0);
+
+      double dSlabStart = g_vFragmentPeptides[0].dPepMass;
+      for (size_t i = 1; i < iNumPeptides; ++i)
+      {
+         if (g_vFragmentPeptides[i].dPepMass >= dSlabStart + dSlabWidth)
+         {
+            vSlabPeptide.push_back((unsigned int)i);
+            dSlabStart = g_vFragmentPeptides[i].dPepMass;
+         }
+      }
+
+      if (vSlabPeptide.size() * (size_t)g_massRange.uiMaxFragmentArrayIndex <= iMaxOffsets || vSlabPeptide.size() == 1)
+         break;
+
+      dSlabWidth *= 2.0;
+   }
+
+   if (vSlabPeptide.size() == 1)
+      return;
+
+   g_uiNumFragmentSlabs = (unsigned int)vSlabPeptide.size();
+   vSlabPeptide.push_back((unsigned int)iNumPeptides);
+
+   g_uiFragmentSlabPeptide = new unsigned int[vSlabPeptide.size()];
+   memcpy(g_uiFragmentSlabPeptide, vSlabPeptide.data(), sizeof(unsigned int) * vSlabPeptide.size());
+
+   if (dSlabWidth != g_staticParams.options.dFragIndexSlabWidth)
+      printf("%u slabs, width increased to %0.1f Da ... ", g_uiNumFragmentSlabs, dSlabWidth);
+   else
+      printf("%u slabs ... ", g_uiNumFragmentSlabs);
+}
+
+
+// Generate the modified peptides for g_vRawPeptides[iStartPeptide, iEndPeptide) into pvFragmentPeptides.
+void CometFragmentIndex::AddFragmentsThreadProc(size_t iStartPeptide,
+                                                size_t iEndPeptide,
+                                                vector<FragmentPeptidesStruct>* pvFragmentPeptides)
+{
+   size_t iWhichFragmentPeptide = 0;  // unused here for peptide generation
 
    // each thread will loop through a subset of the g_vRawPeptides
-   for (size_t iWhichPeptide = 0; iWhichPeptide < g_vRawPeptides.size(); ++iWhichPeptide)
+   for (size_t iWhichPeptide = iStartPeptide; iWhichPeptide < iEndPeptide; ++iWhichPeptide)
    {
       // AddFragments for unmodified peptide; only if no variable mods are required
       if (!g_staticParams.variableModParameters.iRequireVarMod)
-         AddFragments(g_vRawPeptides, iWhichPeptide, iWhichFragmentPeptide, -1, -1, -1, bCountOnly);
+         AddFragments(g_vRawPeptides, iWhichPeptide, iWhichFragmentPeptide, -1, -1, -1, FRAGINDEX_PASS_PEPTIDES, pvFragmentPeptides, NULL);
 
       // FIX: need to see if individual required varmods are met
       int modSeqIdx = PEPTIDE_MOD_SEQ_IDXS[iWhichPeptide];
@@ -265,7 +1189,7 @@ void CometFragmentIndex::AddFragmentsThreadProc(bool bCountOnly,
                && (!g_staticParams.variableModParameters.bVarModProteinFilter
                   || cometbitcheck(g_vRawPeptides.at(iWhichPeptide).siVarModProteinFilter, ctNtermMod)))
             {
-               AddFragments(g_vRawPeptides, iWhichPeptide, iWhichFragmentPeptide, -1, ctNtermMod, -1, bCountOnly);
+               AddFragments(g_vRawPeptides, iWhichPeptide, iWhichFragmentPeptide, -1, ctNtermMod, -1, FRAGINDEX_PASS_PEPTIDES, pvFragmentPeptides, NULL);
             }
          }
 
@@ -276,7 +1200,7 @@ void CometFragmentIndex::AddFragmentsThreadProc(bool bCountOnly,
                && (!g_staticParams.variableModParameters.bVarModProteinFilter
                   || cometbitcheck(g_vRawPeptides.at(iWhichPeptide).siVarModProteinFilter, ctCtermMod)))
             {
-               AddFragments(g_vRawPeptides, iWhichPeptide, iWhichFragmentPeptide, -1, -1, ctCtermMod, bCountOnly);
+               AddFragments(g_vRawPeptides, iWhichPeptide, iWhichFragmentPeptide, -1, -1, ctCtermMod, FRAGINDEX_PASS_PEPTIDES, pvFragmentPeptides, NULL);
             }
          }
 
@@ -291,7 +1215,7 @@ void CometFragmentIndex::AddFragmentsThreadProc(bool bCountOnly,
                      (cometbitcheck(g_vRawPeptides.at(iWhichPeptide).siVarModProteinFilter, ctNtermMod)
                         && cometbitcheck(g_vRawPeptides.at(iWhichPeptide).siVarModProteinFilter, ctCtermMod))))
                {
-                  AddFragments(g_vRawPeptides, iWhichPeptide, iWhichFragmentPeptide, -1, ctNtermMod, ctCtermMod, bCountOnly);
+                  AddFragments(g_vRawPeptides, iWhichPeptide, iWhichFragmentPeptide, -1, ctNtermMod, ctCtermMod, FRAGINDEX_PASS_PEPTIDES, pvFragmentPeptides, NULL);
                }
             }
          }
@@ -333,7 +1257,7 @@ void CometFragmentIndex::AddFragmentsThreadProc(bool bCountOnly,
 
             if (bPass)
             {
-               AddFragments(g_vRawPeptides, iWhichPeptide, iWhichFragmentPeptide, modNumIdx, -1, -1, bCountOnly);
+               AddFragments(g_vRawPeptides, iWhichPeptide, iWhichFragmentPeptide, modNumIdx, -1, -1, FRAGINDEX_PASS_PEPTIDES, pvFragmentPeptides, NULL);
 
                if (g_staticParams.variableModParameters.bVarTermModSearch)
                {
@@ -343,7 +1267,7 @@ void CometFragmentIndex::AddFragmentsThreadProc(bool bCountOnly,
                      if (g_staticParams.variableModParameters.varModList[(int)ctNtermMod].bNtermMod
                         && (!g_staticParams.variableModParameters.bVarModProteinFilter || cometbitcheck(g_vRawPeptides.at(iWhichPeptide).siVarModProteinFilter, ctNtermMod)))
                      {
-                        AddFragments(g_vRawPeptides, iWhichPeptide, iWhichFragmentPeptide, modNumIdx, ctNtermMod, -1, bCountOnly);
+                        AddFragments(g_vRawPeptides, iWhichPeptide, iWhichFragmentPeptide, modNumIdx, ctNtermMod, -1, FRAGINDEX_PASS_PEPTIDES, pvFragmentPeptides, NULL);
                      }
                   }
 
@@ -353,7 +1277,7 @@ void CometFragmentIndex::AddFragmentsThreadProc(bool bCountOnly,
                      if (g_staticParams.variableModParameters.varModList[(int)ctCtermMod].bCtermMod
                         && (!g_staticParams.variableModParameters.bVarModProteinFilter || cometbitcheck(g_vRawPeptides.at(iWhichPeptide).siVarModProteinFilter, ctCtermMod)))
                      {
-                        AddFragments(g_vRawPeptides, iWhichPeptide, iWhichFragmentPeptide, modNumIdx, -1, ctCtermMod, bCountOnly);
+                        AddFragments(g_vRawPeptides, iWhichPeptide, iWhichFragmentPeptide, modNumIdx, -1, ctCtermMod, FRAGINDEX_PASS_PEPTIDES, pvFragmentPeptides, NULL);
                      }
                   }
 
@@ -368,7 +1292,7 @@ void CometFragmentIndex::AddFragmentsThreadProc(bool bCountOnly,
                               (cometbitcheck(g_vRawPeptides.at(iWhichPeptide).siVarModProteinFilter, ctNtermMod)
                                  && cometbitcheck(g_vRawPeptides.at(iWhichPeptide).siVarModProteinFilter, ctCtermMod))))
                         {
-                           AddFragments(g_vRawPeptides, iWhichPeptide, iWhichFragmentPeptide, modNumIdx, ctNtermMod, ctCtermMod, bCountOnly);
+                           AddFragments(g_vRawPeptides, iWhichPeptide, iWhichFragmentPeptide, modNumIdx, ctNtermMod, ctCtermMod, FRAGINDEX_PASS_PEPTIDES, pvFragmentPeptides, NULL);
                         }
                      }
                   }
@@ -386,7 +1310,9 @@ void CometFragmentIndex::AddFragments(vector<PlainPeptideIndexStruct>& g_vRawPep
                                       int modNumIdx,
                                       char cNtermMod,
                                       char cCtermMod,
-                                      bool bCountOnly)
+                                      int iPass,
+                                      vector<FragmentPeptidesStruct>* pvFragmentPeptides,
+                                      unsigned int* piBins)
 {
    string sPeptide = g_vRawPeptides.at(iWhichPeptide).sPeptide;
 
@@ -454,26 +1380,29 @@ void CometFragmentIndex::AddFragments(vector<PlainPeptideIndexStruct>& g_vRawPep
    if (!g_staticParams.options.iFragIndexSkipReadPrecursors && !g_bIndexPrecursors[BIN(dCalcPepMass)])
       return;
 
-   if (bCountOnly)
+   if (iPass == FRAGINDEX_PASS_PEPTIDES)
    {
       struct FragmentPeptidesStruct sTmp;
 
+      memset(&sTmp, 0, sizeof(sTmp));  // clear padding so the .fidx file contents are reproducible
       sTmp.iWhichPeptide = iWhichPeptide;
       sTmp.modNumIdx = modNumIdx;
       sTmp.dPepMass = dCalcPepMass;
       sTmp.cNtermMod = cNtermMod;
       sTmp.cCtermMod = cCtermMod;
 
-      // Store the current peptide; iWhichFragmentPeptide references this peptide entry
-      // for use in the g_iFragmentIndex fragment index.  As this is a global list of
-      // peptides, need to lock when updating to avoid thread conflicts
-      if (g_vFragmentPeptides.size() >= UINT_MAX)
+      // Store the current peptide; after all chunks are merged and sorted by mass, its
+      // position in g_vFragmentPeptides is the reference stored in g_iFragmentIndex.
+      if (pvFragmentPeptides->size() >= UINT_MAX)
       {
          printf(" Error in CometFragmentIndex; UINT_MAX (%d) peptides reached.\n", UINT_MAX);
          exit(1);
       }
       // store peptide representation based on sequence (iWhichPeptide), modification state (modNumIdx), and mass (dPepMass)
-      g_vFragmentPeptides.push_back(sTmp);
+      pvFragmentPeptides->push_back(sTmp);
+
+      // fragment ions are binned in the later count and fill passes
+      return;
    }
 
 /*
@@ -538,10 +1467,10 @@ if (!(iWhichPeptide%1000))
                exit(1);
             }
 
-            if (bCountOnly)
-               g_iFragmentIndexOffset[iBinBion] += 1;
+            if (iPass == FRAGINDEX_PASS_COUNT)
+               piBins[iBinBion] += 1;
             else
-               g_iFragmentIndex[s_iWritePos[iBinBion]++] = static_cast<unsigned int>(iWhichFragmentPeptide);
+               g_iFragmentIndex[piBins[iBinBion]++] = static_cast<unsigned int>(iWhichFragmentPeptide);
          }
 
          if (dYion > g_staticParams.options.dFragIndexMinMass && dYion < g_staticParams.options.dFragIndexMaxMass)
@@ -554,10 +1483,10 @@ if (!(iWhichPeptide%1000))
                exit(1);
             }
 
-            if (bCountOnly)
-               g_iFragmentIndexOffset[iBinYion] += 1;
+            if (iPass == FRAGINDEX_PASS_COUNT)
+               piBins[iBinYion] += 1;
             else
-               g_iFragmentIndex[s_iWritePos[iBinYion]++] = static_cast<unsigned int>(iWhichFragmentPeptide);
+               g_iFragmentIndex[piBins[iBinYion]++] = static_cast<unsigned int>(iWhichFragmentPeptide);
          }
       }
    }
@@ -866,32 +1795,12 @@ bool CometFragmentIndex::WriteFIPlainPeptideIndex(ThreadPool *tp)
 }
 
 
-// read the raw peptides from disk
-bool CometFragmentIndex::ReadPlainPeptideIndex(void)
+// Read the search settings (masses, enzyme, modifications) from the text header of
+// the .idx file; fp is left at the end of the header.
+bool CometFragmentIndex::ReadPlainPeptideIndexHeader(FILE *fp)
 {
-   FILE *fp;
    int iRet;     // used to reduce compiler warnings only
    char szBuf[SIZE_BUF];
-   string strIndexFile;
-
-   if (g_bPlainPeptideIndexRead)
-      return 1;
-
-   size_t databaseLen = strlen(g_staticParams.databaseInfo.szDatabase);
-   if (g_staticParams.options.bCreateFragmentIndex
-      && (databaseLen >=4 && !strstr(g_staticParams.databaseInfo.szDatabase + strlen(g_staticParams.databaseInfo.szDatabase) - 4, ".idx")))
-   {
-      strIndexFile = g_staticParams.databaseInfo.szDatabase + string(".idx");
-   }
-   else // database already is .idx
-      strIndexFile = g_staticParams.databaseInfo.szDatabase;
-
-   if ((fp = fopen(strIndexFile.c_str(), "rb")) == NULL)
-   {
-      printf(" Error - cannot open index file %s to read\n", strIndexFile.c_str());
-      exit(1);
-   }
-   setvbuf(fp, NULL, _IOFBF, 32 * 1024 * 1024);
 
    bool bFoundStatic = false;
    bool bFoundVariable= false;
@@ -906,7 +1815,6 @@ bool CometFragmentIndex::ReadPlainPeptideIndex(void)
          {
             string strErrorMsg = " Error with raw peptide index database format. MassType: did not parse 2 values.\n";
             logerr(strErrorMsg);
-            fclose(fp);
             return false;
          }
       }
@@ -918,7 +1826,6 @@ bool CometFragmentIndex::ReadPlainPeptideIndex(void)
          {
             string strErrorMsg = " Error with raw peptide index database format. LengthRange: did not parse 2 values.\n";
             logerr(strErrorMsg);
-            fclose(fp);
             return false;
          }
       }
@@ -932,7 +1839,6 @@ bool CometFragmentIndex::ReadPlainPeptideIndex(void)
          {
             string strErrorMsg = " Error with raw peptide index database format. Enzyme: did not parse 3 values.\n";
             logerr(strErrorMsg);
-            fclose(fp);
             return false;
          }
       }
@@ -946,7 +1852,6 @@ bool CometFragmentIndex::ReadPlainPeptideIndex(void)
          {
             string strErrorMsg = " Error with raw peptide index database format. Enzyme2: did not parse 3 values.\n";
             logerr(strErrorMsg);
-            fclose(fp);
             return false;
          }
       }
@@ -1085,6 +1990,40 @@ bool CometFragmentIndex::ReadPlainPeptideIndex(void)
       string strErrorMsg = " Error with raw peptide index database format. Modifications ("
          + std::to_string(bFoundStatic) + "/" + std::to_string(bFoundVariable) + ") not parsed.\n";
       logerr(strErrorMsg);
+      return false;
+   }
+
+   return true;
+}
+
+
+// read the raw peptides from disk
+bool CometFragmentIndex::ReadPlainPeptideIndex(void)
+{
+   FILE *fp;
+   string strIndexFile;
+
+   if (g_bPlainPeptideIndexRead)
+      return 1;
+
+   size_t databaseLen = strlen(g_staticParams.databaseInfo.szDatabase);
+   if (g_staticParams.options.bCreateFragmentIndex
+      && (databaseLen >=4 && !strstr(g_staticParams.databaseInfo.szDatabase + strlen(g_staticParams.databaseInfo.szDatabase) - 4, ".idx")))
+   {
+      strIndexFile = g_staticParams.databaseInfo.szDatabase + string(".idx");
+   }
+   else // database already is .idx
+      strIndexFile = g_staticParams.databaseInfo.szDatabase;
+
+   if ((fp = fopen(strIndexFile.c_str(), "rb")) == NULL)
+   {
+      printf(" Error - cannot open index file %s to read\n", strIndexFile.c_str());
+      exit(1);
+   }
+   setvbuf(fp, NULL, _IOFBF, 32 * 1024 * 1024);
+
+   if (!ReadPlainPeptideIndexHeader(fp))
+   {
       fclose(fp);
       return false;
    }
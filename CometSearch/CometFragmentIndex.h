@@ -20,6 +20,33 @@
 #include "CometSearch.h"
 #include <functional>
 
+// Passes of the fragment index build performed by AddFragments()
+enum FragmentIndexPass
+{
+   FRAGINDEX_PASS_PEPTIDES = 0,   // generate modified peptides into g_vFragmentPeptides
+   FRAGINDEX_PASS_COUNT,          // count fragment ions per bin
+   FRAGINDEX_PASS_FILL            // write peptide references into g_iFragmentIndex
+};
+
+// Compressed posting lists (fragindex_compress):  each list is split into blocks of
+// FRAGINDEX_PACK_BLOCK entries.  A block is the first entry as a 4 byte value, one byte
+// bit width, then the deltas of the remaining entries bit-packed at that width.
+// Peptides sharing a fragment bin are spread across the whole mass sorted peptide
+// list, so the deltas are large and a list costs about 13 bits per entry (~2.3x).
+#define FRAGINDEX_PACK_BLOCK  128
+#define FRAGINDEX_PACK_HEADER 5
+#define FRAGINDEX_PACK_PAD    8        // readable bytes past the last block; deltas are read 8 bytes at a time
+
+// g_vRawPeptides entry as stored in a .fidx file.
+struct FragmentIndexRawPeptide
+{
+   uint64_t ulSequence;                          // offset of the NUL terminated sequence in the sequence section
+   comet_fileoffset_t lIndexProteinFilePosition; // points to entry in g_pvProteinsList
+   char cPrevAA;
+   char cNextAA;
+   char szPad[6];
+};
+
 class CometFragmentIndex
 {
 public:
@@ -29,26 +56,129 @@ public:
    static bool WriteFIPlainPeptideIndex(ThreadPool *tp);
    static bool ReadPlainPeptideIndex(void);
    static bool CreateFragmentIndex(ThreadPool *tp);
+   static void DeleteFragmentIndex(void);
    static int WhichPrecursorBin(double dMass);
 
+   // Raw peptide and modification tables used when scoring fragment index matches.
+   // They come from the parsed .idx file or, when the index was mapped from a .fidx
+   // file, straight from the mapping.
+   static inline const char* RawPeptideSequence(size_t iWhichPeptide)
+   {
+      if (_pRawPeptideMap != NULL)
+         return _pcRawSequenceMap + _pRawPeptideMap[iWhichPeptide].ulSequence;
+      return g_vRawPeptides[iWhichPeptide].sPeptide.c_str();
+   }
+
+   static inline char RawPeptidePrevAA(size_t iWhichPeptide)
+   {
+      return (_pRawPeptideMap != NULL ? _pRawPeptideMap[iWhichPeptide].cPrevAA : g_vRawPeptides[iWhichPeptide].cPrevAA);
+   }
+
+   static inline char RawPeptideNextAA(size_t iWhichPeptide)
+   {
+      return (_pRawPeptideMap != NULL ? _pRawPeptideMap[iWhichPeptide].cNextAA : g_vRawPeptides[iWhichPeptide].cNextAA);
+   }
+
+   static inline comet_fileoffset_t RawPeptideProteinList(size_t iWhichPeptide)
+   {
+      if (_pRawPeptideMap != NULL)
+         return _pRawPeptideMap[iWhichPeptide].lIndexProteinFilePosition;
+      return g_vRawPeptides[iWhichPeptide].lIndexProteinFilePosition;
+   }
+
+   // MOD_SEQS entry, NUL terminated.
+   static inline const char* ModSequence(int iModSeqIdx)
+   {
+      if (_pullModSeqOffset != NULL)
+         return _pcModSeqMap + _pullModSeqOffset[iModSeqIdx];
+      return MOD_SEQS[iModSeqIdx].c_str();
+   }
+
+   // MOD_NUMBERS entry:  variable mod of each residue of the modifiable sequence or -1.
+   static inline const char* ModNumber(int iModNumIdx)
+   {
+      if (_pullModNumberOffset != NULL)
+         return _pcModNumberMap + _pullModNumberOffset[iModNumIdx];
+      return MOD_NUMBERS[iModNumIdx].modifications;
+   }
+
+   // First entry of a compressed posting block.
+   static inline unsigned int PackedBlockFirst(const unsigned char* pBlock)
+   {
+      unsigned int uiFirst;
+      memcpy(&uiFirst, pBlock, sizeof(unsigned int));
+      return uiFirst;
+   }
+
+   // Start of the block that follows a compressed block of uiCount entries.
+   static inline const unsigned char* PackedBlockNext(const unsigned char* pBlock,
+                                                      unsigned int uiCount)
+   {
+      return pBlock + FRAGINDEX_PACK_HEADER + (((size_t)(uiCount - 1) * pBlock[4] + 7) >> 3);
+   }
+
+   // Decode a compressed block of uiCount entries into puiOut.  The deltas are
+   // extracted independently of each other and then summed so both loops are
+   // free of loop-carried dependencies except the final running sum.
+   static inline void UnpackBlock(const unsigned char* pBlock,
+                                  unsigned int uiCount,
+                                  unsigned int* puiOut)
+   {
+      const unsigned char* pData = pBlock + FRAGINDEX_PACK_HEADER;
+      unsigned int uiBits = pBlock[4];
+      unsigned long long ullMask = (1ULL << uiBits) - 1;
+
+      puiOut[0] = PackedBlockFirst(pBlock);
+
+      for (unsigned int i = 1; i < uiCount; ++i)
+      {
+         size_t tBit = (size_t)(i - 1) * uiBits;
+         unsigned long long ullWord;
+         memcpy(&ullWord, pData + (tBit >> 3), sizeof(ullWord));
+         puiOut[i] = (unsigned int)((ullWord >> (tBit & 7)) & ullMask);
+      }
+
+      for (unsigned int i = 1; i < uiCount; ++i)
+         puiOut[i] += puiOut[i - 1];
+   }
+
 private:
 
+   static string FragmentIndexCacheFile(void);
+   static bool ReadPlainPeptideIndexHeader(FILE *fp);
+   static bool ReadFragmentIndexCache(void);
+   static bool WriteFragmentIndexCache(void);
+
    static void PermuteIndexPeptideMods(vector<PlainPeptideIndexStruct>& vRawPeptides);
    static void GenerateFragmentIndex(ThreadPool *tp);
+   static void SetFragmentSlabs(void);
+   static void CompressFragmentIndex(ThreadPool *tp);
    static void AddFragments(vector<PlainPeptideIndexStruct>& vRawPeptides,
                             size_t iWhichPeptide,
                             size_t iWhichFragmentPeptide,
                             int modNumIdx,
                             char cNtermMod,
                             char cCtermMod,
-                            bool bCountOnly);
-   static void AddFragmentsThreadProc(bool bCountOnly,
-                                      ThreadPool *tp);
+                            int iPass,
+                            vector<FragmentPeptidesStruct>* pvFragmentPeptides,
+                            unsigned int* piBins);
+   static void AddFragmentsThreadProc(size_t iStartPeptide,
+                                      size_t iEndPeptide,
+                                      vector<FragmentPeptidesStruct>* pvFragmentPeptides);
 
    static bool *_pbSearchMemoryPool;    // Pool of memory to be shared by search threads
    static bool **_ppbDuplFragmentArr;   // Number of arrays equals number of threads
 
-   static Mutex _vFragmentPeptidesMutex;
+   static char *_pcFragmentIndexMap;    // read-only mapping of .fidx file; NULL if index was built in memory
+   static size_t _tFragmentIndexMapSize;
+
+   // Tables of the .idx file in the mapping; NULL if they were parsed from the .idx file
+   static const FragmentIndexRawPeptide *_pRawPeptideMap;
+   static const char *_pcRawSequenceMap;
+   static const unsigned long long *_pullModSeqOffset;
+   static const char *_pcModSeqMap;
+   static const unsigned long long *_pullModNumberOffset;
+   static const char *_pcModNumberMap;
 };
 
 #endif // _COMETFRAGMENTINDEX_H_
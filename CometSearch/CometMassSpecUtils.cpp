@@ -181,7 +181,7 @@ void CometMassSpecUtils::GetProteinSequence(FILE *fpfasta,
 
 // return all matched protein names in a vector of strings
 void CometMassSpecUtils::GetProteinNameString(FILE *fpdb,
-                                              int iWhichQuery,  // which search
+                                              Query *pQuery,    // which search
                                               int iWhichResult, // which peptide within the search
                                               int iPrintTargetDecoy,    // 0 = target+decoys, 1=target only, 2=decoy only
                                               bool bReturnFullProteinString,   // 0 = return accession only, 1 = return full description line
@@ -203,9 +203,9 @@ void CometMassSpecUtils::GetProteinNameString(FILE *fpdb,
       Results* pOutput;
 
       if (iPrintTargetDecoy != 2)
-         pOutput = g_pvQuery.at(iWhichQuery)->_pResults;
+         pOutput = pQuery->_pResults;
       else
-         pOutput = g_pvQuery.at(iWhichQuery)->_pDecoys;
+         pOutput = pQuery->_pDecoys;
 
       int iPrintDuplicateProteinCt = 0; // track # proteins, exit when at iMaxDuplicateProteins
 
@@ -219,9 +219,11 @@ void CometMassSpecUtils::GetProteinNameString(FILE *fpdb,
          else
             lEntry = pOutput[iWhichResult].pWhichProtein.at(0).lWhichProtein;
 
-         *uiNumTotProteins += (unsigned int)g_pvProteinsList.at(lEntry).size();
+         ProteinListView proteinList = GetIndexProteinList(lEntry);
 
-         for (auto it = g_pvProteinsList.at(lEntry).begin(); it != g_pvProteinsList.at(lEntry).end(); ++it)
+         *uiNumTotProteins += (unsigned int)proteinList.size();
+
+         for (auto it = proteinList.begin(); it != proteinList.end(); ++it)
          {
             comet_fseek(fpdb, *it, SEEK_SET);
 
@@ -248,9 +250,11 @@ void CometMassSpecUtils::GetProteinNameString(FILE *fpdb,
       if (g_staticParams.iDbType == DbType::PI_DB && pOutput[iWhichResult].pWhichDecoyProtein.size() > 0)
       {
          comet_fileoffset_t lEntry = pOutput[iWhichResult].pWhichDecoyProtein.at(0).lWhichProtein;
-         *uiNumTotProteins += (unsigned int)g_pvProteinsList.at(lEntry).size();
+         ProteinListView proteinList = GetIndexProteinList(lEntry);
+
+         *uiNumTotProteins += (unsigned int)proteinList.size();
 
-         for (auto it = g_pvProteinsList.at(lEntry).begin(); it != g_pvProteinsList.at(lEntry).end(); ++it)
+         for (auto it = proteinList.begin(); it != proteinList.end(); ++it)
          {
             comet_fseek(fpdb, *it, SEEK_SET);
 
@@ -278,9 +282,9 @@ void CometMassSpecUtils::GetProteinNameString(FILE *fpdb,
       Results* pOutput;
 
       if (iPrintTargetDecoy != 2)
-         pOutput = g_pvQuery.at(iWhichQuery)->_pResults;
+         pOutput = pQuery->_pResults;
       else
-         pOutput = g_pvQuery.at(iWhichQuery)->_pDecoys;
+         pOutput = pQuery->_pDecoys;
 
       int iPrintDuplicateProteinCt = 0; // track # proteins, exit when at iMaxDuplicateProteins
 
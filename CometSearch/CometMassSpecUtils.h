@@ -49,7 +49,7 @@ public:
                                   string &strSeq);
 
    static void GetProteinNameString(FILE *fpdb,
-                                    int iWhichQuery,  // which search
+                                    Query *pQuery,    // which search
                                     int iWhichResult, // which peptide within the search
                                     int iPrintTargetDecoy,
                                     bool bReturnFullProteinString,   // 0 = return accession only, 1 = return full description line
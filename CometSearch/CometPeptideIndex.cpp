@@ -15,8 +15,26 @@
 
 #include "CometPeptideIndex.h"
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+
 extern comet_fileoffset_t clSizeCometFileOffset;
 
+int CometPeptideIndex::_iIndexFormat = PEPTIDE_INDEX_FORMAT;
+char* CometPeptideIndex::_pcPeptideIndexMap = NULL;
+size_t CometPeptideIndex::_tPeptideIndexMapSize = 0;
+const PeptideIndexRecord* CometPeptideIndex::_pPeptideRecords = NULL;
+const char* CometPeptideIndex::_pcSequenceHeap = NULL;
+const comet_fileoffset_t* CometPeptideIndex::_plMassIndex = NULL;
+comet_fileoffset_t CometPeptideIndex::_lRecordsPos = 0;
+size_t CometPeptideIndex::_tNumPeptides = 0;
+int CometPeptideIndex::_iMaxPeptideMass10 = 0;
+vector<PeptideIndexRecord> CometPeptideIndex::_vPeptideRecords;
+vector<char> CometPeptideIndex::_vSequenceHeap;
+vector<comet_fileoffset_t> CometPeptideIndex::_vMassIndex;
+
 
 CometPeptideIndex::CometPeptideIndex()
 {
@@ -26,25 +44,33 @@ CometPeptideIndex::~CometPeptideIndex()
 {
 }
 
-// Read the full peptide index (.idx) file into global read-only structures:
-//   g_pvDBIndex         - all peptide entries, sorted by mass
+// Read the peptide index (.idx) file into global read-only structures:
+//   peptide records     - accessed through NumPeptides()/PeptideMass()/GetPeptide(), sorted by mass
 //   g_pvProteinsList    - vector-of-vectors mapping peptide to protein file positions
-//   g_pvProteinNames    - map of file offset to protein name string
 //   g_bPeptideIndexRead - guard flag
 //
 // The .idx binary layout (written by WritePeptideIndex):
 //   [text header lines ending with blank line]
 //   [protein names: each WIDTH_REFERENCE chars]
 //   [proteins list: count then per-entry (size + file offsets)]
-//   [peptide entries: each via ReadPeptideIndexEntry format]
-//   [footer: iMinMass(int), iMaxMass(int), tNumPeptides(uint64_t),
-//            lIndex[iMaxMass*10](comet_fileoffset_t), lEndOfPeptides, clProteinsFilePos]
+//   [peptide records: PeptideIndexRecord[tNumPeptides], 8 byte aligned]
+//   [sequence heap: residues then iLen+2 var mod sites for modified peptides]
+//   [footer, 8 byte aligned: iMinMass(int), iMaxMass(int), tNumPeptides(uint64_t),
+//            lIndex[iMaxMass*10](comet_fileoffset_t), lRecordsPos, lHeapPos,
+//            lEndOfPeptides, clProteinsFilePos]
+//
+// A v2 file is memory-mapped so only the pages of the mass ranges actually
+// searched are read.  Legacy files (no "IndexFormat:" header line) store
+// variable length entries (see ReadPeptideIndexEntry) and no lRecordsPos/lHeapPos;
+// they are converted to the same record layout in memory.
 //
-bool CometPeptideIndex::ReadPeptideIndex(void)
+bool CometPeptideIndex::ReadPeptideIndex(bool bLogSummary)
 {
    if (g_bPeptideIndexRead)
       return true;
 
+   DeletePeptideIndex();  // release an index loaded by a previous search
+
    FILE* fp;
    char szBuf[SIZE_BUF];
 
@@ -74,10 +100,13 @@ bool CometPeptideIndex::ReadPeptideIndex(void)
    }
 
    // Skip remaining header lines until blank line
+   _iIndexFormat = 1;
    while (fgets(szBuf, SIZE_BUF, fp) != NULL)
    {
       if (szBuf[0] == '\n' || szBuf[0] == '\r')
          break;
+      if (!strncmp(szBuf, "IndexFormat:", 12))
+         sscanf(szBuf + 12, "%d", &_iIndexFormat);
    }
 
    // --- Read footer first to get layout positions ---
@@ -92,7 +121,7 @@ bool CometPeptideIndex::ReadPeptideIndex(void)
    tTmpRead = fread(&lEndOfPeptides, clSizeCometFileOffset, 1, fp);
    tTmpRead = fread(&clProteinsFilePos, clSizeCometFileOffset, 1, fp);
 
-   // --- Read the mass index and peptide count from lEndOfPeptides position ---
+   // --- Read the peptide count and mass range from lEndOfPeptides position ---
    comet_fseek(fp, lEndOfPeptides, SEEK_SET);
 
    int iMinMass, iMaxMass;
@@ -101,27 +130,19 @@ bool CometPeptideIndex::ReadPeptideIndex(void)
    tTmpRead = fread(&iMaxMass, sizeof(int), 1, fp);
    tTmpRead = fread(&tNumPeptides, sizeof(uint64_t), 1, fp);
 
-   int iMaxPeptideMass10 = iMaxMass * 10;
-
-   // Read the mass index array: lIndex[0..iMaxPeptideMass10-1]
-   // Each entry is a file offset to the first peptide at that 0.1 Da mass bin
-   comet_fileoffset_t* lIndex = new comet_fileoffset_t[iMaxPeptideMass10];
-   tTmpRead = fread(lIndex, clSizeCometFileOffset, iMaxPeptideMass10, fp);
-
-   // --- Read protein names ---
-   // Protein names are stored between end-of-header and clProteinsFilePos
-   // Each protein name is WIDTH_REFERENCE chars.  We need to know how many
-   // there are.  Read them by seeking to the position right after the header
-   // and reading until clProteinsFilePos.
-
-   // Actually, the protein names are written BEFORE clProteinsFilePos.
-   // The structure is: [header][protein names][proteins list at clProteinsFilePos][peptides][footer]
-   // We need the protein name positions for g_pvProteinNames mapping.
-   // For the single-spectrum search path, protein names are resolved via
-   // g_pvProteinsList file offsets that point into the .idx file protein name region.
-   // We'll store them after reading the proteins list.
+   if (iMinMass < 0 || iMinMass > 20000 || iMaxMass < 0 || iMaxMass > 20000)
+   {
+      string strErrorMsg = " Error reading .idx database:  min mass " + std::to_string(iMinMass) + ", max mass "
+         + std::to_string(iMaxMass) + ", num peptides " + std::to_string(tNumPeptides) + "\n";
+      g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
+      logerr(strErrorMsg);
+      fclose(fp);
+      return false;
+   }
 
    // --- Read proteins list (vector of vectors) from clProteinsFilePos ---
+   // Protein names are stored before clProteinsFilePos and are resolved at
+   // output time via the g_pvProteinsList file offsets into that region.
    comet_fseek(fp, clProteinsFilePos, SEEK_SET);
 
    size_t tNumProteinEntries;
@@ -136,54 +157,317 @@ bool CometPeptideIndex::ReadPeptideIndex(void)
       tTmpRead = fread(&tNumProteins, sizeof(size_t), 1, fp);
 
       g_pvProteinsList[i].resize(tNumProteins);
-      for (size_t j = 0; j < tNumProteins; ++j)
-      {
-         comet_fileoffset_t lProtFilePos;
-         tTmpRead = fread(&lProtFilePos, clSizeCometFileOffset, 1, fp);
-         g_pvProteinsList[i][j] = lProtFilePos;
-      }
+      if (tNumProteins > 0)
+         tTmpRead = fread(g_pvProteinsList[i].data(), clSizeCometFileOffset, tNumProteins, fp);
    }
 
    // The file position after reading the proteins list is where the peptides start.
    comet_fileoffset_t lFirstPeptidePos = comet_ftell(fp);
 
-   // --- Read all peptide entries into g_pvDBIndex ---
-   g_pvDBIndex.clear();
-   g_pvDBIndex.reserve((size_t)tNumPeptides);
+   bool bRead;
+   if (_iIndexFormat >= 2)
+      bRead = MapPeptideIndex();
+   else
+      bRead = LoadLegacyPeptideIndex(fp, lFirstPeptidePos, tNumPeptides, iMaxMass * 10);
+
+   fclose(fp);
+
+   if (!bRead)
+   {
+      DeletePeptideIndex();
+      string strErrorMsg = " Error - failed to read peptides from \"" + string(g_staticParams.databaseInfo.szDatabase)
+         + "\"; file may be truncated or corrupt.\n";
+      g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
+      logerr(strErrorMsg);
+      return false;
+   }
+
+   if (bLogSummary)
+   {
+      logout(" Read peptide index: " + to_string(tNumPeptides) + " peptides, "
+         + to_string(tNumProteinEntries) + " protein groups\n");
+   }
+
+   g_staticParams.iDbType = DbType::PI_DB;
+   g_bPeptideIndexRead = true;
+
+   return true;
+}
+
+
+// Map a v2 .idx file read-only and point the record, sequence heap and mass
+// table arrays directly into the mapping.  Pages are only read when a search
+// touches the corresponding mass range and are shared between processes.
+bool CometPeptideIndex::MapPeptideIndex(void)
+{
+   char *pcMap = NULL;
+   size_t tMapSize = 0;
+
+#ifdef _WIN32
+   HANDLE hFile = CreateFileA(g_staticParams.databaseInfo.szDatabase, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+   if (hFile == INVALID_HANDLE_VALUE)
+      return false;
+
+   LARGE_INTEGER liSize;
+   if (GetFileSizeEx(hFile, &liSize))
+      tMapSize = (size_t)liSize.QuadPart;
+
+   if (tMapSize > 0)
+   {
+      HANDLE hMap = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+      if (hMap != NULL)
+      {
+         pcMap = (char *)MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, 0);
+         CloseHandle(hMap);  // view keeps the mapping alive
+      }
+   }
+   CloseHandle(hFile);
+#else
+   int fd = open(g_staticParams.databaseInfo.szDatabase, O_RDONLY);
+   if (fd < 0)
+      return false;
+
+   struct stat statIndex;
+   if (fstat(fd, &statIndex) == 0)
+      tMapSize = (size_t)statIndex.st_size;
+
+   if (tMapSize > 0)
+   {
+      void *pMap = mmap(NULL, tMapSize, PROT_READ, MAP_SHARED, fd, 0);
+      if (pMap != MAP_FAILED)
+         pcMap = (char *)pMap;
+   }
+   close(fd);
+#endif
+
+   if (pcMap == NULL)
+      return false;
+
+   _pcPeptideIndexMap = pcMap;
+   _tPeptideIndexMapSize = tMapSize;
+
+   if (tMapSize < 2 * sizeof(comet_fileoffset_t))
+      return false;
+
+   comet_fileoffset_t lEndOfPeptides;
+   memcpy(&lEndOfPeptides, pcMap + tMapSize - 2 * sizeof(comet_fileoffset_t), sizeof(comet_fileoffset_t));
+
+   size_t tFooterSize = 2 * sizeof(int) + sizeof(uint64_t);
+   if (lEndOfPeptides < 0 || (lEndOfPeptides & 7) || (size_t)lEndOfPeptides + tFooterSize > tMapSize)
+      return false;
+
+   const char *pcFooter = pcMap + lEndOfPeptides;
+   int iMaxMass;
+   uint64_t tNumPeptides;
+   memcpy(&iMaxMass, pcFooter + sizeof(int), sizeof(int));
+   memcpy(&tNumPeptides, pcFooter + 2 * sizeof(int), sizeof(uint64_t));
+
+   int iMaxPeptideMass10 = iMaxMass * 10;
+   const comet_fileoffset_t *plFooter = (const comet_fileoffset_t *)(pcFooter + tFooterSize);
+
+   // footer:  lIndex[iMaxPeptideMass10], lRecordsPos, lHeapPos, lEndOfPeptides, clProteinsFilePos
+   if ((size_t)lEndOfPeptides + tFooterSize + sizeof(comet_fileoffset_t) * ((size_t)iMaxPeptideMass10 + 4) != tMapSize)
+      return false;
+
+   comet_fileoffset_t lRecordsPos = plFooter[iMaxPeptideMass10];
+   comet_fileoffset_t lHeapPos = plFooter[iMaxPeptideMass10 + 1];
+
+   if (lRecordsPos < 0 || (lRecordsPos & 7)
+      || (uint64_t)(lHeapPos - lRecordsPos) != tNumPeptides * sizeof(PeptideIndexRecord)
+      || lHeapPos > lEndOfPeptides)
+   {
+      return false;
+   }
+
+   _pPeptideRecords = (const PeptideIndexRecord *)(pcMap + lRecordsPos);
+   _pcSequenceHeap = pcMap + lHeapPos;
+   _plMassIndex = plFooter;
+   _lRecordsPos = lRecordsPos;
+   _tNumPeptides = (size_t)tNumPeptides;
+   _iMaxPeptideMass10 = iMaxPeptideMass10;
+
+   return true;
+}
 
-   // Seek to first peptide (right after the proteins list)
+
+// Append one peptide as a fixed width record plus its residues (and var mod
+// sites if modified) to the sequence heap.
+static void AppendPeptideRecord(const DBIndex& sDBI,
+                                vector<PeptideIndexRecord>& vRecords,
+                                vector<char>& vHeap)
+{
+   PeptideIndexRecord sRecord;
+   memset(&sRecord, 0, sizeof(PeptideIndexRecord));
+
+   int iLen = (int)sDBI.sPeptide.size();
+
+   sRecord.dPepMass = sDBI.dPepMass;
+   sRecord.lIndexProteinFilePosition = sDBI.lIndexProteinFilePosition;
+   sRecord.ulSeqOffset = vHeap.size();
+   sRecord.usLen = (unsigned short)iLen;
+   sRecord.cPrevAA = sDBI.cPrevAA;
+   sRecord.cNextAA = sDBI.cNextAA;
+
+   vHeap.insert(vHeap.end(), sDBI.sPeptide.begin(), sDBI.sPeptide.end());
+
+   if (!sDBI.pcVarModSites.empty())
+   {
+      for (int x = 0; x < iLen + 2; ++x)
+      {
+         if (sDBI.pcVarModSites[x] != 0)
+         {
+            sRecord.bModified = 1;
+            break;
+         }
+      }
+
+      if (sRecord.bModified)
+         vHeap.insert(vHeap.end(), sDBI.pcVarModSites.begin(), sDBI.pcVarModSites.begin() + iLen + 2);
+   }
+
+   vRecords.push_back(sRecord);
+}
+
+
+// lIndex[] holds the file offset of the first record in each 0.1 Da mass bin,
+// -1 for bins without peptides.
+static void BuildMassIndex(const vector<PeptideIndexRecord>& vRecords,
+                           comet_fileoffset_t lRecordsPos,
+                           int iMaxPeptideMass10,
+                           vector<comet_fileoffset_t>& vMassIndex)
+{
+   vMassIndex.assign(iMaxPeptideMass10, -1);
+
+   int iPrevMass10 = 0;
+   for (size_t i = 0; i < vRecords.size(); ++i)
+   {
+      if ((int)(vRecords[i].dPepMass * 10.0) > iPrevMass10)
+      {
+         iPrevMass10 = (int)(vRecords[i].dPepMass * 10.0);
+         if (iPrevMass10 < iMaxPeptideMass10)
+            vMassIndex[iPrevMass10] = lRecordsPos + (comet_fileoffset_t)(i * sizeof(PeptideIndexRecord));
+      }
+   }
+}
+
+
+// Read the variable length entries of a legacy .idx file and convert them
+// to records held in memory.
+bool CometPeptideIndex::LoadLegacyPeptideIndex(FILE* fp,
+                                               comet_fileoffset_t lFirstPeptidePos,
+                                               uint64_t tNumPeptides,
+                                               int iMaxPeptideMass10)
+{
    comet_fseek(fp, lFirstPeptidePos, SEEK_SET);
 
+   _vPeptideRecords.reserve((size_t)tNumPeptides);
+
+   DBIndex sEntry;
    for (uint64_t i = 0; i < tNumPeptides; ++i)
    {
-      DBIndex sEntry;
       if (!ReadPeptideIndexEntry(&sEntry, fp))
-      {
-         g_pvDBIndex.clear();
-         delete[] lIndex;
-         fclose(fp);
-         logout(" Error - failed to read peptide index entry " + to_string(i)
-            + " from .idx file; file may be truncated or corrupt.\n");
          return false;
-      }
-      g_pvDBIndex.push_back(sEntry);
+
+      AppendPeptideRecord(sEntry, _vPeptideRecords, _vSequenceHeap);
    }
 
-   // g_pvDBIndex is already sorted by mass from the .idx file
+   BuildMassIndex(_vPeptideRecords, 0, iMaxPeptideMass10, _vMassIndex);
 
-   delete[] lIndex;
-   fclose(fp);
+   _pPeptideRecords = _vPeptideRecords.data();
+   _pcSequenceHeap = _vSequenceHeap.data();
+   _plMassIndex = _vMassIndex.data();
+   _lRecordsPos = 0;
+   _tNumPeptides = _vPeptideRecords.size();
+   _iMaxPeptideMass10 = iMaxPeptideMass10;
 
-   logout(" Read peptide index: " + to_string(tNumPeptides) + " peptides, "
-      + to_string(tNumProteinEntries) + " protein groups\n");
+   return true;
+}
 
-   g_staticParams.iDbType = DbType::PI_DB;
-   g_bPeptideIndexRead = true;
 
-   return true;
+void CometPeptideIndex::DeletePeptideIndex(void)
+{
+   if (_pcPeptideIndexMap != NULL)
+   {
+#ifdef _WIN32
+      UnmapViewOfFile(_pcPeptideIndexMap);
+#else
+      munmap(_pcPeptideIndexMap, _tPeptideIndexMapSize);
+#endif
+      _pcPeptideIndexMap = NULL;
+      _tPeptideIndexMapSize = 0;
+   }
+
+   vector<PeptideIndexRecord>().swap(_vPeptideRecords);
+   vector<char>().swap(_vSequenceHeap);
+   vector<comet_fileoffset_t>().swap(_vMassIndex);
+
+   _pPeptideRecords = NULL;
+   _pcSequenceHeap = NULL;
+   _plMassIndex = NULL;
+   _lRecordsPos = 0;
+   _tNumPeptides = 0;
+   _iMaxPeptideMass10 = 0;
+
+   g_bPeptideIndexRead = false;
 }
 
 
+// Returns the first record with mass >= dMass.  The 0.1 Da mass table gives
+// the start of the bin so only the records of that bin are scanned.
+size_t CometPeptideIndex::FirstPeptide(double dMass)
+{
+   size_t tFirst = 0;
+   int iBin = (int)(dMass * 10.0);
+
+   if (iBin > 0 && _iMaxPeptideMass10 > 0)
+   {
+      // every record before the first non-empty bin at or above iBin is lighter than dMass
+      int iWhichBin = iBin;
+      while (iWhichBin < _iMaxPeptideMass10 && _plMassIndex[iWhichBin] == -1)
+         iWhichBin++;
+
+      if (iWhichBin < _iMaxPeptideMass10)
+         tFirst = (size_t)((_plMassIndex[iWhichBin] - _lRecordsPos) / (comet_fileoffset_t)sizeof(PeptideIndexRecord));
+      else
+      {
+         // beyond the mass table; start from the last indexed bin below dMass
+         iWhichBin = (iBin < _iMaxPeptideMass10 ? iBin : _iMaxPeptideMass10) - 1;
+         while (iWhichBin > 0 && _plMassIndex[iWhichBin] == -1)
+            iWhichBin--;
+
+         if (iWhichBin > 0)
+            tFirst = (size_t)((_plMassIndex[iWhichBin] - _lRecordsPos) / (comet_fileoffset_t)sizeof(PeptideIndexRecord));
+      }
+   }
+
+   while (tFirst < _tNumPeptides && _pPeptideRecords[tFirst].dPepMass < dMass)
+      tFirst++;
+
+   return tFirst;
+}
+
+
+// Decode record i into sDBI.  sDBI is meant to be reused across calls so its
+// string and vector buffers are only allocated once.
+void CometPeptideIndex::GetPeptide(size_t i,
+                                   DBIndex& sDBI)
+{
+   const PeptideIndexRecord& sRecord = _pPeptideRecords[i];
+   const char* pcSeq = _pcSequenceHeap + sRecord.ulSeqOffset;
+
+   sDBI.sPeptide.assign(pcSeq, sRecord.usLen);
+   if (sRecord.bModified)
+      sDBI.pcVarModSites.assign(pcSeq + sRecord.usLen, pcSeq + 2 * sRecord.usLen + 2);
+   else
+      sDBI.pcVarModSites.clear();
+
+   sDBI.lIndexProteinFilePosition = sRecord.lIndexProteinFilePosition;
+   sDBI.dPepMass = sRecord.dPepMass;
+   sDBI.siVarModProteinFilter = 0;
+   sDBI.cPrevAA = sRecord.cPrevAA;
+   sDBI.cNextAA = sRecord.cNextAA;
+}
+
 bool CometPeptideIndex::WritePeptideIndex(ThreadPool* tp)
 {
    bool bSucceeded;
@@ -346,6 +630,7 @@ bool CometPeptideIndex::WritePeptideIndex(ThreadPool* tp)
       g_staticParams.enzymeInformation.szSearchEnzyme2BreakAA,
       g_staticParams.enzymeInformation.szSearchEnzyme2NoBreakAA);
    fprintf(fptr, "NumPeptides: %ld\n", (long)g_pvDBIndex.size());
+   fprintf(fptr, "IndexFormat: %d\n", PEPTIDE_INDEX_FORMAT);
 
    // write out static mod params A to Z is ascii 65 to 90 then terminal mods
    fprintf(fptr, "StaticMod:");
@@ -420,70 +705,50 @@ bool CometPeptideIndex::WritePeptideIndex(ThreadPool* tp)
 
    delete[] lProteinIndex;
 
-   // next write out the peptides and track peptide mass index
+   // next convert the peptides to fixed width records and a sequence heap;
+   // g_pvDBIndex is released as soon as the records are built
    int iMaxPeptideMass = (int)(g_staticParams.options.dPeptideMassHigh);
    int iMaxPeptideMass10 = iMaxPeptideMass * 10;  // make mass index at resolution of 0.1 Da
-   comet_fileoffset_t* lIndex = new comet_fileoffset_t[iMaxPeptideMass10 + 1];
-   for (int x = 0; x <= iMaxPeptideMass10; x++)
-      lIndex[x] = -1;
-
-   // write out peptide entry here
-   int iPrevMass10 = 0;
-   for (std::vector<DBIndex>::iterator it = g_pvDBIndex.begin(); it != g_pvDBIndex.end(); ++it)
-   {
-      if ((int)((*it).dPepMass * 10.0) > iPrevMass10)
-      {
-         iPrevMass10 = (int)((*it).dPepMass * 10.0);
-         if (iPrevMass10 < iMaxPeptideMass10)
-            lIndex[iPrevMass10] = comet_ftell(fptr);
-      }
+   uint64_t tNumPeptides = g_pvDBIndex.size();
 
-      int iLen = (int)(*it).sPeptide.size();
-      fwrite(&iLen, sizeof(int), 1, fptr);
-      fwrite((*it).sPeptide.c_str(), sizeof(char), iLen, fptr);
+   vector<PeptideIndexRecord> vRecords;
+   vector<char> vHeap;
+   vector<comet_fileoffset_t> vMassIndex;
 
-      fwrite(&((*it).cPrevAA), sizeof(char), 1, fptr);
-      fwrite(&((*it).cNextAA), sizeof(char), 1, fptr);
+   vRecords.reserve(g_pvDBIndex.size());
+   for (auto it = g_pvDBIndex.begin(); it != g_pvDBIndex.end(); ++it)
+      AppendPeptideRecord(*it, vRecords, vHeap);
+   vector<DBIndex>().swap(g_pvDBIndex);
 
-      // write out for char 0=no mod, N=mod.  If N, write out var mods as N pairs (pos,whichmod)
-      int iLen2 = iLen + 2;
-      unsigned char cNumMods = 0;
-      if (!(*it).pcVarModSites.empty())
-      {
-         for (unsigned char x = 0; x < iLen2; x++)
-         {
-            if ((*it).pcVarModSites[x] != 0)
-               cNumMods++;
-         }
-      }
-      fwrite(&cNumMods, sizeof(unsigned char), 1, fptr);
+   // records and footer start on 8 byte boundaries so they can be used in place when mapped
+   char szPad[8] = {0};
+   comet_fileoffset_t lRecordsPos = comet_ftell(fptr);
+   if (lRecordsPos & 7)
+   {
+      fwrite(szPad, 1, (size_t)(8 - (lRecordsPos & 7)), fptr);
+      lRecordsPos = comet_ftell(fptr);
+   }
 
-      if (cNumMods > 0)
-      {
-         for (unsigned char x = 0; x < iLen2; x++)
-         {
-            if ((*it).pcVarModSites[x] != 0)
-            {
-               char cWhichMod = (*it).pcVarModSites[x];
-               fwrite(&x, sizeof(unsigned char), 1, fptr);
-               fwrite(&cWhichMod, sizeof(char), 1, fptr);
-            }
-         }
-      }
-      // done writing out mod sites
+   BuildMassIndex(vRecords, lRecordsPos, iMaxPeptideMass10, vMassIndex);
 
-      fwrite(&((*it).dPepMass), sizeof(double), 1, fptr);
-      fwrite(&((*it).lIndexProteinFilePosition), sizeof(comet_fileoffset_t), 1, fptr);
-   }
+   fwrite(vRecords.data(), sizeof(PeptideIndexRecord), vRecords.size(), fptr);
+   comet_fileoffset_t lHeapPos = comet_ftell(fptr);
+   fwrite(vHeap.data(), sizeof(char), vHeap.size(), fptr);
 
    comet_fileoffset_t lEndOfPeptides = comet_ftell(fptr);
+   if (lEndOfPeptides & 7)
+   {
+      fwrite(szPad, 1, (size_t)(8 - (lEndOfPeptides & 7)), fptr);
+      lEndOfPeptides = comet_ftell(fptr);
+   }
 
    int iTmpCh = (int)(g_staticParams.options.dPeptideMassLow);
    fwrite(&iTmpCh, sizeof(int), 1, fptr);  // write min mass
    fwrite(&iMaxPeptideMass, sizeof(int), 1, fptr);  // write max mass
-   uint64_t tNumPeptides = g_pvDBIndex.size();
    fwrite(&tNumPeptides, sizeof(uint64_t), 1, fptr);  // write # of peptides
-   fwrite(lIndex, clSizeCometFileOffset, iMaxPeptideMass10, fptr); // write index
+   fwrite(vMassIndex.data(), clSizeCometFileOffset, iMaxPeptideMass10, fptr); // write index
+   fwrite(&lRecordsPos, clSizeCometFileOffset, 1, fptr);
+   fwrite(&lHeapPos, clSizeCometFileOffset, 1, fptr);
    fwrite(&lEndOfPeptides, clSizeCometFileOffset, 1, fptr);  // write ftell position of min/max mass, # peptides, peptide index
    fwrite(&clProteinsFilePos, clSizeCometFileOffset, 1, fptr);
 
@@ -507,9 +772,6 @@ bool CometPeptideIndex::WritePeptideIndex(ThreadPool* tp)
 
    CometSearch::DeallocateMemory(g_staticParams.options.iNumThreads);
 
-   g_pvDBIndex.clear();
-   delete[] lIndex;
-
    return bSucceeded;
 }
 
@@ -560,7 +822,7 @@ bool CometPeptideIndex::ReadPeptideIndexEntry(struct DBIndex* sDBI, FILE* fp)
 }
 
 
-// Parses the .idx text header lines (MassType:, StaticMod:, DecoySearch:,
+// Parses the .idx text header lines (IndexFormat:, MassType:, StaticMod:, DecoySearch:,
 // Enzyme:, Enzyme2:, VariableMod:) from fp.  Reads until the VariableMod:
 // line (inclusive), which is always the last header entry before the blank
 // line separator.
@@ -585,9 +847,15 @@ bool CometPeptideIndex::ParsePeptideIndexHeader(FILE* fp)
 
    rewind(fp);
 
+   _iIndexFormat = 1;  // files written before the IndexFormat: line was added
+
    while (fgets(szBuf, SIZE_BUF, fp))
    {
-      if (!strncmp(szBuf, "MassType:", 9))
+      if (!strncmp(szBuf, "IndexFormat:", 12))
+      {
+         sscanf(szBuf + 12, "%d", &_iIndexFormat);
+      }
+      else if (!strncmp(szBuf, "MassType:", 9))
       {
          sscanf(szBuf + 10, "%d %d",
             &g_staticParams.massUtility.bMonoMassesParent,
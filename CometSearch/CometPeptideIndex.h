@@ -26,17 +26,56 @@
 #include <iomanip>
 #include <sstream>
 
+// .idx peptide section format written by WritePeptideIndex; older files
+// without an "IndexFormat:" header line use variable length entries (1).
+#define PEPTIDE_INDEX_FORMAT 2
+
+// Fixed width v2 peptide record.  The peptide residues, followed by the
+// iLen+2 var mod sites if bModified is set, live in the sequence heap.
+struct PeptideIndexRecord
+{
+   double dPepMass;                              // MH+ pep mass
+   comet_fileoffset_t lIndexProteinFilePosition; // points to entry in g_pvProteinsList
+   uint64_t ulSeqOffset;                         // offset of peptide in sequence heap
+   unsigned short usLen;
+   unsigned char bModified;
+   char cPrevAA;
+   char cNextAA;
+   char cPad[3];
+};
+
 class CometPeptideIndex
 {
 public:
    CometPeptideIndex();
    ~CometPeptideIndex();
 
-   static bool ReadPeptideIndex(void);
+   static bool ReadPeptideIndex(bool bLogSummary = true);
    static bool WritePeptideIndex(ThreadPool* tp);
    static bool ReadPeptideIndexEntry(struct DBIndex* sDBI, FILE* fp);
+   static void DeletePeptideIndex(void);
+
+   static int IndexFormat(void)
+   {
+      return _iIndexFormat;
+   }
 
-   // Parses the .idx text header (MassType, StaticMod, DecoySearch, Enzyme,
+   // Accessors for the peptide records loaded by ReadPeptideIndex(); records
+   // are sorted by mass.
+   static size_t NumPeptides(void)
+   {
+      return _tNumPeptides;
+   }
+
+   static double PeptideMass(size_t i)
+   {
+      return _pPeptideRecords[i].dPepMass;
+   }
+
+   static size_t FirstPeptide(double dMass);
+   static void GetPeptide(size_t i, DBIndex& sDBI);
+
+   // Parses the .idx text header (IndexFormat, MassType, StaticMod, DecoySearch, Enzyme,
    // Enzyme2, VariableMod lines) from an already-open file pointer.
    // Updates g_staticParams in-place and must only be called once per index
    // load (guarded by g_bPeptideIndexRead). Called by both
@@ -44,6 +83,25 @@ public:
    // to avoid duplication.
    static bool ParsePeptideIndexHeader(FILE* fp);
 
+private:
+   static bool MapPeptideIndex(void);
+   static bool LoadLegacyPeptideIndex(FILE* fp,
+                                      comet_fileoffset_t lFirstPeptidePos,
+                                      uint64_t tNumPeptides,
+                                      int iMaxPeptideMass10);
+
+   static int _iIndexFormat;                          // format of the last parsed .idx header
+   static char* _pcPeptideIndexMap;                   // read-only mapping of v2 .idx file; NULL if not mapped
+   static size_t _tPeptideIndexMapSize;
+   static const PeptideIndexRecord* _pPeptideRecords;
+   static const char* _pcSequenceHeap;
+   static const comet_fileoffset_t* _plMassIndex;    // file offset of first record in each 0.1 Da bin, -1 if empty
+   static comet_fileoffset_t _lRecordsPos;            // file offset of _pPeptideRecords[0]
+   static size_t _tNumPeptides;
+   static int _iMaxPeptideMass10;
+   static vector<PeptideIndexRecord> _vPeptideRecords; // legacy .idx files are converted to records in memory
+   static vector<char> _vSequenceHeap;
+   static vector<comet_fileoffset_t> _vMassIndex;
 };
 
 #endif // _COMETPEPTIDEINDEX_H_
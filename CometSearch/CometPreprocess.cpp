@@ -16,14 +16,29 @@
 #include "Common.h"
 #include "CometDataInternal.h"
 #include "CometPreprocess.h"
+#include "CometSearch.h"
 #include "CometStatus.h"
 #include "CometMassSpecUtils.h"
 #include <string.h>
 
+#if defined(__x86_64__) || defined(_M_X64)
+#define PREPROCESS_SIMD
+#include <immintrin.h>
+#ifdef _WIN32
+#include <intrin.h>
+#define PREPROCESS_TARGET_AVX2
+#else
+#define PREPROCESS_TARGET_AVX2   __attribute__((target("avx2")))
+#endif
+#endif
+
 Mutex CometPreprocess::_maxChargeMutex;
 bool CometPreprocess::_bDoneProcessingAllSpectra;
 bool CometPreprocess::_bFirstScan;
-bool *CometPreprocess::pbMemoryPool;
+bool CometPreprocess::_bPrefetchChecked;
+bool CometPreprocess::_bPrefetch;
+CometSpectrumPrefetch CometPreprocess::_spectrumPrefetch;
+CometSlotPool CometPreprocess::memoryPoolSlots;
 double **CometPreprocess::ppdTmpRawDataArr;
 double **CometPreprocess::ppdTmpFastXcorrDataArr;
 double **CometPreprocess::ppdTmpCorrelationDataArr;
@@ -37,11 +52,11 @@ float **CometPreprocess::ppfSpScoreData;
 //
 // Eliminates per-spectrum heap traffic by pre-allocating:
 //   - 6 large float/double scratch buffers (sized to iArraySizeGlobal)
-//   - a flat slab of float[SPARSE_MATRIX_SIZE] blocks for sparse child arrays
+//   - a CometArena for the sparse rows and row tables; the thread-local
+//     counterpart of g_batchArena, reset per spectrum instead of per batch
 //
 // Lifecycle: allocated on first use, freed when the thread exits.
 // The pool is only used by the RTS (single-spectrum) search path.
-// The batch-search path continues to allocate normally.
 // ---------------------------------------------------------------------------
 struct RtsScratch
 {
@@ -52,18 +67,15 @@ struct RtsScratch
    float*  pfFastXcorrDataNL;
    float*  pfSpScoreData;
 
-   // Flat slab of pre-zeroed float[SPARSE_MATRIX_SIZE] blocks.
-   // Handed out sequentially; zeroed in bulk at ResetForNewSpectrum().
-   float*  pSparseChildPool;
-   int     iSparsePoolCapacity;    // total number of SPARSE_MATRIX_SIZE blocks in pool
-   int     iSparsePoolUsed;        // blocks handed out during current call
+   // Sparse rows of the spectrum being preprocessed; single-threaded, so no lock.
+   CometArena arenaSparse;
 
    int     iAllocSize;             // 0 = not yet initialised
 
    RtsScratch()
       : pdTmpRawData(nullptr), pdTmpFastXcorrData(nullptr), pdTmpCorrelationData(nullptr),
         pfFastXcorrData(nullptr), pfFastXcorrDataNL(nullptr), pfSpScoreData(nullptr),
-        pSparseChildPool(nullptr), iSparsePoolCapacity(0), iSparsePoolUsed(0), iAllocSize(0)
+        arenaSparse(4 * 1024 * 1024, false), iAllocSize(0)
    {}
 
    ~RtsScratch()
@@ -74,7 +86,6 @@ struct RtsScratch
       delete[] pfFastXcorrData;
       delete[] pfFastXcorrDataNL;
       delete[] pfSpScoreData;
-      delete[] pSparseChildPool;
    }
 
    // Called once on first use (or if global array size changes at re-init).
@@ -90,7 +101,6 @@ struct RtsScratch
       delete[] pfFastXcorrData;
       delete[] pfFastXcorrDataNL;
       delete[] pfSpScoreData;
-      delete[] pSparseChildPool;
 
       pdTmpRawData         = new double[iSize];
       pdTmpFastXcorrData   = new double[iSize];
@@ -99,39 +109,301 @@ struct RtsScratch
       pfFastXcorrDataNL    = new float[iSize];
       pfSpScoreData        = new float[iSize];
 
-      // Each spectrum uses at most (iSize/SPARSE_MATRIX_SIZE + 1) child blocks per
-      // sparse matrix; there are 3 matrices.  A 2× margin covers dense spectra.
-      iSparsePoolCapacity = 6 * (iSize / SPARSE_MATRIX_SIZE + 2);
-      pSparseChildPool    = new float[(size_t)iSparsePoolCapacity * SPARSE_MATRIX_SIZE]();
-
-      iSparsePoolUsed = 0;
       iAllocSize      = iSize;
    }
 
-   // Zero out the child-array blocks used during the previous call and reset the counter.
-   // Called at the start of each new spectrum so blocks are clean for reuse.
+   // Called at the start of each new spectrum:  the previous spectrum's Query
+   // has been deleted by then, so its sparse rows can be handed out again.
    void ResetForNewSpectrum()
    {
-      if (iSparsePoolUsed > 0)
+      arenaSparse.Reset();
+   }
+};
+
+thread_local RtsScratch g_rtsScratch;
+
+
+// ---------------------------------------------------------------------------
+// Preprocessing kernels.
+//
+// Each kernel has a scalar version and an AVX2 version picked once at startup.
+// The AVX2 versions do the same double operations per element in the same
+// order (no reassociation, no FMA) so their output is bit-identical to the
+// scalar code.  The fast xcorr sliding window is left scalar as its running
+// sum depends on the order of additions.
+// ---------------------------------------------------------------------------
+
+typedef double (*WindowMaxFn)(const double *pdData, int iStart, int iEnd);
+typedef void (*WindowNormalizeFn)(const double *pdRawData, double *pdCorrelationData, int iStart, int iEnd, double dScale, double dThreshold);
+typedef void (*SpScoreTransformFn)(const double *pdRawData, float *pfSpScoreData, int iArraySize, double dHighestIntensity);
+typedef void (*FastXcorrTransformFn)(const double *pdCorrelationData, const double *pdFastXcorrData, float *pfFastXcorrData, float *pfFastXcorrDataNL,
+                                     int iStart, int iEnd, int iArraySize, bool bFlank, bool bUseNL, int iMinus17, int iMinus18);
+
+// largest value of pdData[iStart, iEnd), 0 if none is positive
+static double WindowMaxScalar(const double *pdData,
+                              int iStart,
+                              int iEnd)
+{
+   double dMax = 0.0;
+
+   for (int i = iStart; i < iEnd; ++i)
+   {
+      if (pdData[i] > dMax)
+         dMax = pdData[i];
+   }
+
+   return dMax;
+}
+
+// pdCorrelationData = pdRawData * dScale wherever pdRawData > dThreshold
+static void WindowNormalizeScalar(const double *pdRawData,
+                                  double *pdCorrelationData,
+                                  int iStart,
+                                  int iEnd,
+                                  double dScale,
+                                  double dThreshold)
+{
+   for (int i = iStart; i < iEnd; ++i)
+   {
+      if (pdRawData[i] > dThreshold)
+         pdCorrelationData[i] = pdRawData[i] * dScale;
+   }
+}
+
+// binned peaks normalized to a max intensity of 100
+static void SpScoreTransformScalar(const double *pdRawData,
+                                   float *pfSpScoreData,
+                                   int iArraySize,
+                                   double dHighestIntensity)
+{
+   for (int i = 0; i < iArraySize; ++i)
+      pfSpScoreData[i] = (float)(100.0 * pdRawData[i] / dHighestIntensity);
+}
+
+// pfFastXcorrData[i] = correlation minus its local mean, plus half of each
+// flanking bin if bFlank; pfFastXcorrDataNL adds a fifth of the -17/-18 bins.
+static void FastXcorrTransformScalar(const double *pdCorrelationData,
+                                     const double *pdFastXcorrData,
+                                     float *pfFastXcorrData,
+                                     float *pfFastXcorrDataNL,
+                                     int iStart,
+                                     int iEnd,
+                                     int iArraySize,
+                                     bool bFlank,
+                                     bool bUseNL,
+                                     int iMinus17,
+                                     int iMinus18)
+{
+   for (int i = iStart; i < iEnd; ++i)
+   {
+      double dTmp = pdCorrelationData[i] - pdFastXcorrData[i];
+
+      pfFastXcorrData[i] = (float)dTmp;
+
+      // Add flanking peaks if used
+      if (bFlank)
       {
-         memset(pSparseChildPool, 0,
-                (size_t)iSparsePoolUsed * SPARSE_MATRIX_SIZE * sizeof(float));
-         iSparsePoolUsed = 0;
+         int iTmp;
+
+         iTmp = i-1;
+         pfFastXcorrData[i] += (float) ((pdCorrelationData[iTmp] - pdFastXcorrData[iTmp])*0.5);
+
+         iTmp = i+1;
+         if (iTmp < iArraySize)
+            pfFastXcorrData[i] += (float) ((pdCorrelationData[iTmp] - pdFastXcorrData[iTmp])*0.5);
+      }
+
+      // roll in -17/-18 contributions to pfFastXcorrDataNL
+      if (bUseNL)
+      {
+         int iTmp;
+
+         pfFastXcorrDataNL[i] = pfFastXcorrData[i];
+
+         iTmp = i-iMinus17;
+         if (iTmp>= 0)
+            pfFastXcorrDataNL[i] += (float)((pdCorrelationData[iTmp] - pdFastXcorrData[iTmp]) * 0.2);
+
+         iTmp = i-iMinus18;
+         if (iTmp>= 0)
+            pfFastXcorrDataNL[i] += (float)((pdCorrelationData[iTmp] - pdFastXcorrData[iTmp]) * 0.2);
       }
    }
+}
+
+#ifdef PREPROCESS_SIMD
+PREPROCESS_TARGET_AVX2
+static double WindowMaxAVX2(const double *pdData,
+                            int iStart,
+                            int iEnd)
+{
+   __m256d vMax = _mm256_setzero_pd();
+   int i = iStart;
 
-   // Return a zeroed float[SPARSE_MATRIX_SIZE] block from the pool.
-   // Falls back to heap allocation only if the pool is exhausted (should not happen
-   // in practice for normal spectra with iArraySizeGlobal).
-   float* AllocSparseChild()
+   for (; i + 4 <= iEnd; i += 4)
+      vMax = _mm256_max_pd(vMax, _mm256_loadu_pd(pdData + i));
+
+   double pdMax[4];
+   _mm256_storeu_pd(pdMax, vMax);
+
+   double dMax = WindowMaxScalar(pdData, i, iEnd);
+   for (int ii = 0; ii < 4; ++ii)
    {
-      if (iSparsePoolUsed < iSparsePoolCapacity)
-         return pSparseChildPool + (size_t)iSparsePoolUsed++ * SPARSE_MATRIX_SIZE;
-      return new float[SPARSE_MATRIX_SIZE]();   // safety fallback
+      if (pdMax[ii] > dMax)
+         dMax = pdMax[ii];
    }
-};
 
-thread_local RtsScratch g_rtsScratch;
+   return dMax;
+}
+
+PREPROCESS_TARGET_AVX2
+static void WindowNormalizeAVX2(const double *pdRawData,
+                                double *pdCorrelationData,
+                                int iStart,
+                                int iEnd,
+                                double dScale,
+                                double dThreshold)
+{
+   const __m256d vScale = _mm256_set1_pd(dScale);
+   const __m256d vThreshold = _mm256_set1_pd(dThreshold);
+   int i = iStart;
+
+   for (; i + 4 <= iEnd; i += 4)
+   {
+      __m256d vRaw = _mm256_loadu_pd(pdRawData + i);
+      __m256i vMask = _mm256_castpd_si256(_mm256_cmp_pd(vRaw, vThreshold, _CMP_GT_OQ));
+
+      _mm256_maskstore_pd(pdCorrelationData + i, vMask, _mm256_mul_pd(vRaw, vScale));
+   }
+
+   WindowNormalizeScalar(pdRawData, pdCorrelationData, i, iEnd, dScale, dThreshold);
+}
+
+PREPROCESS_TARGET_AVX2
+static void SpScoreTransformAVX2(const double *pdRawData,
+                                 float *pfSpScoreData,
+                                 int iArraySize,
+                                 double dHighestIntensity)
+{
+   const __m256d v100 = _mm256_set1_pd(100.0);
+   const __m256d vHighest = _mm256_set1_pd(dHighestIntensity);
+   int i = 0;
+
+   for (; i + 4 <= iArraySize; i += 4)
+   {
+      __m256d vSp = _mm256_div_pd(_mm256_mul_pd(v100, _mm256_loadu_pd(pdRawData + i)), vHighest);
+      _mm_storeu_ps(pfSpScoreData + i, _mm256_cvtpd_ps(vSp));
+   }
+
+   for (; i < iArraySize; ++i)
+      pfSpScoreData[i] = (float)(100.0 * pdRawData[i] / dHighestIntensity);
+}
+
+PREPROCESS_TARGET_AVX2
+static void FastXcorrTransformAVX2(const double *pdCorrelationData,
+                                   const double *pdFastXcorrData,
+                                   float *pfFastXcorrData,
+                                   float *pfFastXcorrDataNL,
+                                   int iStart,
+                                   int iEnd,
+                                   int iArraySize,
+                                   bool bFlank,
+                                   bool bUseNL,
+                                   int iMinus17,
+                                   int iMinus18)
+{
+   // the vector loop needs bins i-1, i+1 and the neutral loss bins in range
+   int iVecStart = (iStart < 1 ? 1 : iStart);
+   int iVecEnd = (iEnd > iArraySize - 1 ? iArraySize - 1 : iEnd);
+
+   if (bUseNL)
+   {
+      if (iVecStart < iMinus17)
+         iVecStart = iMinus17;
+      if (iVecStart < iMinus18)
+         iVecStart = iMinus18;
+   }
+
+   if (iVecStart + 4 > iVecEnd)
+   {
+      FastXcorrTransformScalar(pdCorrelationData, pdFastXcorrData, pfFastXcorrData, pfFastXcorrDataNL,
+            iStart, iEnd, iArraySize, bFlank, bUseNL, iMinus17, iMinus18);
+      return;
+   }
+
+   FastXcorrTransformScalar(pdCorrelationData, pdFastXcorrData, pfFastXcorrData, pfFastXcorrDataNL,
+         iStart, iVecStart, iArraySize, bFlank, bUseNL, iMinus17, iMinus18);
+
+   const __m256d vHalf = _mm256_set1_pd(0.5);
+   const __m256d vFifth = _mm256_set1_pd(0.2);
+   int i = iVecStart;
+
+   for (; i + 4 <= iVecEnd; i += 4)
+   {
+      __m256d vTmp = _mm256_sub_pd(_mm256_loadu_pd(pdCorrelationData + i), _mm256_loadu_pd(pdFastXcorrData + i));
+      __m128 vXcorr = _mm256_cvtpd_ps(vTmp);
+
+      if (bFlank)
+      {
+         vTmp = _mm256_sub_pd(_mm256_loadu_pd(pdCorrelationData + i - 1), _mm256_loadu_pd(pdFastXcorrData + i - 1));
+         vXcorr = _mm_add_ps(vXcorr, _mm256_cvtpd_ps(_mm256_mul_pd(vTmp, vHalf)));
+
+         vTmp = _mm256_sub_pd(_mm256_loadu_pd(pdCorrelationData + i + 1), _mm256_loadu_pd(pdFastXcorrData + i + 1));
+         vXcorr = _mm_add_ps(vXcorr, _mm256_cvtpd_ps(_mm256_mul_pd(vTmp, vHalf)));
+      }
+
+      _mm_storeu_ps(pfFastXcorrData + i, vXcorr);
+
+      if (bUseNL)
+      {
+         vTmp = _mm256_sub_pd(_mm256_loadu_pd(pdCorrelationData + i - iMinus17), _mm256_loadu_pd(pdFastXcorrData + i - iMinus17));
+         vXcorr = _mm_add_ps(vXcorr, _mm256_cvtpd_ps(_mm256_mul_pd(vTmp, vFifth)));
+
+         vTmp = _mm256_sub_pd(_mm256_loadu_pd(pdCorrelationData + i - iMinus18), _mm256_loadu_pd(pdFastXcorrData + i - iMinus18));
+         vXcorr = _mm_add_ps(vXcorr, _mm256_cvtpd_ps(_mm256_mul_pd(vTmp, vFifth)));
+
+         _mm_storeu_ps(pfFastXcorrDataNL + i, vXcorr);
+      }
+   }
+
+   FastXcorrTransformScalar(pdCorrelationData, pdFastXcorrData, pfFastXcorrData, pfFastXcorrDataNL,
+         i, iEnd, iArraySize, bFlank, bUseNL, iMinus17, iMinus18);
+}
+
+// CPU and OS support for the AVX2 kernels.
+static bool PreprocessCpuSupportsAVX2(void)
+{
+#ifdef _WIN32
+   int piInfo[4];
+   __cpuid(piInfo, 0);
+   if (piInfo[0] < 7)
+      return false;
+
+   __cpuid(piInfo, 1);
+   if (!(piInfo[2] & (1 << 27)))  // OSXSAVE
+      return false;
+
+   unsigned long long ullXCR0 = _xgetbv(0);
+   __cpuidex(piInfo, 7, 0);
+
+   return (piInfo[1] & (1 << 5)) && (ullXCR0 & 0x6) == 0x6;
+#else
+   __builtin_cpu_init();
+
+   return __builtin_cpu_supports("avx2");
+#endif
+}
+
+static const bool g_bPreprocessAVX2 = PreprocessCpuSupportsAVX2();
+#define PREPROCESS_KERNEL(name) (g_bPreprocessAVX2 ? name##AVX2 : name##Scalar)
+#else
+#define PREPROCESS_KERNEL(name) (name##Scalar)
+#endif
+
+static const WindowMaxFn g_pfnWindowMax = PREPROCESS_KERNEL(WindowMax);
+static const WindowNormalizeFn g_pfnWindowNormalize = PREPROCESS_KERNEL(WindowNormalize);
+static const SpScoreTransformFn g_pfnSpScoreTransform = PREPROCESS_KERNEL(SpScoreTransform);
+static const FastXcorrTransformFn g_pfnFastXcorrTransform = PREPROCESS_KERNEL(FastXcorrTransform);
 
 // Generate data for both sp scoring (pfSpScoreData) and xcorr analysis (FastXcorr).
 CometPreprocess::CometPreprocess()
@@ -146,6 +418,9 @@ void CometPreprocess::Reset()
 {
     _bFirstScan = true;
     _bDoneProcessingAllSpectra = false;
+    _bPrefetchChecked = false;
+    _bPrefetch = false;
+    _spectrumPrefetch.Stop();
 }
 
 bool CometPreprocess::ReadPrecursors(MSReader &mstReader)
@@ -581,6 +856,20 @@ bool CometPreprocess::LoadAndPreprocessSpectra(MSReader &mstReader,
                                                int iLastScan,
                                                int iAnalysisType,
                                                ThreadPool* tp)
+{
+   return LoadAndPreprocessSpectra(mstReader, iFirstScan, iLastScan, iAnalysisType, tp,
+      g_pvQuery, g_batchArena, g_massRange.usiMaxFragmentCharge);
+}
+
+
+bool CometPreprocess::LoadAndPreprocessSpectra(MSReader &mstReader,
+                                               int iFirstScan,
+                                               int iLastScan,
+                                               int iAnalysisType,
+                                               ThreadPool* tp,
+                                               vector<Query*>& vQuery,
+                                               CometArena& arena,
+                                               unsigned short& usiMaxFragmentCharge)
 {
    int iFileLastScan = -1;         // The actual last scan in the file.
    int iScanNumber = 0;
@@ -589,7 +878,9 @@ bool CometPreprocess::LoadAndPreprocessSpectra(MSReader &mstReader,
    int iTmpCount = 0;
    Spectrum mstSpectrum;           // For holding spectrum.
 
-   g_massRange.usiMaxFragmentCharge = 0;
+   PreprocessLoadContext loadContext(&vQuery, &arena, &usiMaxFragmentCharge);
+
+   usiMaxFragmentCharge = 0;
    g_staticParams.precalcMasses.iMinus17 = BIN(g_staticParams.massUtility.dH2O);
    g_staticParams.precalcMasses.iMinus18 = BIN(g_staticParams.massUtility.dNH3);
 
@@ -609,6 +900,11 @@ bool CometPreprocess::LoadAndPreprocessSpectra(MSReader &mstReader,
          PreloadIons(mstReader, mstSpectrum, false, 0);  // Use 0 as scan num here in last argument instead of iFirstScan; must
          _bFirstScan = false;                            // be MS/MS scan else data not read by MSToolkit so safer to start at 0.
       }                                                  // Not ideal as could be reading non-relevant scans but it's fast enough.
+      else if (_bPrefetch)
+      {
+         if (!_spectrumPrefetch.Next(mstSpectrum) && g_cometStatus.IsError())
+            break;
+      }
       else
       {
          PreloadIons(mstReader, mstSpectrum, true);
@@ -642,6 +938,15 @@ bool CometPreprocess::LoadAndPreprocessSpectra(MSReader &mstReader,
          }
       }
 
+      // mstReader is now positioned at iScanNumber; read the remaining scans ahead
+      if (!_bPrefetchChecked)
+      {
+         _bPrefetchChecked = true;
+
+         if (iScanNumber != 0)
+            StartSpectrumPrefetch(mstReader, iScanNumber, (int)pPreprocessThreadPool->get_thread_count());
+      }
+
       if (iScanNumber != 0)
       {
          int iNumClearedPeaks = 0;
@@ -695,13 +1000,13 @@ bool CometPreprocess::LoadAndPreprocessSpectra(MSReader &mstReader,
 
             if (CheckActivationMethodFilter(mstSpectrum.getActivationMethod()))
             {
-               // add this hack when 1 thread is specified otherwise g_pvQuery.size() returns 0
-               if (g_staticParams.options.iNumThreads == 1)
+               // add this hack when 1 thread is specified otherwise vQuery.size() returns 0
+               if (pPreprocessThreadPool->get_thread_count() == 1)
                   pPreprocessThreadPool->wait_on_threads();
 
                Threading::LockMutex(g_pvQueryMutex);
                // this needed because processing can add multiple spectra at a time
-               iNumSpectraLoaded = (int)g_pvQuery.size();
+               iNumSpectraLoaded = (int)vQuery.size();
                iNumSpectraLoaded++;
                Threading::UnlockMutex(g_pvQueryMutex);
 
@@ -711,7 +1016,7 @@ bool CometPreprocess::LoadAndPreprocessSpectra(MSReader &mstReader,
                //If there are no Z-lines, filter the spectrum for charge state
                //run filter here.
 
-               PreprocessThreadData *pPreprocessThreadData = new PreprocessThreadData(mstSpectrum, iAnalysisType, iFileLastScan);
+               PreprocessThreadData *pPreprocessThreadData = new PreprocessThreadData(mstSpectrum, iAnalysisType, iFileLastScan, &loadContext);
 
                pPreprocessThreadPool->doJob(std::bind(PreprocessThreadProc, pPreprocessThreadData, pPreprocessThreadPool));
             }
@@ -761,6 +1066,9 @@ bool CometPreprocess::LoadAndPreprocessSpectra(MSReader &mstReader,
    // Wait for active preprocess threads to complete processing.
    pPreprocessThreadPool->wait_on_threads();
 
+   if (_bDoneProcessingAllSpectra)
+      _spectrumPrefetch.Stop();
+
    Threading::DestroyMutex(_maxChargeMutex);
 
    bool bSucceeded = !g_cometStatus.IsError() && !g_cometStatus.IsCancel();
@@ -769,48 +1077,221 @@ bool CometPreprocess::LoadAndPreprocessSpectra(MSReader &mstReader,
 }
 
 
-void CometPreprocess::PreprocessThreadProc(PreprocessThreadData *pPreprocessThreadData,
-                                           ThreadPool* tp)
+// Reads the scans after iScanNumber on reader threads when the input is an indexed
+// mzML/mzXML file and more than one thread loads the batch.  Base64 decoding, inflating
+// and numpress decoding then run in parallel instead of on the loading thread.
+void CometPreprocess::StartSpectrumPrefetch(MSReader &mstReader,
+                                            int iScanNumber,
+                                            int iNumLoadThreads)
 {
-   // This returns false if it fails, but the errors are already logged
-   // so no need to check the return value here.
+   if (iNumLoadThreads < 2 || g_staticParams.inputFile.iInputType != InputType_MZXML)
+      return;
 
-   int i;
+   // Readers of a gzipped file load the random access index saved when the
+   // file was first opened.  Without it (e.g. read-only directory) every
+   // reader would first inflate the whole file to rebuild the index.
+   int iLen = (int)strlen(g_staticParams.inputFile.szFileName);
+   if (iLen > 3 && !STRCMP_IGNORE_CASE(g_staticParams.inputFile.szFileName + iLen - 3, ".gz")
+         && !mzParser::Czran::has_saved_index(g_staticParams.inputFile.szFileName, SPAN))
+      return;
 
-   //MH: Grab available array from shared memory pool.
-   Threading::LockMutex(g_preprocessMemoryPoolMutex);
-   auto tStartTime = std::chrono::high_resolution_clock::now();
-   const auto timeout_duration = std::chrono::seconds(240);
+   vector<int> vScans;
+   if (!mstReader.getIndexedScans(vScans, iScanNumber) || vScans.empty())
+      return;
+
+   // leave the other half of the loading threads to preprocessing
+   int iNumReaders = iNumLoadThreads / 2;
+   if (iNumReaders > MAX_PREFETCH_THREADS)
+      iNumReaders = MAX_PREFETCH_THREADS;
+
+   _spectrumPrefetch.Start(g_staticParams.inputFile.szFileName, vScans, iNumReaders);
+   _bPrefetch = true;
+}
+
+
+// Progress through the input file; mstReader itself stops advancing once the
+// remaining scans are read by _spectrumPrefetch.
+int CometPreprocess::GetReadPercent(MSReader &mstReader)
+{
+   if (_bPrefetch && mstReader.getLastScan() > 0)
+      return (int)((double)_spectrumPrefetch.LastScan() / mstReader.getLastScan() * 100);
+
+   return mstReader.getPercent();
+}
+
+
+CometSpectrumPrefetch::CometSpectrumPrefetch()
+   : _tNextRead(0), _tNextOut(0), _iLastScan(0), _bStop(false), _bFailed(false)
+{
+}
+
+
+CometSpectrumPrefetch::~CometSpectrumPrefetch()
+{
+   Stop();
+}
+
+
+void CometSpectrumPrefetch::Start(const char *szFileName,
+                                  const vector<int>& vScans,
+                                  int iNumReaders)
+{
+   Stop();
+
+   _strFileName = szFileName;
+   _vScans = vScans;
+   _vSlots.resize((size_t)iNumReaders * PREFETCH_SLOTS_PER_THREAD);
+   _vbReady.assign(_vSlots.size(), 0);
+   _tNextRead = 0;
+   _tNextOut = 0;
+   _iLastScan = 0;
+   _bStop = false;
+   _bFailed = false;
+
+   for (int i = 0; i < iNumReaders; ++i)
+      _vThreads.emplace_back(&CometSpectrumPrefetch::ReaderProc, this);
+}
+
+
+void CometSpectrumPrefetch::Stop()
+{
+   {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _bStop = true;
+   }
+   _cvSpace.notify_all();
+
+   for (auto it = _vThreads.begin(); it != _vThreads.end(); ++it)
+      it->join();
+
+   _vThreads.clear();
+   _vScans.clear();
+   _vSlots.clear();
+   _vbReady.clear();
+}
+
+
+bool CometSpectrumPrefetch::IsActive()
+{
+   return !_vThreads.empty();
+}
+
+
+int CometSpectrumPrefetch::LastScan()
+{
+   return _iLastScan;
+}
+
+
+bool CometSpectrumPrefetch::Next(Spectrum &spec)
+{
+   while (_tNextOut < _vScans.size())
+   {
+      size_t tSlot = _tNextOut % _vSlots.size();
+
+      {
+         std::unique_lock<std::mutex> lock(_mutex);
+         _cvReady.wait(lock, [&] { return _vbReady[tSlot] || _bFailed; });
+
+         if (_bFailed)
+            break;
+      }
+
+      // a scan at another MS level is read as an empty spectrum
+      bool bFound = (_vSlots[tSlot].getScanNumber() != 0);
+      if (bFound)
+      {
+         spec = _vSlots[tSlot];
+         _iLastScan = spec.getScanNumber();
+      }
+
+      {
+         std::lock_guard<std::mutex> lock(_mutex);
+         _vbReady[tSlot] = 0;
+         _tNextOut++;
+      }
+      _cvSpace.notify_all();
+
+      if (bFound)
+         return true;
+   }
+
+   spec.clear();
+   return false;
+}
+
+
+void CometSpectrumPrefetch::ReaderProc()
+{
+   MSReader mstReader;
+   bool bOpen = false;
+
+   CometPreprocess::SetMSLevelFilter(mstReader);
+   mstReader.setGZIndexSave(g_staticParams.options.iGZIndexCache != 0);
 
    while (true)
    {
-      for (i = 0; i < g_staticParams.options.iNumThreads; ++i)
+      size_t tPos;
+
+      {
+         std::unique_lock<std::mutex> lock(_mutex);
+         _cvSpace.wait(lock, [this] { return _bStop || _tNextRead >= _vScans.size() || _tNextRead < _tNextOut + _vSlots.size(); });
+
+         if (_bStop || _tNextRead >= _vScans.size())
+            return;
+
+         tPos = _tNextRead++;
+      }
+
+      // this slot's previous spectrum has been handed out so it is ours until marked ready
+      Spectrum &spec = _vSlots[tPos % _vSlots.size()];
+      spec.clear();
+      mstReader.readFile(bOpen ? NULL : _strFileName.c_str(), spec, _vScans[tPos]);
+
+      if (!bOpen)
       {
-         if (pbMemoryPool[i] == false)
+         bOpen = true;
+
+         if (mstReader.getLastScan() < 0)
          {
-            pbMemoryPool[i] = true;
-            break;
+            string strErrorMsg = " Error - cannot read input file \"" + _strFileName + "\" on a prefetch thread.\n";
+            g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
+            logerr(strErrorMsg);
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            _bFailed = true;
+            _cvReady.notify_all();
+            return;
          }
       }
 
-      if (i < g_staticParams.options.iNumThreads
-         || std::chrono::high_resolution_clock::now() - tStartTime > timeout_duration)
       {
-         break;
+         std::lock_guard<std::mutex> lock(_mutex);
+         _vbReady[tPos % _vSlots.size()] = 1;
       }
+      _cvReady.notify_all();
    }
-   Threading::UnlockMutex(g_preprocessMemoryPoolMutex);
+}
+
+
+void CometPreprocess::PreprocessThreadProc(PreprocessThreadData *pPreprocessThreadData,
+                                           ThreadPool* tp)
+{
+   // This returns false if it fails, but the errors are already logged
+   // so no need to check the return value here.
 
-   if (i == g_staticParams.options.iNumThreads)
+   //MH: Grab available array from shared memory pool.
+   int i = memoryPoolSlots.Acquire();
+
+   if (i < 0)
    {
       logerr(" Error - could not find available memory pool for MS2 preprocessing thread.\n");
+      delete pPreprocessThreadData;
       return;
    }
 
-   //MH: Give memory manager access to the thread.
-   pPreprocessThreadData->SetMemory(&pbMemoryPool[i]);
-
    PreprocessSpectrum(pPreprocessThreadData->mstSpectrum,
+         pPreprocessThreadData->pLoadContext,
          ppdTmpRawDataArr[i],
          ppdTmpFastXcorrDataArr[i],
          ppdTmpCorrelationDataArr[i],
@@ -818,6 +1299,9 @@ void CometPreprocess::PreprocessThreadProc(PreprocessThreadData *pPreprocessThre
          ppfFastXcorrDataNL[i],
          ppfSpScoreData[i]);
 
+   //MH: Mark that the memory is no longer in use.
+   memoryPoolSlots.Release(i);
+
    delete pPreprocessThreadData;
    pPreprocessThreadData = NULL;
 }
@@ -831,41 +1315,15 @@ void CometPreprocess::PreprocessThreadProcMS1(PreprocessThreadData* pPreprocessT
    // This returns false if it fails, but the errors are already logged
    // so no need to check the return value here.
 
-   int i;
-
-   Threading::LockMutex(g_preprocessMemoryPoolMutex);
-   auto tStartTime = std::chrono::high_resolution_clock::now();
-   const auto timeout_duration = std::chrono::seconds(240);
-
-
-   while (true)
-   {
-      for (i = 0; i < g_staticParams.options.iNumThreads; ++i)
-      {
-         if (pbMemoryPool[i] == false)
-         {
-            pbMemoryPool[i] = true;
-            break;
-         }
-      }
-
-      if (i < g_staticParams.options.iNumThreads
-         || std::chrono::high_resolution_clock::now() - tStartTime > timeout_duration)
-      {
-         break;
-      }
-   }
-   Threading::UnlockMutex(g_preprocessMemoryPoolMutex);
+   int i = memoryPoolSlots.Acquire();
 
-   if (i == g_staticParams.options.iNumThreads)
+   if (i < 0)
    {
       logerr(" Error - could not find available memory pool for MS1 preprocessing thread.\n");
+      delete pPreprocessThreadDataMS1;
       return;
    }
 
-   //MH: Give memory manager access to the thread.
-   pPreprocessThreadDataMS1->SetMemory(&pbMemoryPool[i]);
-
    double* pdTmpRawData = ppdTmpRawDataArr[i];
    double* pdTmpFastXcorrData = ppdTmpFastXcorrDataArr[i];
    double* pdTmpCorrelationData = ppdTmpCorrelationDataArr[i];
@@ -943,6 +1401,8 @@ void CometPreprocess::PreprocessThreadProcMS1(PreprocessThreadData* pPreprocessT
    g_vSpecLib.push_back(pTmp);
    Threading::UnlockMutex(g_pvQueryMutex);
 
+   memoryPoolSlots.Release(i);
+
    delete pPreprocessThreadDataMS1;
    pPreprocessThreadDataMS1 = NULL;
 }
@@ -954,8 +1414,166 @@ bool CometPreprocess::DoneProcessingAllSpectra()
 }
 
 
+// Number of SPARSE_MATRIX_SIZE rows of pfData[iStart, iArraySize) that hold at least one
+// value kept in the sparse matrix:  |value| > FLOAT_ZERO if bSigned, else value > FLOAT_ZERO.
+int CometPreprocess::CountSparseRows(const float *pfData,
+                                     int iStart,
+                                     int iArraySize,
+                                     bool bSigned)
+{
+   int iNumRows = 0;
+   int iLastRow = -1;
+
+   for (int i = iStart; i < iArraySize; ++i)
+   {
+      if (pfData[i] > FLOAT_ZERO || (bSigned && pfData[i] < -FLOAT_ZERO))
+      {
+         int x = i / SPARSE_MATRIX_SIZE;
+         if (x != iLastRow)
+         {
+            iNumRows++;
+            iLastRow = x;
+         }
+      }
+   }
+
+   return iNumRows;
+}
+
+
+// Copy the values kept by CountSparseRows() into ppfSparse, taking each new row from
+// *ppfNextRow which must point to enough zeroed rows.
+void CometPreprocess::FillSparseMatrix(float **ppfSparse,
+                                       float **ppfNextRow,
+                                       const float *pfData,
+                                       int iStart,
+                                       int iArraySize,
+                                       bool bSigned)
+{
+   for (int i = iStart; i < iArraySize; ++i)
+   {
+      if (pfData[i] > FLOAT_ZERO || (bSigned && pfData[i] < -FLOAT_ZERO))
+      {
+         int x = i / SPARSE_MATRIX_SIZE;
+         if (ppfSparse[x] == NULL)
+         {
+            ppfSparse[x] = *ppfNextRow;
+            *ppfNextRow += SPARSE_MATRIX_SIZE;
+         }
+         ppfSparse[x][i - x * SPARSE_MATRIX_SIZE] = pfData[i];
+      }
+   }
+}
+
+
+// Rows of the sparse row block used by the fast xcorr matrix and, if bUseNL, its NL
+// version.  When the matrix has data in enough of its rows (XCORR_DENSE_MAX_RATIO),
+// *pbDense is set and every row is counted so the data can be kept as one dense
+// array for the xcorr kernels.
+size_t CometPreprocess::CountXcorrRows(struct Query *pScoring,
+                                       const float *pfFastXcorrData,
+                                       const float *pfFastXcorrDataNL,
+                                       bool bUseNL,
+                                       bool *pbDense)
+{
+   int iArraySize = pScoring->_spectrumInfoInternal.iArraySize;
+   size_t tRows = (size_t)CountSparseRows(pfFastXcorrData, 1, iArraySize, true);
+
+   *pbDense = (tRows * XCORR_DENSE_MAX_RATIO >= (size_t)pScoring->iFastXcorrDataSize);
+
+   if (*pbDense)
+      return (size_t)pScoring->iFastXcorrDataSize * (bUseNL ? 2 : 1);
+
+   if (bUseNL)
+      tRows += (size_t)CountSparseRows(pfFastXcorrDataNL, 1, iArraySize, true);
+
+   return tRows;
+}
+
+
+// Fills the fast xcorr matrix (and its NL version) from *ppfNextRow.  Dense matrices
+// take iFastXcorrDataSize consecutive zeroed rows; values FillSparseMatrix() would
+// drop stay zero and only rows holding data get a row pointer, so readers of the
+// sparse matrix see the same values either way.
+void CometPreprocess::FillXcorrMatrices(struct Query *pScoring,
+                                        float **ppfNextRow,
+                                        const float *pfFastXcorrData,
+                                        const float *pfFastXcorrDataNL,
+                                        bool bUseNL,
+                                        bool bDense)
+{
+   int iArraySize = pScoring->_spectrumInfoInternal.iArraySize;
+
+   if (!bDense)
+   {
+      if (bUseNL)
+         FillSparseMatrix(pScoring->ppfSparseFastXcorrDataNL, ppfNextRow, pfFastXcorrDataNL, 1, iArraySize, true);
+      FillSparseMatrix(pScoring->ppfSparseFastXcorrData, ppfNextRow, pfFastXcorrData, 1, iArraySize, true);
+      return;
+   }
+
+   for (int iPass = (bUseNL ? 0 : 1); iPass < 2; ++iPass)
+   {
+      float **ppfSparse = (iPass == 0 ? pScoring->ppfSparseFastXcorrDataNL : pScoring->ppfSparseFastXcorrData);
+      const float *pfData = (iPass == 0 ? pfFastXcorrDataNL : pfFastXcorrData);
+      float *pfDense = *ppfNextRow;
+
+      *ppfNextRow += (size_t)pScoring->iFastXcorrDataSize * SPARSE_MATRIX_SIZE;
+
+      for (int i = 1; i < iArraySize; ++i)
+      {
+         if (pfData[i] > FLOAT_ZERO || pfData[i] < -FLOAT_ZERO)
+         {
+            int x = i / SPARSE_MATRIX_SIZE;
+            ppfSparse[x] = pfDense + (size_t)x * SPARSE_MATRIX_SIZE;
+            pfDense[i] = pfData[i];
+         }
+      }
+
+      if (iPass == 0)
+         pScoring->pfDenseFastXcorrDataNL = pfDense;
+      else
+         pScoring->pfDenseFastXcorrData = pfDense;
+   }
+}
+
+
+// Carves the sparse rows and the row pointer tables of pScoring out of one
+// zeroed arena allocation and returns the first row.  Throws std::bad_alloc.
+float* CometPreprocess::AllocSparseFromArena(struct Query *pScoring,
+                                             CometArena *pArena,
+                                             size_t tNumRows,
+                                             bool bUseNL)
+{
+   size_t tRowBytes = tNumRows * SPARSE_MATRIX_SIZE * sizeof(float);
+   tRowBytes = (tRowBytes + sizeof(float*) - 1) & ~(sizeof(float*) - 1);
+
+   size_t tNumPtrs = (size_t)pScoring->iFastXcorrDataSize + (size_t)pScoring->iSpScoreData;
+   if (bUseNL)
+      tNumPtrs += (size_t)pScoring->iFastXcorrDataSize;
+
+   size_t tBytes = tRowBytes + tNumPtrs * sizeof(float*);
+   char *pBlock = (char*)pArena->Allocate(tBytes);
+   memset(pBlock, 0, tBytes);
+
+   float **ppfTable = (float**)(pBlock + tRowBytes);
+   if (bUseNL)
+   {
+      pScoring->ppfSparseFastXcorrDataNL = ppfTable;
+      ppfTable += pScoring->iFastXcorrDataSize;
+   }
+   pScoring->ppfSparseFastXcorrData = ppfTable;
+   ppfTable += pScoring->iFastXcorrDataSize;
+   pScoring->ppfSparseSpScoreData = ppfTable;
+   pScoring->bSparseFromArena = true;
+
+   return (float*)pBlock;
+}
+
+
 bool CometPreprocess::Preprocess(struct Query *pScoring,
                                  Spectrum mstSpectrum,
+                                 CometArena *pArena,
                                  double *pdTmpRawData,
                                  double *pdTmpFastXcorrData,
                                  double *pdTmpCorrelationData,
@@ -964,17 +1582,15 @@ bool CometPreprocess::Preprocess(struct Query *pScoring,
                                  float *pfSpScoreData)
 {
    int i;
-   int x;
-   int y;
    struct PreprocessStruct pPre;
 
    pPre.iHighestIon = 0;
    pPre.dHighestIntensity = 0;
 
-   // initialize these temporary arrays before re-using
-   size_t iTmp = (size_t)(g_staticParams.iArraySizeGlobal * sizeof(double));
+   // initialize these temporary arrays before re-using; pdTmpFastXcorrData and
+   // the float arrays are completely overwritten over [0, iArraySize) below
+   size_t iTmp = (size_t)GetScratchZeroSize(pScoring) * sizeof(double);
    memset(pdTmpRawData, 0, iTmp);
-   memset(pdTmpFastXcorrData, 0, iTmp);
    memset(pdTmpCorrelationData, 0, iTmp);
 
    // pdTmpRawData is a binned array holding raw data
@@ -1000,184 +1616,57 @@ bool CometPreprocess::Preprocess(struct Query *pScoring,
    double dTmp = 1.0 / (iTmpRange - 1.0);
    double dMinXcorrInten = 0.0;
 
-   dSum = 0.0;
-   for (i = 0; i < g_staticParams.iXcorrProcessingOffset; ++i)
-      dSum += pdTmpCorrelationData[i];
-   for (i = g_staticParams.iXcorrProcessingOffset; i < pScoring->_spectrumInfoInternal.iArraySize + g_staticParams.iXcorrProcessingOffset; ++i)
-   {
-      if (dMinXcorrInten < pdTmpCorrelationData[i])
-         dMinXcorrInten = pdTmpCorrelationData[i];
-
-      if (i < pScoring->_spectrumInfoInternal.iArraySize)
-         dSum += pdTmpCorrelationData[i];
-      if (i >= iTmpRange)
-         dSum -= pdTmpCorrelationData[i - iTmpRange];
-      pdTmpFastXcorrData[i - g_staticParams.iXcorrProcessingOffset] = (dSum - pdTmpCorrelationData[i - g_staticParams.iXcorrProcessingOffset]) * dTmp;
-   }
-
-   pScoring->iMinXcorrHisto = (int)(dMinXcorrInten * 10.0 * 0.005 + 0.5);
-
-   pfFastXcorrData[0] = 0.0;
-   for (i=1; i<pScoring->_spectrumInfoInternal.iArraySize; ++i)
-   {
-      double dTmp = pdTmpCorrelationData[i] - pdTmpFastXcorrData[i];
-
-      pfFastXcorrData[i] = (float)dTmp;
-
-      // Add flanking peaks if used
-      if (g_staticParams.ionInformation.iTheoreticalFragmentIons == 0)
-      {
-         int iTmp;
-
-         iTmp = i-1;
-         pfFastXcorrData[i] += (float) ((pdTmpCorrelationData[iTmp] - pdTmpFastXcorrData[iTmp])*0.5);
-
-         iTmp = i+1;
-         if (iTmp < pScoring->_spectrumInfoInternal.iArraySize)
-            pfFastXcorrData[i] += (float) ((pdTmpCorrelationData[iTmp] - pdTmpFastXcorrData[iTmp])*0.5);
-      }
-
-      // If A, B or Y ions and their neutral loss selected, roll in -17/-18 contributions to pfFastXcorrDataNL
-      if (g_staticParams.ionInformation.bUseWaterAmmoniaLoss
-            && (g_staticParams.ionInformation.iIonVal[ION_SERIES_A]
-               || g_staticParams.ionInformation.iIonVal[ION_SERIES_B]
-               || g_staticParams.ionInformation.iIonVal[ION_SERIES_Y]))
-      {
-         int iTmp;
-
-         pfFastXcorrDataNL[i] = pfFastXcorrData[i];
-
-         iTmp = i-g_staticParams.precalcMasses.iMinus17;
-         if (iTmp>= 0)
-         {
-            pfFastXcorrDataNL[i] += (float)((pdTmpCorrelationData[iTmp] - pdTmpFastXcorrData[iTmp]) * 0.2);
-         }
-
-         iTmp = i-g_staticParams.precalcMasses.iMinus18;
-         if (iTmp>= 0)
-         {
-            pfFastXcorrDataNL[i] += (float)((pdTmpCorrelationData[iTmp] - pdTmpFastXcorrData[iTmp]) * 0.2);
-         }
-      }
-   }
-
-   pScoring->iFastXcorrDataSize = (pScoring->_spectrumInfoInternal.iArraySize / SPARSE_MATRIX_SIZE) + 1;
-
-   // Using sparse matrix which means we free pScoring->pfFastXcorrData, ->pfFastXcorrDataNL here
-   // If A, B or Y ions and their neutral loss selected, roll in -17/-18 contributions to pfFastXcorrDataNL.
-   if (g_staticParams.ionInformation.bUseWaterAmmoniaLoss
-         && (g_staticParams.ionInformation.iIonVal[ION_SERIES_A]
-            || g_staticParams.ionInformation.iIonVal[ION_SERIES_B]
-            || g_staticParams.ionInformation.iIonVal[ION_SERIES_Y]))
-   {
-
-      try
-      {
-         pScoring->ppfSparseFastXcorrDataNL = new float*[pScoring->iFastXcorrDataSize]();
-      }
-      catch (std::bad_alloc& ba)
-      {
-         string strErrorMsg =" Error - new(pScoring->ppfSparseFastXcorrDataNL["
-            + std::to_string(pScoring->iFastXcorrDataSize) + "]). bad_alloc: " + std::string(ba.what()) + ".\n"
-            + "Comet ran out of memory. Look into \"spectrum_batch_size\"\n"
-            + "parameters to address mitigate memory use.\n";
-         g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
-         logerr(strErrorMsg);
-         return false;
-      }
-
-      for (i=1; i<pScoring->_spectrumInfoInternal.iArraySize; ++i)
-      {
-         if (pfFastXcorrDataNL[i]>FLOAT_ZERO || pfFastXcorrDataNL[i]<-FLOAT_ZERO)
-         {
-            x=i/SPARSE_MATRIX_SIZE;
-            if (pScoring->ppfSparseFastXcorrDataNL[x]==NULL)
-            {
-               try
-               {
-                  pScoring->ppfSparseFastXcorrDataNL[x] = new float[SPARSE_MATRIX_SIZE]();
-               }
-               catch (std::bad_alloc& ba)
-               {
-                  string strErrorMsg =" Error - new(pScoring->ppfSparseFastXcorrDataNL["
-                     + std::to_string(x) + "][" + std::to_string(SPARSE_MATRIX_SIZE) + "]). bad_alloc: " + std::string(ba.what()) + ".\n"
-                     + "Comet ran out of memory. Look into \"spectrum_batch_size\"\n"
-                     + "parameters to address mitigate memory use.\n";
-                  g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
-                  logerr(strErrorMsg);
-                  return false;
-               }
-               for (y=0; y<SPARSE_MATRIX_SIZE; ++y)
-                  pScoring->ppfSparseFastXcorrDataNL[x][y]=0;
-            }
-            y=i-(x*SPARSE_MATRIX_SIZE);
-            pScoring->ppfSparseFastXcorrDataNL[x][y] = pfFastXcorrDataNL[i];
-         }
-      }
-   }
-
-   //MH: Fill sparse matrix
-   try
-   {
-      pScoring->ppfSparseFastXcorrData = new float*[pScoring->iFastXcorrDataSize]();
-   }
-   catch (std::bad_alloc& ba)
+   dSum = 0.0;
+   for (i = 0; i < g_staticParams.iXcorrProcessingOffset; ++i)
+      dSum += pdTmpCorrelationData[i];
+   for (i = g_staticParams.iXcorrProcessingOffset; i < pScoring->_spectrumInfoInternal.iArraySize + g_staticParams.iXcorrProcessingOffset; ++i)
    {
-      string strErrorMsg =" Error - new(pScoring->ppfSparseFastXcorrData["
-         + std::to_string(pScoring->iFastXcorrDataSize) + "]). bad_alloc: " + std::string(ba.what()) + ".\n"
-         + "Comet ran out of memory. Look into \"spectrum_batch_size\"\n"
-         + "parameters to address mitigate memory use.\n";
-      g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
-      logerr(strErrorMsg);
-      return false;
-   }
+      if (dMinXcorrInten < pdTmpCorrelationData[i])
+         dMinXcorrInten = pdTmpCorrelationData[i];
 
-   for (i=1; i<pScoring->_spectrumInfoInternal.iArraySize; ++i)
-   {
-      if (pfFastXcorrData[i]>FLOAT_ZERO || pfFastXcorrData[i]<-FLOAT_ZERO)
-      {
-         x=i/SPARSE_MATRIX_SIZE;
-         if (pScoring->ppfSparseFastXcorrData[x]==NULL)
-         {
-            try
-            {
-               pScoring->ppfSparseFastXcorrData[x] = new float[SPARSE_MATRIX_SIZE]();
-            }
-            catch (std::bad_alloc& ba)
-            {
-               string strErrorMsg =" Error - new(pScoring->ppfSparseFastXcorrData["
-                  + std::to_string(x) + "][" + std::to_string(SPARSE_MATRIX_SIZE) + "]). bad_alloc: " + std::string(ba.what()) + ".\n"
-                  + "Comet ran out of memory. Look into \"spectrum_batch_size\"\n"
-                  + "parameters to address mitigate memory use.\n";
-               g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
-               logerr(strErrorMsg);
-               return false;
-            }
-            for (y=0; y<SPARSE_MATRIX_SIZE; ++y)
-               pScoring->ppfSparseFastXcorrData[x][y]=0;
-         }
-         y=i-(x*SPARSE_MATRIX_SIZE);
-         pScoring->ppfSparseFastXcorrData[x][y] = pfFastXcorrData[i];
-      }
+      if (i < pScoring->_spectrumInfoInternal.iArraySize)
+         dSum += pdTmpCorrelationData[i];
+      if (i >= iTmpRange)
+         dSum -= pdTmpCorrelationData[i - iTmpRange];
+      pdTmpFastXcorrData[i - g_staticParams.iXcorrProcessingOffset] = (dSum - pdTmpCorrelationData[i - g_staticParams.iXcorrProcessingOffset]) * dTmp;
    }
 
+   pScoring->iMinXcorrHisto = (int)(dMinXcorrInten * 10.0 * 0.005 + 0.5);
+
+   // If A, B or Y ions and their neutral loss selected, roll in -17/-18 contributions to pfFastXcorrDataNL
+   bool bUseNL = (g_staticParams.ionInformation.bUseWaterAmmoniaLoss
+         && (g_staticParams.ionInformation.iIonVal[ION_SERIES_A]
+            || g_staticParams.ionInformation.iIonVal[ION_SERIES_B]
+            || g_staticParams.ionInformation.iIonVal[ION_SERIES_Y]));
+
+   pfFastXcorrData[0] = 0.0;
+   g_pfnFastXcorrTransform(pdTmpCorrelationData, pdTmpFastXcorrData, pfFastXcorrData, pfFastXcorrDataNL,
+         1, pScoring->_spectrumInfoInternal.iArraySize, pScoring->_spectrumInfoInternal.iArraySize,
+         g_staticParams.ionInformation.iTheoreticalFragmentIons == 0, bUseNL,
+         g_staticParams.precalcMasses.iMinus17, g_staticParams.precalcMasses.iMinus18);
+
    // Create data for sp scoring which is just the binned peaks normalized to max inten 100
-   for (i = 0; i < pScoring->_spectrumInfoInternal.iArraySize; ++i)
-   {
-      pfSpScoreData[i] = (float)(100.0 * pdTmpRawData[i] / pPre.dHighestIntensity);
-   }
+   g_pfnSpScoreTransform(pdTmpRawData, pfSpScoreData, pScoring->_spectrumInfoInternal.iArraySize, pPre.dHighestIntensity);
 
-   // MH: Fill sparse matrix for SpScore
+   pScoring->iFastXcorrDataSize = (pScoring->_spectrumInfoInternal.iArraySize / SPARSE_MATRIX_SIZE) + 1;
    pScoring->iSpScoreData = pScoring->_spectrumInfoInternal.iArraySize / SPARSE_MATRIX_SIZE + 1;
 
+   //MH: Fill sparse matrices.  All rows of the three matrices and their row tables
+   // share one zeroed block carved from the batch arena, released with the batch.
+   bool bDense;
+   size_t tNumRows = CountXcorrRows(pScoring, pfFastXcorrData, pfFastXcorrDataNL, bUseNL, &bDense)
+      + (size_t)CountSparseRows(pfSpScoreData, 0, pScoring->_spectrumInfoInternal.iArraySize, false);
+
+   float *pfNextRow;
+
    try
    {
-      pScoring->ppfSparseSpScoreData = new float*[pScoring->iSpScoreData]();
+      pfNextRow = AllocSparseFromArena(pScoring, pArena, tNumRows, bUseNL);
    }
    catch (std::bad_alloc& ba)
    {
-      string strErrorMsg =" Error - new(pScoring->ppfSparseSpScoreData["
-         + std::to_string(pScoring->iSpScoreData) + "]). bad_alloc: " + std::string(ba.what()) + ".\n"
+      string strErrorMsg =" Error - g_batchArena.Allocate(sparse rows["
+         + std::to_string(tNumRows * SPARSE_MATRIX_SIZE) + "]). bad_alloc: " + std::string(ba.what()) + ".\n"
          + "Comet ran out of memory. Look into \"spectrum_batch_size\"\n"
          + "parameters to address mitigate memory use.\n";
       g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
@@ -1185,34 +1674,8 @@ bool CometPreprocess::Preprocess(struct Query *pScoring,
       return false;
    }
 
-   for (i=0; i<pScoring->_spectrumInfoInternal.iArraySize; ++i)
-   {
-      if (pfSpScoreData[i] > FLOAT_ZERO)
-      {
-         x=i/SPARSE_MATRIX_SIZE;
-         if (pScoring->ppfSparseSpScoreData[x]==NULL)
-         {
-            try
-            {
-               pScoring->ppfSparseSpScoreData[x] = new float[SPARSE_MATRIX_SIZE]();
-            }
-            catch (std::bad_alloc& ba)
-            {
-               string strErrorMsg =" Error - new(pScoring->ppfSparseSpScoreData["
-                  + std::to_string(x) + "][" + std::to_string(SPARSE_MATRIX_SIZE) + "]). bad_alloc: " + std::string(ba.what()) + ".\n"
-                  + "Comet ran out of memory. Look into \"spectrum_batch_size\"\n"
-                  + "parameters to address mitigate memory use.\n";
-               g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
-               logerr(strErrorMsg);
-               return false;
-            }
-            for (y=0; y<SPARSE_MATRIX_SIZE; ++y)
-               pScoring->ppfSparseSpScoreData[x][y]=0;
-         }
-         y=i-(x*SPARSE_MATRIX_SIZE);
-         pScoring->ppfSparseSpScoreData[x][y] = pfSpScoreData[i];
-      }
-   }
+   FillXcorrMatrices(pScoring, &pfNextRow, pfFastXcorrData, pfFastXcorrDataNL, bUseNL, bDense);
+   FillSparseMatrix(pScoring->ppfSparseSpScoreData, &pfNextRow, pfSpScoreData, 0, pScoring->_spectrumInfoInternal.iArraySize, false);
 
    return true;
 }
@@ -1224,8 +1687,9 @@ bool CometPreprocess::Preprocess(struct Query *pScoring,
 //   - The 5 scratch buffers are taken from the per-thread RtsScratch pool instead
 //     of being heap-allocated, eliminating 5 new[]/delete[] pairs per spectrum.
 //   - pdTmpSpectrum is ignored; g_rtsScratch.pdTmpRawData is used instead.
-//   - Sparse matrix child arrays come from the pool (Query::bSparseFromPool=true).
-//   - Only the region [0, iArraySize + iXcorrOffset) is zeroed rather than
+//   - Sparse matrix rows and row tables come from the thread-local arena
+//     (Query::bSparseFromArena=true).
+//   - Only the region given by GetScratchZeroSize() is zeroed rather than
 //     the full iArraySizeGlobal, saving significant memset time.
 Query* CometPreprocess::PreprocessSingleSpectrumCore(int iPrecursorCharge,
                                                      double dMZ,
@@ -1276,8 +1740,8 @@ Query* CometPreprocess::PreprocessSingleSpectrumCore(int iPrecursorCharge,
    // --- Scratch buffer setup ---
    //
    // RTS path  (bUseThreadLocalPool=true): use pre-allocated per-thread buffers.
-   //   - Zero only [0, iArraySize + iXcorrProcessingOffset) — the region actually
-   //     read/written — instead of the full iArraySizeGlobal.
+   //   - Zero only the leading GetScratchZeroSize() bins of the raw and correlation
+   //     data - the region actually read - instead of the full iArraySizeGlobal.
    //
    // Batch path (bUseThreadLocalPool=false): allocate on heap as before.
 
@@ -1304,19 +1768,11 @@ Query* CometPreprocess::PreprocessSingleSpectrumCore(int iPrecursorCharge,
       pfFastXcorrDataNL    = g_rtsScratch.pfFastXcorrDataNL;
       pfSpScoreData        = g_rtsScratch.pfSpScoreData;
 
-      pScoring->bSparseFromPool = true;
-
-      // Zero only the region that will be accessed.
-      // pdTmpCorrelationData and pdTmpFastXcorrData are read up to
-      // iArraySize + iXcorrOffset by the sliding-window loop.
-      const size_t nD = (size_t)(iArraySize + iXcorrOffset);
-      const size_t nF = (size_t)iArraySize;
+      // Zero only the region that will be read.  pdTmpFastXcorrData and the
+      // float arrays are completely overwritten over [0, iArraySize) below.
+      const size_t nD = (size_t)GetScratchZeroSize(pScoring);
       memset(pdTmpRawData,         0, nD * sizeof(double));
-      memset(pdTmpFastXcorrData,   0, nD * sizeof(double));
       memset(pdTmpCorrelationData, 0, nD * sizeof(double));
-      memset(pfFastXcorrData,      0, nF * sizeof(float));
-      memset(pfFastXcorrDataNL,    0, nF * sizeof(float));
-      memset(pfSpScoreData,        0, nF * sizeof(float));
    }
    else
    {
@@ -1328,7 +1784,7 @@ Query* CometPreprocess::PreprocessSingleSpectrumCore(int iPrecursorCharge,
       pfSpScoreData        = new float[iGlobalBytes]();
 
       // Zero the raw data buffer (caller may not have cleared it)
-      memset(pdTmpRawData, 0, iGlobalBytes * sizeof(double));
+      memset(pdTmpRawData, 0, (size_t)GetScratchZeroSize(pScoring) * sizeof(double));
    }
 
 #ifdef RTS_TIMING
@@ -1530,40 +1986,15 @@ Query* CometPreprocess::PreprocessSingleSpectrumCore(int iPrecursorCharge,
 
    pScoring->iMinXcorrHisto = (int)(dMinXcorrInten * 10.0 * 0.005 + 0.5);
 
-   pfFastXcorrData[0] = 0.0;
-   for (i = 1; i < iArraySize; ++i)
-   {
-      double dVal = pdTmpCorrelationData[i] - pdTmpFastXcorrData[i];
-
-      pfFastXcorrData[i] = (float)dVal;
-
-      if (g_staticParams.ionInformation.iTheoreticalFragmentIons == 0)
-      {
-         int iTmpIdx;
-         iTmpIdx = i - 1;
-         pfFastXcorrData[i] += (float)((pdTmpCorrelationData[iTmpIdx] - pdTmpFastXcorrData[iTmpIdx]) * 0.5);
-         iTmpIdx = i + 1;
-         if (iTmpIdx < iArraySize)
-            pfFastXcorrData[i] += (float)((pdTmpCorrelationData[iTmpIdx] - pdTmpFastXcorrData[iTmpIdx]) * 0.5);
-      }
-
-      if (g_staticParams.ionInformation.bUseWaterAmmoniaLoss
-            && (g_staticParams.ionInformation.iIonVal[ION_SERIES_A]
-               || g_staticParams.ionInformation.iIonVal[ION_SERIES_B]
-               || g_staticParams.ionInformation.iIonVal[ION_SERIES_Y]))
-      {
-         int iTmpIdx;
-         pfFastXcorrDataNL[i] = pfFastXcorrData[i];
-
-         iTmpIdx = i - g_staticParams.precalcMasses.iMinus17;
-         if (iTmpIdx >= 0)
-            pfFastXcorrDataNL[i] += (float)((pdTmpCorrelationData[iTmpIdx] - pdTmpFastXcorrData[iTmpIdx]) * 0.2);
+   bool bUseNL = (g_staticParams.ionInformation.bUseWaterAmmoniaLoss
+         && (g_staticParams.ionInformation.iIonVal[ION_SERIES_A]
+            || g_staticParams.ionInformation.iIonVal[ION_SERIES_B]
+            || g_staticParams.ionInformation.iIonVal[ION_SERIES_Y]));
 
-         iTmpIdx = i - g_staticParams.precalcMasses.iMinus18;
-         if (iTmpIdx >= 0)
-            pfFastXcorrDataNL[i] += (float)((pdTmpCorrelationData[iTmpIdx] - pdTmpFastXcorrData[iTmpIdx]) * 0.2);
-      }
-   }
+   pfFastXcorrData[0] = 0.0;
+   g_pfnFastXcorrTransform(pdTmpCorrelationData, pdTmpFastXcorrData, pfFastXcorrData, pfFastXcorrDataNL,
+         1, iArraySize, iArraySize, g_staticParams.ionInformation.iTheoreticalFragmentIons == 0, bUseNL,
+         g_staticParams.precalcMasses.iMinus17, g_staticParams.precalcMasses.iMinus18);
 
 #ifdef RTS_TIMING
    if (bUseThreadLocalPool)
@@ -1571,89 +2002,33 @@ Query* CometPreprocess::PreprocessSingleSpectrumCore(int iPrecursorCharge,
 #endif
 
    // --- Build sparse matrices on the Query ---
-   int x, y;
    pScoring->iFastXcorrDataSize = (iArraySize / SPARSE_MATRIX_SIZE) + 1;
+   pScoring->iSpScoreData = iArraySize / SPARSE_MATRIX_SIZE + 1;
 
-   // Sparse NL matrix
-   if (g_staticParams.ionInformation.bUseWaterAmmoniaLoss
-         && (g_staticParams.ionInformation.iIonVal[ION_SERIES_A]
-            || g_staticParams.ionInformation.iIonVal[ION_SERIES_B]
-            || g_staticParams.ionInformation.iIonVal[ION_SERIES_Y]))
-   {
-      try
-      {
-         pScoring->ppfSparseFastXcorrDataNL = new float*[pScoring->iFastXcorrDataSize]();
-      }
-      catch (std::bad_alloc&)
-      {
-         delete[] pdTmpFastXcorrData;
-         delete[] pdTmpCorrelationData;
-         delete[] pfFastXcorrData;
-         delete[] pfFastXcorrDataNL;
-         delete[] pfSpScoreData;
-         delete pScoring;
-         return nullptr;
-      }
+   g_pfnSpScoreTransform(pdTmpRawData, pfSpScoreData, iArraySize, pPre.dHighestIntensity);
 
-      for (i = 1; i < iArraySize; ++i)
-      {
-         if (pfFastXcorrDataNL[i] > FLOAT_ZERO || pfFastXcorrDataNL[i] < -FLOAT_ZERO)
-         {
-            x = i / SPARSE_MATRIX_SIZE;
-            if (pScoring->ppfSparseFastXcorrDataNL[x] == NULL)
-            {
-               pScoring->ppfSparseFastXcorrDataNL[x] = bUseThreadLocalPool
-                  ? g_rtsScratch.AllocSparseChild()
-                  : new float[SPARSE_MATRIX_SIZE]();
-            }
-            y = i - (x * SPARSE_MATRIX_SIZE);
-            pScoring->ppfSparseFastXcorrDataNL[x][y] = pfFastXcorrDataNL[i];
-         }
-      }
-   }
+   // All rows of the three matrices are taken from one contiguous run of zeroed
+   // rows:  the RtsScratch arena on the RTS path, else a block owned by the Query.
+   bool bDense;
+   size_t tNumRows = CountXcorrRows(pScoring, pfFastXcorrData, pfFastXcorrDataNL, bUseNL, &bDense)
+      + (size_t)CountSparseRows(pfSpScoreData, 0, iArraySize, false);
 
-   // Sparse fast xcorr matrix
-   try
-   {
-      pScoring->ppfSparseFastXcorrData = new float*[pScoring->iFastXcorrDataSize]();
-   }
-   catch (std::bad_alloc&)
-   {
-      if (!bUseThreadLocalPool)
-      {
-         delete[] pdTmpFastXcorrData;
-         delete[] pdTmpCorrelationData;
-         delete[] pfFastXcorrData;
-         delete[] pfFastXcorrDataNL;
-         delete[] pfSpScoreData;
-      }
-      delete pScoring;
-      return nullptr;
-   }
+   float *pfNextRow = NULL;
 
-   for (i = 1; i < iArraySize; ++i)
+   try
    {
-      if (pfFastXcorrData[i] > FLOAT_ZERO || pfFastXcorrData[i] < -FLOAT_ZERO)
+      if (bUseThreadLocalPool)
+         pfNextRow = AllocSparseFromArena(pScoring, &g_rtsScratch.arenaSparse, tNumRows, bUseNL);
+      else
       {
-         x = i / SPARSE_MATRIX_SIZE;
-         if (pScoring->ppfSparseFastXcorrData[x] == NULL)
-         {
-            pScoring->ppfSparseFastXcorrData[x] = bUseThreadLocalPool
-               ? g_rtsScratch.AllocSparseChild()
-               : new float[SPARSE_MATRIX_SIZE]();
-         }
-         y = i - (x * SPARSE_MATRIX_SIZE);
-         pScoring->ppfSparseFastXcorrData[x][y] = pfFastXcorrData[i];
+         pScoring->pfSparseRows = new float[tNumRows * SPARSE_MATRIX_SIZE]();
+         pfNextRow = pScoring->pfSparseRows;
+         if (bUseNL)
+            pScoring->ppfSparseFastXcorrDataNL = new float*[pScoring->iFastXcorrDataSize]();
+         pScoring->ppfSparseFastXcorrData = new float*[pScoring->iFastXcorrDataSize]();
+         pScoring->ppfSparseSpScoreData = new float*[pScoring->iSpScoreData]();
       }
    }
-
-   // Sparse Sp score matrix
-   pScoring->iSpScoreData = iArraySize / SPARSE_MATRIX_SIZE + 1;
-
-   try
-   {
-      pScoring->ppfSparseSpScoreData = new float*[pScoring->iSpScoreData]();
-   }
    catch (std::bad_alloc&)
    {
       if (!bUseThreadLocalPool)
@@ -1664,30 +2039,18 @@ Query* CometPreprocess::PreprocessSingleSpectrumCore(int iPrecursorCharge,
          delete[] pfFastXcorrDataNL;
          delete[] pfSpScoreData;
       }
+      delete[] pScoring->pfSparseRows;
+      delete[] pScoring->ppfSparseFastXcorrDataNL;
+      delete[] pScoring->ppfSparseFastXcorrData;
+      pScoring->pfSparseRows = NULL;
+      pScoring->ppfSparseFastXcorrDataNL = NULL;
+      pScoring->ppfSparseFastXcorrData = NULL;
       delete pScoring;
       return nullptr;
    }
 
-   for (i = 0; i < iArraySize; ++i)
-   {
-      pfSpScoreData[i] = (float)(100.0 * pdTmpRawData[i] / pPre.dHighestIntensity);
-   }
-
-   for (i = 0; i < iArraySize; ++i)
-   {
-      if (pfSpScoreData[i] > FLOAT_ZERO)
-      {
-         x = i / SPARSE_MATRIX_SIZE;
-         if (pScoring->ppfSparseSpScoreData[x] == NULL)
-         {
-            pScoring->ppfSparseSpScoreData[x] = bUseThreadLocalPool
-               ? g_rtsScratch.AllocSparseChild()
-               : new float[SPARSE_MATRIX_SIZE]();
-         }
-         y = i - (x * SPARSE_MATRIX_SIZE);
-         pScoring->ppfSparseSpScoreData[x][y] = pfSpScoreData[i];
-      }
-   }
+   FillXcorrMatrices(pScoring, &pfNextRow, pfFastXcorrData, pfFastXcorrDataNL, bUseNL, bDense);
+   FillSparseMatrix(pScoring->ppfSparseSpScoreData, &pfNextRow, pfSpScoreData, 0, iArraySize, false);
 
    // Free heap-allocated scratch buffers.
    // Pool path: buffers are thread-local; nothing to free.
@@ -1757,6 +2120,18 @@ Query* CometPreprocess::PreprocessSingleSpectrumCore(int iPrecursorCharge,
       }
    }
 
+   int iNumBuckets;
+   size_t tOrderSize = StoredResultsOrder::BlockSize(g_staticParams.options.iNumStored, &iNumBuckets);
+
+   pScoring->_resultsOrder.SetBlock(new int[tOrderSize], g_staticParams.options.iNumStored, iNumBuckets);
+   CometSearch::InitStoredOrder(&pScoring->_resultsOrder, pScoring->_pResults);
+
+   if (g_staticParams.options.iDecoySearch == 2)
+   {
+      pScoring->_decoysOrder.SetBlock(new int[tOrderSize], g_staticParams.options.iNumStored, iNumBuckets);
+      CometSearch::InitStoredOrder(&pScoring->_decoysOrder, pScoring->_pDecoys);
+   }
+
 #ifdef RTS_TIMING
    if (bUseThreadLocalPool)
    {
@@ -1839,6 +2214,21 @@ void CometPreprocess::PreloadIons(MSReader &mstReader,
 }
 
 
+void CometPreprocess::SetMSLevelFilter(MSReader &mstReader)
+{
+   vector<MSSpectrumType> msLevel;
+
+   if (g_staticParams.options.iMSLevel == 3)
+      msLevel.push_back(MS3);
+   else if (g_staticParams.options.iMSLevel == 2)
+      msLevel.push_back(MS2);
+   else if (g_staticParams.options.iMSLevel == 1)
+      msLevel.push_back(MS1);
+
+   mstReader.setFilter(msLevel);
+}
+
+
 bool CometPreprocess::CheckActivationMethodFilter(MSActivation act)
 {
    bool bSearchSpectrum = true;
@@ -1952,6 +2342,7 @@ bool CometPreprocess::CheckExit(int iAnalysisType,
 
 
 bool CometPreprocess::PreprocessSpectrum(Spectrum &spec,
+                                         PreprocessLoadContext *pLoadContext,
                                          double *pdTmpRawData,
                                          double *pdTmpFastXcorrData,
                                          double *pdTmpCorrelationData,
@@ -2109,6 +2500,9 @@ bool CometPreprocess::PreprocessSpectrum(Spectrum &spec,
          }
       }
 
+      // queries for all valid charge states of this precursor; preprocessed below
+      vector<Query*> vScanQueries;
+
       // now analyze all possible precursor charges for this spectrum
       for (vector<pair<int, double>>::iterator iter = vChargeStates.begin(); iter != vChargeStates.end(); ++iter)
       {
@@ -2121,7 +2515,19 @@ bool CometPreprocess::PreprocessSpectrum(Spectrum &spec,
                && iPrecursorCharge <= g_staticParams.options.iMaxPrecursorCharge
                && iPrecursorCharge >= g_staticParams.options.iMinPrecursorCharge)
          {
-            Query *pScoring = new Query();
+            Query *pScoring;
+            try
+            {
+               pScoring = new (pLoadContext->pArena->Allocate(sizeof(Query))) Query();
+            }
+            catch (std::bad_alloc& ba)
+            {
+               string strErrorMsg = " Error - g_batchArena.Allocate(Query). bad_alloc: " + std::string(ba.what()) + ".\n";
+               g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
+               logerr(strErrorMsg);
+               return false;
+            }
+            pScoring->bInBatchArena = true;
 
             pScoring->dMangoIndex = iScanNumber + 0.0001 * distance(vChargeStates.begin(),iter);  // for Mango; used to sort by this value to get original file order
 
@@ -2149,38 +2555,115 @@ bool CometPreprocess::PreprocessSpectrum(Spectrum &spec,
 
             Threading::LockMutex(_maxChargeMutex);
             // g_massRange.iMaxFragmentCharge is global maximum fragment ion charge across all spectra.
-            if (pScoring->_spectrumInfoInternal.usiMaxFragCharge > g_massRange.usiMaxFragmentCharge)
+            if (pScoring->_spectrumInfoInternal.usiMaxFragCharge > *pLoadContext->pusiMaxFragmentCharge)
             {
-               g_massRange.usiMaxFragmentCharge = pScoring->_spectrumInfoInternal.usiMaxFragCharge;
+               *pLoadContext->pusiMaxFragmentCharge = pScoring->_spectrumInfoInternal.usiMaxFragCharge;
             }
             Threading::UnlockMutex(_maxChargeMutex);
 
             if (!AdjustMassTol(pScoring))
             {
-               delete pScoring;
+               DestroyQuery(pScoring);
+               for (size_t ii = 0; ii < vScanQueries.size(); ++ii)
+                  DestroyQuery(vScanQueries[ii]);
                return false;
             }
 
-            // Populate pdCorrelation data.
-            // NOTE: there must be a good way of doing this just once per spectrum instead
-            //       of repeating for each charge state.
-            if (!Preprocess(pScoring, spec, pdTmpRawData, pdTmpFastXcorrData, pdTmpCorrelationData, pfFastXcorrData, pfFastXcorrDataNL, pfSpScoreData))
+            vScanQueries.push_back(pScoring);
+         }
+      }
+
+      if (vScanQueries.empty())
+         continue;
+
+      // Charge states that bin exactly the same peaks share one preprocessed spectrum.
+      // The peaks must also sit more than the xcorr window below each query's
+      // iArraySize so that the shared arrays are zero past every query's own range.
+      // Precursor peak removal depends on charge so it rules out sharing.
+      vector<int> viNumLoadedPeaks(vScanQueries.size(), -1);
+      vector<size_t> vtOrder(vScanQueries.size());
+      for (size_t ii = 0; ii < vScanQueries.size(); ++ii)
+         vtOrder[ii] = ii;
+
+      if (vScanQueries.size() > 1 && g_staticParams.options.iRemovePrecursor == 0)
+      {
+         double dIntensityCutoff = GetIntensityCutoff(spec);
+
+         for (size_t ii = 0; ii < vScanQueries.size(); ++ii)
+         {
+            int iHighestIon;
+            int iNumPeaks = CountLoadedPeaks(spec, dIntensityCutoff, vScanQueries[ii]->_pepMassInfo.dExpPepMass, &iHighestIon);
+
+            if (iHighestIon + g_staticParams.iXcorrProcessingOffset < vScanQueries[ii]->_spectrumInfoInternal.iArraySize)
+               viNumLoadedPeaks[ii] = iNumPeaks;
+         }
+
+         // preprocess the largest array first; its sparse row tables cover every smaller one
+         std::stable_sort(vtOrder.begin(), vtOrder.end(), [&vScanQueries](size_t a, size_t b)
+            { return vScanQueries[a]->_spectrumInfoInternal.iArraySize > vScanQueries[b]->_spectrumInfoInternal.iArraySize; });
+      }
+
+      for (size_t ii = 0; ii < vtOrder.size(); ++ii)
+      {
+         size_t tWhich = vtOrder[ii];
+         Query *pScoring = vScanQueries[tWhich];
+         Query *pSource = NULL;
+
+         for (size_t jj = 0; jj < ii && viNumLoadedPeaks[tWhich] != -1; ++jj)
+         {
+            if (viNumLoadedPeaks[vtOrder[jj]] == viNumLoadedPeaks[tWhich])
             {
-               delete pScoring;
-               return false;
+               pSource = vScanQueries[vtOrder[jj]];
+               break;
             }
+         }
 
-            Threading::LockMutex(g_pvQueryMutex);
-            g_pvQuery.push_back(pScoring);
-            Threading::UnlockMutex(g_pvQueryMutex);
+         if (pSource != NULL)
+            SharePreprocessedSpectrum(pScoring, pSource);
+         else if (!Preprocess(pScoring, spec, pLoadContext->pArena, pdTmpRawData, pdTmpFastXcorrData, pdTmpCorrelationData, pfFastXcorrData, pfFastXcorrDataNL, pfSpScoreData))
+         {
+            for (size_t jj = 0; jj < vScanQueries.size(); ++jj)
+               DestroyQuery(vScanQueries[jj]);
+            return false;
          }
       }
+
+      Threading::LockMutex(g_pvQueryMutex);
+      pLoadContext->pvQuery->insert(pLoadContext->pvQuery->end(), vScanQueries.begin(), vScanQueries.end());
+      Threading::UnlockMutex(g_pvQueryMutex);
    }
 
    return true;
 }
 
 
+// Point pScoring at the sparse matrices preprocessed for pSource, another charge state
+// of the same scan that binned exactly the same peaks.  The rows live in the batch arena
+// so they stay valid until the batch is released.  Only the row counts follow
+// pScoring's own iArraySize; the rows past it are all empty.
+void CometPreprocess::SharePreprocessedSpectrum(struct Query *pScoring,
+                                                const struct Query *pSource)
+{
+   pScoring->_spectrumInfoInternal.dTotalIntensity = pSource->_spectrumInfoInternal.dTotalIntensity;
+   strcpy(pScoring->_spectrumInfoInternal.szNativeID, pSource->_spectrumInfoInternal.szNativeID);
+
+   pScoring->vfRawFragmentPeakMass = pSource->vfRawFragmentPeakMass;
+   pScoring->vRawFragmentPeakMassIntensity = pSource->vRawFragmentPeakMassIntensity;
+
+   pScoring->iMinXcorrHisto = pSource->iMinXcorrHisto;
+
+   pScoring->iFastXcorrDataSize = (pScoring->_spectrumInfoInternal.iArraySize / SPARSE_MATRIX_SIZE) + 1;
+   pScoring->iSpScoreData = pScoring->_spectrumInfoInternal.iArraySize / SPARSE_MATRIX_SIZE + 1;
+
+   pScoring->ppfSparseFastXcorrData = pSource->ppfSparseFastXcorrData;
+   pScoring->ppfSparseFastXcorrDataNL = pSource->ppfSparseFastXcorrDataNL;
+   pScoring->ppfSparseSpScoreData = pSource->ppfSparseSpScoreData;
+   pScoring->pfDenseFastXcorrData = pSource->pfDenseFastXcorrData;
+   pScoring->pfDenseFastXcorrDataNL = pSource->pfDenseFastXcorrDataNL;
+   pScoring->bSparseFromArena = true;
+}
+
+
 bool CometPreprocess::AdjustMassTol(struct Query *pScoring)
 {
    if (g_staticParams.tolerances.iMassToleranceUnits == 0) // amu
@@ -2335,24 +2818,7 @@ bool CometPreprocess::LoadIons(struct Query *pScoring,
    double dIon,
           dIntensity;
 
-   // set dIntensityCutoff based on either minimum intensity or % of base peak
-   double dIntensityCutoff = g_staticParams.options.dMinIntensity;
-
-   if (g_staticParams.options.dMinPercentageIntensity > 0.0 && g_staticParams.options.dMinPercentageIntensity <= 1.0)
-   {
-      double dBasePeakIntensity = 0.0;
-
-      for (i = 0; i < mstSpectrum.size(); ++i)
-      {
-         if (mstSpectrum.at(i).intensity > dBasePeakIntensity)
-            dBasePeakIntensity = mstSpectrum.at(i).intensity;
-      }
-
-      dIntensityCutoff = g_staticParams.options.dMinPercentageIntensity * dBasePeakIntensity;
-
-      if (dIntensityCutoff < g_staticParams.options.dMinIntensity)
-         dIntensityCutoff = g_staticParams.options.dMinIntensity;
-   }
+   double dIntensityCutoff = GetIntensityCutoff(mstSpectrum);
 
    int iNumFragmentPeaks = 0;
 
@@ -2505,9 +2971,83 @@ bool CometPreprocess::LoadIons(struct Query *pScoring,
 }
 
 
+// set dIntensityCutoff based on either minimum intensity or % of base peak
+double CometPreprocess::GetIntensityCutoff(Spectrum &mstSpectrum)
+{
+   double dIntensityCutoff = g_staticParams.options.dMinIntensity;
+
+   if (g_staticParams.options.dMinPercentageIntensity > 0.0 && g_staticParams.options.dMinPercentageIntensity <= 1.0)
+   {
+      double dBasePeakIntensity = 0.0;
+
+      for (int i = 0; i < mstSpectrum.size(); ++i)
+      {
+         if (mstSpectrum.at(i).intensity > dBasePeakIntensity)
+            dBasePeakIntensity = mstSpectrum.at(i).intensity;
+      }
+
+      dIntensityCutoff = g_staticParams.options.dMinPercentageIntensity * dBasePeakIntensity;
+
+      if (dIntensityCutoff < g_staticParams.options.dMinIntensity)
+         dIntensityCutoff = g_staticParams.options.dMinIntensity;
+   }
+
+   return dIntensityCutoff;
+}
+
+
+// Number of peaks LoadIons() considers for a precursor of mass dExpPepMass and the
+// highest bin among them.  These peaks are all those below a mass cutoff so two
+// precursor masses with the same count see the same peaks.
+int CometPreprocess::CountLoadedPeaks(Spectrum &mstSpectrum,
+                                      double dIntensityCutoff,
+                                      double dExpPepMass,
+                                      int *piHighestIon)
+{
+   int iNumPeaks = 0;
+
+   *piHighestIon = 0;
+
+   for (int i = 0; i < mstSpectrum.size(); ++i)
+   {
+      double dIon = mstSpectrum.at(i).mz;
+      double dIntensity = mstSpectrum.at(i).intensity;
+
+      if (dIntensity >= dIntensityCutoff && dIntensity > 0.0 && dIon < dExpPepMass + 50.0)
+      {
+         int iBinIon = BIN(dIon);
+
+         if (iBinIon > *piHighestIon)
+            *piHighestIon = iBinIon;
+
+         iNumPeaks++;
+      }
+   }
+
+   return iNumPeaks;
+}
 
 
 // pdTmpRawData now holds raw data, pdTmpCorrelationData is windowed data after this function
+// Number of leading bins of pdTmpRawData and pdTmpCorrelationData read while
+// preprocessing pScoring:  the fast xcorr window runs iXcorrProcessingOffset bins
+// past iArraySize and MakeCorrData() visits every bin up to the highest peak
+// below dExpPepMass + 50, which can lie beyond iArraySize.
+int CometPreprocess::GetScratchZeroSize(struct Query *pScoring)
+{
+   int iSize = pScoring->_spectrumInfoInternal.iArraySize + g_staticParams.iXcorrProcessingOffset;
+   int iHighestIon = BIN(pScoring->_pepMassInfo.dExpPepMass + 50.0);
+
+   if (iHighestIon >= iSize)
+      iSize = iHighestIon + 1;
+
+   if (iSize > g_staticParams.iArraySizeGlobal)
+      iSize = g_staticParams.iArraySizeGlobal;
+
+   return iSize;
+}
+
+
 // FIX: need to check why both iArraySize and iHighestIons are used
 void CometPreprocess::MakeCorrData(double* pdTmpRawData,
    double* pdTmpCorrelationData,
@@ -2515,8 +3055,8 @@ void CometPreprocess::MakeCorrData(double* pdTmpRawData,
    double dHighestIntensity)
 {
    int  i,
-      ii,
       iBin,
+      iEnd,
       iWindowSize,
       iNumWindows = 10;
    double dMaxWindowInten,
@@ -2527,32 +3067,23 @@ void CometPreprocess::MakeCorrData(double* pdTmpRawData,
 
    for (i = 0; i < iNumWindows; ++i)
    {
-      dMaxWindowInten = 0.0;
+      // window bins [iBin, iEnd), clipped to iHighestIon and the array size
+      iBin = i * iWindowSize;
+      iEnd = iBin + iWindowSize;
+      if (iEnd > iHighestIon + 1)
+         iEnd = iHighestIon + 1;
+      if (iEnd > g_staticParams.iArraySizeGlobal)
+         iEnd = g_staticParams.iArraySizeGlobal;
 
-      for (ii = 0; ii < iWindowSize; ++ii)    // Find max inten. in window.
-      {
-         iBin = i * iWindowSize + ii;
-         if (iBin <= iHighestIon && iBin < g_staticParams.iArraySizeGlobal)
-         {
-            if (pdTmpRawData[iBin] > dMaxWindowInten)
-               dMaxWindowInten = pdTmpRawData[iBin];
-         }
-      }
+      dMaxWindowInten = g_pfnWindowMax(pdTmpRawData, iBin, iEnd);    // Find max inten. in window.
 
       if (dMaxWindowInten > 0.0)
       {
          dTmp1 = 50.0 / dMaxWindowInten;
          dTmp2 = 0.05 * dHighestIntensity;
 
-         for (ii = 0; ii < iWindowSize; ++ii)    // Normalize to max inten. in window.
-         {
-            iBin = i * iWindowSize + ii;
-            if (iBin <= iHighestIon && iBin < g_staticParams.iArraySizeGlobal)
-            {
-               if (pdTmpRawData[iBin] > dTmp2)
-                  pdTmpCorrelationData[iBin] = pdTmpRawData[iBin] * dTmp1;
-            }
-         }
+         // Normalize to max inten. in window.
+         g_pfnWindowNormalize(pdTmpRawData, pdTmpCorrelationData, iBin, iEnd, dTmp1, dTmp2);
       }
    }
 }
@@ -2566,12 +3097,8 @@ bool CometPreprocess::AllocateMemory(int maxNumThreads)
 
    int i;
 
-   //MH: Initally mark all arrays as available (i.e. false=not inuse).
-   pbMemoryPool = new bool[maxNumThreads];
-   for (i = 0; i < maxNumThreads; ++i)
-   {
-      pbMemoryPool[i] = false;
-   }
+   //MH: Initally mark all arrays as available.
+   memoryPoolSlots.Init(maxNumThreads);
 
    //MH: Allocate arrays
    ppdTmpRawDataArr = new double* [maxNumThreads]();
@@ -2706,7 +3233,7 @@ bool CometPreprocess::DeallocateMemory(int maxNumThreads)
    if (!g_bCometPreprocessMemoryAllocated)
       return true;
 
-   delete[] pbMemoryPool;
+   memoryPoolSlots.Free();
 
    for (i = 0; i < maxNumThreads; ++i)
    {
@@ -17,43 +17,91 @@
 #define _COMETPREPROCESS_H_
 
 #include "ThreadPool.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#define MAX_PREFETCH_THREADS        8        // max # of mzML/mzXML reader threads
+#define PREFETCH_SLOTS_PER_THREAD   4        // spectra each reader thread may read ahead
+#define XCORR_DENSE_MAX_RATIO       2        // keep fast xcorr data dense if that costs at most this many times the sparse rows
+
+// The batch being filled by one LoadAndPreprocessSpectra() call.
+struct PreprocessLoadContext
+{
+   vector<Query*>* pvQuery;                // preprocessed queries are added here
+   CometArena* pArena;                     // arena the queries and their sparse rows are allocated from
+   unsigned short* pusiMaxFragmentCharge;  // maximum fragment charge of the batch
+
+   PreprocessLoadContext(vector<Query*>* pvQuery_in,
+                         CometArena* pArena_in,
+                         unsigned short* pusiMaxFragmentCharge_in)
+      : pvQuery(pvQuery_in), pArena(pArena_in), pusiMaxFragmentCharge(pusiMaxFragmentCharge_in)
+   {
+   }
+};
 
 struct PreprocessThreadData
 {
    Spectrum mstSpectrum;
    int iAnalysisType;
    int iFileLastScan;
-   bool *pbMemoryPool;  //MH: Manages active memory pool
+   PreprocessLoadContext* pLoadContext;    // MS2 batch loading only
 
    PreprocessThreadData()
-      : mstSpectrum(), iAnalysisType(0), iFileLastScan(0), pbMemoryPool(nullptr)
+      : mstSpectrum(), iAnalysisType(0), iFileLastScan(0), pLoadContext(NULL)
    {
    }
 
    PreprocessThreadData(Spectrum& spec_in,
                         int iAnalysisType_in,
-                        int iFileLastScan_in)
-      : mstSpectrum(spec_in), iAnalysisType(iAnalysisType_in), iFileLastScan(iFileLastScan_in), pbMemoryPool(nullptr)
+                        int iFileLastScan_in,
+                        PreprocessLoadContext* pLoadContext_in = NULL)
+      : mstSpectrum(spec_in), iAnalysisType(iAnalysisType_in), iFileLastScan(iFileLastScan_in),
+        pLoadContext(pLoadContext_in)
    {
    }
+};
 
-   ~PreprocessThreadData()
-   {
-      //MH: Mark that the memory is no longer in use.
-      //DO NOT FREE MEMORY HERE. Just release pointer.
-      Threading::LockMutex(g_preprocessMemoryPoolMutex);
 
-      if(pbMemoryPool!=NULL)
-         *pbMemoryPool=false;
-      pbMemoryPool=NULL;
+// Reads the scans of an indexed mzML/mzXML file on several threads, each with its
+// own MSReader and so its own parser and file handle, seeking to each scan through
+// the file's index.  Spectra are handed out in scan order through a bounded ring
+// of slots so the readers stay at most a few spectra per thread ahead.
+class CometSpectrumPrefetch
+{
+public:
+   CometSpectrumPrefetch();
+   ~CometSpectrumPrefetch();
+
+   void Start(const char *szFileName,
+              const vector<int>& vScans,
+              int iNumReaders);
+   void Stop();
+   bool IsActive();
 
-      Threading::UnlockMutex(g_preprocessMemoryPoolMutex);
-   }
+   // Next spectrum at the MS level filter in scan order.  Returns false, with
+   // spec cleared, once all scans have been handed out or a reader failed.
+   bool Next(Spectrum &spec);
 
-   void SetMemory(bool *pbMemoryPool_in)
-   {
-      pbMemoryPool = pbMemoryPool_in;
-   }
+   // Scan number of the last spectrum handed out.
+   int LastScan();
+
+private:
+   void ReaderProc();
+
+   string _strFileName;
+   vector<int> _vScans;                    // scan numbers to read, ascending
+   vector<Spectrum> _vSlots;               // spectrum of scan i is in slot i % size
+   vector<char> _vbReady;
+   vector<std::thread> _vThreads;
+   size_t _tNextRead;                      // next position in _vScans claimed by a reader
+   size_t _tNextOut;                       // next position handed out by Next()
+   int _iLastScan;
+   bool _bStop;
+   bool _bFailed;
+   std::mutex _mutex;
+   std::condition_variable _cvReady;       // a slot was filled
+   std::condition_variable _cvSpace;       // a slot was freed
 };
 
 
@@ -70,6 +118,16 @@ public:
                                         int iLastScan,
                                         int iAnalysisType,
                                         ThreadPool* tp);
+   // Same, but loads the batch into vQuery/arena instead of g_pvQuery/g_batchArena
+   // so the next batch can be read while the current one is searched.
+   static bool LoadAndPreprocessSpectra(MSReader &mstReader,
+                                        int iFirstScan,
+                                        int iLastScan,
+                                        int iAnalysisType,
+                                        ThreadPool* tp,
+                                        vector<Query*>& vQuery,
+                                        CometArena& arena,
+                                        unsigned short& usiMaxFragmentCharge);
    static void PreprocessThreadProc(PreprocessThreadData *pPreprocessThreadData,
                                     ThreadPool* tp);
    static void PreprocessThreadProcMS1(PreprocessThreadData* pPreprocessThreadDataMS1,
@@ -117,6 +175,8 @@ public:
                            Spectrum& spec,
                            bool bNext = false,
                            int scNum = 0);
+   static void SetMSLevelFilter(MSReader &mstReader);
+   static int GetReadPercent(MSReader &mstReader);
    static bool CheckExit(int iAnalysisType,
                          int iScanNum,
                          int iTotalScans,
@@ -130,6 +190,7 @@ private:
 
    // Private static methods
    static bool PreprocessSpectrum(Spectrum &spec,
+                                  PreprocessLoadContext *pLoadContext,
                                   double *pdTmpRawData,
                                   double *pdTmpFastXcorrData,
                                   double *pdTmpCorrelationData,
@@ -140,6 +201,7 @@ private:
    static bool CheckActivationMethodFilter(MSActivation act);
    static bool Preprocess(struct Query *pScoring,
                           Spectrum mstSpectrum,
+                          CometArena *pArena,
                           double *pdTmpRawData,
                           double *pdTmpFastXcorrData,
                           double *pdTmpCorrelationData,
@@ -150,6 +212,42 @@ private:
                         double *pdTmpRawData,
                         Spectrum mstSpectrum,
                         struct PreprocessStruct *pPre);
+   static double GetIntensityCutoff(Spectrum &mstSpectrum);
+   static int CountLoadedPeaks(Spectrum &mstSpectrum,
+                               double dIntensityCutoff,
+                               double dExpPepMass,
+                               int *piHighestIon);
+   static void SharePreprocessedSpectrum(struct Query *pScoring,
+                                         const struct Query *pSource);
+   static int CountSparseRows(const float *pfData,
+                              int iStart,
+                              int iArraySize,
+                              bool bSigned);
+   static void FillSparseMatrix(float **ppfSparse,
+                                float **ppfNextRow,
+                                const float *pfData,
+                                int iStart,
+                                int iArraySize,
+                                bool bSigned);
+   static size_t CountXcorrRows(struct Query *pScoring,
+                                const float *pfFastXcorrData,
+                                const float *pfFastXcorrDataNL,
+                                bool bUseNL,
+                                bool *pbDense);
+   static void FillXcorrMatrices(struct Query *pScoring,
+                                 float **ppfNextRow,
+                                 const float *pfFastXcorrData,
+                                 const float *pfFastXcorrDataNL,
+                                 bool bUseNL,
+                                 bool bDense);
+   static float* AllocSparseFromArena(struct Query *pScoring,
+                                      CometArena *pArena,
+                                      size_t tNumRows,
+                                      bool bUseNL);
+   static int GetScratchZeroSize(struct Query *pScoring);
+   static void StartSpectrumPrefetch(MSReader &mstReader,
+                                     int iScanNumber,
+                                     int iNumLoadThreads);
    static void MakeCorrData(double* pdTmpRawData,
                             double* pdTmpCorrelationData,
                             int iHighestIon,
@@ -175,9 +273,12 @@ private:
    static Mutex _maxChargeMutex;
    static bool _bFirstScan;
    static bool _bDoneProcessingAllSpectra;
+   static bool _bPrefetchChecked;             // StartSpectrumPrefetch() called for this file
+   static bool _bPrefetch;                    // remaining scans come from _spectrumPrefetch
+   static CometSpectrumPrefetch _spectrumPrefetch;
 
    //MH: Common memory to be shared by all threads during spectral processing
-   static bool *pbMemoryPool;                 //MH: Regulator of memory use
+   static CometSlotPool memoryPoolSlots;      //MH: Regulator of memory use; free list of array slots
    static double **ppdTmpRawDataArr;          //MH: Number of arrays equals threads
    static double **ppdTmpFastXcorrDataArr;    //MH: Ditto
    static double **ppdTmpCorrelationDataArr;  //MH: Ditto
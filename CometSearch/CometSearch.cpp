@@ -14,14 +14,311 @@
 
 #include "Common.h"
 #include "CometSearch.h"
-#include "CometFragmentIndexReader.h"
+#include "CometSearchBench.h"
+#include <atomic>
+#include <bit>
 #include <unordered_map>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define XCORR_SIMD
+#define FASTA_SSE2
+#include <immintrin.h>
+#ifdef _WIN32
+#include <intrin.h>
+#define XCORR_TARGET_AVX2
+#define XCORR_TARGET_AVX512
+#else
+#define XCORR_TARGET_AVX2   __attribute__((target("avx2")))
+#define XCORR_TARGET_AVX512 __attribute__((target("avx2,avx512f,avx512vl")))
+#endif
+#endif
+
 
 #define BINARYSEARCHCUTOFF 20                // do linear search through FI if # entries is this or less
+#define FRAGINDEX_MAX_DENSE_SLICE (1 << 20)  // largest precursor window slice counted in the dense array (8 MB)
+#define SEARCH_CHUNK_RESIDUES 32768          // residues queued per search job by the stream FASTA reader
+#define PRECURSOR_BUCKETS_MAX (1 << 20)      // most bins in the precursor bucket table
+#define MAX_ISOTOPE_SHIFTS 8                 // most isotope offsets tested for one isotope_error setting
+
+
+thread_local FragmentIndexScratch g_fragmentIndexScratch;
+
+// Fragment bins flattened by XcorrScoreI, whose ion masses are computed per query.
+thread_local XcorrBinList g_xcorrBinListScratch;
+
+
+// ---------------------------------------------------------------------------
+// Xcorr lookup kernels used by XcorrScore and XcorrScoreI.
+//
+// Each adds up the fast xcorr values of iNumBins fragment bins taken from a
+// contiguous XcorrBinList.  The sparse kernels read
+// ppSparse[bin / SPARSE_MATRIX_SIZE][bin % SPARSE_MATRIX_SIZE]; bins beyond iMax or in
+// an empty sparse row add nothing.  The dense kernels read pfDense[bin] for bins below
+// iLimit, the length of the dense array, with one gather.  Bins <= 0 add nothing.
+//
+// Lanes are summed in double so scores only differ from the scalar sum in the last
+// bits, well below the 3 decimal rounding of xcorr.  g_xcorrKernels is set once to
+// the best version the CPU supports.
+// ---------------------------------------------------------------------------
+static double XcorrSumSparseScalar(float** ppSparse,
+                                   int iMax,
+                                   const unsigned int* puiBins,
+                                   int iNumBins,
+                                   double dSum)
+{
+   for (int i = 0; i < iNumBins; ++i)
+   {
+      int bin = (int)puiBins[i];
+      int x = bin / SPARSE_MATRIX_SIZE;
+
+      if (!(bin <= 0 || x > iMax || ppSparse[x] == NULL)) // x should never be > iMax so this is just a safety check
+         dSum += ppSparse[x][bin - x * SPARSE_MATRIX_SIZE];
+   }
+
+   return dSum;
+}
+
+static double XcorrSumDenseScalar(const float* pfDense,
+                                  int iLimit,
+                                  const unsigned int* puiBins,
+                                  int iNumBins,
+                                  double dSum)
+{
+   for (int i = 0; i < iNumBins; ++i)
+   {
+      int bin = (int)puiBins[i];
+
+      if (bin > 0 && bin < iLimit)
+         dSum += pfDense[bin];
+   }
+
+   return dSum;
+}
+
+#ifdef XCORR_SIMD
+XCORR_TARGET_AVX2
+static double XcorrSumSparseAVX2(float** ppSparse,
+                                 int iMax,
+                                 const unsigned int* puiBins,
+                                 int iNumBins,
+                                 double dSum)
+{
+   const __m128i vZero = _mm_setzero_si128();
+   const __m128i vMaxPlus1 = _mm_set1_epi32(iMax + 1);
+   const __m128i vMatrixSize = _mm_set1_epi32(SPARSE_MATRIX_SIZE);
+   const __m256i vPackMask = _mm256_setr_epi32(0, 2, 4, 6, 0, 0, 0, 0);
+   const __m256d vHalf = _mm256_set1_pd(0.5);
+   const __m256d vInvMatrixSize = _mm256_set1_pd(1.0 / SPARSE_MATRIX_SIZE);
+   __m256d vSum = _mm256_setzero_pd();
+   int i = 0;
+
+   for (; i + 4 <= iNumBins; i += 4)
+   {
+      __m128i vBin = _mm_loadu_si128((const __m128i*)(puiBins + i));
+
+      // x = bin / SPARSE_MATRIX_SIZE; the 0.5 keeps exact multiples from rounding down
+      __m128i vX = _mm256_cvttpd_epi32(_mm256_floor_pd(_mm256_mul_pd(_mm256_add_pd(_mm256_cvtepi32_pd(vBin), vHalf), vInvMatrixSize)));
+      __m128i vY = _mm_sub_epi32(vBin, _mm_mullo_epi32(vX, vMatrixSize));
+      __m256i vValid = _mm256_cvtepi32_epi64(_mm_and_si128(_mm_cmpgt_epi32(vBin, vZero), _mm_cmpgt_epi32(vMaxPlus1, vX)));
+
+      __m256i vRow = _mm256_mask_i32gather_epi64(_mm256_setzero_si256(), (const long long*)ppSparse, vX, vValid, 8);
+      vValid = _mm256_andnot_si256(_mm256_cmpeq_epi64(vRow, _mm256_setzero_si256()), vValid);
+
+      __m256i vAddr = _mm256_add_epi64(vRow, _mm256_slli_epi64(_mm256_cvtepi32_epi64(vY), 2));
+      __m128 vMask = _mm_castsi128_ps(_mm256_castsi256_si128(_mm256_permutevar8x32_epi32(vValid, vPackMask)));
+      __m128 vValue = _mm256_mask_i64gather_ps(_mm_setzero_ps(), (const float*)NULL, vAddr, vMask, 1);
+
+      vSum = _mm256_add_pd(vSum, _mm256_cvtps_pd(vValue));
+   }
+
+   double pdSum[4];
+   _mm256_storeu_pd(pdSum, vSum);
+   dSum += (pdSum[0] + pdSum[1]) + (pdSum[2] + pdSum[3]);
+
+   return XcorrSumSparseScalar(ppSparse, iMax, puiBins + i, iNumBins - i, dSum);
+}
+
+XCORR_TARGET_AVX2
+static double XcorrSumDenseAVX2(const float* pfDense,
+                                int iLimit,
+                                const unsigned int* puiBins,
+                                int iNumBins,
+                                double dSum)
+{
+   const __m256i vZero = _mm256_setzero_si256();
+   const __m256i vLimit = _mm256_set1_epi32(iLimit);
+   __m256d vSumLo = _mm256_setzero_pd();
+   __m256d vSumHi = _mm256_setzero_pd();
+   int i = 0;
+
+   for (; i + 8 <= iNumBins; i += 8)
+   {
+      __m256i vBin = _mm256_loadu_si256((const __m256i*)(puiBins + i));
+      __m256i vValid = _mm256_and_si256(_mm256_cmpgt_epi32(vBin, vZero), _mm256_cmpgt_epi32(vLimit, vBin));
+      __m256 vValue = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), pfDense, vBin, _mm256_castsi256_ps(vValid), 4);
+
+      vSumLo = _mm256_add_pd(vSumLo, _mm256_cvtps_pd(_mm256_castps256_ps128(vValue)));
+      vSumHi = _mm256_add_pd(vSumHi, _mm256_cvtps_pd(_mm256_extractf128_ps(vValue, 1)));
+   }
+
+   double pdSum[4];
+   _mm256_storeu_pd(pdSum, _mm256_add_pd(vSumLo, vSumHi));
+   dSum += (pdSum[0] + pdSum[1]) + (pdSum[2] + pdSum[3]);
+
+   return XcorrSumDenseScalar(pfDense, iLimit, puiBins + i, iNumBins - i, dSum);
+}
+
+// The AVX-512 kernels use the zero-masking forms of the conversions:  the unmasked
+// ones take an undefined source operand that GCC reports as maybe-uninitialized.
+XCORR_TARGET_AVX512
+static double XcorrSumSparseAVX512(float** ppSparse,
+                                   int iMax,
+                                   const unsigned int* puiBins,
+                                   int iNumBins,
+                                   double dSum)
+{
+   const __mmask8 kAll = 0xFF;
+   const __m256i vZero = _mm256_setzero_si256();
+   const __m256i vMaxPlus1 = _mm256_set1_epi32(iMax + 1);
+   const __m256i vMatrixSize = _mm256_set1_epi32(SPARSE_MATRIX_SIZE);
+   const __m512d vHalf = _mm512_set1_pd(0.5);
+   const __m512d vInvMatrixSize = _mm512_set1_pd(1.0 / SPARSE_MATRIX_SIZE);
+   __m512d vSum = _mm512_setzero_pd();
+   int i = 0;
+
+   for (; i + 8 <= iNumBins; i += 8)
+   {
+      __m256i vBin = _mm256_loadu_si256((const __m256i*)(puiBins + i));
+
+      // x = bin / SPARSE_MATRIX_SIZE; the 0.5 keeps exact multiples from rounding down
+      __m512d vRowD = _mm512_mul_pd(_mm512_add_pd(_mm512_maskz_cvtepi32_pd(kAll, vBin), vHalf), vInvMatrixSize);
+      vRowD = _mm512_maskz_roundscale_pd(kAll, vRowD, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+      __m256i vX = _mm512_maskz_cvttpd_epi32(kAll, vRowD);
+      __m256i vY = _mm256_sub_epi32(vBin, _mm256_mullo_epi32(vX, vMatrixSize));
+      __mmask8 kValid = _mm256_cmpgt_epi32_mask(vBin, vZero) & _mm256_cmpgt_epi32_mask(vMaxPlus1, vX);
+
+      __m512i vRow = _mm512_mask_i32gather_epi64(_mm512_setzero_si512(), kValid, vX, (const void*)ppSparse, 8);
+      kValid = _mm512_mask_test_epi64_mask(kValid, vRow, vRow);
+
+      __m512i vAddr = _mm512_add_epi64(vRow, _mm512_maskz_slli_epi64(kAll, _mm512_maskz_cvtepi32_epi64(kAll, vY), 2));
+      __m256 vValue = _mm512_mask_i64gather_ps(_mm256_setzero_ps(), kValid, vAddr, (const void*)NULL, 1);
+
+      vSum = _mm512_add_pd(vSum, _mm512_maskz_cvtps_pd(kAll, vValue));
+   }
+
+   double pdSum[8];
+   _mm512_storeu_pd(pdSum, vSum);
+   dSum += ((pdSum[0] + pdSum[1]) + (pdSum[2] + pdSum[3])) + ((pdSum[4] + pdSum[5]) + (pdSum[6] + pdSum[7]));
+
+   return XcorrSumSparseAVX2(ppSparse, iMax, puiBins + i, iNumBins - i, dSum);
+}
+
+XCORR_TARGET_AVX512
+static double XcorrSumDenseAVX512(const float* pfDense,
+                                  int iLimit,
+                                  const unsigned int* puiBins,
+                                  int iNumBins,
+                                  double dSum)
+{
+   const __mmask8 kAll = 0xFF;
+   const __m256i vZero = _mm256_setzero_si256();
+   const __m256i vLimit = _mm256_set1_epi32(iLimit);
+   __m512d vSumA = _mm512_setzero_pd();
+   __m512d vSumB = _mm512_setzero_pd();
+   int i = 0;
+
+   for (; i + 16 <= iNumBins; i += 16)
+   {
+      __m256i vBinA = _mm256_loadu_si256((const __m256i*)(puiBins + i));
+      __m256i vBinB = _mm256_loadu_si256((const __m256i*)(puiBins + i + 8));
+      __mmask8 kValidA = _mm256_cmpgt_epi32_mask(vBinA, vZero) & _mm256_cmpgt_epi32_mask(vLimit, vBinA);
+      __mmask8 kValidB = _mm256_cmpgt_epi32_mask(vBinB, vZero) & _mm256_cmpgt_epi32_mask(vLimit, vBinB);
+      __m256 vValueA = _mm256_mmask_i32gather_ps(_mm256_setzero_ps(), kValidA, vBinA, pfDense, 4);
+      __m256 vValueB = _mm256_mmask_i32gather_ps(_mm256_setzero_ps(), kValidB, vBinB, pfDense, 4);
+
+      vSumA = _mm512_add_pd(vSumA, _mm512_maskz_cvtps_pd(kAll, vValueA));
+      vSumB = _mm512_add_pd(vSumB, _mm512_maskz_cvtps_pd(kAll, vValueB));
+   }
+
+   double pdSum[8];
+   _mm512_storeu_pd(pdSum, _mm512_add_pd(vSumA, vSumB));
+   dSum += ((pdSum[0] + pdSum[1]) + (pdSum[2] + pdSum[3])) + ((pdSum[4] + pdSum[5]) + (pdSum[6] + pdSum[7]));
+
+   return XcorrSumDenseAVX2(pfDense, iLimit, puiBins + i, iNumBins - i, dSum);
+}
+
+// CPU and OS support for the AVX2 (iLevel 1) or AVX-512 (iLevel 2) kernels.
+static bool XcorrCpuSupports(int iLevel)
+{
+#ifdef _WIN32
+   int piInfo[4];
+   __cpuid(piInfo, 0);
+   if (piInfo[0] < 7)
+      return false;
+
+   __cpuid(piInfo, 1);
+   if (!(piInfo[2] & (1 << 27)))  // OSXSAVE
+      return false;
+
+   unsigned long long ullXCR0 = _xgetbv(0);
+   __cpuidex(piInfo, 7, 0);
+
+   if (iLevel == 1)
+      return (piInfo[1] & (1 << 5)) && (ullXCR0 & 0x6) == 0x6;
+   else
+      return (piInfo[1] & (1 << 5)) && (piInfo[1] & (1 << 16)) && (piInfo[1] & (1 << 31)) && (ullXCR0 & 0xE6) == 0xE6;
+#else
+   __builtin_cpu_init();
+
+   if (iLevel == 1)
+      return __builtin_cpu_supports("avx2");
+   else
+      return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl");
+#endif
+}
+#endif
+
+// Kernel sets in order of the instruction set they need; the first
+// g_iNumXcorrKernels of them run on this CPU and the last of those is used.
+const XcorrKernels g_pXcorrKernelTable[] =
+{
+   { "scalar", XcorrSumSparseScalar, XcorrSumDenseScalar },
+#ifdef XCORR_SIMD
+   { "AVX2", XcorrSumSparseAVX2, XcorrSumDenseAVX2 },
+   { "AVX-512", XcorrSumSparseAVX512, XcorrSumDenseAVX512 },
+#endif
+};
+
+static int XcorrKernelsSupported(void)
+{
+#ifdef XCORR_SIMD
+   if (XcorrCpuSupports(2))
+      return 3;
+   if (XcorrCpuSupports(1))
+      return 2;
+#endif
+   return 1;
+}
 
-bool* CometSearch::_pbSearchMemoryPool = nullptr;
+const int g_iNumXcorrKernels = XcorrKernelsSupported();
+static const XcorrKernels g_xcorrKernels = g_pXcorrKernelTable[g_iNumXcorrKernels - 1];
+
+CometSlotPool CometSearch::_searchSlotPool;
 bool** CometSearch::_ppbDuplFragmentArr = nullptr;
+CometSearch** CometSearch::_ppSearchContext = nullptr;
+vector<PrecursorBucketEntry> CometSearch::_vPrecursorBuckets;
+vector<size_t> CometSearch::_vtPrecursorBucketStart(1, 0);
+double CometSearch::_dPrecursorBucketLow = 0.0;
+double CometSearch::_dPrecursorBucketInvWidth = 0.0;
+vector<DBIndex> CometSearch::_vPeptideCentricList;
+bool CometSearch::_bPeptideCentricListBuilt = false;
+double CometSearch::_dPeptideCentricLow = 0.0;
+double CometSearch::_dPeptideCentricHigh = 0.0;
 
 extern comet_fileoffset_t clSizeCometFileOffset;
 
@@ -34,6 +331,12 @@ CometSearch::CometSearch()
 
    _usiSizepiVarModSites = (unsigned short)(sizeof(int)*MAX_PEPTIDE_LEN_P2);
    _usiSizepdVarModSites = (unsigned short)(sizeof(double)*MAX_PEPTIDE_LEN_P2);
+
+   _bXcorrBinListStale[0] = true;
+   _bXcorrBinListStale[1] = true;
+
+   _proteinInfo.bClippedNtermMet = false;
+   _proteinInfo.iPeptideStartResidue = -1;
 }
 
 
@@ -49,12 +352,18 @@ bool CometSearch::AllocateMemory(int maxNumThreads)
 
    try
    {
-      _pbSearchMemoryPool = new bool[maxNumThreads]();
+      _searchSlotPool.Init(maxNumThreads);
       _ppbDuplFragmentArr = new bool* [maxNumThreads];
 
       for (int i = 0; i < maxNumThreads; ++i)
          _ppbDuplFragmentArr[i] = new bool[g_staticParams.iArraySizeGlobal]();
 
+      // Heap-allocated as CometSearch has ~295 KB of member arrays (_uiBinnedIonMasses, etc.)
+      // which is too large for thread stacks; one per slot is kept for the whole run.
+      _ppSearchContext = new CometSearch* [maxNumThreads]();
+      for (int i = 0; i < maxNumThreads; ++i)
+         _ppSearchContext[i] = new CometSearch();
+
       g_bCometSearchMemoryAllocated = true;
 
       return true;
@@ -77,14 +386,16 @@ bool CometSearch::DeallocateMemory(int maxNumThreads)
    if (!g_bCometSearchMemoryAllocated)
       return true;
 
-   delete [] _pbSearchMemoryPool;
+   _searchSlotPool.Free();
 
    for (int i = 0; i < maxNumThreads; ++i)
    {
       delete [] _ppbDuplFragmentArr[i];
+      delete _ppSearchContext[i];
    }
 
    delete [] _ppbDuplFragmentArr;
+   delete [] _ppSearchContext;
 
    g_bCometSearchMemoryAllocated = false;
 
@@ -92,43 +403,17 @@ bool CometSearch::DeallocateMemory(int maxNumThreads)
 }
 
 
-// Spin-wait under g_searchMemoryPoolMutex until a free slot is found.
+// Pops a free slot off the lock-free free list.
 // Returns the slot index (0..iNumThreads-1), or -1 on timeout.
 int CometSearch::AcquirePoolSlot()
 {
-   int i = -1;
-
-   Threading::LockMutex(g_searchMemoryPoolMutex);
-   auto tStartTime = std::chrono::high_resolution_clock::now();
-   const auto timeout_duration = std::chrono::seconds(240);
-
-   while (true)
-   {
-      for (i = 0; i < g_staticParams.options.iNumThreads; ++i)
-      {
-         if (_pbSearchMemoryPool[i] == false)
-         {
-            _pbSearchMemoryPool[i] = true;
-            break;
-         }
-      }
-
-      if (i < g_staticParams.options.iNumThreads)
-         break;
-
-      if (std::chrono::high_resolution_clock::now() - tStartTime > timeout_duration)
-      {
-         i = -1;
-         break;
-      }
+   return _searchSlotPool.Acquire();
+}
 
-      Threading::UnlockMutex(g_searchMemoryPoolMutex);
-      std::this_thread::yield();
-      Threading::LockMutex(g_searchMemoryPoolMutex);
-   }
-   Threading::UnlockMutex(g_searchMemoryPoolMutex);
 
-   return i;
+void CometSearch::ReleasePoolSlot(int iSlot)
+{
+   _searchSlotPool.Release(iSlot);
 }
 
 
@@ -152,9 +437,7 @@ bool CometSearch::RunSearch(Query* pQuery)
          return false;
       }
       SearchFragmentIndex(pQuery, _ppbDuplFragmentArr[iSlot]);
-      Threading::LockMutex(g_searchMemoryPoolMutex);
-      _pbSearchMemoryPool[iSlot] = false;
-      Threading::UnlockMutex(g_searchMemoryPoolMutex);
+      ReleasePoolSlot(iSlot);
    }
    else if (g_staticParams.iDbType == DbType::PI_DB)  // peptide index
    {
@@ -196,9 +479,7 @@ bool CometSearch::RunSearch(Query* pQuery)
          return false;
       }
       SearchPeptideIndex(pQuery, _ppbDuplFragmentArr[iSlot]);
-      Threading::LockMutex(g_searchMemoryPoolMutex);
-      _pbSearchMemoryPool[iSlot] = false;
-      Threading::UnlockMutex(g_searchMemoryPoolMutex);
+      ReleasePoolSlot(iSlot);
    }
    else
    {
@@ -223,7 +504,6 @@ bool CometSearch::RunSearch(ThreadPool *tp)
       if (!g_bPlainPeptideIndexRead)
       {
          CometFragmentIndex sqFI;
-         sqFI.ReadPlainPeptideIndex();
          sqFI.CreateFragmentIndex(tp);
       }
 
@@ -234,12 +514,11 @@ bool CometSearch::RunSearch(ThreadPool *tp)
          return false;
       }
       SearchFragmentIndex(g_pvQuery.at(iWhichQuery), _ppbDuplFragmentArr[iSlot]);
-      Threading::LockMutex(g_searchMemoryPoolMutex);
-      _pbSearchMemoryPool[iSlot] = false;
-      Threading::UnlockMutex(g_searchMemoryPoolMutex);
+      ReleasePoolSlot(iSlot);
    }
    else if (g_staticParams.iDbType == DbType::PI_DB)  // peptide index
    {
+      BuildPrecursorBuckets();
       sqSearch.SearchPeptideIndex(tp);
    }
    else
@@ -260,6 +539,13 @@ bool CometSearch::RunSearch(int iPercentStart,
 {
    bool bSucceeded = true;
 
+   if (UsePeptideCentricSearch())
+      return RunPeptideCentricSearch(iPercentStart, iPercentEnd, tp);
+
+   // the fragment ion index search checks each query's own window
+   if (g_staticParams.iDbType != DbType::FI_DB)
+      BuildPrecursorBuckets();
+
    if (g_staticParams.iDbType == DbType::FI_DB)
    {
       CometFragmentIndex* sqFI = new CometFragmentIndex();
@@ -267,7 +553,6 @@ bool CometSearch::RunSearch(int iPercentStart,
 
       if (!g_bPlainPeptideIndexRead)
       {
-         sqFI->ReadPlainPeptideIndex();
          sqFI->CreateFragmentIndex(tp);
       }
 
@@ -287,9 +572,7 @@ bool CometSearch::RunSearch(int iPercentStart,
                return;
             }
             SearchFragmentIndex(g_pvQuery.at(iWhichQuery), _ppbDuplFragmentArr[iSlot]);
-            Threading::LockMutex(g_searchMemoryPoolMutex);
-            _pbSearchMemoryPool[iSlot] = false;
-            Threading::UnlockMutex(g_searchMemoryPoolMutex);
+            ReleasePoolSlot(iSlot);
          });
       }
 
@@ -314,6 +597,11 @@ bool CometSearch::RunSearch(int iPercentStart,
       delete sqSearch;
       return bSucceeded;
    }
+   else if (!g_staticParams.peffInfo.iPeffSearch
+         && RunSearchMappedFasta(iPercentStart, iPercentEnd, tp, bSucceeded))
+   {
+      return bSucceeded;
+   }
    else
    {
       sDBEntry dbe;
@@ -330,6 +618,7 @@ bool CometSearch::RunSearch(int iPercentStart,
       comet_fileoffset_t iLen = 0;
 
       vector<OBOStruct> vectorPeffOBO;
+      SearchThreadData* pSearchThreadData = NULL;  // chunk of entries being filled for the next search job
 
       //Reuse existing ThreadPool
       ThreadPool* pSearchThreadPool = tp;
@@ -937,19 +1226,27 @@ bool CometSearch::RunSearch(int iPercentStart,
                }
             }
 
-            // Allow up to 500 jobs/sequences to be queued before pausing; otherwise all
-            // sequences in the database will be loaded/queued all at once which can be
-            // a memory issue for extremely large fasta files
-            while (pSearchThreadPool->jobs_.size() >= 500)
-            {
-                pSearchThreadPool->wait_for_available_thread();
-            }
+            // Sequence entries are handed to the search threads in chunks of about
+            // SEARCH_CHUNK_RESIDUES residues rather than one protein per job.
+            if (pSearchThreadData == NULL)
+               pSearchThreadData = new SearchThreadData();
 
-            // Now search sequence entry; add threading here so that
-            // each protein sequence is passed to a separate thread.
-            SearchThreadData *pSearchThreadData = new SearchThreadData(dbe);
+            pSearchThreadData->tNumResidues += dbe.strSeq.size();
+            pSearchThreadData->vDBEntry.push_back(std::move(dbe));
 
-            pSearchThreadPool->doJob(std::bind(SearchThreadProc, pSearchThreadData, pSearchThreadPool));
+            if (pSearchThreadData->tNumResidues >= SEARCH_CHUNK_RESIDUES)
+            {
+               // Allow a few chunks per thread to be queued before pausing; otherwise all
+               // sequences in the database will be loaded/queued all at once which can be
+               // a memory issue for extremely large fasta files
+               while (pSearchThreadPool->jobs_.size() >= (size_t)g_staticParams.options.iNumThreads * 4)
+               {
+                   pSearchThreadPool->wait_for_available_thread();
+               }
+
+               pSearchThreadPool->doJob(std::bind(SearchThreadProc, pSearchThreadData, pSearchThreadPool));
+               pSearchThreadData = NULL;
+            }
 
             g_staticParams.databaseInfo.iTotalNumProteins++;
 
@@ -980,6 +1277,15 @@ bool CometSearch::RunSearch(int iPercentStart,
          }
       }
 
+      // search the last partial chunk
+      if (pSearchThreadData != NULL)
+      {
+         if (bSucceeded)
+            pSearchThreadPool->doJob(std::bind(SearchThreadProc, pSearchThreadData, pSearchThreadPool));
+         else
+            delete pSearchThreadData;
+      }
+
       // Wait for active search threads to complete processing.
 
       pSearchThreadPool->wait_on_threads();
@@ -1015,143 +1321,836 @@ bool CometSearch::RunSearch(int iPercentStart,
 }
 
 
-bool CometSearch::RunSpecLibSearch(ThreadPool* tp)
+// State shared by the workers of one memory-mapped FASTA pass.
+struct FastaChunkShared
 {
-   printf("OK in RunSpecLib\n");
+   const char* pcMap;                        // start of the mapped database
+   std::atomic<int> iNumProteins;
+   std::atomic<unsigned long> ulAACount;
+   std::atomic<int> iNumBadChars;            // non-printing header characters seen so far
+   Mutex mutexProteinNames;                  // guards g_pvProteinNames during index creation
+};
 
-   return true;
+
+// Residue filter used when loading sequences:  lowercase letters are uppercased,
+// '*' (stop codon) is kept and everything else (whitespace, digits, ...) is dropped.
+static char s_pcFastaResidue[256];
+static std::once_flag s_fastaResidueOnce;
+
+static void InitFastaResidueTable()
+{
+   for (int i = 0; i < 256; ++i)
+   {
+      if ('A' <= i && i <= 'Z')
+         s_pcFastaResidue[i] = (char)i;
+      else if ('a' <= i && i <= 'z')
+         s_pcFastaResidue[i] = (char)(i - 32);
+      else if (i == '*')
+         s_pcFastaResidue[i] = '*';
+      else
+         s_pcFastaResidue[i] = 0;
+   }
 }
 
 
-bool CometSearch::RunSpecLibSearch(int iPercentStart,
-                                   int iPercentEnd,
-                                   ThreadPool* tp)
+// Append the residues in [pcBegin, pcEnd) to strSeq, uppercasing and filtering as
+// the stream reader does; returns the number of A-Z residues (stop codons excluded).
+// Full 16-byte runs of letters, i.e. the body of every sequence line, are handled
+// with SSE2 and only the line ends and odd characters go through the lookup table.
+static unsigned long LoadFastaResidues(const char* pcBegin,
+                                       const char* pcEnd,
+                                       string& strSeq)
 {
-   // to fill g_vulSpecLibPrecursorIndex, set
-   // binmin = BINPREC(expmass - tol)
-   // binmax = BINPREC(expmass + tol)
-   // then for (i=binmin; i<=binmax; ++i) {g_vulSpecLibPrecursorIndex[i].push_back(entry)}
+   size_t tOld = strSeq.size();
+   strSeq.resize(tOld + (pcEnd - pcBegin));
 
-   for (vector<Query*>::iterator it = g_pvQuery.begin(); it != g_pvQuery.end(); ++it)
-   {
-      int iBinExpMass = BINPREC((*it)->_pepMassInfo.dExpPepMass);
+   char* pcOut = &strSeq[0] + tOld;
+   char* pcOutStart = pcOut;
+   unsigned long ulAACount = 0;
+   const char* pc = pcBegin;
 
-      // FIX: need to address isotope offsets as well
+#ifdef FASTA_SSE2
+   const __m128i vCaseBit = _mm_set1_epi8(0x20);
+   const __m128i vBeforeA = _mm_set1_epi8('A' - 1);
+   const __m128i vAfterZ = _mm_set1_epi8('Z' + 1);
 
-      if (g_vulSpecLibPrecursorIndex[iBinExpMass].size() > 0)
-      {
-         // compare query spectrum (*it) against list of precursor
+   while (pcEnd - pc >= 16)
+   {
+      __m128i v = _mm_loadu_si128((const __m128i*)pc);
+      __m128i vUpper = _mm_andnot_si128(vCaseBit, v);   // clears bit 5; 'a'-'z' -> 'A'-'Z'
 
-         for (size_t x = 0; x < g_vulSpecLibPrecursorIndex[iBinExpMass].size(); ++x)
-         {
-            double dSpecLibScore = CometSpecLib::ScoreSpecLib(*it, g_vulSpecLibPrecursorIndex[iBinExpMass].at(x));
+      // letters are exactly the bytes whose case-folded value is within 'A'-'Z' and whose
+      // other high bits match; bytes >= 0x80 compare as negative so they fail the range test
+      __m128i vLetter = _mm_and_si128(_mm_cmpgt_epi8(vUpper, vBeforeA), _mm_cmplt_epi8(vUpper, vAfterZ));
 
-            if (dSpecLibScore > (*it)->fLowestSpecLibScore)
-               CometSpecLib::StoreSpecLib(*it, g_vulSpecLibPrecursorIndex[iBinExpMass].at(x), dSpecLibScore);
+      if (_mm_movemask_epi8(vLetter) == 0xFFFF)
+      {
+         _mm_storeu_si128((__m128i*)pcOut, vUpper);
+         pcOut += 16;
+         pc += 16;
+         ulAACount += 16;
+         continue;
+      }
 
-         }
+      // mixed block: filter one byte at a time up to and including the first non-letter
+      int iStop = std::countr_zero((unsigned int)~_mm_movemask_epi8(vLetter)) + 1;
+      for (int i = 0; i < iStop; ++i, ++pc)
+      {
+         char cRes = s_pcFastaResidue[(unsigned char)*pc];
+         *pcOut = cRes;
+         pcOut += (cRes != 0);
+         ulAACount += (cRes != 0 && cRes != '*');
       }
    }
-   return true;
-}
-
-bool CometSearch::RunMS1Search(ThreadPool* tp,
-                               double dRT,
-                               double dMaxMS1RTDiff,
-                               const double dMaxSpecLibRT,
-                               const double dMaxQueryRT)
-{
-   ThreadPool* pRunMS1SearchThreadPool = tp;
+#endif
 
-   for (size_t iWhichMS1Query = 0; iWhichMS1Query < g_pvQueryMS1.size(); ++iWhichMS1Query)
+   for (; pc < pcEnd; ++pc)
    {
-      // for each query, thread the search by segmenting the library
-      for (int iWhichThread = 0; iWhichThread < g_staticParams.options.iNumThreads; ++iWhichThread)
-      {
-         pRunMS1SearchThreadPool->doJob(std::bind(SearchMS1Library, iWhichMS1Query, iWhichThread, dRT,
-            dMaxMS1RTDiff, dMaxSpecLibRT, dMaxQueryRT, pRunMS1SearchThreadPool));
-      }
+      char cRes = s_pcFastaResidue[(unsigned char)*pc];
+      *pcOut = cRes;
+      pcOut += (cRes != 0);
+      ulAACount += (cRes != 0 && cRes != '*');
    }
-   pRunMS1SearchThreadPool->wait_on_threads();
 
-   return true;
+   strSeq.resize(tOld + (pcOut - pcOutStart));
+
+   return ulAACount;
 }
 
 
-// Thread-local RunMS1Search overload: compares a caller-owned QueryMS1* against
-// the read-only g_vSpecLib entries within the RT window. Populates the output
-// scores vector with up to topN best matches. Zero shared mutable state.
-bool CometSearch::RunMS1Search(QueryMS1* pQueryMS1,
-                               const int topN,
-                               double dRT,
-                               double dMaxMS1RTDiff,
-                               const double dMaxSpecLibRT,
-                               const double dMaxQueryRT,
-                               vector<CometScoresMS1>& scores)
+// Parse and search the FASTA entries in [tBegin, tEnd) of the mapped database.
+// Chunks after the first start on a '>' at the beginning of a line.  Header and
+// sequence handling matches the stream reader in RunSearch() so that protein
+// names, lProteinFilePosition and the residue filtering are identical.
+void CometSearch::SearchFastaChunk(FastaChunkShared* pShared,
+                                   size_t tBegin,
+                                   size_t tEnd)
 {
-   if (pQueryMS1 == nullptr || pQueryMS1->pfFastXcorrData == nullptr)
-      return false;
-
-   scores.clear();
+   if (g_cometStatus.IsError() || g_cometStatus.IsCancel())
+      return;
 
-   // Use the aligner to adjust the query RT if alignment data is available
-   // For now, use the raw RT ratio to estimate the corresponding library RT
-   double dScaledRT = dRT;
-   if (dMaxQueryRT > 0.0 && dMaxSpecLibRT > 0.0)
-      dScaledRT = dRT * (dMaxSpecLibRT / dMaxQueryRT);
+   int iSlot = AcquirePoolSlot();
+   if (iSlot < 0)
+   {
+      logerr(" Error - could not find available memory pool for MS2 search thread.\n");
+      return;
+   }
 
-   float fBestDotProduct = -1.0f;
-   int iBestLibIdx = -1;
+   const char* pcMap = pShared->pcMap;
+   const char* pc = pcMap + tBegin;
+   const char* pcEnd = pcMap + tEnd;
 
-   size_t iNumLibEntries = g_vSpecLib.size();
-   unsigned int uiQueryArraySize = pQueryMS1->iArraySizeMS1;
+   sDBEntry dbe;   // reused for each entry so the name and sequence buffers are allocated once
+   int iNumProteins = 0;
+   unsigned long ulAACount = 0;
 
-   for (size_t i = 0; i < iNumLibEntries; ++i)
+   if (tBegin == 0)
    {
-      const SpecLibStruct& libEntry = g_vSpecLib[i];
+      // skip through whitespace at head of file
+      while (pc < pcEnd && isspace((unsigned char)*pc))
+         pc++;
 
-      // Check RT window
-      double dLibRT = (double)libEntry.fRTime;
-      if (fabs(dScaledRT - dLibRT) > dMaxMS1RTDiff)
-         continue;
+      // skip comment lines
+      if (pc < pcEnd && *pc == '#')
+      {
+         while (pc < pcEnd && *pc != '\n' && *pc != '\r')
+            pc++;
+      }
+   }
 
-      // Check array size compatibility
-      if (libEntry.pfUnitVector == nullptr)
+   while (pc < pcEnd)
+   {
+      if (*pc != '>')
+      {
+         // not a description line; skip to the start of the next line
+         const char* pcNewline = (const char*)memchr(pc, '\n', pcEnd - pc);
+         pc = (pcNewline == NULL ? pcEnd : pcNewline + 1);
          continue;
+      }
 
-      unsigned int uiLibArraySize = libEntry.uiArraySizeMS1;
-      unsigned int uiMinSize = (uiQueryArraySize < uiLibArraySize) ? uiQueryArraySize : uiLibArraySize;
+      pc++;  // step past '>'
 
-      // Compute dot product between query unit vector and library unit vector
-      double dDotProduct = 0.0;
-      for (unsigned int j = 0; j < uiMinSize; ++j)
-         dDotProduct += (double)pQueryMS1->pfFastXcorrData[j] * (double)libEntry.pfUnitVector[j];
+      dbe.lProteinFilePosition = (comet_fileoffset_t)(pc - pcMap);
+      dbe.strName.clear();
+      dbe.strSeq.clear();
 
-      if ((float)dDotProduct > fBestDotProduct)
+      bool bTrimDescr = false;
+      while (pc < pcEnd && *pc != '\n' && *pc != '\r')
       {
-         fBestDotProduct = (float)dDotProduct;
-         iBestLibIdx = (int)i;
+         int iTmpCh = (unsigned char)*pc++;
+
+         if (!bTrimDescr && iscntrl(iTmpCh))
+            bTrimDescr = true;
+
+         if (!bTrimDescr && dbe.strName.size() < (WIDTH_REFERENCE-1))
+         {
+            if (iTmpCh < 32 || iTmpCh > 126)  // sanity check for reading binary (index) file
+            {
+               if (++pShared->iNumBadChars > 20)
+               {
+                  string strErrorMsg = " Too many non-printing characters in database header lines; wrong file type/format?\n";
+                  g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
+                  logerr(strErrorMsg);
+                  break;
+               }
+            }
+            else
+               dbe.strName += (char)iTmpCh;
+         }
       }
-   }
 
-   // For topN=1, just return the single best match
-   if (iBestLibIdx >= 0)
-   {
-      CometScoresMS1 result;
-      result.fDotProduct = fBestDotProduct;
-      result.fRTime = g_vSpecLib[iBestLibIdx].fRTime;
-      result.iScanNumber = (int)g_vSpecLib[iBestLibIdx].iLibEntry;
-      scores.push_back(result);
-   }
+      if (g_cometStatus.IsError())
+         break;
 
-   return true;
-}
+      if (dbe.strName.length() <= 0)
+      {
+         string strErrorMsg = " Error - zero length sequence description; wrong database file/format?\n";
+         g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
+         logerr(strErrorMsg);
+         break;
+      }
 
+      if (g_staticParams.options.bCreateFragmentIndex || g_staticParams.options.bCreatePeptideIndex)
+      {
+         struct IndexProteinStruct sEntry;
 
-void CometSearch::ReadOBO(char *szOBO,
-                          vector<OBOStruct> *vectorPeffOBO)
-{
-   FILE *fp;
+         // store protein name
+         std::strncpy(sEntry.szProt, dbe.strName.c_str(), sizeof(sEntry.szProt) - 1);
+         sEntry.szProt[sizeof(sEntry.szProt) - 1] = '\0';
+         sEntry.lProteinFilePosition = dbe.lProteinFilePosition;
+         sEntry.iWhichProtein = -1; // not used for index creation
+
+         Threading::LockMutex(pShared->mutexProteinNames);
+         g_pvProteinNames.insert({ sEntry.lProteinFilePosition, sEntry });
+         Threading::UnlockMutex(pShared->mutexProteinNames);
+      }
+
+      // Load sequence; it runs to the next '>' wherever that appears
+      const char* pcSeqEnd = (const char*)memchr(pc, '>', pcEnd - pc);
+      if (pcSeqEnd == NULL)
+         pcSeqEnd = pcEnd;
+
+      ulAACount += LoadFastaResidues(pc, pcSeqEnd, dbe.strSeq);
+      pc = pcSeqEnd;
+
+      _ppSearchContext[iSlot]->DoSearch(dbe, _ppbDuplFragmentArr[iSlot]);
+
+      iNumProteins++;
+
+      if (g_cometStatus.IsError() || g_cometStatus.IsCancel())
+         break;
+   }
+
+   pShared->iNumProteins += iNumProteins;
+   pShared->ulAACount += ulAACount;
+
+   ReleasePoolSlot(iSlot);
+}
+
+
+// Search a plain FASTA database by memory-mapping it and handing out chunks split at
+// '>' line starts to the thread pool; each worker parses and searches its own entries
+// so the reader thread no longer limits throughput on very large databases.
+// Returns false, leaving bSucceeded untouched, if the file cannot be mapped so that
+// the caller falls back to the stream reader.
+bool CometSearch::RunSearchMappedFasta(int iPercentStart,
+                                       int iPercentEnd,
+                                       ThreadPool* tp,
+                                       bool& bSucceeded)
+{
+   char *pcMap = NULL;
+   size_t tMapSize = 0;
+
+#ifdef _WIN32
+   HANDLE hFile = CreateFileA(g_staticParams.databaseInfo.szDatabase, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+   if (hFile == INVALID_HANDLE_VALUE)
+      return false;
+
+   LARGE_INTEGER liSize;
+   if (GetFileSizeEx(hFile, &liSize))
+      tMapSize = (size_t)liSize.QuadPart;
+
+   if (tMapSize > 0)
+   {
+      HANDLE hMap = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+      if (hMap != NULL)
+      {
+         pcMap = (char *)MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, 0);
+         CloseHandle(hMap);  // view keeps the mapping alive
+      }
+   }
+   CloseHandle(hFile);
+#else
+   int fd = open(g_staticParams.databaseInfo.szDatabase, O_RDONLY);
+   if (fd < 0)
+      return false;
+
+   struct stat statDB;
+   if (fstat(fd, &statDB) == 0 && S_ISREG(statDB.st_mode))
+      tMapSize = (size_t)statDB.st_size;
+
+   if (tMapSize > 0)
+   {
+      void *pMap = mmap(NULL, tMapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (pMap != MAP_FAILED)
+         pcMap = (char *)pMap;
+   }
+   close(fd);
+#endif
+
+   if (pcMap == NULL)
+      return false;
+
+   std::call_once(s_fastaResidueOnce, InitFastaResidueTable);
+
+   FastaChunkShared sShared;
+   sShared.pcMap = pcMap;
+   sShared.iNumProteins = 0;
+   sShared.ulAACount = 0;
+   sShared.iNumBadChars = 0;
+   Threading::InitMutex(&sShared.mutexProteinNames);
+
+   g_staticParams.databaseInfo.uliTotAACount = 0;
+   g_staticParams.databaseInfo.iTotalNumProteins = 0;
+
+   if (!g_staticParams.options.bOutputSqtStream && !g_staticParams.options.bCreatePeptideIndex && !g_staticParams.options.bCreateFragmentIndex)
+   {
+      logout("     - Search progress: ");
+      fflush(stdout);
+   }
+
+   // Enough chunks to keep every thread busy through the tail of the database,
+   // but large enough that the per-chunk slot acquisition is negligible.
+   size_t tChunkSize = tMapSize / ((size_t)g_staticParams.options.iNumThreads * 16);
+   if (tChunkSize < 64 * 1024)
+      tChunkSize = 64 * 1024;
+   else if (tChunkSize > 4 * 1024 * 1024)
+      tChunkSize = 4 * 1024 * 1024;
+
+   int iLastPercent = -1;
+   size_t tBegin = 0;
+
+   while (tBegin < tMapSize)
+   {
+      // advance the end of this chunk to the next '>' that starts a line
+      size_t tEnd = tBegin + tChunkSize;
+      while (tEnd < tMapSize)
+      {
+         const char* pcGt = (const char*)memchr(pcMap + tEnd, '>', tMapSize - tEnd);
+         if (pcGt == NULL)
+         {
+            tEnd = tMapSize;
+            break;
+         }
+
+         tEnd = (size_t)(pcGt - pcMap);
+         if (pcMap[tEnd - 1] == '\n' || pcMap[tEnd - 1] == '\r')
+            break;
+         tEnd++;
+      }
+      if (tEnd > tMapSize)
+         tEnd = tMapSize;
+
+      // Limit the number of queued chunks; each one holds a search memory slot while it runs.
+      while (tp->jobs_.size() >= (size_t)g_staticParams.options.iNumThreads)
+      {
+         tp->wait_for_available_thread();
+      }
+
+      tp->doJob(std::bind(SearchFastaChunk, &sShared, tBegin, tEnd));
+
+      tBegin = tEnd;
+
+      if (!g_staticParams.options.bOutputSqtStream)
+      {
+         int iPercent;
+         if (g_staticParams.options.bCreatePeptideIndex || g_staticParams.options.bCreateFragmentIndex)
+            iPercent = (int)(100.0*(0.005 + (double)tBegin/(double)tMapSize));
+         else // go from iPercentStart to iPercentEnd, scaled by tBegin/tMapSize
+            iPercent = (int)(((iPercentStart + ((double)iPercentEnd-iPercentStart)*(double)tBegin/(double)tMapSize) ));
+
+         if (iPercent != iLastPercent)
+         {
+            char szTmp[128];
+            sprintf(szTmp, "%3d%%", iPercent);
+            logout(szTmp);
+            fflush(stdout);
+            logout("\b\b\b\b");
+            iLastPercent = iPercent;
+         }
+      }
+
+      if (g_cometStatus.IsError() || g_cometStatus.IsCancel())
+         break;
+   }
+
+   // Wait for active search threads to complete processing.
+   tp->wait_on_threads();
+
+   g_staticParams.databaseInfo.iTotalNumProteins = sShared.iNumProteins;
+   g_staticParams.databaseInfo.uliTotAACount = sShared.ulAACount;
+
+   Threading::DestroyMutex(sShared.mutexProteinNames);
+
+#ifdef _WIN32
+   UnmapViewOfFile(pcMap);
+#else
+   munmap(pcMap, tMapSize);
+#endif
+
+   bSucceeded = !g_cometStatus.IsError() && !g_cometStatus.IsCancel();
+
+   if (!g_staticParams.options.bOutputSqtStream)
+   {
+      char szTmp[128];
+      if (g_staticParams.options.bCreatePeptideIndex || g_staticParams.options.bCreateFragmentIndex)
+         sprintf(szTmp, "100%%\n");
+      else
+         sprintf(szTmp, "%3d%%\n", iPercentEnd);
+      logout(szTmp);
+      fflush(stdout);
+   }
+
+   return true;
+}
+
+
+// Fixed order of peptide-centric entries with the same mass, so that results do
+// not depend on the order of the digest threads: sequence, mod state, then protein.
+static bool PeptideCentricEntryOrder(const DBIndex& lhs,
+                                     const DBIndex& rhs)
+{
+   int cmp = lhs.sPeptide.compare(rhs.sPeptide);
+   if (cmp != 0)
+      return cmp < 0;
+
+   if (lhs.pcVarModSites != rhs.pcVarModSites)
+      return lhs.pcVarModSites < rhs.pcVarModSites;
+
+   if (lhs.lIndexProteinFilePosition != rhs.lIndexProteinFilePosition)
+      return lhs.lIndexProteinFilePosition < rhs.lIndexProteinFilePosition;
+
+   if (lhs.iStartResidue != rhs.iStartResidue)
+      return lhs.iStartResidue < rhs.iStartResidue;
+
+   if (lhs.bClippedM != rhs.bClippedM)
+      return rhs.bClippedM;
+
+   if (lhs.cPrevAA != rhs.cPrevAA)
+      return lhs.cPrevAA < rhs.cPrevAA;
+
+   return lhs.cNextAA < rhs.cNextAA;
+}
+
+
+// Groups the copies of each peptide, in protein order.
+static bool PeptideCentricSequenceOrder(const DBIndex& lhs,
+                                        const DBIndex& rhs)
+{
+   if (lhs.sPeptide != rhs.sPeptide || lhs.pcVarModSites != rhs.pcVarModSites)
+      return PeptideCentricEntryOrder(lhs, rhs);
+
+   if (lhs.dPepMass != rhs.dPepMass)
+      return lhs.dPepMass < rhs.dPepMass;
+
+   return PeptideCentricEntryOrder(lhs, rhs);
+}
+
+
+// Scoring order of the peptide-centric list: ascending mass.
+static bool PeptideCentricOrder(const DBIndex& lhs,
+                                const DBIndex& rhs)
+{
+   if (lhs.dPepMass != rhs.dPepMass)
+      return lhs.dPepMass < rhs.dPepMass;
+
+   return PeptideCentricEntryOrder(lhs, rhs);
+}
+
+
+// Peptide-centric search is limited to plain protein FASTA searches; PEFF,
+// nucleotide and compound mod searches stay protein-centric.  The digest itself
+// runs RunSearch() with bCreatePeptideIndex set so it takes the protein path.
+bool CometSearch::UsePeptideCentricSearch()
+{
+   return g_staticParams.options.iPeptideCentricSearch
+      && g_staticParams.iDbType == DbType::FASTA_DB
+      && !g_staticParams.peffInfo.iPeffSearch
+      && g_staticParams.options.iWhichReadingFrame == 0
+      && g_staticParams.variableModParameters.uiNumCompoundMasses == 0
+      && !g_staticParams.options.bCreatePeptideIndex
+      && !g_staticParams.options.bCreateFragmentIndex;
+}
+
+
+// Digest the database into _vPeptideCentricList with the peptide index creation
+// path: every target peptide and variable mod form with its flanking residues,
+// protein file position and MH+ mass, one entry per protein occurrence.  The
+// digest covers digest_mass_range and the batch's tolerance windows so a single
+// digest normally serves every batch and input file of the run.
+bool CometSearch::BuildPeptideCentricList(ThreadPool* tp)
+{
+   MassRange savedMassRange = g_massRange;
+
+   double dLow = (std::min)(g_massRange.dMinMass, g_staticParams.options.dPeptideMassLow);
+   double dHigh = (std::max)(g_massRange.dMaxMass, g_staticParams.options.dPeptideMassHigh);
+
+   // a batch outside the current list is digested again over both ranges
+   if (_bPeptideCentricListBuilt)
+   {
+      dLow = (std::min)(dLow, _dPeptideCentricLow);
+      dHigh = (std::max)(dHigh, _dPeptideCentricHigh);
+   }
+
+   DeletePeptideCentricList();
+
+   g_massRange.dMinMass = dLow;
+   g_massRange.dMaxMass = dHigh;
+
+   if (g_massRange.dMaxMass - g_massRange.dMinMass > g_massRange.dMinMass)
+      g_massRange.bNarrowMassRange = true;
+   else
+      g_massRange.bNarrowMassRange = false;
+
+   if (!g_staticParams.options.bOutputSqtStream)
+   {
+      logout("     - Digesting database: ");
+      fflush(stdout);
+   }
+
+   g_staticParams.options.bCreatePeptideIndex = true;
+   bool bSucceeded = RunSearch(0, 0, tp);
+   g_staticParams.options.bCreatePeptideIndex = false;
+
+   g_massRange = savedMassRange;
+
+   g_pvProteinNames.clear();   // only used when writing an index file
+   _vPeptideCentricList.swap(g_pvDBIndex);
+   vector<DBIndex>().swap(g_pvDBIndex);
+
+   if (!bSucceeded)
+   {
+      DeletePeptideCentricList();
+      return false;
+   }
+
+   // The digest sums residue masses as it slides along each protein, so copies of
+   // a peptide from different proteins can differ in the last bits.  Give them all
+   // one mass so they stay together in protein order, as the protein-centric search
+   // meets them.  Copies with a protein terminal mod keep their own mass.
+   sort(_vPeptideCentricList.begin(), _vPeptideCentricList.end(), PeptideCentricSequenceOrder);
+
+   for (size_t i = 1; i < _vPeptideCentricList.size(); ++i)
+   {
+      DBIndex& sPrev = _vPeptideCentricList[i - 1];
+      DBIndex& sDBI = _vPeptideCentricList[i];
+
+      if (sDBI.sPeptide == sPrev.sPeptide
+            && sDBI.pcVarModSites == sPrev.pcVarModSites
+            && fabs(sDBI.dPepMass - sPrev.dPepMass) < FLOAT_ZERO)
+      {
+         sDBI.dPepMass = sPrev.dPepMass;
+      }
+   }
+
+   sort(_vPeptideCentricList.begin(), _vPeptideCentricList.end(), PeptideCentricOrder);
+
+   _dPeptideCentricLow = dLow;
+   _dPeptideCentricHigh = dHigh;
+   _bPeptideCentricListBuilt = true;
+
+   return true;
+}
+
+
+void CometSearch::DeletePeptideCentricList()
+{
+   vector<DBIndex>().swap(_vPeptideCentricList);
+   _bPeptideCentricListBuilt = false;
+}
+
+
+// Search the batch peptide-first.  The peptides of the batch's mass range are one
+// contiguous run of the mass-sorted list; they are scored in order in chunks on the
+// thread pool, so each thread walks a narrow, advancing window of the sorted queries
+// instead of the whole batch for every protein.  Scoring goes through
+// AnalyzePeptideIndex() with the FASTA file position of each protein occurrence,
+// which gives the same protein lists as the protein-centric search.
+bool CometSearch::RunPeptideCentricSearch(int iPercentStart,
+                                          int iPercentEnd,
+                                          ThreadPool* tp)
+{
+   if (!_bPeptideCentricListBuilt
+      || g_massRange.dMinMass < _dPeptideCentricLow
+      || g_massRange.dMaxMass > _dPeptideCentricHigh)
+   {
+#ifdef PEPTIDE_CENTRIC_BENCH
+      auto tBenchStart = std::chrono::steady_clock::now();
+#endif
+      if (!BuildPeptideCentricList(tp))
+         return false;
+#ifdef PEPTIDE_CENTRIC_BENCH
+      RecordPeptideCentricBenchStep(PEPTIDE_CENTRIC_BENCH_DIGEST,
+         std::chrono::duration<double>(std::chrono::steady_clock::now() - tBenchStart).count(), _vPeptideCentricList.size());
+#endif
+   }
+
+#ifdef PEPTIDE_CENTRIC_BENCH
+   auto tBenchStart = std::chrono::steady_clock::now();
+#endif
+
+   BuildPrecursorBuckets();
+
+   auto itBegin = lower_bound(_vPeptideCentricList.begin(), _vPeptideCentricList.end(), g_massRange.dMinMass,
+      [](const DBIndex& lhs, double dMass) { return lhs.dPepMass < dMass; });
+   auto itEnd = upper_bound(itBegin, _vPeptideCentricList.end(), g_massRange.dMaxMass,
+      [](double dMass, const DBIndex& rhs) { return dMass < rhs.dPepMass; });
+
+   size_t tFirst = (size_t)(itBegin - _vPeptideCentricList.begin());
+   size_t tLast = (size_t)(itEnd - _vPeptideCentricList.begin());
+   size_t tNumPeptides = tLast - tFirst;
+
+   if (!g_staticParams.options.bOutputSqtStream)
+   {
+      logout("     - Search progress: ");
+      fflush(stdout);
+   }
+
+   // Same job sizing as the mapped FASTA search: enough ranges to balance the
+   // threads, each large enough that the slot acquisition is negligible.
+   size_t tChunkSize = tNumPeptides / ((size_t)g_staticParams.options.iNumThreads * 16);
+   if (tChunkSize < 256)
+      tChunkSize = 256;
+
+   int iLastPercent = -1;
+
+   for (size_t tBegin = tFirst; tBegin < tLast; tBegin += tChunkSize)
+   {
+      size_t tEnd = (std::min)(tBegin + tChunkSize, tLast);
+
+      while (tp->jobs_.size() >= (size_t)g_staticParams.options.iNumThreads)
+      {
+         tp->wait_for_available_thread();
+      }
+
+      tp->doJob(std::bind(SearchPeptideCentricRange, tBegin, tEnd));
+
+      if (!g_staticParams.options.bOutputSqtStream)
+      {
+         // go from iPercentStart to iPercentEnd, scaled by the peptides handed out
+         int iPercent = (int)(iPercentStart + ((double)iPercentEnd - iPercentStart) * (double)(tEnd - tFirst) / (double)tNumPeptides);
+
+         if (iPercent != iLastPercent)
+         {
+            char szTmp[128];
+            sprintf(szTmp, "%3d%%", iPercent);
+            logout(szTmp);
+            fflush(stdout);
+            logout("\b\b\b\b");
+            iLastPercent = iPercent;
+         }
+      }
+
+      if (g_cometStatus.IsError() || g_cometStatus.IsCancel())
+         break;
+   }
+
+   tp->wait_on_threads();
+
+   if (!g_staticParams.options.bOutputSqtStream)
+   {
+      char szTmp[128];
+      sprintf(szTmp, "%3d%%\n", iPercentEnd);
+      logout(szTmp);
+      fflush(stdout);
+   }
+
+#ifdef PEPTIDE_CENTRIC_BENCH
+   RecordPeptideCentricBenchStep(PEPTIDE_CENTRIC_BENCH_SWEEP,
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - tBenchStart).count(), tNumPeptides);
+#endif
+
+   return !g_cometStatus.IsError() && !g_cometStatus.IsCancel();
+}
+
+
+// Score the peptides [tBegin, tEnd) of _vPeptideCentricList on one memory pool slot.
+void CometSearch::SearchPeptideCentricRange(size_t tBegin,
+                                            size_t tEnd)
+{
+   if (g_cometStatus.IsError() || g_cometStatus.IsCancel())
+      return;
+
+   int iSlot = AcquirePoolSlot();
+   if (iSlot < 0)
+   {
+      logerr(" Error - could not find available memory pool for MS2 search thread.\n");
+      return;
+   }
+
+   CometSearch* pSearch = _ppSearchContext[iSlot];
+   sDBEntry dbe;   // only carries the protein position, as in the peptide index search
+
+   pSearch->_proteinInfo.sPeffOrigResidues.clear();
+   pSearch->_proteinInfo.iPeffOrigResiduePosition = NO_PEFF_VARIANT;
+   pSearch->_proteinInfo.iPeffNewResidueCount = 0;
+
+   for (size_t i = tBegin; i < tEnd; ++i)
+   {
+      const DBIndex& sDBI = _vPeptideCentricList[i];
+
+      // szProteinSeq only holds the peptide and its flanks; report the protein position
+      dbe.lProteinFilePosition = sDBI.lIndexProteinFilePosition;
+      pSearch->_proteinInfo.bClippedNtermMet = sDBI.bClippedM;
+      pSearch->_proteinInfo.iPeptideStartResidue = sDBI.iStartResidue;
+
+      pSearch->AnalyzePeptideIndex(0, sDBI, _ppbDuplFragmentArr[iSlot], &dbe);
+   }
+
+   pSearch->_proteinInfo.bClippedNtermMet = false;
+   pSearch->_proteinInfo.iPeptideStartResidue = -1;
+
+   ReleasePoolSlot(iSlot);
+}
+
+
+bool CometSearch::RunSpecLibSearch(ThreadPool* tp)
+{
+   printf("OK in RunSpecLib\n");
+
+   return true;
+}
+
+
+bool CometSearch::RunSpecLibSearch(int iPercentStart,
+                                   int iPercentEnd,
+                                   ThreadPool* tp)
+{
+   // to fill g_vulSpecLibPrecursorIndex, set
+   // binmin = BINPREC(expmass - tol)
+   // binmax = BINPREC(expmass + tol)
+   // then for (i=binmin; i<=binmax; ++i) {g_vulSpecLibPrecursorIndex[i].push_back(entry)}
+
+   for (vector<Query*>::iterator it = g_pvQuery.begin(); it != g_pvQuery.end(); ++it)
+   {
+      int iBinExpMass = BINPREC((*it)->_pepMassInfo.dExpPepMass);
+
+      // FIX: need to address isotope offsets as well
+
+      if (g_vulSpecLibPrecursorIndex[iBinExpMass].size() > 0)
+      {
+         // compare query spectrum (*it) against list of precursor
+
+         for (size_t x = 0; x < g_vulSpecLibPrecursorIndex[iBinExpMass].size(); ++x)
+         {
+            double dSpecLibScore = CometSpecLib::ScoreSpecLib(*it, g_vulSpecLibPrecursorIndex[iBinExpMass].at(x));
+
+            if (dSpecLibScore > (*it)->fLowestSpecLibScore)
+               CometSpecLib::StoreSpecLib(*it, g_vulSpecLibPrecursorIndex[iBinExpMass].at(x), dSpecLibScore);
+
+         }
+      }
+   }
+   return true;
+}
+
+bool CometSearch::RunMS1Search(ThreadPool* tp,
+                               double dRT,
+                               double dMaxMS1RTDiff,
+                               const double dMaxSpecLibRT,
+                               const double dMaxQueryRT)
+{
+   ThreadPool* pRunMS1SearchThreadPool = tp;
+
+   for (size_t iWhichMS1Query = 0; iWhichMS1Query < g_pvQueryMS1.size(); ++iWhichMS1Query)
+   {
+      // for each query, thread the search by segmenting the library
+      for (int iWhichThread = 0; iWhichThread < g_staticParams.options.iNumThreads; ++iWhichThread)
+      {
+         pRunMS1SearchThreadPool->doJob(std::bind(SearchMS1Library, iWhichMS1Query, iWhichThread, dRT,
+            dMaxMS1RTDiff, dMaxSpecLibRT, dMaxQueryRT, pRunMS1SearchThreadPool));
+      }
+   }
+   pRunMS1SearchThreadPool->wait_on_threads();
+
+   return true;
+}
+
+
+// Thread-local RunMS1Search overload: compares a caller-owned QueryMS1* against
+// the read-only g_vSpecLib entries within the RT window. Populates the output
+// scores vector with up to topN best matches. Zero shared mutable state.
+bool CometSearch::RunMS1Search(QueryMS1* pQueryMS1,
+                               const int topN,
+                               double dRT,
+                               double dMaxMS1RTDiff,
+                               const double dMaxSpecLibRT,
+                               const double dMaxQueryRT,
+                               vector<CometScoresMS1>& scores)
+{
+   if (pQueryMS1 == nullptr || pQueryMS1->pfFastXcorrData == nullptr)
+      return false;
+
+   scores.clear();
+
+   // Use the aligner to adjust the query RT if alignment data is available
+   // For now, use the raw RT ratio to estimate the corresponding library RT
+   double dScaledRT = dRT;
+   if (dMaxQueryRT > 0.0 && dMaxSpecLibRT > 0.0)
+      dScaledRT = dRT * (dMaxSpecLibRT / dMaxQueryRT);
+
+   float fBestDotProduct = -1.0f;
+   int iBestLibIdx = -1;
+
+   size_t iNumLibEntries = g_vSpecLib.size();
+   unsigned int uiQueryArraySize = pQueryMS1->iArraySizeMS1;
+
+   for (size_t i = 0; i < iNumLibEntries; ++i)
+   {
+      const SpecLibStruct& libEntry = g_vSpecLib[i];
+
+      // Check RT window
+      double dLibRT = (double)libEntry.fRTime;
+      if (fabs(dScaledRT - dLibRT) > dMaxMS1RTDiff)
+         continue;
+
+      // Check array size compatibility
+      if (libEntry.pfUnitVector == nullptr)
+         continue;
+
+      unsigned int uiLibArraySize = libEntry.uiArraySizeMS1;
+      unsigned int uiMinSize = (uiQueryArraySize < uiLibArraySize) ? uiQueryArraySize : uiLibArraySize;
+
+      // Compute dot product between query unit vector and library unit vector
+      double dDotProduct = 0.0;
+      for (unsigned int j = 0; j < uiMinSize; ++j)
+         dDotProduct += (double)pQueryMS1->pfFastXcorrData[j] * (double)libEntry.pfUnitVector[j];
+
+      if ((float)dDotProduct > fBestDotProduct)
+      {
+         fBestDotProduct = (float)dDotProduct;
+         iBestLibIdx = (int)i;
+      }
+   }
+
+   // For topN=1, just return the single best match
+   if (iBestLibIdx >= 0)
+   {
+      CometScoresMS1 result;
+      result.fDotProduct = fBestDotProduct;
+      result.fRTime = g_vSpecLib[iBestLibIdx].fRTime;
+      result.iScanNumber = (int)g_vSpecLib[iBestLibIdx].iLibEntry;
+      scores.push_back(result);
+   }
+
+   return true;
+}
+
+
+void CometSearch::ReadOBO(char *szOBO,
+                          vector<OBOStruct> *vectorPeffOBO)
+{
+   FILE *fp;
 
    if ( (fp=fopen(szOBO, "r")) != NULL)
    {
@@ -1275,66 +2274,40 @@ bool CometSearch::MapOBO(string strMod,
 void CometSearch::SearchThreadProc(SearchThreadData *pSearchThreadData,
                                    ThreadPool* tp)
 {
-   int i;
-
    // Grab available array from shared memory pool.
+   int i = AcquirePoolSlot();
 
-   Threading::LockMutex(g_searchMemoryPoolMutex);
-   auto tStartTime = std::chrono::high_resolution_clock::now();
-   const auto timeout_duration = std::chrono::seconds(240);
-
-   while (true)
-   {
-       for (i = 0; i < g_staticParams.options.iNumThreads; ++i)
-       {
-           if (_pbSearchMemoryPool[i] == false)
-           {
-              _pbSearchMemoryPool[i] = true;
-              break;
-           }
-       }
-
-       if (i < g_staticParams.options.iNumThreads)
-       {
-           break;
-       }
-
-       if (std::chrono::high_resolution_clock::now() - tStartTime > timeout_duration)
-       {
-           break;
-       }
-
-       // Release mutex and yield to allow other threads to release memory
-       Threading::UnlockMutex(g_searchMemoryPoolMutex);
-       std::this_thread::yield();
-       Threading::LockMutex(g_searchMemoryPoolMutex);
-   }
-   Threading::UnlockMutex(g_searchMemoryPoolMutex);
-
-   if (i == g_staticParams.options.iNumThreads)
+   if (i < 0)
    {
       logerr(" Error - could not find available memory pool for MS2 search thread.\n");
+      delete pSearchThreadData;
       return;
    }
 
-   // Give memory manager access to the thread.
-   pSearchThreadData->pbSearchMemoryPool = &_pbSearchMemoryPool[i];
+   // The slot's search object and duplicate fragment array are reused for the whole chunk.
+   for (auto it = pSearchThreadData->vDBEntry.begin(); it != pSearchThreadData->vDBEntry.end(); ++it)
+   {
+      _ppSearchContext[i]->DoSearch(*it, _ppbDuplFragmentArr[i]);
+
+      if (g_cometStatus.IsError() || g_cometStatus.IsCancel())
+         break;
+   }
 
-   // Heap-allocate to avoid thread stack overflow: CometSearch has ~295 KB of
-   // member arrays (_uiBinnedIonMasses, etc.) that would exhaust the 1 MB thread
-   // stack in debug builds when combined with the deep DoSearch call chain.
-   CometSearch* sqSearch = new CometSearch();
-   sqSearch->DoSearch(pSearchThreadData->dbEntry, _ppbDuplFragmentArr[i]);
-   delete sqSearch;
+   ReleasePoolSlot(i);
 
    delete pSearchThreadData;
    pSearchThreadData = NULL;
 }
 
 
-bool CometSearch::DoSearch(sDBEntry dbe,
+bool CometSearch::DoSearch(sDBEntry& dbe,
                            bool *pbDuplFragment)
 {
+   // PEFF mods are referenced by index from piVarModSites so sort them once here;
+   // every SearchForPeptides() call for this entry shares the same order.
+   if (dbe.vectorPeffMod.size() > 0) // sort vectorPeffMod by iPosition
+      sort(dbe.vectorPeffMod.begin(), dbe.vectorPeffMod.end());
+
    // Standard protein database search.
    if (g_staticParams.options.iWhichReadingFrame == 0)
    {
@@ -1344,6 +2317,7 @@ bool CometSearch::DoSearch(sDBEntry dbe,
       _proteinInfo.sPeffOrigResidues.clear();
       _proteinInfo.iPeffOrigResiduePosition = NO_PEFF_VARIANT;  // used for PEFF variant (SAAV);  NO_PEFF_VARIANT set to off
       _proteinInfo.iPeffNewResidueCount = 0;
+      _proteinInfo.bClippedNtermMet = false;
 
       // have to pass sequence as it can be modified per below
       if (!SearchForPeptides(dbe, (char *)dbe.strSeq.c_str(), 0, pbDuplFragment))
@@ -1352,11 +2326,13 @@ bool CometSearch::DoSearch(sDBEntry dbe,
       if (g_staticParams.options.bClipNtermMet && dbe.strSeq[0]=='M')
       {
          _proteinInfo.iTmpProteinSeqLength -= 1;   // remove 1 for M, used in checking termini
+         _proteinInfo.bClippedNtermMet = true;
 
          if (!SearchForPeptides(dbe, (char *)dbe.strSeq.c_str()+1, 1, pbDuplFragment))
             return false;
 
          _proteinInfo.iTmpProteinSeqLength += 1;
+         _proteinInfo.bClippedNtermMet = false;
       }
 
       // Plug in an AA substitutions (or deletions) and do a search, requiring that AA be present
@@ -1498,64 +2474,219 @@ void CometSearch::SearchFragmentIndex(Query* pQuery,
    double pdAAforward[MAX_PEPTIDE_LEN];
    double pdAAreverse[MAX_PEPTIDE_LEN];
 
-   std::unordered_map<unsigned int, int> mPeptides;   // which peptide (index into g_vFragmentPeptides, and # matched fragments)
+   std::unordered_map<unsigned int, int> mPeptides;   // fallback counter for very wide precursor windows
    size_t lNumPeps = 0;
    unsigned int uiFragmentMass;
 
    unsigned int uiBinnedIonMasses[MAX_FRAGMENT_CHARGE + 1][NUM_ION_SERIES][MAX_PEPTIDE_LEN][VMODS + 2];
    unsigned int uiBinnedPrecursorNL[MAX_PRECURSOR_NL_SIZE][MAX_PRECURSOR_CHARGE];
 
-   mPeptides.clear();
+   // Slice of mass sorted g_pFragmentPeptides that covers the precursor tolerance window.
+   const FragmentPeptidesStruct* pPeptidesEnd = g_pFragmentPeptides + g_tNumFragmentPeptides;
+   auto itSliceStart = std::lower_bound(g_pFragmentPeptides, pPeptidesEnd,
+      pQuery->_pepMassInfo.dPeptideMassToleranceMinus,
+      [](const FragmentPeptidesStruct& a, double dMass) { return a.dPepMass < dMass; });
+   auto itSliceEnd = std::upper_bound(itSliceStart, pPeptidesEnd,
+      pQuery->_pepMassInfo.dPeptideMassTolerancePlus,
+      [](double dMass, const FragmentPeptidesStruct& a) { return dMass < a.dPepMass; });
+
+   unsigned int uiSliceStart = (unsigned int)(itSliceStart - g_pFragmentPeptides);
+   size_t iSliceSize = (size_t)(itSliceEnd - itSliceStart);
+
+   if (iSliceSize == 0)
+      return;
+
+   FragmentIndexScratch& scratch = g_fragmentIndexScratch;
+   bool bDenseCount = (iSliceSize <= FRAGINDEX_MAX_DENSE_SLICE);
+
+   if (bDenseCount)
+      scratch.Reset(iSliceSize);
+
+   bool bTimeout = false;
+
+   // Entries are peptide indices into mass sorted g_pFragmentPeptides, so the precursor
+   // window is the index range [uiSliceStart, uiSliceEnd).  The slab and compressed
+   // layouts select entries by that range and read no peptide mass while counting.
+   unsigned int uiSliceEnd = uiSliceStart + (unsigned int)iSliceSize;
+   unsigned int uiFirstSlab = 0;
+   unsigned int uiLastSlab = 0;
+   bool bCheckMassAfterCount = (g_uiNumFragmentSlabs > 1 || g_ucFragmentIndexPacked != NULL);
+
+   if (g_uiNumFragmentSlabs > 1)
+   {
+      uiFirstSlab = (unsigned int)(std::upper_bound(g_uiFragmentSlabPeptide, g_uiFragmentSlabPeptide + g_uiNumFragmentSlabs + 1, uiSliceStart) - g_uiFragmentSlabPeptide) - 1;
+      uiLastSlab = (unsigned int)(std::upper_bound(g_uiFragmentSlabPeptide, g_uiFragmentSlabPeptide + g_uiNumFragmentSlabs + 1, uiSliceEnd - 1) - g_uiFragmentSlabPeptide) - 1;
+   }
+
+   if (g_ucFragmentIndexPacked != NULL)
+   {
+      // Compressed posting lists: blocks entirely below the precursor window are skipped
+      // using the first entry of the following block, the rest are decoded and filtered.
+      unsigned int puiBlock[FRAGINDEX_PACK_BLOCK];
+
+      for (auto it2 = pQuery->vfRawFragmentPeakMass.begin();
+         it2 != pQuery->vfRawFragmentPeakMass.end() && !bTimeout; ++it2)
+      {
+         for (int iChg = 1; iChg <= pQuery->_spectrumInfoInternal.usiMaxFragCharge && !bTimeout; ++iChg)
+         {
+            uiFragmentMass = BIN((*it2) * iChg - (iChg - 1.0));
+
+            if (uiFragmentMass >= g_massRange.uiMaxFragmentArrayIndex)
+               continue;
+
+            for (unsigned int uiSlab = uiFirstSlab; uiSlab <= uiLastSlab; ++uiSlab)
+            {
+               size_t iBin = (size_t)uiSlab * g_massRange.uiMaxFragmentArrayIndex + uiFragmentMass;
+               unsigned int uiCount = g_iFragmentIndexOffset[iBin + 1] - g_iFragmentIndexOffset[iBin];
+               const unsigned char* pBlock = g_ucFragmentIndexPacked + g_ullFragmentIndexPackedOffset[iBin];
+
+               for (unsigned int uiDone = 0; uiDone < uiCount; uiDone += FRAGINDEX_PACK_BLOCK)
+               {
+                  unsigned int uiBlockCount = (std::min)((unsigned int)FRAGINDEX_PACK_BLOCK, uiCount - uiDone);
+                  const unsigned char* pNext = CometFragmentIndex::PackedBlockNext(pBlock, uiBlockCount);
+
+                  if (CometFragmentIndex::PackedBlockFirst(pBlock) >= uiSliceEnd)
+                     break;
+
+                  if (uiDone + uiBlockCount < uiCount && CometFragmentIndex::PackedBlockFirst(pNext) < uiSliceStart)
+                  {
+                     pBlock = pNext;
+                     continue;
+                  }
+
+                  CometFragmentIndex::UnpackBlock(pBlock, uiBlockCount, puiBlock);
+
+                  for (unsigned int i = 0; i < uiBlockCount; ++i)
+                  {
+                     unsigned int uiEntry = puiBlock[i];
+
+                     if (uiEntry < uiSliceStart)
+                        continue;
+                     if (uiEntry >= uiSliceEnd)
+                        break;
+
+                     if (bDenseCount)
+                        scratch.Add(uiEntry - uiSliceStart);
+                     else if (CheckMassMatch(pQuery, g_pFragmentPeptides[uiEntry].dPepMass))
+                        mPeptides[uiEntry] += 1;
+                  }
+
+                  pBlock = pNext;
+               }
+            }
 
-   // Walk through the binned peaks in the spectrum and map them to the fragment index
-   // to count all peptides that contain each fragment peak.
-   bool bTimeout = false;
-   for (auto it2 = pQuery->vfRawFragmentPeakMass.begin();
-      it2 != pQuery->vfRawFragmentPeakMass.end() && !bTimeout; ++it2)
+            if (g_staticParams.options.iMaxIndexRunTime > 0)
+            {
+               auto tNow = std::chrono::high_resolution_clock::now();
+               auto tElapsedTime = std::chrono::duration_cast<std::chrono::milliseconds>(tNow - pQuery->tSearchStart).count();
+               if (tElapsedTime >= g_staticParams.options.iMaxIndexRunTime)
+                  bTimeout = true;
+            }
+         }
+      }
+   }
+   else if (g_uiNumFragmentSlabs > 1)
    {
-      for (int iChg = 1; iChg <= pQuery->_spectrumInfoInternal.usiMaxFragCharge && !bTimeout; ++iChg)
+      // Slab layout: only the slabs overlapping the precursor window are read.
+      for (auto it2 = pQuery->vfRawFragmentPeakMass.begin();
+         it2 != pQuery->vfRawFragmentPeakMass.end() && !bTimeout; ++it2)
       {
-         uiFragmentMass = BIN((*it2) * iChg - (iChg - 1.0));
-
-         if (uiFragmentMass < g_massRange.uiMaxFragmentArrayIndex)
+         for (int iChg = 1; iChg <= pQuery->_spectrumInfoInternal.usiMaxFragCharge && !bTimeout; ++iChg)
          {
-            lNumPeps = (size_t)(g_iFragmentIndexOffset[uiFragmentMass + 1] - g_iFragmentIndexOffset[uiFragmentMass]);
+            uiFragmentMass = BIN((*it2) * iChg - (iChg - 1.0));
+
+            if (uiFragmentMass >= g_massRange.uiMaxFragmentArrayIndex)
+               continue;
 
-            if (lNumPeps > 0)
+            for (unsigned int uiSlab = uiFirstSlab; uiSlab <= uiLastSlab; ++uiSlab)
             {
-               size_t iFirst;
+               size_t iBin = (size_t)uiSlab * g_massRange.uiMaxFragmentArrayIndex + uiFragmentMass;
+               unsigned int *puiFirst = g_iFragmentIndex + g_iFragmentIndexOffset[iBin];
+               unsigned int *puiLast = g_iFragmentIndex + g_iFragmentIndexOffset[iBin + 1];
 
-               if (lNumPeps <= BINARYSEARCHCUTOFF)
-                  iFirst = 0;
-               else
+               // only the first and last slab can extend past the precursor window
+               if (g_uiFragmentSlabPeptide[uiSlab] < uiSliceStart)
+                  puiFirst = std::lower_bound(puiFirst, puiLast, uiSliceStart);
+               if (g_uiFragmentSlabPeptide[uiSlab + 1] > uiSliceEnd)
+                  puiLast = std::lower_bound(puiFirst, puiLast, uiSliceEnd);
+
+               for (unsigned int *pui = puiFirst; pui < puiLast; ++pui)
                {
-                  iFirst = BinarySearchIndexMass(0, lNumPeps,
-                     pQuery->_pepMassInfo.dPeptideMassToleranceMinus, &uiFragmentMass);
+                  // CheckMassMatch depends only on the peptide so it is applied once per
+                  // peptide after counting
+                  if (bDenseCount)
+                     scratch.Add(*pui - uiSliceStart);
+                  else if (CheckMassMatch(pQuery, g_pFragmentPeptides[*pui].dPepMass))
+                     mPeptides[*pui] += 1;
                }
+            }
+
+            if (g_staticParams.options.iMaxIndexRunTime > 0)
+            {
+               auto tNow = std::chrono::high_resolution_clock::now();
+               auto tElapsedTime = std::chrono::duration_cast<std::chrono::milliseconds>(tNow - pQuery->tSearchStart).count();
+               if (tElapsedTime >= g_staticParams.options.iMaxIndexRunTime)
+                  bTimeout = true;
+            }
+         }
+      }
+   }
+   else
+   {
+      // Walk through the binned peaks in the spectrum and map them to the fragment index
+      // to count all peptides that contain each fragment peak.
+      for (auto it2 = pQuery->vfRawFragmentPeakMass.begin();
+         it2 != pQuery->vfRawFragmentPeakMass.end() && !bTimeout; ++it2)
+      {
+         for (int iChg = 1; iChg <= pQuery->_spectrumInfoInternal.usiMaxFragCharge && !bTimeout; ++iChg)
+         {
+            uiFragmentMass = BIN((*it2) * iChg - (iChg - 1.0));
+
+            if (uiFragmentMass < g_massRange.uiMaxFragmentArrayIndex)
+            {
+               lNumPeps = (size_t)(g_iFragmentIndexOffset[uiFragmentMass + 1] - g_iFragmentIndexOffset[uiFragmentMass]);
 
-               unsigned int uiBinBase = g_iFragmentIndexOffset[uiFragmentMass];
-               for (size_t ix = iFirst; ix < lNumPeps; ++ix)
+               if (lNumPeps > 0)
                {
-                  unsigned int iTmp = g_iFragmentIndex[uiBinBase + ix];
-                  double dCalcPepMass = g_vFragmentPeptides[iTmp].dPepMass;
+                  size_t iFirst;
 
-                  if (dCalcPepMass >= pQuery->_pepMassInfo.dPeptideMassToleranceMinus
-                     && dCalcPepMass <= pQuery->_pepMassInfo.dPeptideMassTolerancePlus)
+                  if (lNumPeps <= BINARYSEARCHCUTOFF)
+                     iFirst = 0;
+                  else
                   {
-                     if (CheckMassMatch(pQuery, dCalcPepMass))
-                        mPeptides[iTmp] += 1;
+                     iFirst = BinarySearchIndexMass(0, lNumPeps,
+                        pQuery->_pepMassInfo.dPeptideMassToleranceMinus, &uiFragmentMass);
                   }
-                  else if (dCalcPepMass > pQuery->_pepMassInfo.dPeptideMassTolerancePlus)
-                     break;
 
-                  if (g_staticParams.options.iMaxIndexRunTime > 0 && (ix & 0x3FF) == 0)
+                  unsigned int uiBinBase = g_iFragmentIndexOffset[uiFragmentMass];
+                  for (size_t ix = iFirst; ix < lNumPeps; ++ix)
                   {
-                     auto tNow = std::chrono::high_resolution_clock::now();
-                     auto tElapsedTime = std::chrono::duration_cast<std::chrono::milliseconds>(tNow - pQuery->tSearchStart).count();
-                     if (tElapsedTime >= g_staticParams.options.iMaxIndexRunTime)
+                     unsigned int iTmp = g_iFragmentIndex[uiBinBase + ix];
+                     double dCalcPepMass = g_pFragmentPeptides[iTmp].dPepMass;
+
+                     if (dCalcPepMass >= pQuery->_pepMassInfo.dPeptideMassToleranceMinus
+                        && dCalcPepMass <= pQuery->_pepMassInfo.dPeptideMassTolerancePlus)
                      {
-                        bTimeout = true;
+                        if (CheckMassMatch(pQuery, dCalcPepMass))
+                        {
+                           if (bDenseCount)
+                              scratch.Add(iTmp - uiSliceStart);
+                           else
+                              mPeptides[iTmp] += 1;
+                        }
+                     }
+                     else if (dCalcPepMass > pQuery->_pepMassInfo.dPeptideMassTolerancePlus)
                         break;
+
+                     if (g_staticParams.options.iMaxIndexRunTime > 0 && (ix & 0x3FF) == 0)
+                     {
+                        auto tNow = std::chrono::high_resolution_clock::now();
+                        auto tElapsedTime = std::chrono::duration_cast<std::chrono::milliseconds>(tNow - pQuery->tSearchStart).count();
+                        if (tElapsedTime >= g_staticParams.options.iMaxIndexRunTime)
+                        {
+                           bTimeout = true;
+                           break;
+                        }
                      }
                   }
                }
@@ -1564,7 +2695,7 @@ void CometSearch::SearchFragmentIndex(Query* pQuery,
       }
    }
 
-   // copy mPeptides map to a vector of pairs and sort in
+   // copy matched peptides to a vector of pairs and sort in
    // descending order of matched fragment ions
    if (g_staticParams.options.iMaxIndexRunTime > 0)
    {
@@ -1575,13 +2706,32 @@ void CometSearch::SearchFragmentIndex(Query* pQuery,
    }
 
    std::vector<std::pair<unsigned int, int>> vPeptides;
-   for (auto ix = mPeptides.begin(); ix != mPeptides.end(); ++ix)
+   if (bDenseCount)
    {
-      if (ix->second >= g_staticParams.options.iFragIndexMinIonsScore)
-         vPeptides.push_back(*ix);
+#ifdef FRAGINDEX_BENCH
+      RecordFragmentIndexBenchQuery(scratch, iSliceSize);
+#endif
+
+      for (auto uiOffset : scratch.vTouched)
+      {
+         int iCount = scratch.vCounters[uiOffset].iCount;
+         if (iCount >= g_staticParams.options.iFragIndexMinIonsScore
+            && (!bCheckMassAfterCount || CheckMassMatch(pQuery, g_pFragmentPeptides[uiSliceStart + uiOffset].dPepMass)))
+         {
+            vPeptides.push_back(std::make_pair(uiSliceStart + uiOffset, iCount));
+         }
+      }
    }
+   else
+   {
+      for (auto ix = mPeptides.begin(); ix != mPeptides.end(); ++ix)
+      {
+         if (ix->second >= g_staticParams.options.iFragIndexMinIonsScore)
+            vPeptides.push_back(*ix);
+      }
 
-   mPeptides.clear();
+      mPeptides.clear();
+   }
 
    if (g_staticParams.options.iMaxIndexRunTime > 0)
    {
@@ -1591,11 +2741,14 @@ void CometSearch::SearchFragmentIndex(Query* pQuery,
          return;
    }
 
-   sort(vPeptides.begin(), vPeptides.end(), [](const std::pair<unsigned int, int>& a, const std::pair<unsigned int, int>& b)
+   // Only the top FRAGINDEX_MAX_NUMSCORED peptides are scored so only those need to be ordered.
+   auto itScoreEnd = vPeptides.size() > FRAGINDEX_MAX_NUMSCORED ? vPeptides.begin() + FRAGINDEX_MAX_NUMSCORED : vPeptides.end();
+   partial_sort(vPeptides.begin(), itScoreEnd, vPeptides.end(), [](const std::pair<unsigned int, int>& a, const std::pair<unsigned int, int>& b)
    {
       if (a.second != b.second) return a.second > b.second;
       return a.first < b.first;  // tie-break by peptide index for deterministic output
    });
+   vPeptides.erase(itScoreEnd, vPeptides.end());
 
    int iLenPeptide;
    int iWhichIonSeries;
@@ -1627,16 +2780,14 @@ void CometSearch::SearchFragmentIndex(Query* pQuery,
       {
          int iFoundVariableMod = 0;
 
-         strcpy(szPeptide, g_vRawPeptides.at(g_vFragmentPeptides[ix->first].iWhichPeptide).sPeptide.c_str());
+         strcpy(szPeptide, CometFragmentIndex::RawPeptideSequence(g_pFragmentPeptides[ix->first].iWhichPeptide));
          iLenPeptide = (int)strlen(szPeptide);
 
-         ModificationNumber modNum;
-         char* mods = NULL;
-         int modSeqIdx;
-         int modNumIdx = g_vFragmentPeptides[ix->first].modNumIdx;
-         size_t iWhichPeptide = g_vFragmentPeptides[ix->first].iWhichPeptide;
-         string modSeq;
-         double dCalcPepMass = g_vFragmentPeptides[ix->first].dPepMass;
+         const char* mods = NULL;
+         int modNumIdx = g_pFragmentPeptides[ix->first].modNumIdx;
+         size_t iWhichPeptide = g_pFragmentPeptides[ix->first].iWhichPeptide;
+         const char* modSeq;
+         double dCalcPepMass = g_pFragmentPeptides[ix->first].dPepMass;
 
          iEndPos = iLenMinus1 = iLenPeptide - 1;
 
@@ -1644,10 +2795,8 @@ void CometSearch::SearchFragmentIndex(Query* pQuery,
 
          if (modNumIdx != -1)  // set modified peptide info
          {
-            modNum = MOD_NUMBERS.at(modNumIdx);
-            mods = modNum.modifications;
-            modSeqIdx = PEPTIDE_MOD_SEQ_IDXS[iWhichPeptide];
-            modSeq = MOD_SEQS.at(modSeqIdx);
+            mods = CometFragmentIndex::ModNumber(modNumIdx);
+            modSeq = CometFragmentIndex::ModSequence(PEPTIDE_MOD_SEQ_IDXS[iWhichPeptide]);
 
             int j = 0;
             for (int k = 0; k <= iEndPos; ++k)
@@ -1667,16 +2816,16 @@ void CometSearch::SearchFragmentIndex(Query* pQuery,
          double dYion = g_staticParams.precalcMasses.dCtermOH2Proton;
 
          // set terminal mods
-         if (g_vFragmentPeptides[ix->first].cNtermMod > -1)
+         if (g_pFragmentPeptides[ix->first].cNtermMod > -1)
          {
-            piVarModSites[iLenPeptide] = g_vFragmentPeptides[ix->first].cNtermMod + 1;
-            dBion += g_staticParams.variableModParameters.varModList[g_vFragmentPeptides[ix->first].cNtermMod].dVarModMass;
+            piVarModSites[iLenPeptide] = g_pFragmentPeptides[ix->first].cNtermMod + 1;
+            dBion += g_staticParams.variableModParameters.varModList[g_pFragmentPeptides[ix->first].cNtermMod].dVarModMass;
             iFoundVariableMod = 1;
          }
-         if (g_vFragmentPeptides[ix->first].cCtermMod > -1)
+         if (g_pFragmentPeptides[ix->first].cCtermMod > -1)
          {
-            piVarModSites[iLenPeptide + 1] = g_vFragmentPeptides[ix->first].cCtermMod + 1;
-            dYion += g_staticParams.variableModParameters.varModList[g_vFragmentPeptides[ix->first].cCtermMod].dVarModMass;
+            piVarModSites[iLenPeptide + 1] = g_pFragmentPeptides[ix->first].cCtermMod + 1;
+            dYion += g_staticParams.variableModParameters.varModList[g_pFragmentPeptides[ix->first].cCtermMod].dVarModMass;
             iFoundVariableMod = 1;
          }
 
@@ -1845,8 +2994,8 @@ void CometSearch::SearchFragmentIndex(Query* pQuery,
 
          struct sDBEntry dbe;
 
-         char cPrevAA = g_vRawPeptides.at(g_vFragmentPeptides[ix->first].iWhichPeptide).cPrevAA;
-         char cNextAA = g_vRawPeptides.at(g_vFragmentPeptides[ix->first].iWhichPeptide).cNextAA;
+         char cPrevAA = CometFragmentIndex::RawPeptidePrevAA(g_pFragmentPeptides[ix->first].iWhichPeptide);
+         char cNextAA = CometFragmentIndex::RawPeptideNextAA(g_pFragmentPeptides[ix->first].iWhichPeptide);
          char szProtein[MAX_PEPTIDE_LEN_P2];
          if (cPrevAA == '-')
          {
@@ -1875,7 +3024,7 @@ void CometSearch::SearchFragmentIndex(Query* pQuery,
 
          dbe.strName = "";
          dbe.strSeq = szProtein;
-         dbe.lProteinFilePosition = g_vRawPeptides.at(g_vFragmentPeptides[ix->first].iWhichPeptide).lIndexProteinFilePosition;
+         dbe.lProteinFilePosition = CometFragmentIndex::RawPeptideProteinList(g_pFragmentPeptides[ix->first].iWhichPeptide);
 
          XcorrScoreI(szProtein, iStartPos, iEndPos, iFoundVariableMod, dCalcPepMass, false, pQuery,
             iLenPeptide, piVarModSites, &dbe, uiBinnedIonMasses, uiBinnedPrecursorNL, ix->second);
@@ -1941,6 +3090,60 @@ bool CometSearch::SearchPeptideIndex(ThreadPool* tp)
       }
    }
 
+   // v2 index files are mapped once and searched in place; only the records
+   // within this batch's mass range are touched
+   if (CometPeptideIndex::IndexFormat() >= 2)
+   {
+      std::fclose(fp);
+
+      if (!g_bPeptideIndexRead)
+      {
+         if (!CometPeptideIndex::ReadPeptideIndex(false))
+            return false;
+
+         // for the first RTS query, set clock start now to skip time reading index
+         g_staticParams.tRealTimeStart = std::chrono::high_resolution_clock::now();
+      }
+
+      struct DBIndex sDBI;
+      sDBEntry dbe;
+      size_t tNumPeptides = CometPeptideIndex::NumPeptides();
+
+      for (size_t i = CometPeptideIndex::FirstPeptide(g_massRange.dMinMass); i < tNumPeptides; ++i)
+      {
+         double dPepMass = CometPeptideIndex::PeptideMass(i);
+
+         if (dPepMass > g_massRange.dMaxMass)
+            break;
+
+         MassMatchCursor matchCursor;
+         int iWhichQuery = FirstMassMatch(dPepMass, 0, &matchCursor);
+
+         // Do the search; the peptide is only decoded when some query matches its mass
+         if (iWhichQuery != -1)
+         {
+            CometPeptideIndex::GetPeptide(i, sDBI);
+
+            // only use of dbe here is to store the protein position; used for backwards
+            // compatibility with standard search in StorePeptide
+            dbe.lProteinFilePosition = sDBI.lIndexProteinFilePosition;
+            AnalyzePeptideIndex(iWhichQuery, sDBI, _ppbDuplFragmentArr[0], &dbe);
+         }
+
+         if (g_staticParams.options.iMaxIndexRunTime > 0)
+         {
+            // now check search run time
+            std::chrono::high_resolution_clock::time_point tNow = std::chrono::high_resolution_clock::now();
+            auto tElapsedTime = std::chrono::duration_cast<chrono::milliseconds>(tNow - g_staticParams.tRealTimeStart).count();
+            if (tElapsedTime >= g_staticParams.options.iMaxIndexRunTime)
+               break;
+         }
+      }
+
+      return true;
+   }
+
+   // legacy index files:  stream the variable length entries from disk
    // read fp of index
    comet_fileoffset_t clTmp;
    comet_fileoffset_t clProteinsFilePos;
@@ -2071,10 +3274,8 @@ bool CometSearch::SearchPeptideIndex(ThreadPool* tp)
       if (sDBI.dPepMass > g_massRange.dMaxMass)
          break;
 
-      int iWhichQuery = BinarySearchMass(0, (int)g_pvQuery.size(), sDBI.dPepMass);
-
-      while (iWhichQuery > 0 && g_pvQuery.at(iWhichQuery)->_pepMassInfo.dPeptideMassTolerancePlus >= sDBI.dPepMass)
-         iWhichQuery--;
+      MassMatchCursor matchCursor;
+      int iWhichQuery = FirstMassMatch(sDBI.dPepMass, 0, &matchCursor);
 
       // Do the search
       if (iWhichQuery != -1)
@@ -2126,44 +3327,37 @@ bool CometSearch::SearchPeptideIndex(ThreadPool* tp)
 
 
 // Thread-local overload: searches a caller-owned Query* against the
-// read-only g_pvDBIndex.  Does not access g_pvQuery.
+// read-only peptide index records.  Does not access g_pvQuery.
 // pbDuplFragment is a thread-local scratch buffer of size g_staticParams.iArraySizeGlobal.
 void CometSearch::SearchPeptideIndex(Query* pQuery,
                                      bool* pbDuplFragment)
 {
-   if (!g_bPeptideIndexRead || g_pvDBIndex.empty())
+   if (!g_bPeptideIndexRead || CometPeptideIndex::NumPeptides() == 0)
       return;
 
    double dMassTolLow = pQuery->_pepMassInfo.dPeptideMassToleranceMinus;
    double dMassTolHigh = pQuery->_pepMassInfo.dPeptideMassTolerancePlus;
 
-   // Binary search: find first entry with dPepMass >= dMassTolLow
-   size_t iStart = 0;
-   size_t iEnd = g_pvDBIndex.size();
-
-   while (iStart < iEnd)
-   {
-      size_t iMid = iStart + (iEnd - iStart) / 2;
-      if (g_pvDBIndex[iMid].dPepMass < dMassTolLow)
-         iStart = iMid + 1;
-      else
-         iEnd = iMid;
-   }
+   size_t tNumPeptides = CometPeptideIndex::NumPeptides();
 
+   struct DBIndex sDBI;
    struct sDBEntry dbe;
 
    // Iterate through candidates within mass tolerance
-   for (size_t i = iStart; i < g_pvDBIndex.size(); ++i)
+   for (size_t i = CometPeptideIndex::FirstPeptide(dMassTolLow); i < tNumPeptides; ++i)
    {
-      if (g_pvDBIndex[i].dPepMass > dMassTolHigh)
+      double dPepMass = CometPeptideIndex::PeptideMass(i);
+
+      if (dPepMass > dMassTolHigh)
          break;
 
       // Verify mass match (handles isotope offsets)
-      if (!CheckMassMatch(pQuery, g_pvDBIndex[i].dPepMass))
+      if (!CheckMassMatch(pQuery, dPepMass))
          continue;
 
-      dbe.lProteinFilePosition = g_pvDBIndex[i].lIndexProteinFilePosition;
-      AnalyzePeptideIndex(pQuery, g_pvDBIndex[i], pbDuplFragment, &dbe);
+      CometPeptideIndex::GetPeptide(i, sDBI);
+      dbe.lProteinFilePosition = sDBI.lIndexProteinFilePosition;
+      AnalyzePeptideIndex(pQuery, sDBI, pbDuplFragment, &dbe);
 
       if (g_staticParams.options.iMaxIndexRunTime > 0)
       {
@@ -2179,7 +3373,7 @@ void CometSearch::SearchPeptideIndex(Query* pQuery,
 // Thread-local overload of AnalyzePeptideIndex: scores a single peptide index
 // entry against a caller-owned Query*. Does not access g_pvQuery.
 void CometSearch::AnalyzePeptideIndex(Query* pQuery,
-                                      DBIndex sDBI,
+                                      const DBIndex& sDBI,
                                       bool* pbDuplFragment,
                                       struct sDBEntry* dbe)
 {
@@ -2732,7 +3926,7 @@ void CometSearch::AnalyzePeptideIndex(Query* pQuery,
 
 
 void CometSearch::AnalyzePeptideIndex(int iWhichQuery,
-                                      DBIndex sDBI,
+                                      const DBIndex& sDBI,
                                       bool* pbDuplFragment,
                                       struct sDBEntry* dbe)
 {
@@ -2743,7 +3937,6 @@ void CometSearch::AnalyzePeptideIndex(int iWhichQuery,
    int iLenPeptide = (int)sDBI.sPeptide.size();
    int iStartPos = 0;
    int iEndPos = iLenPeptide - 1;
-   int iUnused = 0;
    bool bFirstTimeThroughLoopForPeptide = true;
 
    int iFoundVariableMod = 0;   // 1 = variable mod, 2 = with fragment NL
@@ -2796,18 +3989,15 @@ void CometSearch::AnalyzePeptideIndex(int iWhichQuery,
    }
 
    // Compare calculated fragment ions against all matching query spectra.
-   while (iWhichQuery < (int)g_pvQuery.size())
-   {
-      if (sDBI.dPepMass < g_pvQuery.at(iWhichQuery)->_pepMassInfo.dPeptideMassToleranceMinus)
-      {
-         // If calculated mass is smaller than low mass range.
-         break;
-      }
+   MassMatchCursor matchCursor;
 
+   iWhichQuery = FirstMassMatch(sDBI.dPepMass, iWhichQuery, &matchCursor);
+   while (iWhichQuery != -1)
+   {
       // Mass tolerance check for particular query against this candidate peptide mass.
       if (CheckMassMatch(iWhichQuery, sDBI.dPepMass))
       {
-         char szDecoyPeptide[MAX_PEPTIDE_LEN];
+         char szDecoyPeptide[MAX_PEPTIDE_LEN_P2];  // Allow for prev/next AA in string.
          int piVarModSites[MAX_PEPTIDE_LEN_P2];  // forward mods, generated from sDBI.sVarModSites
          int piVarModSitesDecoy[MAX_PEPTIDE_LEN_P2];
 
@@ -2830,14 +4020,11 @@ void CometSearch::AnalyzePeptideIndex(int iWhichQuery,
             double dBion = g_staticParams.precalcMasses.dNtermProton;
             double dYion = g_staticParams.precalcMasses.dCtermOH2Proton;
 
-            if (g_staticParams.iDbType == DbType::PI_DB)
-            {
-               // Protein n-term / c-term static mod adjustments
-               if (sDBI.cPrevAA == '-')
-                  dBion += g_staticParams.staticModifications.dAddNterminusProtein;
-               if (sDBI.cNextAA == '-')
-                  dYion += g_staticParams.staticModifications.dAddCterminusProtein;
-            }
+            // Protein n-term / c-term static mod adjustments
+            if (sDBI.cPrevAA == '-')
+               dBion += g_staticParams.staticModifications.dAddNterminusProtein;
+            if (sDBI.cNextAA == '-')
+               dYion += g_staticParams.staticModifications.dAddCterminusProtein;
 
             // variable N-term peptide mod
             if (piVarModSites[iLenPeptide] > 0)
@@ -2879,6 +4066,7 @@ void CometSearch::AnalyzePeptideIndex(int iWhichQuery,
 
             // Now get the set of binned fragment ions once to compare this peptide against all matching spectra.
             // First initialize pbDuplFragment and _uiBinnedIonMasses
+            _bXcorrBinListStale[0] = true;
             for (ctCharge = 1; ctCharge <= g_massRange.usiMaxFragmentCharge; ctCharge++)
             {
                for (ctIonSeries = 0; ctIonSeries < g_staticParams.ionInformation.iNumIonSeriesUsed; ctIonSeries++)
@@ -3023,17 +4211,23 @@ void CometSearch::AnalyzePeptideIndex(int iWhichQuery,
 
             if (g_staticParams.options.iDecoySearch)
             {
+               // Keep prev and next AA in szDecoyPeptide so the reversed peptide
+               // is at positions 1 to iLenPeptide, as in the protein search.
+               szDecoyPeptide[0] = sDBI.cPrevAA;
+               szDecoyPeptide[iLenPeptide + 1] = sDBI.cNextAA;
+               szDecoyPeptide[iLenPeptide + 2] = '\0';
+
                if (g_staticParams.enzymeInformation.iSearchEnzymeOffSet == 1)
                {
                   // last residue stays the same:  change ABCDEK to EDCBAK
 
                   for (i = iEndPos - 1; i >= iStartPos; i--)
                   {
-                     szDecoyPeptide[iEndPos - i - 1] = sDBI.sPeptide[i - iStartPos];
+                     szDecoyPeptide[iEndPos - i] = sDBI.sPeptide[i - iStartPos];
                      piVarModSitesDecoy[iEndPos - i - 1] = piVarModSites[i - iStartPos];
                   }
 
-                  szDecoyPeptide[iEndPos] = sDBI.sPeptide[iEndPos];  // last residue stays same
+                  szDecoyPeptide[iEndPos + 1] = sDBI.sPeptide[iEndPos];  // last residue stays same
                   piVarModSitesDecoy[iLenPeptide - 1] = piVarModSites[iLenPeptide - 1];
                }
                else
@@ -3042,14 +4236,13 @@ void CometSearch::AnalyzePeptideIndex(int iWhichQuery,
 
                   for (i = iEndPos; i > iStartPos; i--)
                   {
-                     szDecoyPeptide[iEndPos - i + 1] = sDBI.sPeptide[i - iStartPos];
+                     szDecoyPeptide[iEndPos - i + 2] = sDBI.sPeptide[i - iStartPos];
                      piVarModSitesDecoy[iEndPos - i + 1] = piVarModSites[i - iStartPos];
                   }
 
-                  szDecoyPeptide[iStartPos] = sDBI.sPeptide[iStartPos];  // first residue stays same
+                  szDecoyPeptide[iStartPos + 1] = sDBI.sPeptide[iStartPos];  // first residue stays same
                   piVarModSitesDecoy[iStartPos] = piVarModSites[iStartPos];
                }
-               szDecoyPeptide[iEndPos - iStartPos + 1] = '\0';
 
                piVarModSitesDecoy[iLenPeptide] = piVarModSites[iLenPeptide];      // N-term
                piVarModSitesDecoy[iLenPeptide + 1] = piVarModSites[iLenPeptide + 1];  // C-term
@@ -3058,13 +4251,11 @@ void CometSearch::AnalyzePeptideIndex(int iWhichQuery,
                dBion = g_staticParams.precalcMasses.dNtermProton;
                dYion = g_staticParams.precalcMasses.dCtermOH2Proton;
 
-               /* n/c-term protein mods not supported
-                              // use same protein terminal static mods as target peptide
-                              if (_varModInfo.iStartPos == 0)
-                                 dBion += g_staticParams.staticModifications.dAddNterminusProtein;
-                              if (_varModInfo.iEndPos == iLenProteinMinus1)
-                                 dYion += g_staticParams.staticModifications.dAddCterminusProtein;
-               */
+               // use same protein terminal static mods as target peptide
+               if (sDBI.cPrevAA == '-')
+                  dBion += g_staticParams.staticModifications.dAddNterminusProtein;
+               if (sDBI.cNextAA == '-')
+                  dYion += g_staticParams.staticModifications.dAddCterminusProtein;
 
                // variable N-term
                if (piVarModSitesDecoy[iLenPeptide] > 0)
@@ -3074,8 +4265,8 @@ void CometSearch::AnalyzePeptideIndex(int iWhichQuery,
                if (piVarModSitesDecoy[iLenPeptide + 1] > 0)
                   dYion += g_staticParams.variableModParameters.varModList[piVarModSitesDecoy[iLenPeptide + 1] - 1].dVarModMass;
 
-               int iDecoyStartPos = iStartPos;
-               int iDecoyEndPos = iEndPos;
+               int iDecoyStartPos = 1;
+               int iDecoyEndPos = iLenPeptide;
 
                // Generate pdAAforward for szDecoyPeptide
                for (i = iDecoyStartPos; i < iDecoyEndPos; i++)
@@ -3091,9 +4282,9 @@ void CometSearch::AnalyzePeptideIndex(int iWhichQuery,
                   }
 
                   dYion += g_staticParams.massUtility.pdAAMassFragment[(int)szDecoyPeptide[iPos2]];
-                  if (piVarModSitesDecoy[iPos2] > 0)
+                  if (piVarModSitesDecoy[iPos2 - iDecoyStartPos] > 0)
                   {
-                     dYion += g_staticParams.variableModParameters.varModList[piVarModSitesDecoy[iPos2] - 1].dVarModMass;
+                     dYion += g_staticParams.variableModParameters.varModList[piVarModSitesDecoy[iPos2 - iDecoyStartPos] - 1].dVarModMass;
                      iFoundVariableModDecoy = 1;
                   }
 
@@ -3103,6 +4294,7 @@ void CometSearch::AnalyzePeptideIndex(int iWhichQuery,
 
                // Now get the set of binned fragment ions once to compare this peptide against all matching spectra.
                // First initialize pbDuplFragment and _uiBinnedIonMassesDecoy
+               _bXcorrBinListStale[1] = true;
                for (ctCharge = 1; ctCharge <= g_massRange.usiMaxFragmentCharge; ctCharge++)
                {
                   for (ctIonSeries = 0; ctIonSeries < g_staticParams.ionInformation.iNumIonSeriesUsed; ctIonSeries++)
@@ -3260,30 +4452,28 @@ void CometSearch::AnalyzePeptideIndex(int iWhichQuery,
             snprintf(szProtein, sizeof(szProtein), "%c%s", cPrevAA, sDBI.sPeptide.c_str());
          }
 
-         if (cNextAA == '-')
-         {
-            iEndPos = strlen(szProtein) - 1;
-         }
-         else
+         iEndPos = iStartPos + iLenPeptide - 1;
+
+         if (cNextAA != '-')
          {
-            snprintf(szProtein, sizeof(szProtein), "%s%c", szProtein, cNextAA);
-            iEndPos = strlen(szProtein) - 2;
+            szProtein[iEndPos + 1] = cNextAA;
+            szProtein[iEndPos + 2] = '\0';
          }
 
          _proteinInfo.iTmpProteinSeqLength = (int)strlen(szProtein);
 
-         XcorrScore(szProtein, iUnused, iUnused, iStartPos, iEndPos, iFoundVariableMod,
+         XcorrScore(szProtein, iStartPos, iEndPos, iStartPos, iEndPos, iFoundVariableMod,
             sDBI.dPepMass, false, iWhichQuery, iLenPeptide, piVarModSites, dbe);
 
          if (g_staticParams.options.iDecoySearch)
          {
-            iStartPos = 0;
-            iEndPos = iLenPeptide - 1;
-            XcorrScore(szDecoyPeptide, iUnused, iUnused, iStartPos, iEndPos, iFoundVariableModDecoy,
+            _proteinInfo.iTmpProteinSeqLength = iLenPeptide + 2;  // flanking residues are part of szDecoyPeptide
+
+            XcorrScore(szDecoyPeptide, 1, iLenPeptide, 1, iLenPeptide, iFoundVariableModDecoy,
                sDBI.dPepMass, true, iWhichQuery, iLenPeptide, piVarModSitesDecoy, dbe);
          }
       }
-      iWhichQuery++;
+      iWhichQuery = NextMassMatch(sDBI.dPepMass, &matchCursor);
    }
 }
 
@@ -3341,7 +4531,7 @@ void CometSearch::SearchMS1Library(size_t iWhichMS1Query,
 // iNtermPeptideOnly==1 specifies clipped methionine sequence
 // iNtermPeptideOnly==2 specifies clipped methionine sequence due to the
 //                      PEFF variant becoming the clipped methionine
-bool CometSearch::SearchForPeptides(struct sDBEntry dbe,
+bool CometSearch::SearchForPeptides(struct sDBEntry& dbe,
                                     char* szProteinSeq,
                                     int iNtermPeptideOnly,
                                     bool* pbDuplFragment)
@@ -3382,15 +4572,6 @@ bool CometSearch::SearchForPeptides(struct sDBEntry dbe,
 
    int iFirstResiduePosition = 0;
 
-   if (dbe.vectorPeffMod.size() > 0) // sort vectorPeffMod by iPosition
-      sort(dbe.vectorPeffMod.begin(), dbe.vectorPeffMod.end());
-
-   if (dbe.vectorPeffVariantSimple.size() > 0) // sort peffVariantSimpleStruct by iPosition
-      sort(dbe.vectorPeffVariantSimple.begin(), dbe.vectorPeffVariantSimple.end());
-
-   if (dbe.vectorPeffVariantComplex.size() > 0) // sort peffVariantComplexStruct by iPositionA
-      sort(dbe.vectorPeffVariantComplex.begin(), dbe.vectorPeffVariantComplex.end());
-
    memset(piVarModCounts, 0, sizeof(piVarModCounts));
 
    unsigned short siVarModProteinFilter = 0;  // bitwise representation of mmapProtein, all bits set to "0" initially
@@ -3550,6 +4731,8 @@ bool CometSearch::SearchForPeptides(struct sDBEntry dbe,
                sEntry.cPrevAA = (iStartPos == iFirstResiduePosition) ? '-' : szProteinSeq[iStartPos - 1];
                sEntry.cNextAA = (iEndPos == iProteinSeqLengthMinus1) ? '-' : szProteinSeq[iEndPos + 1] ;
                sEntry.siVarModProteinFilter = siVarModProteinFilter;
+               sEntry.bClippedM = _proteinInfo.bClippedNtermMet;
+               sEntry.iStartResidue = iStartPos;
 
                // little sanity check here to not include peptides with '*' in them
                // although mass check above should've caught these before
@@ -3563,7 +4746,7 @@ bool CometSearch::SearchForPeptides(struct sDBEntry dbe,
                   {
                      try
                      {
-                        g_pvDBIndex.push_back(sEntry);
+                        g_pvDBIndex.push_back(std::move(sEntry));
                      }
                      catch (const std::bad_alloc& e)
                      {
@@ -3715,14 +4898,11 @@ bool CometSearch::SearchForPeptides(struct sDBEntry dbe,
                bool bFirstTimeThroughLoopForPeptide = true;
 
                // Compare calculated fragment ions against all matching query spectra.
-               while (iWhichQuery < (int)g_pvQuery.size())
-               {
-                  if (dCalcPepMass < g_pvQuery.at(iWhichQuery)->_pepMassInfo.dPeptideMassToleranceMinus)
-                  {
-                     // If calculated mass is smaller than low mass range.
-                     break;
-                  }
+               MassMatchCursor matchCursor;
 
+               iWhichQuery = FirstMassMatch(dCalcPepMass, iWhichQuery, &matchCursor);
+               while (iWhichQuery != -1)
+               {
                   // Mass tolerance check for particular query against this candidate peptide mass.
                   if (CheckMassMatch(iWhichQuery, dCalcPepMass))
                   {
@@ -3761,6 +4941,7 @@ bool CometSearch::SearchForPeptides(struct sDBEntry dbe,
 
                         // Now get the set of binned fragment ions once to compare this peptide against all matching spectra.
                         // First initialize pbDuplFragment and _uiBinnedIonMasses
+                        _bXcorrBinListStale[0] = true;
                         for (ctCharge = 1; ctCharge <= g_massRange.usiMaxFragmentCharge; ++ctCharge)
                         {
                            for (ctIonSeries = 0; ctIonSeries < g_staticParams.ionInformation.iNumIonSeriesUsed; ++ctIonSeries)
@@ -3915,6 +5096,7 @@ bool CometSearch::SearchForPeptides(struct sDBEntry dbe,
 
                         // Now get the set of binned fragment ions once for all matching decoy peptides
                         // First initialize pbDuplFragment and _uiBinnedIonMassesDecoy
+                        _bXcorrBinListStale[1] = true;
                         for (ctCharge = 1; ctCharge <= g_massRange.usiMaxFragmentCharge; ++ctCharge)
                         {
                            for (ctIonSeries = 0; ctIonSeries < g_staticParams.ionInformation.iNumIonSeriesUsed; ++ctIonSeries)
@@ -3994,7 +5176,7 @@ bool CometSearch::SearchForPeptides(struct sDBEntry dbe,
                            dCalcPepMass, true, iWhichQuery, iLenPeptide, piVarModSites, &dbe);
                      }
                   }
-                  iWhichQuery++;
+                  iWhichQuery = NextMassMatch(dCalcPepMass, &matchCursor);
                }
             }
          }
@@ -4124,7 +5306,7 @@ bool CometSearch::SearchForPeptides(struct sDBEntry dbe,
 // Analyze regions of the sequence that are affected by the variant
 // Each analyzed peptide must either contain the variant or be flanked
 // by the variant enabling new enzyme-digested peptide
-void CometSearch::SearchForVariants(struct sDBEntry dbe,
+void CometSearch::SearchForVariants(struct sDBEntry& dbe,
                                     char* szProteinSeq,
                                     bool* pbDuplFragment)
 {
@@ -4287,20 +5469,10 @@ int CometSearch::WithinMassTolerance(double dCalcPepMass,
       }
 
       // Now that we know it's within the global mass range of our queries and has
-      // proper enzyme termini, check if within mass tolerance of any given entry.
-
-      // Do a binary search on list of input queries to find matching mass.
-      int iPos = BinarySearchMass(0, (int)g_pvQuery.size(), dCalcPepMass);
+      // proper enzyme termini, return the first query whose mass tolerance it may match.
+      MassMatchCursor matchCursor;
 
-      // Seek back to first peptide entry that matches mass tolerance in case binary
-      // search doesn't hit the first entry.
-      while (iPos > 0 && g_pvQuery.at(iPos)->_pepMassInfo.dPeptideMassTolerancePlus >= dCalcPepMass)
-         iPos--;
-
-      if (iPos != -1)
-         return iPos;
-      else
-         return -1;
+      return FirstMassMatch(dCalcPepMass, 0, &matchCursor);
    }
    else
       return -1;
@@ -4351,15 +5523,7 @@ bool CometSearch::WithinMassTolerancePeff(double dCalcPepMass,
             // At this stage here, just need to see if any PEFF mod addition is within mass tolerance
             // of any entry.  If so, simply return true here and will repeat the PEFF permutations later.
 
-            // Do a binary search on list of input queries to find matching mass.
-            int iPos = BinarySearchMass(0, (int)g_pvQuery.size(), dCalcPepMass + dMassAddition);
-
-            // Seek back to first peptide entry that matches mass tolerance in case binary
-            // search doesn't hit the first entry.
-            while (iPos > 0 && g_pvQuery.at(iPos)->_pepMassInfo.dPeptideMassTolerancePlus >= dCalcPepMass)
-               iPos--;
-
-            if (iPos != -1)
+            if (FirstCheckedMassMatch(dCalcPepMass + dMassAddition) != -1)
                return true;
          }
       }
@@ -4555,235 +5719,310 @@ int CometSearch::BinarySearchPeffStrMod(int start,
 }
 
 
-// Performance: Use std::lower_bound for binary search
-int CometSearch::BinarySearchMass(int start,
-                                  int end,
-                                  double dCalcPepMass) const
+// Isotope offsets added to a candidate peptide mass by CheckMassMatch() for
+// isotope_error; returns how many were written to pdIsotopes, 0 if isotope_error
+// is not a known setting.
+//
+//   isotope 0 = 0
+//   isotope 1 = 0,1
+//   isotope 2 = 0,1,2
+//   isotope 3 = 0,1,2,3
+//   isotope 4 = -1,0,1,2,3
+//   isotope 5 = -1,0,1
+//   isotope 6 = -3,-2,-1,0,1,2,3
+//   isotope 7 = -8,-4,0,4,8
+int CometSearch::PrecursorIsotopeShifts(double* pdIsotopes)
 {
-   auto it = std::lower_bound(
-      g_pvQuery.begin() + start,
-      g_pvQuery.begin() + end,
-      dCalcPepMass,
-      [](const Query* query, double mass) {
-         return query->_pepMassInfo.dPeptideMassTolerancePlus < mass;
-      });
+   int iIsotopeError = g_staticParams.tolerances.iIsotopeError;
+   int iNumIsotopes = 0;
+
+   if (iIsotopeError >= 0 && iIsotopeError <= 6)
+   {
+      // first handle larger C13 isotopes
+      int iMaxIsotope = 3;
+      if (iIsotopeError < 3)
+         iMaxIsotope = iIsotopeError;
+
+      if (iIsotopeError == 5)
+         iMaxIsotope = 1;
 
-   if (it != g_pvQuery.begin() + end
-      && (*it)->_pepMassInfo.dPeptideMassToleranceMinus <= dCalcPepMass
-      && dCalcPepMass <= (*it)->_pepMassInfo.dPeptideMassTolerancePlus)
+      for (int x = 0; x <= iMaxIsotope; ++x)
+         pdIsotopes[iNumIsotopes++] = x * C13_DIFF;
+
+      // now consider negative C13 isotopes aka triggered peak is less than real peak
+      if (iIsotopeError >= 4)
+      {
+         iMaxIsotope = (iIsotopeError == 6 ? 3 : 1);
+
+         for (int x = 1; x <= iMaxIsotope; ++x)
+            pdIsotopes[iNumIsotopes++] = -(x * C13_DIFF);
+      }
+   }
+   else if (iIsotopeError == 7)
    {
-      return static_cast<int>(std::distance(g_pvQuery.begin(), it));
+      for (int x = -2; x <= 2; ++x)
+         pdIsotopes[iNumIsotopes++] = x * 4.0070995;
    }
 
-   return -1;
+   return iNumIsotopes;
 }
 
 
-size_t CometSearch::BinarySearchIndexMass(size_t start,
-                                          size_t end,
-                                          double dQueryMass,
-                                          unsigned int* uiFragmentMass)
+// Builds the precursor bucket table for the current (sorted) g_pvQuery.
+//
+// Candidate peptide masses between _dPrecursorBucketLow and the last query window are
+// split into bins of equal width.  Each query is listed in every bin that overlaps one
+// of its acceptance windows: Minus..Plus when there are no isotope errors or mass
+// offsets, otherwise each Low..High window shifted by the offsets and isotopes that
+// CheckMassMatch() tests.  Queries are listed in ascending order within a bin so the
+// lookups visit them in g_pvQuery order.
+//
+// Unlike the old scan through g_pvQuery, which stopped at the first query whose window
+// started above the candidate mass, the table finds every matching query even when the
+// windows are not ordered like the queries (m/z tolerances scale with the charge).
+void CometSearch::BuildPrecursorBuckets()
 {
-   // dQueryMass is the lower bound tolerance mass of input spectrum.
+   _vPrecursorBuckets.clear();
+   _vtPrecursorBucketStart.assign(1, 0);  // no bins; every lookup misses
+   _dPrecursorBucketLow = 0.0;
+   _dPrecursorBucketInvWidth = 0.0;
 
-   // Termination condition: start index greater than end index.
-   if (start >= end || end <= BINARYSEARCHCUTOFF)
+   if (g_pvQuery.empty())
+      return;
+
+   // Mass added to a candidate peptide before it is compared against a query's Low..High window.
+   vector<double> vdShifts;
+   if (g_staticParams.tolerances.iIsotopeError != 0 || !g_staticParams.vectorMassOffsets.empty())
    {
-      return start;
+      double pdIsotopes[MAX_ISOTOPE_SHIFTS];
+      int iNumIsotopes = PrecursorIsotopeShifts(pdIsotopes);
+
+      if (g_staticParams.vectorMassOffsets.empty())
+         vdShifts.assign(pdIsotopes, pdIsotopes + iNumIsotopes);
+      else
+      {
+         for (double dOffset : g_staticParams.vectorMassOffsets)
+         {
+            for (int x = 0; x < iNumIsotopes; ++x)
+               vdShifts.push_back(dOffset + pdIsotopes[x]);
+         }
+      }
    }
+   // Candidate mass ranges accepted by each query, sorted by low end within a query.
+   // The windows are widened by FLOAT_ZERO as they are only used to pick bins;
+   // every lookup still applies the exact test.
+   vector<pair<double, double>> vRanges;
+   vector<size_t> vtRangeStart(g_pvQuery.size() + 1, 0);
+   double dLow = DBL_MAX;
+   double dHigh = -DBL_MAX;
+   double dTotalWidth = 0.0;
 
-   // Find the middle element of the vector and use that for splitting
-   // the array into two pieces.
-   size_t middle = start + ((end - start) / 2);
+   for (size_t i = 0; i < g_pvQuery.size(); ++i)
+   {
+      const PepMassInfo& pepMassInfo = g_pvQuery.at(i)->_pepMassInfo;
 
-   unsigned int uiBinBase = g_iFragmentIndexOffset[*uiFragmentMass];
-   double dArrayMass = g_vFragmentPeptides[g_iFragmentIndex[uiBinBase + middle]].dPepMass;
+      vtRangeStart[i] = vRanges.size();
 
-   if (dArrayMass > dQueryMass)
-   {
-      return BinarySearchIndexMass(start, middle - 1, dQueryMass, uiFragmentMass);
+      if (vdShifts.empty())
+         vRanges.push_back(make_pair(pepMassInfo.dPeptideMassToleranceMinus, pepMassInfo.dPeptideMassTolerancePlus));
+      else
+      {
+         for (double dShift : vdShifts)
+         {
+            double dRangeLow = std::max(pepMassInfo.dPeptideMassToleranceMinus, pepMassInfo.dPeptideMassToleranceLow - dShift - FLOAT_ZERO);
+            double dRangeHigh = std::min(pepMassInfo.dPeptideMassTolerancePlus, pepMassInfo.dPeptideMassToleranceHigh - dShift + FLOAT_ZERO);
+
+            if (dRangeLow <= dRangeHigh)
+               vRanges.push_back(make_pair(dRangeLow, dRangeHigh));
+         }
+
+         std::sort(vRanges.begin() + vtRangeStart[i], vRanges.end());
+      }
+
+      for (size_t ii = vtRangeStart[i]; ii < vRanges.size(); ++ii)
+      {
+         dLow = std::min(dLow, vRanges[ii].first);
+         dHigh = std::max(dHigh, vRanges[ii].second);
+         dTotalWidth += vRanges[ii].second - vRanges[ii].first;
+      }
    }
-   else if (dArrayMass < dQueryMass)
+   vtRangeStart[g_pvQuery.size()] = vRanges.size();
+
+   if (vRanges.empty())
+      return;
+
+   // Bins are as wide as an average window so a lookup sees few queries that miss,
+   // but never so narrow that the table exceeds PRECURSOR_BUCKETS_MAX bins.
+   double dWidth = std::max(dTotalWidth / vRanges.size(), (dHigh - dLow) / PRECURSOR_BUCKETS_MAX);
+   if (dWidth < FLOAT_ZERO)
+      dWidth = FLOAT_ZERO;
+
+   _dPrecursorBucketLow = dLow;
+   _dPrecursorBucketInvWidth = 1.0 / dWidth;
+
+   size_t tNumBins = (size_t)((dHigh - dLow) * _dPrecursorBucketInvWidth) + 1;
+
+   auto binOf = [&](double dMass) -> size_t
    {
-      return BinarySearchIndexMass(middle + 1, end, dQueryMass, uiFragmentMass);
-   }
-   else // this means (dArrayMass >= dQueryMass && dArrayMass <= dQueryMass)
+      double dBin = (dMass - _dPrecursorBucketLow) * _dPrecursorBucketInvWidth;
+      if (dBin <= 0.0)
+         return 0;
+      return std::min((size_t)dBin, tNumBins - 1);
+   };
+
+   // Bins of each query, in query order; a query is listed once per bin even
+   // when several of its windows overlap that bin.
+   vector<pair<unsigned int, int>> vBinQuery;
+   for (size_t i = 0; i < g_pvQuery.size(); ++i)
    {
-      // always walk backwards now until ArrayMass is < dQueryMass
-      // as there may be multiple entries in the mass vector with the same ArrayMass so
-      // need to start at the first one (or the entry before the first one)
-      while (middle > 0 && g_vFragmentPeptides[g_iFragmentIndex[uiBinBase + middle]].dPepMass >= dQueryMass)
+      size_t tNextBin = 0;
+
+      for (size_t ii = vtRangeStart[i]; ii < vtRangeStart[i + 1]; ++ii)
       {
-         middle--;
+         size_t tBin = std::max(binOf(vRanges[ii].first), tNextBin);
+         size_t tLastBin = binOf(vRanges[ii].second);
+
+         for (; tBin <= tLastBin; ++tBin)
+            vBinQuery.push_back(make_pair((unsigned int)tBin, (int)i));
+
+         tNextBin = std::max(tNextBin, tLastBin + 1);
       }
+   }
 
-      return middle;
+   // Counting sort by bin keeps queries in ascending order within each bin.
+   _vtPrecursorBucketStart.assign(tNumBins + 1, 0);
+   for (const auto& binQuery : vBinQuery)
+      _vtPrecursorBucketStart[binQuery.first + 1]++;
+   for (size_t i = 0; i < tNumBins; ++i)
+      _vtPrecursorBucketStart[i + 1] += _vtPrecursorBucketStart[i];
+
+   vector<size_t> vtFill(_vtPrecursorBucketStart.begin(), _vtPrecursorBucketStart.end() - 1);
+   _vPrecursorBuckets.resize(vBinQuery.size());
+   for (const auto& binQuery : vBinQuery)
+   {
+      const PepMassInfo& pepMassInfo = g_pvQuery.at(binQuery.second)->_pepMassInfo;
+      PrecursorBucketEntry& entry = _vPrecursorBuckets[vtFill[binQuery.first]++];
+
+      entry.dMinus = pepMassInfo.dPeptideMassToleranceMinus;
+      entry.dPlus = pepMassInfo.dPeptideMassTolerancePlus;
+      entry.iWhichQuery = binQuery.second;
    }
 }
 
 
-bool CometSearch::CheckMassMatch(size_t iWhichQuery,
-                                 double dCalcPepMass)
+// Returns the first query at or after iFromQuery whose Minus..Plus window holds
+// dCalcPepMass, or -1.  Callers still apply CheckMassMatch().  pCursor is set up
+// for NextMassMatch().
+int CometSearch::FirstMassMatch(double dCalcPepMass,
+                                int iFromQuery,
+                                MassMatchCursor* pCursor)
 {
-   Query* pQuery = g_pvQuery.at(iWhichQuery);
+   double dBin = (dCalcPepMass - _dPrecursorBucketLow) * _dPrecursorBucketInvWidth;
+   size_t tNumBins = _vtPrecursorBucketStart.size() - 1;
 
-   int iMassOffsetsSize = (int)g_staticParams.vectorMassOffsets.size();
-
-   // this first check sees if calculated pepmass is within the low/high mass
-   // range (including isotope offsets) of query.
-   if ((dCalcPepMass >= pQuery->_pepMassInfo.dPeptideMassToleranceMinus)
-      && (dCalcPepMass <= pQuery->_pepMassInfo.dPeptideMassTolerancePlus))
+   if (!(dBin >= 0.0) || dBin >= (double)tNumBins)
    {
-      if (g_staticParams.tolerances.iIsotopeError == 0 && iMassOffsetsSize == 0)
-         return true;
-      else if (iMassOffsetsSize > 0)
-      {
-         // need to account for both mass offsets and possible isotope offsets
+      pCursor->tEntry = pCursor->tEnd = 0;
+      return -1;
+   }
 
-         // isotope 0 = 0
-         // isotope 1 = 0,1
-         // isotope 2 = 0,1,2
-         // isotope 3 = 0,1,2,3
-         // isotope 4 = -1,0,2,3
-         // isotope 5 = -1,0,1
-         // isotope 6 = -3,-2,-1,0,1,2,3
-         // isotope 7 = -8,-4,0,4,8
+   size_t tBin = (size_t)dBin;
 
-         if (g_staticParams.tolerances.iIsotopeError <= 6)
-         {
-            // first handle larger C13 isotopes
-            int iMaxIsotope = 3;
-            if (g_staticParams.tolerances.iIsotopeError < 3)
-               iMaxIsotope = g_staticParams.tolerances.iIsotopeError;
+   pCursor->tEntry = _vtPrecursorBucketStart[tBin];
+   pCursor->tEnd = _vtPrecursorBucketStart[tBin + 1];
 
-            if (g_staticParams.tolerances.iIsotopeError == 5)
-               iMaxIsotope = 1;
+   if (iFromQuery > 0)
+   {
+      auto it = std::lower_bound(_vPrecursorBuckets.begin() + pCursor->tEntry,
+         _vPrecursorBuckets.begin() + pCursor->tEnd,
+         iFromQuery,
+         [](const PrecursorBucketEntry& entry, int iQuery) { return entry.iWhichQuery < iQuery; });
 
-            for (int i = 0; i < iMassOffsetsSize; ++i)
-            {
-               for (int x = 0; x <= iMaxIsotope; ++x)
-               {
-                  if ((pQuery->_pepMassInfo.dPeptideMassToleranceLow <= dCalcPepMass + g_staticParams.vectorMassOffsets[i] + x * C13_DIFF
-                     && dCalcPepMass + g_staticParams.vectorMassOffsets[i] + x * C13_DIFF <= pQuery->_pepMassInfo.dPeptideMassToleranceHigh))
-                  {
-                     return true;
-                  }
-               }
-            }
+      pCursor->tEntry = (size_t)(it - _vPrecursorBuckets.begin());
+   }
 
-            if (g_staticParams.tolerances.iIsotopeError >= 4 && g_staticParams.tolerances.iIsotopeError <= 6)
-            {
-               // now consider negative C13 isotopes aka triggered peak is less than real peak
-               if (g_staticParams.tolerances.iIsotopeError == 4 || g_staticParams.tolerances.iIsotopeError == 5)
-                  iMaxIsotope = 1;
-               else  // g_staticParams.tolerances.iIsotopeError == 6
-                  iMaxIsotope = 3;
+   return NextMassMatch(dCalcPepMass, pCursor);
+}
 
-               for (int i = 0; i < iMassOffsetsSize; ++i)
-               {
-                  for (int x = 0; x <= iMaxIsotope; ++x)
-                  {
-                     if ((pQuery->_pepMassInfo.dPeptideMassToleranceLow <= dCalcPepMass + g_staticParams.vectorMassOffsets[i] - x * C13_DIFF
-                        && dCalcPepMass + g_staticParams.vectorMassOffsets[i] - x * C13_DIFF <= pQuery->_pepMassInfo.dPeptideMassToleranceHigh))
-                     {
-                        return true;
-                     }
-                  }
-               }
-            }
 
-            return false;
-         }
-         else if (g_staticParams.tolerances.iIsotopeError == 7)
-         {
-            for (int i = 0; i < iMassOffsetsSize; ++i)
-            {
-               for (int x = -2; x <= 2; ++x)
-               {
-                  if ((pQuery->_pepMassInfo.dPeptideMassToleranceLow <= dCalcPepMass + g_staticParams.vectorMassOffsets[i] + x * 4.0070995
-                     && dCalcPepMass + g_staticParams.vectorMassOffsets[i] + x * 4.0070995 <= pQuery->_pepMassInfo.dPeptideMassToleranceHigh))
-                  {
-                     return true;
-                  }
-               }
-            }
-            return false;
-         }
-         else
-         {
-            string strErrorMsg = " Error - iIsotopeError=" + std::to_string(g_staticParams.tolerances.iIsotopeError) + ", should not be here!\n";
-            g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
-            logerr(strErrorMsg);
-            return false;
-         }
-      }
-      else
-      {
-         if (g_staticParams.tolerances.iIsotopeError <= 6)
-         {
-            // first handle larger C13 isotopes
-            int iMaxIsotope = 3;
-            if (g_staticParams.tolerances.iIsotopeError < 3)
-               iMaxIsotope = g_staticParams.tolerances.iIsotopeError;
+// Returns the next query in the cursor's bin whose Minus..Plus window holds
+// dCalcPepMass, or -1 when the bin is exhausted.
+int CometSearch::NextMassMatch(double dCalcPepMass,
+                               MassMatchCursor* pCursor)
+{
+   while (pCursor->tEntry < pCursor->tEnd)
+   {
+      const PrecursorBucketEntry& entry = _vPrecursorBuckets[pCursor->tEntry++];
+
+      if (dCalcPepMass >= entry.dMinus && dCalcPepMass <= entry.dPlus)
+         return entry.iWhichQuery;
+   }
 
-            if (g_staticParams.tolerances.iIsotopeError == 5)
-               iMaxIsotope = 1;
+   return -1;
+}
 
-            for (int x = 0; x <= iMaxIsotope; ++x)
-            {
-               if ((pQuery->_pepMassInfo.dPeptideMassToleranceLow <= dCalcPepMass + x * C13_DIFF
-                  && dCalcPepMass + x * C13_DIFF <= pQuery->_pepMassInfo.dPeptideMassToleranceHigh))
-               {
-                  return true;
-               }
-            }
 
-            if (g_staticParams.tolerances.iIsotopeError >= 4 && g_staticParams.tolerances.iIsotopeError <= 6)
-            {
-               // now consider negative C13 isotopes
-               if (g_staticParams.tolerances.iIsotopeError == 4 || g_staticParams.tolerances.iIsotopeError == 5)
-                  iMaxIsotope = 1;
-               else  // g_staticParams.tolerances.iIsotopeError == 6
-                  iMaxIsotope = 3;
+// Returns the first query whose tolerance, isotope and offset windows accept
+// dCalcPepMass (i.e. passes CheckMassMatch()), or -1.
+int CometSearch::FirstCheckedMassMatch(double dCalcPepMass)
+{
+   MassMatchCursor matchCursor;
+   int iWhichQuery = FirstMassMatch(dCalcPepMass, 0, &matchCursor);
 
-               for (int x = 0; x <= iMaxIsotope; ++x)
-               {
-                  if ((pQuery->_pepMassInfo.dPeptideMassToleranceLow <= dCalcPepMass - x * C13_DIFF
-                     && dCalcPepMass - x * C13_DIFF <= pQuery->_pepMassInfo.dPeptideMassToleranceHigh))
-                  {
-                     return true;
-                  }
-               }
-            }
+   while (iWhichQuery != -1 && !CheckMassMatch(iWhichQuery, dCalcPepMass))
+      iWhichQuery = NextMassMatch(dCalcPepMass, &matchCursor);
 
-            return false;
-         }
-         else if (g_staticParams.tolerances.iIsotopeError == 7)
-         {
-            for (int x = -2; x <= 2; ++x)
-            {
-               if ((pQuery->_pepMassInfo.dPeptideMassToleranceLow <= dCalcPepMass + x * 4.0070995
-                  && dCalcPepMass + x * 4.0070995 <= pQuery->_pepMassInfo.dPeptideMassToleranceHigh))
-               {
-                  return true;
-               }
-            }
+   return iWhichQuery;
+}
 
-            return false;
-         }
 
-         // only deal with isotope offsets; no mass offsets
-         else
-         {
-            string strErrorMsg = " Error - iIsotopeError=" + std::to_string(g_staticParams.tolerances.iIsotopeError) + ", should not be here!\n";
-            g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
-            logerr(strErrorMsg);
-            return false;
-         }
+size_t CometSearch::BinarySearchIndexMass(size_t start,
+                                          size_t end,
+                                          double dQueryMass,
+                                          unsigned int* uiFragmentMass)
+{
+   // dQueryMass is the lower bound tolerance mass of input spectrum.
+
+   // Termination condition: start index greater than end index.
+   if (start >= end || end <= BINARYSEARCHCUTOFF)
+   {
+      return start;
+   }
+
+   // Find the middle element of the vector and use that for splitting
+   // the array into two pieces.
+   size_t middle = start + ((end - start) / 2);
+
+   unsigned int uiBinBase = g_iFragmentIndexOffset[*uiFragmentMass];
+   double dArrayMass = g_pFragmentPeptides[g_iFragmentIndex[uiBinBase + middle]].dPepMass;
+
+   if (dArrayMass > dQueryMass)
+   {
+      return BinarySearchIndexMass(start, middle - 1, dQueryMass, uiFragmentMass);
+   }
+   else if (dArrayMass < dQueryMass)
+   {
+      return BinarySearchIndexMass(middle + 1, end, dQueryMass, uiFragmentMass);
+   }
+   else // this means (dArrayMass >= dQueryMass && dArrayMass <= dQueryMass)
+   {
+      // always walk backwards now until ArrayMass is < dQueryMass
+      // as there may be multiple entries in the mass vector with the same ArrayMass so
+      // need to start at the first one (or the entry before the first one)
+      while (middle > 0 && g_pFragmentPeptides[g_iFragmentIndex[uiBinBase + middle]].dPepMass >= dQueryMass)
+      {
+         middle--;
       }
+
+      return middle;
    }
+}
 
-   return false;
+
+bool CometSearch::CheckMassMatch(size_t iWhichQuery,
+                                 double dCalcPepMass)
+{
+   return CheckMassMatch(g_pvQuery.at(iWhichQuery), dCalcPepMass);
 }
 
 
@@ -4974,6 +6213,107 @@ char CometSearch::GetAA(int i,
 }
 
 
+// Flattens the nonzero bins of uiBinnedIonMasses into pBinList for fragment charges 1 to
+// iMaxFragCharge.  With bUseNLData the 1+ a/b/y bins are kept apart as they are scored
+// against the NH3/H2O loss data.  Fragment neutral loss bins of the first iNumModNL
+// variable mods are only listed when fragment neutral losses are searched.
+void CometSearch::BuildXcorrBinList(XcorrBinList* pBinList,
+                                    unsigned int uiBinnedIonMasses[MAX_FRAGMENT_CHARGE + 1][NUM_ION_SERIES][MAX_PEPTIDE_LEN][VMODS + 2],
+                                    int iLenPeptide,
+                                    int iMaxFragCharge,
+                                    bool bUseNLData,
+                                    int iNumModNL)
+{
+   vector<unsigned int>& vuiBins = pBinList->vuiBins;
+   int iLenPeptideMinus1 = iLenPeptide - 1;
+   int iNumKinds = (g_staticParams.variableModParameters.bUseFragmentNeutralLoss ? XCORR_BIN_KINDS : XCORR_BINS_MODNL);
+
+   vuiBins.clear();
+
+   for (int iKind = 0; iKind < XCORR_BIN_KINDS; ++iKind)
+   {
+      bool bNLDataKind = (iKind == XCORR_BINS_ION_NL || iKind == XCORR_BINS_MODNL_NL);
+
+      pBinList->piEnd[iKind][0] = (int)vuiBins.size();
+
+      for (int ctCharge = 1; ctCharge <= MAX_FRAGMENT_CHARGE; ++ctCharge)
+      {
+         for (int ctIonSeries = 0; iKind < iNumKinds && ctCharge <= iMaxFragCharge
+            && ctIonSeries < g_staticParams.ionInformation.iNumIonSeriesUsed; ++ctIonSeries)
+         {
+            int iWhichIonSeries = g_staticParams.ionInformation.piSelectedIonSeries[ctIonSeries];
+            bool bNLData = (bUseNLData && ctCharge == 1
+               && (iWhichIonSeries == ION_SERIES_A || iWhichIonSeries == ION_SERIES_B || iWhichIonSeries == ION_SERIES_Y));
+
+            if (bNLData != bNLDataKind)
+               continue;
+
+            for (int ctLen = 0; ctLen < iLenPeptideMinus1; ++ctLen)
+            {
+               unsigned int* puiBin = uiBinnedIonMasses[ctCharge][ctIonSeries][ctLen];
+
+               if (iKind == XCORR_BINS_ION || iKind == XCORR_BINS_ION_NL)
+               {
+                  if ((int)puiBin[0] > 0)
+                     vuiBins.push_back(puiBin[0]);
+                  continue;
+               }
+
+               for (int ii = 0; ii < iNumModNL; ++ii)
+               {
+                  if (g_staticParams.variableModParameters.varModList[ii].dNeutralLoss != 0.0 && (int)puiBin[ii + 1] > 0)
+                     vuiBins.push_back(puiBin[ii + 1]);
+                  if (g_staticParams.variableModParameters.varModList[ii].dNeutralLoss2 != 0.0 && (int)puiBin[ii + 2] > 0)
+                     vuiBins.push_back(puiBin[ii + 2]);
+               }
+            }
+         }
+
+         pBinList->piEnd[iKind][ctCharge] = (int)vuiBins.size();
+      }
+   }
+}
+
+
+// Sum of the fast xcorr values of the bins in pBinList for fragment charges up to the
+// query's max fragment charge, using the dense xcorr array when the query has one.
+double CometSearch::XcorrSumBinList(const XcorrBinList* pBinList,
+                                    Query* pQuery,
+                                    bool bUseModNL)
+{
+   // iMax is largest x-value allowed as iMax+1 is allocated and we're 0-index
+   int iMax = pQuery->_spectrumInfoInternal.iArraySize / SPARSE_MATRIX_SIZE;
+   int iLimit = (iMax + 1) * SPARSE_MATRIX_SIZE;
+   int iMaxFragCharge = pQuery->_spectrumInfoInternal.usiMaxFragCharge;
+   double dSum = 0.0;
+
+   for (int iKind = 0; iKind < (bUseModNL ? XCORR_BIN_KINDS : XCORR_BINS_MODNL); ++iKind)
+   {
+      int iStart = pBinList->piEnd[iKind][0];
+      int iNumBins = pBinList->piEnd[iKind][iMaxFragCharge] - iStart;
+
+      if (iNumBins == 0)
+         continue;
+
+      const unsigned int* puiBins = pBinList->vuiBins.data() + iStart;
+      bool bNLData = (iKind == XCORR_BINS_ION_NL || iKind == XCORR_BINS_MODNL_NL);
+      const float* pfDense = (bNLData ? pQuery->pfDenseFastXcorrDataNL : pQuery->pfDenseFastXcorrData);
+
+#ifdef XCORR_BENCH
+      RecordXcorrBenchCall(pQuery, bNLData, puiBins, iNumBins);
+#endif
+
+      if (pfDense != NULL)
+         dSum = g_xcorrKernels.pfnDense(pfDense, iLimit, puiBins, iNumBins, dSum);
+      else
+         dSum = g_xcorrKernels.pfnSparse((bNLData ? pQuery->ppfSparseFastXcorrDataNL : pQuery->ppfSparseFastXcorrData),
+            iMax, puiBins, iNumBins, dSum);
+   }
+
+   return dSum;
+}
+
+
 // Compares sequence to MSMS spectrum by matching ion intensities.
 void CometSearch::XcorrScore(char* szProteinSeq,
                              int iStartResidue,        // needed for decoy peptide; otherwise just duplicate of iStartPos
@@ -4988,11 +6328,7 @@ void CometSearch::XcorrScore(char* szProteinSeq,
                              int* piVarModSites,
                              struct sDBEntry* dbe)
 {
-   int ctLen,
-       ctIonSeries,
-       ctCharge;
    double dXcorr;
-   int iLenPeptideMinus1 = iLenPeptide - 1;
 
    // Pointer to either regular or decoy uiBinnedIonMasses[][][][][].
    unsigned int (*p_uiBinnedIonMasses)[MAX_FRAGMENT_CHARGE + 1][NUM_ION_SERIES][MAX_PEPTIDE_LEN][VMODS + 2];
@@ -5010,84 +6346,26 @@ void CometSearch::XcorrScore(char* szProteinSeq,
       p_uiBinnedPrecursorNL = &_uiBinnedPrecursorNL;
    }
 
-   int iWhichIonSeries;
-   bool bUseWaterAmmoniaNLPeaks = false;
    Query* pQuery = g_pvQuery.at(iWhichQuery);
 
-   float** ppSparseFastXcorrData;              // use this if bSparseMatrix
+   // The fragment bins of a peptide are flattened once and reused for every query it matches.
+   XcorrBinList* pBinList = &_xcorrBinList[bDecoyPep];
+   if (_bXcorrBinListStale[bDecoyPep])
+   {
+      BuildXcorrBinList(pBinList, *p_uiBinnedIonMasses, iLenPeptide, g_massRange.usiMaxFragmentCharge,
+         g_staticParams.ionInformation.bUseWaterAmmoniaLoss, VMODS);
+      _bXcorrBinListStale[bDecoyPep] = false;
+   }
+
+   dXcorr = XcorrSumBinList(pBinList, pQuery, g_staticParams.variableModParameters.bUseFragmentNeutralLoss && iFoundVariableMod == 2);
 
-   dXcorr = 0.0;
+   float** ppSparseFastXcorrData;
 
    // iMax is largest x-value allowed as iMax+1 is allocated and we're 0-index
    int iMax = pQuery->_spectrumInfoInternal.iArraySize / SPARSE_MATRIX_SIZE;
 
    int bin, x, y;
 
-   for (ctCharge = 1; ctCharge <= pQuery->_spectrumInfoInternal.usiMaxFragCharge; ++ctCharge)
-   {
-      for (ctIonSeries = 0; ctIonSeries < g_staticParams.ionInformation.iNumIonSeriesUsed; ++ctIonSeries)
-      {
-         iWhichIonSeries = g_staticParams.ionInformation.piSelectedIonSeries[ctIonSeries];
-
-         if (g_staticParams.ionInformation.bUseWaterAmmoniaLoss
-            && (iWhichIonSeries == ION_SERIES_A || iWhichIonSeries == ION_SERIES_B || iWhichIonSeries == ION_SERIES_Y))
-         {
-            bUseWaterAmmoniaNLPeaks = true;
-         }
-         else
-            bUseWaterAmmoniaNLPeaks = false;
-
-         if (ctCharge == 1 && bUseWaterAmmoniaNLPeaks)
-         {
-            ppSparseFastXcorrData = pQuery->ppfSparseFastXcorrDataNL;
-         }
-         else
-         {
-            ppSparseFastXcorrData = pQuery->ppfSparseFastXcorrData;
-         }
-
-         for (ctLen = 0; ctLen < iLenPeptideMinus1; ++ctLen)
-         {
-            //MH: newer sparse matrix converts bin to sparse matrix bin
-            bin = *(*(*(*(*p_uiBinnedIonMasses + ctCharge) + ctIonSeries) + ctLen) + 0);
-
-            x = bin / SPARSE_MATRIX_SIZE;
-
-            if (!(bin <= 0 || x > iMax || ppSparseFastXcorrData[x] == NULL)) // x should never be > iMax so this is just a safety check
-            {
-               y = bin - (x * SPARSE_MATRIX_SIZE);
-               dXcorr += ppSparseFastXcorrData[x][y];
-            }
-
-            if (g_staticParams.variableModParameters.bUseFragmentNeutralLoss && iFoundVariableMod == 2)
-            {
-               for (int ii = 0; ii < VMODS; ++ii)
-               {
-                  for (int iWhichNL = 0; iWhichNL < 2; ++iWhichNL)
-                  {
-                     if (iWhichNL == 0 && g_staticParams.variableModParameters.varModList[ii].dNeutralLoss == 0.0)
-                        continue;
-                     else if (iWhichNL == 1 && g_staticParams.variableModParameters.varModList[ii].dNeutralLoss2 == 0.0)
-                        continue;
-
-                     //x+1 here as 0 is the base fragment ion series
-                     // *(*(*(*(*p_uiBinnedIonMasses + ctCharge)+ctIonSeries)+ctLen)+NL) gives uiBinnedIonMasses[ctCharge][ctIonSeries][ctLen][NL].
-                     bin = *(*(*(*(*p_uiBinnedIonMasses + ctCharge) + ctIonSeries) + ctLen) + ii + 1 + iWhichNL);
-
-                     x = bin / SPARSE_MATRIX_SIZE;
-
-                     if (!(bin <= 0 || x > iMax || ppSparseFastXcorrData[x] == NULL)) // x should never be > iMax so this is just a safety check
-                     {
-                        y = bin - (x * SPARSE_MATRIX_SIZE);
-                        dXcorr += ppSparseFastXcorrData[x][y];
-                     }
-                  }
-               }
-            }
-         }
-      }
-   }
-
    // precursor NL
    ppSparseFastXcorrData = pQuery->ppfSparseFastXcorrData;
    for (int ctNL = 0; ctNL < g_staticParams.iPrecursorNLSize; ++ctNL)
@@ -5111,13 +6389,56 @@ void CometSearch::XcorrScore(char* szProteinSeq,
 
    dXcorr = std::round(dXcorr * 1000.0) / 1000.0;  // round to 3 decimal points
 
+   bool bSeparateDecoy = (bDecoyPep && g_staticParams.options.iDecoySearch == 2);
+
+   TallyXcorr(pQuery, bSeparateDecoy, dXcorr, szProteinSeq[iStartPos]);
+
+   // do need this fudge factor in comparing dXcorr to dLowestXcorrScore as there must be some
+   // rounding errors that where random duplicate, same score peptides doesn't make it past here.
+   // Most candidates stop here without taking the query lock; the score check is repeated
+   // under the lock as another thread may have raised the lowest stored score meanwhile.
+   if (dXcorr < g_staticParams.options.dMinimumXcorr
+      || dXcorr + 0.00005 < LowestXcorrScore(pQuery, bSeparateDecoy)
+      || iLenPeptide > g_staticParams.options.peptideLengthRange.iEnd)
+   {
+      return;
+   }
+
    Threading::LockMutex(pQuery->accessMutex);
 
-   // Increment matched peptide counts.
-   if (bDecoyPep && g_staticParams.options.iDecoySearch == 2)
-      pQuery->_uliNumMatchedDecoyPeptides++;
+   if (dXcorr + 0.00005 >= LowestXcorrScore(pQuery, bSeparateDecoy))
+   {
+      // no need to check duplicates if fragment ion indexed database search (internal decoys not supported yet)
+      // and !g_staticParams.options.bTreatSameIL and no internal decoys
+      if (g_staticParams.iDbType == DbType::FI_DB && !g_staticParams.options.bTreatSameIL)
+      {
+         StorePeptide(iWhichQuery, iStartResidue, iStartPos, iEndPos, iFoundVariableMod, szProteinSeq,
+            dCalcPepMass, dXcorr, bDecoyPep, piVarModSites, dbe);
+      }
+      else if (!CheckDuplicate(iWhichQuery, iStartResidue, iEndResidue, iStartPos, iEndPos, iFoundVariableMod, dCalcPepMass,
+         szProteinSeq, bDecoyPep, piVarModSites, dbe))
+      {
+         StorePeptide(iWhichQuery, iStartResidue, iStartPos, iEndPos, iFoundVariableMod, szProteinSeq,
+            dCalcPepMass, dXcorr, bDecoyPep, piVarModSites, dbe);
+      }
+   }
+
+   Threading::UnlockMutex(pQuery->accessMutex);
+}
+
+
+// Matched peptide count and E-value histogram entry for one scored candidate.  These
+// are plain sums so they are updated with atomic adds instead of under the query lock;
+// the totals do not depend on the order in which threads score candidates.
+void CometSearch::TallyXcorr(Query* pQuery,
+                             bool bSeparateDecoy,
+                             double dXcorr,
+                             char cFirstResidue)
+{
+   if (bSeparateDecoy)
+      std::atomic_ref<unsigned long int>(pQuery->_uliNumMatchedDecoyPeptides).fetch_add(1, std::memory_order_relaxed);
    else
-      pQuery->_uliNumMatchedPeptides++;
+      std::atomic_ref<unsigned long int>(pQuery->_uliNumMatchedPeptides).fetch_add(1, std::memory_order_relaxed);
 
    if (g_staticParams.options.bPrintExpectScore
       || g_staticParams.options.bOutputPepXMLFile
@@ -5132,45 +6453,182 @@ void CometSearch::XcorrScore(char* szProteinSeq,
          iTmp = 0;  // lump these all in the mininum score bin of the histogram
 
       // lump some zero decoy entries into iMinXcorrHisto bin
-      if (szProteinSeq[iStartPos] >= 'A' && szProteinSeq[iStartPos] <= 'H' && iTmp < pQuery->iMinXcorrHisto)
+      if (cFirstResidue >= 'A' && cFirstResidue <= 'H' && iTmp < pQuery->iMinXcorrHisto)
          iTmp = pQuery->iMinXcorrHisto;
 
       if (iTmp >= HISTO_SIZE)
          iTmp = HISTO_SIZE - 1;
 
-      pQuery->iXcorrHistogram[iTmp] += 1;
-      pQuery->uiHistogramCount += 1;
-   }
+      std::atomic_ref<int>(pQuery->iXcorrHistogram[iTmp]).fetch_add(1, std::memory_order_relaxed);
+      std::atomic_ref<unsigned int>(pQuery->uiHistogramCount).fetch_add(1, std::memory_order_relaxed);
+   }
+}
+
+
+// Lowest xcorr currently stored for the query.  It only ever increases during a search,
+// so a stale value read without the query lock is merely conservative.
+double CometSearch::LowestXcorrScore(Query* pQuery,
+                                     bool bSeparateDecoy)
+{
+   if (bSeparateDecoy)
+      return std::atomic_ref<double>(pQuery->dLowestDecoyXcorrScore).load(std::memory_order_relaxed);
+   else
+      return std::atomic_ref<double>(pQuery->dLowestXcorrScore).load(std::memory_order_relaxed);
+}
+
+
+// True if stored entry iA is to be replaced before entry iB.  Lower xcorr goes first;
+// for the same xcorr at or above the minimum xcorr, the higher sequence and then the
+// higher mod state go first so the lower ones are kept.  Empty entries already at the
+// minimum xcorr fill from index 1 with index 0 last, as the old linear scan did.
+bool CometSearch::ReplaceBefore(Results* pResults,
+                                int iA,
+                                int iB)
+{
+   Results* pA = pResults + iA;
+   Results* pB = pResults + iB;
+
+   if (pA->fXcorr != pB->fXcorr)
+      return pA->fXcorr < pB->fXcorr;
+
+   if (pA->fXcorr >= g_staticParams.options.dMinimumXcorr)
+   {
+      int iCmp = strcmp(pA->szPeptide, pB->szPeptide);
+
+      if (iCmp != 0)
+         return iCmp > 0;
+
+      if (pA->szPeptide[0] == '\0')
+      {
+         int iNumStored = g_staticParams.options.iNumStored;
+
+         return (iA == 0 ? iNumStored : iA) < (iB == 0 ? iNumStored : iB);
+      }
+
+      if (g_staticParams.variableModParameters.bVarModSearch)
+      {
+         for (int x = 0; x < pA->usiLenPeptide + 2; ++x)
+         {
+            if (pA->piVarModSites[x] != pB->piVarModSites[x])
+               return pA->piVarModSites[x] > pB->piVarModSites[x];
+         }
+      }
+   }
+
+   return iA < iB;
+}
+
+
+// Restores the heap after the sort key of entry iEntry changed.
+void CometSearch::SiftStoredEntry(StoredResultsOrder* pOrder,
+                                  Results* pResults,
+                                  int iEntry)
+{
+   int* piHeap = pOrder->piHeap;
+   int iNumStored = g_staticParams.options.iNumStored;
+   int iPos = pOrder->piHeapPos[iEntry];
+
+   while (iPos > 0 && ReplaceBefore(pResults, iEntry, piHeap[(iPos - 1) / 2]))
+   {
+      piHeap[iPos] = piHeap[(iPos - 1) / 2];
+      pOrder->piHeapPos[piHeap[iPos]] = iPos;
+      iPos = (iPos - 1) / 2;
+   }
+
+   while (2 * iPos + 1 < iNumStored)
+   {
+      int iChild = 2 * iPos + 1;
+
+      if (iChild + 1 < iNumStored && ReplaceBefore(pResults, piHeap[iChild + 1], piHeap[iChild]))
+         iChild++;
+
+      if (!ReplaceBefore(pResults, piHeap[iChild], iEntry))
+         break;
+
+      piHeap[iPos] = piHeap[iChild];
+      pOrder->piHeapPos[piHeap[iPos]] = iPos;
+      iPos = iChild;
+   }
+
+   piHeap[iPos] = iEntry;
+   pOrder->piHeapPos[iEntry] = iPos;
+}
+
+
+void CometSearch::InitStoredOrder(StoredResultsOrder* pOrder,
+                                  Results* pResults)
+{
+   // insert the entries one at a time; each sift only moves the new entry up
+   for (int i = 0; i < g_staticParams.options.iNumStored; ++i)
+   {
+      pOrder->piHeap[i] = i;
+      pOrder->piHeapPos[i] = i;
+
+      int iPos = i;
+      while (iPos > 0 && ReplaceBefore(pResults, i, pOrder->piHeap[(iPos - 1) / 2]))
+      {
+         pOrder->piHeap[iPos] = pOrder->piHeap[(iPos - 1) / 2];
+         pOrder->piHeapPos[pOrder->piHeap[iPos]] = iPos;
+         iPos = (iPos - 1) / 2;
+      }
+      pOrder->piHeap[iPos] = i;
+      pOrder->piHeapPos[i] = iPos;
+   }
+
+   for (int i = 0; i <= pOrder->iHashMask; ++i)
+      pOrder->piHashHead[i] = -1;
+}
+
+
+// FNV-1a over the peptide residues; I and L hash alike when they are treated as equal
+// so that CheckDuplicate finds I/L variants in the same bucket.
+unsigned int CometSearch::StoredPeptideHash(const char* szPeptide,
+                                            int iLenPeptide)
+{
+   unsigned int uiHash = 2166136261u;
+
+   for (int i = 0; i < iLenPeptide; ++i)
+   {
+      unsigned char c = (unsigned char)szPeptide[i];
+
+      if (c == 'I' && g_staticParams.options.bTreatSameIL)
+         c = 'L';
+
+      uiHash = (uiHash ^ c) * 16777619u;
+   }
+
+   return uiHash;
+}
+
+
+// Adds a newly stored entry to its hash bucket, keeping the bucket in index order.
+void CometSearch::LinkStoredEntry(StoredResultsOrder* pOrder,
+                                  Results* pResults,
+                                  int iEntry)
+{
+   unsigned int uiHash = StoredPeptideHash(pResults[iEntry].szPeptide, pResults[iEntry].usiLenPeptide);
+   int* piLink = pOrder->piHashHead + (uiHash & pOrder->iHashMask);
+
+   while (*piLink >= 0 && *piLink < iEntry)
+      piLink = pOrder->piHashNext + *piLink;
+
+   pOrder->piHashNext[iEntry] = *piLink;
+   *piLink = iEntry;
+}
 
-   double dLowestXcorrScore;
 
-   if (bDecoyPep && g_staticParams.options.iDecoySearch == 2)
-      dLowestXcorrScore = pQuery->dLowestDecoyXcorrScore;
-   else
-      dLowestXcorrScore = pQuery->dLowestXcorrScore;
+// Removes an entry about to be replaced from its hash bucket.
+void CometSearch::UnlinkStoredEntry(StoredResultsOrder* pOrder,
+                                    Results* pResults,
+                                    int iEntry)
+{
+   unsigned int uiHash = StoredPeptideHash(pResults[iEntry].szPeptide, pResults[iEntry].usiLenPeptide);
+   int* piLink = pOrder->piHashHead + (uiHash & pOrder->iHashMask);
 
-   // do need this fudge factor in comparing dXcorr to dLowestXcorrScore as there must be some
-   // rounding errors that where random duplicate, same score peptides doesn't make it past here
-   if (dXcorr >= g_staticParams.options.dMinimumXcorr
-      && dXcorr + 0.00005 >= dLowestXcorrScore
-      && iLenPeptide <= g_staticParams.options.peptideLengthRange.iEnd)
-   {
-      // no need to check duplicates if fragment ion indexed database search (internal decoys not supported yet)
-      // and !g_staticParams.options.bTreatSameIL and no internal decoys
-      if (g_staticParams.iDbType == DbType::FI_DB && !g_staticParams.options.bTreatSameIL)
-      {
-         StorePeptide(iWhichQuery, iStartResidue, iStartPos, iEndPos, iFoundVariableMod, szProteinSeq,
-            dCalcPepMass, dXcorr, bDecoyPep, piVarModSites, dbe);
-      }
-      else if (!CheckDuplicate(iWhichQuery, iStartResidue, iEndResidue, iStartPos, iEndPos, iFoundVariableMod, dCalcPepMass,
-         szProteinSeq, bDecoyPep, piVarModSites, dbe))
-      {
-         StorePeptide(iWhichQuery, iStartResidue, iStartPos, iEndPos, iFoundVariableMod, szProteinSeq,
-            dCalcPepMass, dXcorr, bDecoyPep, piVarModSites, dbe);
-      }
-   }
+   while (*piLink != iEntry)
+      piLink = pOrder->piHashNext + *piLink;
 
-   Threading::UnlockMutex(pQuery->accessMutex);
+   *piLink = pOrder->piHashNext[iEntry];
 }
 
 
@@ -5199,72 +6657,11 @@ void CometSearch::StorePeptide(size_t iWhichQuery,
 
    if (g_staticParams.options.iDecoySearch == 2 && bDecoyPep)  // store separate decoys
    {
-      short siLowestDecoyXcorrScoreIndex = 0;
-
-      // siLowestDecoyXcorrScoreIndex will point to which entry to replace
-      // now walk through all stored entries to see which one is lowest
-      for (short siA = 1; siA < g_staticParams.options.iNumStored; ++siA)
-      {
-         if (pQuery->_pDecoys[siLowestDecoyXcorrScoreIndex].fXcorr > pQuery->_pDecoys[siA].fXcorr)
-         {
-            siLowestDecoyXcorrScoreIndex = siA;
-         }
-         else if (pQuery->_pDecoys[siLowestDecoyXcorrScoreIndex].fXcorr == pQuery->_pDecoys[siA].fXcorr
-            && pQuery->_pDecoys[siLowestDecoyXcorrScoreIndex].fXcorr >= g_staticParams.options.dMinimumXcorr)
-         {
-            // if current lowest score is the same as current siA peptide,
-            // determine if need to point to siA peptide as the one to replace
-            // based on keeping lower sequence, lower mod state
+      // the heap root is the lowest scoring entry, the one to replace
+      short siLowestDecoyXcorrScoreIndex = (short)pQuery->_decoysOrder.piHeap[0];
 
-            int iCmp = strcmp(pQuery->_pDecoys[siLowestDecoyXcorrScoreIndex].szPeptide, pQuery->_pDecoys[siA].szPeptide);
-
-            // if (iCmp > 0), do nothing as siLowestXcorrIndex has lower sequence already
-            if (iCmp < 0)
-            {
-               // we want to keep lower sequence peptide so point new lowest entry to the higher peptide
-               siLowestDecoyXcorrScoreIndex = siA;
-            }
-            else if (iCmp == 0) // same sequence, compare mod state
-            {
-               if (strlen(pQuery->_pDecoys[siA].szPeptide) == 0)
-               {
-                  siLowestDecoyXcorrScoreIndex = siA;
-                  break;
-               }
-               else if (g_staticParams.variableModParameters.bVarModSearch)
-               {
-                  // different peptides with same mod state; replace last mod state
-                  for (int x = 0; x < pQuery->_pDecoys[siA].usiLenPeptide + 2; ++x)
-                  {
-                     if (pQuery->_pDecoys[siLowestDecoyXcorrScoreIndex].piVarModSites[x] < pQuery->_pDecoys[siA].piVarModSites[x])
-                     {
-                        // keep peptide with lower mod state so point new entry to higher mod state
-                        siLowestDecoyXcorrScoreIndex = siA;
-                        break;
-                     }
-                     else if (pQuery->_pDecoys[siLowestDecoyXcorrScoreIndex].piVarModSites[x] > pQuery->_pDecoys[siA].piVarModSites[x])
-                     {
-                        // don't swap this peptide entry
-                        break;
-                     }
-                  }
-               }
-               else
-               {
-                  // should not have gotten here; duplicate unmodified peptide would get
-                  // flagged in CheckDuplicates
-                  printf("\n Error in StorePeptides (decoys). %s stored twice:  %d %lf, %d %lf\n",
-                     pQuery->_pDecoys[siA].szPeptide,
-                     siA,
-                     pQuery->_pDecoys[siA].fXcorr,
-                     siLowestDecoyXcorrScoreIndex,
-                     pQuery->_pDecoys[siLowestDecoyXcorrScoreIndex].fXcorr);
-
-                  exit(1);
-               }
-            }
-         }
-      }
+      if (pQuery->_pDecoys[siLowestDecoyXcorrScoreIndex].usiLenPeptide > 0)
+         UnlinkStoredEntry(&pQuery->_decoysOrder, pQuery->_pDecoys, siLowestDecoyXcorrScoreIndex);
 
       pQuery->iDecoyMatchPeptideCount++;
       pQuery->_pDecoys[siLowestDecoyXcorrScoreIndex].usiLenPeptide = iLenPeptide;
@@ -5291,7 +6688,8 @@ void CometSearch::StorePeptide(size_t iWhichQuery,
       if (iStartPos == 0)
       {
          // check if clip n-term met
-         if (g_staticParams.options.bClipNtermMet && dbe->strSeq.c_str()[0] == 'M' && !strcmp(dbe->strSeq.c_str() + 1, szProteinSeq))
+         if (g_staticParams.options.bClipNtermMet
+            && (_proteinInfo.bClippedNtermMet || (dbe->strSeq.c_str()[0] == 'M' && !strcmp(dbe->strSeq.c_str() + 1, szProteinSeq))))
          {
             pQuery->_pDecoys[siLowestDecoyXcorrScoreIndex].cPrevAA = 'M';
             pQuery->_pDecoys[siLowestDecoyXcorrScoreIndex].bClippedM = true;
@@ -5327,11 +6725,12 @@ void CometSearch::StorePeptide(size_t iWhichQuery,
       struct ProteinEntryStruct pTmp;
 
       pTmp.lWhichProtein = dbe->lProteinFilePosition;
-      pTmp.iStartResidue = iStartResidue + 1;  // 1 based position
+      pTmp.iStartResidue = StoredStartResidue(iStartResidue);  // 1 based position
       pTmp.cPrevAA = pQuery->_pDecoys[siLowestDecoyXcorrScoreIndex].cPrevAA;
       pTmp.cNextAA = pQuery->_pDecoys[siLowestDecoyXcorrScoreIndex].cNextAA;
 
       pQuery->_pDecoys[siLowestDecoyXcorrScoreIndex].pWhichDecoyProtein.clear();
+      pQuery->_pDecoys[siLowestDecoyXcorrScoreIndex].vPeffMods.clear();
       pQuery->_pDecoys[siLowestDecoyXcorrScoreIndex].pWhichDecoyProtein.push_back(pTmp);
       pQuery->_pDecoys[siLowestDecoyXcorrScoreIndex].lProteinFilePosition = dbe->lProteinFilePosition;
       pQuery->_pDecoys[siLowestDecoyXcorrScoreIndex].cHasVariableMod = HasVariableModType_None;
@@ -5376,7 +6775,7 @@ void CometSearch::StorePeptide(size_t iWhichQuery,
                {
                   int iTmp = -iVal - 1;
                   pQuery->_pDecoys[siLowestDecoyXcorrScoreIndex].pdVarModSites[i] = dbe->vectorPeffMod.at(iTmp).dMassDiffMono;
-                  strcpy(pQuery->_pDecoys[siLowestDecoyXcorrScoreIndex].pszMod[i], dbe->vectorPeffMod.at(iTmp).szMod);
+                  pQuery->_pDecoys[siLowestDecoyXcorrScoreIndex].AddPeffMod(i, dbe->vectorPeffMod.at(iTmp).szMod);
                   pQuery->_pDecoys[siLowestDecoyXcorrScoreIndex].cHasVariableMod = HasVariableModType_True;
                }
                else
@@ -5390,90 +6789,24 @@ void CometSearch::StorePeptide(size_t iWhichQuery,
          memset(pQuery->_pDecoys[siLowestDecoyXcorrScoreIndex].pdVarModSites, 0, _usiSizepdVarModSites);
       }
 
-      // walk through stored entries and get new lowest xcorr score
-      pQuery->dLowestDecoyXcorrScore = pQuery->_pDecoys[0].fXcorr;
-      siLowestDecoyXcorrScoreIndex = 0;
+      LinkStoredEntry(&pQuery->_decoysOrder, pQuery->_pDecoys, siLowestDecoyXcorrScoreIndex);
+      SiftStoredEntry(&pQuery->_decoysOrder, pQuery->_pDecoys, siLowestDecoyXcorrScoreIndex);
 
-      for (i = 1; i < g_staticParams.options.iNumStored; ++i)
-      {
-         if (pQuery->_pDecoys[i].fXcorr < pQuery->dLowestDecoyXcorrScore)
-         {
-            pQuery->dLowestDecoyXcorrScore = pQuery->_pDecoys[i].fXcorr;
-            siLowestDecoyXcorrScoreIndex = i;
-         }
-      }
+      // new lowest xcorr score is at the heap root
+      siLowestDecoyXcorrScoreIndex = (short)pQuery->_decoysOrder.piHeap[0];
+      double dLowestDecoyXcorrScore = pQuery->_pDecoys[siLowestDecoyXcorrScoreIndex].fXcorr;
 
+      // read without the query lock in XcorrScore
+      std::atomic_ref<double>(pQuery->dLowestDecoyXcorrScore).store(dLowestDecoyXcorrScore, std::memory_order_relaxed);
       pQuery->siLowestDecoyXcorrScoreIndex = siLowestDecoyXcorrScoreIndex;
    }
    else
    {
-      short siLowestXcorrScoreIndex = 0;
-
-      // siLowestScoreIndex will point to which entry to replace
-      // now walk through all stored entries to see which one is lowest
-      for (short siA = 1; siA < g_staticParams.options.iNumStored; ++siA)
-      {
-         if (pQuery->_pResults[siLowestXcorrScoreIndex].fXcorr > pQuery->_pResults[siA].fXcorr)
-         {
-            siLowestXcorrScoreIndex = siA;
-         }
-         else if (pQuery->_pResults[siLowestXcorrScoreIndex].fXcorr == pQuery->_pResults[siA].fXcorr
-            && pQuery->_pResults[siLowestXcorrScoreIndex].fXcorr >= g_staticParams.options.dMinimumXcorr)
-         {
-            // if current lowest score is the same as current siA peptide,
-            // determine if need to point to siA peptide as the one to replace
-            // based on keeping lower sequence, lower mod state
+      // the heap root is the lowest scoring entry, the one to replace
+      short siLowestXcorrScoreIndex = (short)pQuery->_resultsOrder.piHeap[0];
 
-            int iCmp = strcmp(pQuery->_pResults[siLowestXcorrScoreIndex].szPeptide, pQuery->_pResults[siA].szPeptide);
-
-            // if (iCmp > 0), do nothing as siLowestXcorrIndex has lower sequence already
-            if (iCmp < 0)
-            {
-               // we want to keep lower sequence peptide so point new lowest entry to the higher peptide
-               siLowestXcorrScoreIndex = siA;
-            }
-            else if (iCmp == 0) // same sequence, compare mod state
-            {
-               if (strlen(pQuery->_pResults[siA].szPeptide) == 0)
-               {
-                  siLowestXcorrScoreIndex = siA;
-                  break;
-               }
-               else if (g_staticParams.variableModParameters.bVarModSearch)
-               {
-                  // same peptides with different mod state; replace last mod state
-                  for (int x = 0; x < pQuery->_pResults[siA].usiLenPeptide + 2; ++x)
-                  {
-                     if (pQuery->_pResults[siLowestXcorrScoreIndex].piVarModSites[x] < pQuery->_pResults[siA].piVarModSites[x])
-                     {
-                        // keep peptide with lower mod state so point new entry to higher mod state
-                        // lower mod state = var mod later in sequence
-                        siLowestXcorrScoreIndex = siA;
-                        break;
-                     }
-                     else if (pQuery->_pResults[siLowestXcorrScoreIndex].piVarModSites[x] > pQuery->_pResults[siA].piVarModSites[x])
-                     {
-                        // don't swap this peptide entry
-                        break;
-                     }
-                  }
-               }
-               else
-               {
-                  // should not have gotten here; duplicate unmodified peptide would get
-                  // flagged in CheckDuplicates
-                  printf("\n Error in StorePeptides. %s stored twice:  %d %lf, %d %lf\n",
-                     pQuery->_pResults[siA].szPeptide,
-                     siA,
-                     pQuery->_pResults[siA].fXcorr,
-                     siLowestXcorrScoreIndex,
-                     pQuery->_pResults[siLowestXcorrScoreIndex].fXcorr);
-
-                  exit(1);
-               }
-            }
-         }
-      }
+      if (pQuery->_pResults[siLowestXcorrScoreIndex].usiLenPeptide > 0)
+         UnlinkStoredEntry(&pQuery->_resultsOrder, pQuery->_pResults, siLowestXcorrScoreIndex);
 
       pQuery->iMatchPeptideCount++;
       pQuery->_pResults[siLowestXcorrScoreIndex].usiLenPeptide = iLenPeptide;
@@ -5495,12 +6828,17 @@ void CometSearch::StorePeptide(size_t iWhichQuery,
       }
 
       pQuery->_pResults[siLowestXcorrScoreIndex].fXcorr = (float)dXcorr;
+      pQuery->_pResults[siLowestXcorrScoreIndex].bClippedM = false;
 
       if (iStartPos == 0)
       {
          // check if clip n-term met
-         if (g_staticParams.options.bClipNtermMet && dbe->strSeq.c_str()[0] == 'M' && !strcmp(dbe->strSeq.c_str() + 1, szProteinSeq))
+         if (g_staticParams.options.bClipNtermMet
+            && (_proteinInfo.bClippedNtermMet || (dbe->strSeq.c_str()[0] == 'M' && !strcmp(dbe->strSeq.c_str() + 1, szProteinSeq))))
+         {
             pQuery->_pResults[siLowestXcorrScoreIndex].cPrevAA = 'M';
+            pQuery->_pResults[siLowestXcorrScoreIndex].bClippedM = true;
+         }
          else
             pQuery->_pResults[siLowestXcorrScoreIndex].cPrevAA = '-';
       }
@@ -5534,12 +6872,13 @@ void CometSearch::StorePeptide(size_t iWhichQuery,
       struct ProteinEntryStruct pTmp;
 
       pTmp.lWhichProtein = dbe->lProteinFilePosition;
-      pTmp.iStartResidue = iStartResidue + 1;  // 1 based position
+      pTmp.iStartResidue = StoredStartResidue(iStartResidue);  // 1 based position
       pTmp.cPrevAA = pQuery->_pResults[siLowestXcorrScoreIndex].cPrevAA;
       pTmp.cNextAA = pQuery->_pResults[siLowestXcorrScoreIndex].cNextAA;
 
       pQuery->_pResults[siLowestXcorrScoreIndex].pWhichDecoyProtein.clear();
       pQuery->_pResults[siLowestXcorrScoreIndex].pWhichProtein.clear();
+      pQuery->_pResults[siLowestXcorrScoreIndex].vPeffMods.clear();
       pQuery->_pResults[siLowestXcorrScoreIndex].lProteinFilePosition = dbe->lProteinFilePosition;
       pQuery->_pResults[siLowestXcorrScoreIndex].cHasVariableMod = HasVariableModType_None;
 
@@ -5589,7 +6928,7 @@ void CometSearch::StorePeptide(size_t iWhichQuery,
                {
                   int iTmp = -iVal - 1;
                   pQuery->_pResults[siLowestXcorrScoreIndex].pdVarModSites[i] = dbe->vectorPeffMod.at(iTmp).dMassDiffMono;
-                  strcpy(pQuery->_pResults[siLowestXcorrScoreIndex].pszMod[i], dbe->vectorPeffMod.at(iTmp).szMod);
+                  pQuery->_pResults[siLowestXcorrScoreIndex].AddPeffMod(i, dbe->vectorPeffMod.at(iTmp).szMod);
                   pQuery->_pResults[siLowestXcorrScoreIndex].cHasVariableMod = HasVariableModType_True;
                }
                else
@@ -5603,18 +6942,15 @@ void CometSearch::StorePeptide(size_t iWhichQuery,
          memset(pQuery->_pResults[siLowestXcorrScoreIndex].pdVarModSites, 0, _usiSizepdVarModSites);
       }
 
-      // walk through stored entries and get new lowest xcorr score
-      pQuery->dLowestXcorrScore = pQuery->_pResults[0].fXcorr;
-      siLowestXcorrScoreIndex = 0;
+      LinkStoredEntry(&pQuery->_resultsOrder, pQuery->_pResults, siLowestXcorrScoreIndex);
+      SiftStoredEntry(&pQuery->_resultsOrder, pQuery->_pResults, siLowestXcorrScoreIndex);
 
-      for (i = 1; i < g_staticParams.options.iNumStored; ++i)
-      {
-         if (pQuery->_pResults[i].fXcorr < pQuery->dLowestXcorrScore)
-         {
-            pQuery->dLowestXcorrScore = pQuery->_pResults[i].fXcorr;
-            siLowestXcorrScoreIndex = i;
-         }
-      }
+      // new lowest xcorr score is at the heap root
+      siLowestXcorrScoreIndex = (short)pQuery->_resultsOrder.piHeap[0];
+      double dLowestXcorrScore = pQuery->_pResults[siLowestXcorrScoreIndex].fXcorr;
+
+      // read without the query lock in XcorrScore
+      std::atomic_ref<double>(pQuery->dLowestXcorrScore).store(dLowestXcorrScore, std::memory_order_relaxed);
 
       pQuery->siLowestXcorrScoreIndex = siLowestXcorrScoreIndex;
    }
@@ -5639,9 +6975,15 @@ int CometSearch::CheckDuplicate(int iWhichQuery,
    int bIsDuplicate = 0;
    Query* pQuery = g_pvQuery.at(iWhichQuery);
 
+   // only stored entries whose sequence hashes to the same bucket can be duplicates;
+   // buckets are chained in index order so the first matching entry is still found first
+   unsigned int uiHash = StoredPeptideHash(szProteinSeq + iStartPos, iLenPeptide);
+
    if (g_staticParams.options.iDecoySearch == 2 && bDecoyPep)
    {
-      for (i = 0; i < g_staticParams.options.iNumStored; ++i)
+      StoredResultsOrder* pOrder = &pQuery->_decoysOrder;
+
+      for (i = pOrder->piHashHead[uiHash & pOrder->iHashMask]; i >= 0; i = pOrder->piHashNext[i])
       {
          // Quick check of peptide sequence length first.
          if (iLenPeptide == pQuery->_pDecoys[i].usiLenPeptide && isEqual(dCalcPepMass, pQuery->_pDecoys[i].dPepMass))
@@ -5694,14 +7036,12 @@ int CometSearch::CheckDuplicate(int iWhichQuery,
                      else if (iVal < 0)
                      {
                         // must loop through each modsite and see if OBO string is same
-                        if (strcmp(dbe->vectorPeffMod.at(-(piVarModSites[ii]) - 1).szMod, pQuery->_pDecoys[i].pszMod[ii]))
+                        if (strcmp(dbe->vectorPeffMod.at(-(piVarModSites[ii]) - 1).szMod, pQuery->_pDecoys[i].PeffMod(ii)))
                         {
                            bIsDuplicate = 0;
                            break;
                         }
                      }
-                     else
-                        pQuery->_pDecoys[i].pdVarModSites[i] = 0.0;
                   }
                }
                else
@@ -5718,7 +7058,7 @@ int CometSearch::CheckDuplicate(int iWhichQuery,
                struct ProteinEntryStruct pTmp;
 
                pTmp.lWhichProtein = dbe->lProteinFilePosition;
-               pTmp.iStartResidue = iStartResidue + 1;  // 1 based position
+               pTmp.iStartResidue = StoredStartResidue(iStartResidue);  // 1 based position
 
                if (bDecoyPep)
                {
@@ -5749,6 +7089,9 @@ int CometSearch::CheckDuplicate(int iWhichQuery,
                   // also if IL equivalence set, go ahead and copy peptide from first sequence
                   memcpy(pQuery->_pDecoys[i].szPeptide, szProteinSeq + iStartPos, (pQuery->_pDecoys[i].usiLenPeptide * sizeof(char)));
                   pQuery->_pDecoys[i].szPeptide[pQuery->_pDecoys[i].usiLenPeptide] = '\0';
+
+                  // an I/L swap changes the sequence tie-break
+                  SiftStoredEntry(pOrder, pQuery->_pDecoys, i);
                }
 
                pQuery->iDecoyMatchPeptideCount++;
@@ -5760,7 +7103,9 @@ int CometSearch::CheckDuplicate(int iWhichQuery,
    }
    else
    {
-      for (i = 0; i < g_staticParams.options.iNumStored; ++i)
+      StoredResultsOrder* pOrder = &pQuery->_resultsOrder;
+
+      for (i = pOrder->piHashHead[uiHash & pOrder->iHashMask]; i >= 0; i = pOrder->piHashNext[i])
       {
          // Quick check of peptide sequence length.
          if (iLenPeptide == pQuery->_pResults[i].usiLenPeptide && isEqual(dCalcPepMass, pQuery->_pResults[i].dPepMass))
@@ -5813,7 +7158,7 @@ int CometSearch::CheckDuplicate(int iWhichQuery,
                      else // iVal < 0
                      {
                         // must loop through each modsite and see if OBO string is same
-                        if (strcmp(dbe->vectorPeffMod.at(-(piVarModSites[ii]) - 1).szMod, pQuery->_pResults[i].pszMod[ii]))
+                        if (strcmp(dbe->vectorPeffMod.at(-(piVarModSites[ii]) - 1).szMod, pQuery->_pResults[i].PeffMod(ii)))
                         {
                            bIsDuplicate = 0;
                            break;
@@ -5835,7 +7180,7 @@ int CometSearch::CheckDuplicate(int iWhichQuery,
                struct ProteinEntryStruct pTmp;
 
                pTmp.lWhichProtein = dbe->lProteinFilePosition;
-               pTmp.iStartResidue = iStartResidue + 1;  // 1 based position
+               pTmp.iStartResidue = StoredStartResidue(iStartResidue);  // 1 based position
 
                if (bDecoyPep)
                {
@@ -5879,6 +7224,9 @@ int CometSearch::CheckDuplicate(int iWhichQuery,
                      memcpy(pQuery->_pResults[i].szPeptide, szProteinSeq + iStartPos, pQuery->_pResults[i].usiLenPeptide * sizeof(char));
                      pQuery->_pResults[i].szPeptide[pQuery->_pResults[i].usiLenPeptide] = '\0';
 
+                     // an I/L swap changes the sequence tie-break
+                     SiftStoredEntry(pOrder, pQuery->_pResults, i);
+
                      pQuery->_pResults[i].cPrevAA = pTmp.cPrevAA;
                      pQuery->_pResults[i].cNextAA = pTmp.cNextAA;
                   }
@@ -7205,6 +8553,8 @@ bool CometSearch::MergeVarMods(char* szProteinSeq,
    else
       iLenProteinMinus1 = _proteinInfo.iTmpProteinSeqLength - 1;
 
+   if (_varModInfo.iStartPos == 0)
+      dCalcPepMass += g_staticParams.staticModifications.dAddNterminusProtein;
    if (_varModInfo.iEndPos == iLenProteinMinus1)
       dCalcPepMass += g_staticParams.staticModifications.dAddCterminusProtein;
 
@@ -7481,13 +8831,7 @@ bool CometSearch::MergeVarMods(char* szProteinSeq,
                   {
                      // Need to check if mass is ok
 
-                     // Do a binary search on list of input queries to find matching mass.
-                     iWhichQuery = BinarySearchMass(0, (int)g_pvQuery.size(), dTmpCalcPepMass);
-
-                     // Seek back to first peptide entry that matches mass tolerance in case binary
-                     // search doesn't hit the first entry.
-                     while (iWhichQuery > 0 && g_pvQuery.at(iWhichQuery)->_pepMassInfo.dPeptideMassTolerancePlus >= dCalcPepMass)
-                        iWhichQuery--;
+                     iWhichQuery = FirstCheckedMassMatch(dTmpCalcPepMass);
 
                      // Only if this PEFF mod (plus possible variable mods) is within mass tolerance, continue
                      if (iWhichQuery != -1)
@@ -7548,6 +8892,8 @@ bool CometSearch::MergeVarMods(char* szProteinSeq,
                sDBTmp.cNextAA = szProteinSeq[_varModInfo.iEndPos + 1];
 
             sDBTmp.lIndexProteinFilePosition = _proteinInfo.lProteinFilePosition;
+            sDBTmp.bClippedM = _proteinInfo.bClippedNtermMet;
+            sDBTmp.iStartResidue = _varModInfo.iStartPos;
 
             sDBTmp.pcVarModSites.assign(iLen2, 0);
             for (int x = 0; x < iLen2; x++)  // +2 for n/c term mods
@@ -7555,7 +8901,7 @@ bool CometSearch::MergeVarMods(char* szProteinSeq,
 
             try
             {
-               g_pvDBIndex.push_back(sDBTmp);
+               g_pvDBIndex.push_back(std::move(sDBTmp));
             }
             catch (const std::bad_alloc& e)
             {
@@ -7610,21 +8956,19 @@ bool CometSearch::CalcVarModIons(char* szProteinSeq,
 
    // Compare calculated fragment ions against all matching query spectra
 
-   while (iWhichQuery < (int)g_pvQuery.size())
-   {
-      if (dCalcPepMass < g_pvQuery.at(iWhichQuery)->_pepMassInfo.dPeptideMassToleranceMinus)
-      {
-         // if calculated mass is smaller than low mass range, it
-         // means we reached candidate peptides that are too big
-         break;
-      }
+   MassMatchCursor matchCursor;
+
+   iWhichQuery = FirstMassMatch(dCalcPepMass, iWhichQuery, &matchCursor);
+
+   // set with the decoy ions on the first matching query and reused for the rest
+   int iDecoyStartPos = 0;
+   int iDecoyEndPos = 0;
 
+   while (iWhichQuery != -1)
+   {
       // check mass of peptide again; required for terminal mods that may or may not get applied??
       if (CheckMassMatch(iWhichQuery, dCalcPepMass))
       {
-         int iDecoyStartPos;
-         int iDecoyEndPos;
-
          // Calculate ion series just once to compare against all relevant query spectra
          if (bFirstTimeThroughLoopForPeptide)
          {
@@ -7750,6 +9094,7 @@ bool CometSearch::CalcVarModIons(char* szProteinSeq,
 
             // Now get the set of binned fragment ions once to compare this peptide against all matching spectra.
             // First initialize pbDuplFragment and _uiBinnedIonMasses
+            _bXcorrBinListStale[0] = true;
             for (ctCharge = 1; ctCharge <= g_massRange.usiMaxFragmentCharge; ++ctCharge)
             {
                for (ctIonSeries = 0; ctIonSeries < g_staticParams.ionInformation.iNumIonSeriesUsed; ++ctIonSeries)
@@ -8095,6 +9440,7 @@ bool CometSearch::CalcVarModIons(char* szProteinSeq,
 
                // Now get the set of binned fragment ions once for all matching decoy peptides
                // First initialize pbDuplFragment and _uiBinnedIonMassesDecoy
+               _bXcorrBinListStale[1] = true;
                for (ctCharge = 1; ctCharge <= g_massRange.usiMaxFragmentCharge; ++ctCharge)
                {
                   for (ctIonSeries = 0; ctIonSeries < g_staticParams.ionInformation.iNumIonSeriesUsed; ++ctIonSeries)
@@ -8247,7 +9593,7 @@ bool CometSearch::CalcVarModIons(char* szProteinSeq,
          }
       }
 
-      iWhichQuery++;
+      iWhichQuery = NextMassMatch(dCalcPepMass, &matchCursor);
    }
 
    return true;
@@ -8259,137 +9605,54 @@ bool CometSearch::CheckMassMatch(Query* pQuery,
 {
    int iMassOffsetsSize = (int)g_staticParams.vectorMassOffsets.size();
 
+   // this first check sees if calculated pepmass is within the low/high mass
+   // range (including isotope offsets) of query.
    if ((dCalcPepMass >= pQuery->_pepMassInfo.dPeptideMassToleranceMinus)
       && (dCalcPepMass <= pQuery->_pepMassInfo.dPeptideMassTolerancePlus))
    {
       if (g_staticParams.tolerances.iIsotopeError == 0 && iMassOffsetsSize == 0)
          return true;
-      else if (iMassOffsetsSize > 0)
-      {
-         if (g_staticParams.tolerances.iIsotopeError <= 6)
-         {
-            int iMaxIsotope = 3;
-            if (g_staticParams.tolerances.iIsotopeError < 3)
-               iMaxIsotope = g_staticParams.tolerances.iIsotopeError;
-
-            if (g_staticParams.tolerances.iIsotopeError == 5)
-               iMaxIsotope = 1;
-
-            for (int i = 0; i < iMassOffsetsSize; ++i)
-            {
-               for (int x = 0; x <= iMaxIsotope; ++x)
-               {
-                  if ((pQuery->_pepMassInfo.dPeptideMassToleranceLow <= dCalcPepMass + g_staticParams.vectorMassOffsets[i] + x * C13_DIFF
-                     && dCalcPepMass + g_staticParams.vectorMassOffsets[i] + x * C13_DIFF <= pQuery->_pepMassInfo.dPeptideMassToleranceHigh))
-                  {
-                     return true;
-                  }
-               }
-            }
 
-            if (g_staticParams.tolerances.iIsotopeError >= 4 && g_staticParams.tolerances.iIsotopeError <= 6)
-            {
-               if (g_staticParams.tolerances.iIsotopeError == 4 || g_staticParams.tolerances.iIsotopeError == 5)
-                  iMaxIsotope = 1;
-               else
-                  iMaxIsotope = 3;
+      double pdIsotopes[MAX_ISOTOPE_SHIFTS];
+      int iNumIsotopes = PrecursorIsotopeShifts(pdIsotopes);
 
-               for (int i = 0; i < iMassOffsetsSize; ++i)
-               {
-                  for (int x = 0; x <= iMaxIsotope; ++x)
-                  {
-                     if ((pQuery->_pepMassInfo.dPeptideMassToleranceLow <= dCalcPepMass + g_staticParams.vectorMassOffsets[i] - x * C13_DIFF
-                        && dCalcPepMass + g_staticParams.vectorMassOffsets[i] - x * C13_DIFF <= pQuery->_pepMassInfo.dPeptideMassToleranceHigh))
-                     {
-                        return true;
-                     }
-                  }
-               }
-            }
+      if (iNumIsotopes == 0)
+      {
+         string strErrorMsg = " Error - iIsotopeError=" + std::to_string(g_staticParams.tolerances.iIsotopeError) + ", should not be here!\n";
+         g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
+         logerr(strErrorMsg);
+         return false;
+      }
 
-            return false;
-         }
-         else if (g_staticParams.tolerances.iIsotopeError == 7)
+      if (iMassOffsetsSize > 0)
+      {
+         // need to account for both mass offsets and possible isotope offsets
+         for (int i = 0; i < iMassOffsetsSize; ++i)
          {
-            for (int i = 0; i < iMassOffsetsSize; ++i)
+            for (int x = 0; x < iNumIsotopes; ++x)
             {
-               for (int x = -2; x <= 2; ++x)
+               double dShiftedMass = dCalcPepMass + g_staticParams.vectorMassOffsets[i] + pdIsotopes[x];
+
+               if (pQuery->_pepMassInfo.dPeptideMassToleranceLow <= dShiftedMass
+                  && dShiftedMass <= pQuery->_pepMassInfo.dPeptideMassToleranceHigh)
                {
-                  if ((pQuery->_pepMassInfo.dPeptideMassToleranceLow <= dCalcPepMass + g_staticParams.vectorMassOffsets[i] + x * 4.0070995
-                     && dCalcPepMass + g_staticParams.vectorMassOffsets[i] + x * 4.0070995 <= pQuery->_pepMassInfo.dPeptideMassToleranceHigh))
-                  {
-                     return true;
-                  }
+                  return true;
                }
             }
-            return false;
-         }
-         else
-         {
-            string strErrorMsg = " Error - iIsotopeError=" + std::to_string(g_staticParams.tolerances.iIsotopeError) + ", should not be here!\n";
-            g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
-            logerr(strErrorMsg);
-            return false;
          }
       }
       else
       {
-         if (g_staticParams.tolerances.iIsotopeError <= 6)
+         // only deal with isotope offsets; no mass offsets
+         for (int x = 0; x < iNumIsotopes; ++x)
          {
-            int iMaxIsotope = 3;
-            if (g_staticParams.tolerances.iIsotopeError < 3)
-               iMaxIsotope = g_staticParams.tolerances.iIsotopeError;
-
-            if (g_staticParams.tolerances.iIsotopeError == 5)
-               iMaxIsotope = 1;
-
-            for (int x = 0; x <= iMaxIsotope; ++x)
-            {
-               if ((pQuery->_pepMassInfo.dPeptideMassToleranceLow <= dCalcPepMass + x * C13_DIFF
-                  && dCalcPepMass + x * C13_DIFF <= pQuery->_pepMassInfo.dPeptideMassToleranceHigh))
-               {
-                  return true;
-               }
-            }
-
-            if (g_staticParams.tolerances.iIsotopeError >= 4 && g_staticParams.tolerances.iIsotopeError <= 6)
-            {
-               if (g_staticParams.tolerances.iIsotopeError == 4 || g_staticParams.tolerances.iIsotopeError == 5)
-                  iMaxIsotope = 1;
-               else
-                  iMaxIsotope = 3;
+            double dShiftedMass = dCalcPepMass + pdIsotopes[x];
 
-               for (int x = 0; x <= iMaxIsotope; ++x)
-               {
-                  if ((pQuery->_pepMassInfo.dPeptideMassToleranceLow <= dCalcPepMass - x * C13_DIFF
-                     && dCalcPepMass - x * C13_DIFF <= pQuery->_pepMassInfo.dPeptideMassToleranceHigh))
-                  {
-                     return true;
-                  }
-               }
-            }
-
-            return false;
-         }
-         else if (g_staticParams.tolerances.iIsotopeError == 7)
-         {
-            for (int x = -2; x <= 2; ++x)
+            if (pQuery->_pepMassInfo.dPeptideMassToleranceLow <= dShiftedMass
+               && dShiftedMass <= pQuery->_pepMassInfo.dPeptideMassToleranceHigh)
             {
-               if ((pQuery->_pepMassInfo.dPeptideMassToleranceLow <= dCalcPepMass + x * 4.0070995
-                  && dCalcPepMass + x * 4.0070995 <= pQuery->_pepMassInfo.dPeptideMassToleranceHigh))
-               {
-                  return true;
-               }
+               return true;
             }
-
-            return false;
-         }
-         else
-         {
-            string strErrorMsg = " Error - iIsotopeError=" + std::to_string(g_staticParams.tolerances.iIsotopeError) + ", should not be here!\n";
-            g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
-            logerr(strErrorMsg);
-            return false;
          }
       }
    }
@@ -8416,14 +9679,18 @@ void CometSearch::XcorrScoreI(char* szProteinSeq,
                               unsigned int uiBinnedPrecursorNL[MAX_PRECURSOR_NL_SIZE][MAX_PRECURSOR_CHARGE],
                               int iNumMatchedFragmentIons)
 {
-   int ctLen,
-       ctIonSeries,
-       ctCharge;
    double dXcorr = 0.0;
-   int iLenPeptideMinus1 = iLenPeptide - 1;
 
    bool bPeptideIndex = (g_staticParams.iDbType == DbType::PI_DB);
 
+   // The fragment bins were computed for this query alone, so they are flattened on every call.
+   BuildXcorrBinList(&g_xcorrBinListScratch, uiBinnedIonMasses, iLenPeptide, pQuery->_spectrumInfoInternal.usiMaxFragCharge,
+      bPeptideIndex && g_staticParams.ionInformation.bUseWaterAmmoniaLoss,
+      (g_staticParams.iDbType == DbType::FI_DB ? FRAGINDEX_VMODS : VMODS));
+
+   dXcorr = XcorrSumBinList(&g_xcorrBinListScratch, pQuery,
+      g_staticParams.variableModParameters.bUseFragmentNeutralLoss && iFoundVariableMod == 2);
+
    // iMax is largest x-value allowed as iMax+1 is allocated and we're 0-index
    int iMax = pQuery->_spectrumInfoInternal.iArraySize / SPARSE_MATRIX_SIZE;
 
@@ -8431,80 +9698,6 @@ void CometSearch::XcorrScoreI(char* szProteinSeq,
 
    float** ppSparseFastXcorrData;
 
-   int iWhichIonSeries;
-   bool bUseWaterAmmoniaNLPeaks = false;
-
-   for (ctCharge = 1; ctCharge <= pQuery->_spectrumInfoInternal.usiMaxFragCharge; ++ctCharge)
-   {
-      for (ctIonSeries = 0; ctIonSeries < g_staticParams.ionInformation.iNumIonSeriesUsed; ++ctIonSeries)
-      {
-         iWhichIonSeries = g_staticParams.ionInformation.piSelectedIonSeries[ctIonSeries];
-
-         // For PI_DB, use water/ammonia NL spectrum data for singly-charged a/b/y ions
-         // to match the batch XcorrScore() behavior. FI_DB always uses ppfSparseFastXcorrData.
-         if (bPeptideIndex)
-         {
-            if (g_staticParams.ionInformation.bUseWaterAmmoniaLoss
-               && (iWhichIonSeries == ION_SERIES_A || iWhichIonSeries == ION_SERIES_B || iWhichIonSeries == ION_SERIES_Y))
-            {
-               bUseWaterAmmoniaNLPeaks = true;
-            }
-            else
-               bUseWaterAmmoniaNLPeaks = false;
-
-            if (ctCharge == 1 && bUseWaterAmmoniaNLPeaks)
-               ppSparseFastXcorrData = pQuery->ppfSparseFastXcorrDataNL;
-            else
-               ppSparseFastXcorrData = pQuery->ppfSparseFastXcorrData;
-         }
-         else
-         {
-            ppSparseFastXcorrData = pQuery->ppfSparseFastXcorrData;
-         }
-
-         for (ctLen = 0; ctLen < iLenPeptideMinus1; ++ctLen)
-         {
-            //MH: newer sparse matrix converts bin to sparse matrix bin
-            bin = uiBinnedIonMasses[ctCharge][ctIonSeries][ctLen][0];
-
-            x = bin / SPARSE_MATRIX_SIZE;
-
-            if (!(bin <= 0 || x > iMax || ppSparseFastXcorrData[x] == NULL)) // x should never be > iMax so this is just a safety check
-            {
-               y = bin - (x * SPARSE_MATRIX_SIZE);
-               dXcorr += ppSparseFastXcorrData[x][y];
-            }
-
-            if (g_staticParams.variableModParameters.bUseFragmentNeutralLoss && iFoundVariableMod == 2)
-            {
-               for (int ii = 0; ii < VMODS; ++ii)
-               {
-                  if (g_staticParams.iDbType == DbType::FI_DB && ii >= FRAGINDEX_VMODS)
-                     break;
-
-                  for (int iWhichNL = 0; iWhichNL < 2; ++iWhichNL)
-                  {
-                     if (iWhichNL == 0 && g_staticParams.variableModParameters.varModList[ii].dNeutralLoss == 0.0)
-                        continue;
-                     else if (iWhichNL == 1 && g_staticParams.variableModParameters.varModList[ii].dNeutralLoss2 == 0.0)
-                        continue;
-
-                     bin = uiBinnedIonMasses[ctCharge][ctIonSeries][ctLen][ii + 1 + iWhichNL];
-
-                     x = bin / SPARSE_MATRIX_SIZE;
-
-                     if (!(bin <= 0 || x > iMax || ppSparseFastXcorrData[x] == NULL))
-                     {
-                        y = bin - (x * SPARSE_MATRIX_SIZE);
-                        dXcorr += ppSparseFastXcorrData[x][y];
-                     }
-                  }
-               }
-            }
-         }
-      }
-   }
-
    // precursor NL
    ppSparseFastXcorrData = pQuery->ppfSparseFastXcorrData;
    for (int ctNL = 0; ctNL < g_staticParams.iPrecursorNLSize; ++ctNL)
@@ -8528,36 +9721,9 @@ void CometSearch::XcorrScoreI(char* szProteinSeq,
 
    dXcorr = std::round(dXcorr * 1000.0) / 1000.0;  // round to 3 decimal points
 
-   Threading::LockMutex(pQuery->accessMutex);
-
-   // Increment matched peptide counts.
-   if (bDecoyPep && g_staticParams.options.iDecoySearch == 2)
-      pQuery->_uliNumMatchedDecoyPeptides++;
-   else
-      pQuery->_uliNumMatchedPeptides++;
-
-   if (g_staticParams.options.bPrintExpectScore
-      || g_staticParams.options.bOutputPepXMLFile
-      || g_staticParams.options.bOutputPercolatorFile
-      || g_staticParams.options.bOutputTxtFile)
-   {
-      int iTmp;
-
-      iTmp = (int)(dXcorr * 10.0 + 0.5);
-
-      if (iTmp < 0)
-         iTmp = 0;
-
-      // lump some zero decoy entries into iMinXcorrHisto bin
-      if (szProteinSeq[iStartPos] >= 'A' && szProteinSeq[iStartPos] <= 'H' && iTmp < pQuery->iMinXcorrHisto)
-         iTmp = pQuery->iMinXcorrHisto;
-
-      if (iTmp >= HISTO_SIZE)
-         iTmp = HISTO_SIZE - 1;
+   TallyXcorr(pQuery, bDecoyPep && g_staticParams.options.iDecoySearch == 2, dXcorr, szProteinSeq[iStartPos]);
 
-      pQuery->iXcorrHistogram[iTmp] += 1;
-      pQuery->uiHistogramCount += 1;
-   }
+   Threading::LockMutex(pQuery->accessMutex);
 
    // FI_DB: gate on matched fragment ion count (pre-screened candidates)
    // PI_DB: gate on xcorr and minimum xcorr threshold (all mass-matched candidates scored)
@@ -8606,7 +9772,10 @@ void CometSearch::StorePeptideI(Query* pQuery,
    int iLenPeptide = iEndPos - iStartPos + 1;
    int iLenProteinMinus1 = (int)strlen(szProteinSeq) - 1;
 
-   short siLowestXcorrScoreIndex = pQuery->siLowestXcorrScoreIndex;
+   short siLowestXcorrScoreIndex = (short)pQuery->_resultsOrder.piHeap[0];
+
+   if (pQuery->_pResults[siLowestXcorrScoreIndex].usiLenPeptide > 0)
+      UnlinkStoredEntry(&pQuery->_resultsOrder, pQuery->_pResults, siLowestXcorrScoreIndex);
 
    pQuery->iMatchPeptideCount++;
    pQuery->_pResults[siLowestXcorrScoreIndex].usiLenPeptide = iLenPeptide;
@@ -8700,18 +9869,14 @@ void CometSearch::StorePeptideI(Query* pQuery,
       memset(pQuery->_pResults[siLowestXcorrScoreIndex].pdVarModSites, 0, iSizepdVarModSites);
    }
 
-   // Get new lowest score.
-   pQuery->dLowestXcorrScore = pQuery->_pResults[0].fXcorr;
-   siLowestXcorrScoreIndex = 0;
+   LinkStoredEntry(&pQuery->_resultsOrder, pQuery->_pResults, siLowestXcorrScoreIndex);
+   SiftStoredEntry(&pQuery->_resultsOrder, pQuery->_pResults, siLowestXcorrScoreIndex);
 
-   for (int i = g_staticParams.options.iNumStored - 1; i > 0; --i)
-   {
-      if (pQuery->_pResults[i].fXcorr < pQuery->dLowestXcorrScore || pQuery->_pResults[i].usiLenPeptide == 0)
-      {
-         pQuery->dLowestXcorrScore = pQuery->_pResults[i].fXcorr;
-         siLowestXcorrScoreIndex = i;
-      }
-   }
+   // new lowest xcorr score is at the heap root
+   siLowestXcorrScoreIndex = (short)pQuery->_resultsOrder.piHeap[0];
+   double dLowestXcorrScore = pQuery->_pResults[siLowestXcorrScoreIndex].fXcorr;
+
+   std::atomic_ref<double>(pQuery->dLowestXcorrScore).store(dLowestXcorrScore, std::memory_order_relaxed);
 
    pQuery->siLowestXcorrScoreIndex = siLowestXcorrScoreIndex;
 }
@@ -8837,11 +10002,11 @@ void CometSearch::CompoundModSearch(char *szProteinSeq,
 
          bool bFirstTime = true;
 
-         while (iWhichQuery < (int)g_pvQuery.size())
-         {
-            if (dModMass < g_pvQuery.at(iWhichQuery)->_pepMassInfo.dPeptideMassToleranceMinus)
-               break;
+         MassMatchCursor matchCursor;
 
+         iWhichQuery = FirstMassMatch(dModMass, iWhichQuery, &matchCursor);
+         while (iWhichQuery != -1)
+         {
             if (CheckMassMatch(iWhichQuery, dModMass))
             {
                if (bFirstTime)
@@ -8894,6 +10059,7 @@ void CometSearch::CompoundModSearch(char *szProteinSeq,
                   }
 
                   // Initialize then populate binned target fragment ions
+                  _bXcorrBinListStale[0] = true;
                   for (ctCharge = 1; ctCharge <= g_massRange.usiMaxFragmentCharge; ++ctCharge)
                   {
                      for (ctIonSeries = 0; ctIonSeries < g_staticParams.ionInformation.iNumIonSeriesUsed; ++ctIonSeries)
@@ -9019,6 +10185,7 @@ void CometSearch::CompoundModSearch(char *szProteinSeq,
                         _pdAAreverseDecoy[iPosF] = dYionD;
                      }
 
+                     _bXcorrBinListStale[1] = true;
                      for (ctCharge = 1; ctCharge <= g_massRange.usiMaxFragmentCharge; ++ctCharge)
                      {
                         for (ctIonSeries = 0; ctIonSeries < g_staticParams.ionInformation.iNumIonSeriesUsed; ++ctIonSeries)
@@ -9064,7 +10231,7 @@ void CometSearch::CompoundModSearch(char *szProteinSeq,
                }
             }  // end if CheckMassMatch
 
-            iWhichQuery++;
+            iWhichQuery = NextMassMatch(dModMass, &matchCursor);
          }  // end while iWhichQuery
 
          piVarModSites[iJPosition] = 0;  // reset for next compound mass / next J position
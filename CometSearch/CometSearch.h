@@ -35,26 +35,138 @@
 #include <sstream>
 #include <vector>
 
+struct FastaChunkShared;
+
 struct SearchThreadData
 {
-   sDBEntry dbEntry;
-   bool* pbSearchMemoryPool;
+   vector<sDBEntry> vDBEntry;          // consecutive database entries searched by one job
+   size_t tNumResidues;                // total sequence length of vDBEntry
    ThreadPool* tp;
 
-   SearchThreadData() = default;
-   SearchThreadData(const sDBEntry& dbEntry_in)
-      : dbEntry(dbEntry_in), pbSearchMemoryPool(nullptr), tp(nullptr) {
+   SearchThreadData()
+      : tNumResidues(0), tp(nullptr) {
    }
+};
+
+// A query listed in one bin of the precursor bucket table.  Its window is copied
+// here so most candidates are rejected without touching the Query.
+struct PrecursorBucketEntry
+{
+   double dMinus;     // dPeptideMassToleranceMinus of the query
+   double dPlus;      // dPeptideMassTolerancePlus of the query
+   int iWhichQuery;
+};
+
+// Position within a precursor bin, advanced by CometSearch::NextMassMatch().
+struct MassMatchCursor
+{
+   size_t tEntry;
+   size_t tEnd;
+};
+
+// Kinds of fragment bins in an XcorrBinList.
+#define XCORR_BINS_ION          0     // fragment ions, scored against ppfSparseFastXcorrData
+#define XCORR_BINS_ION_NL       1     // 1+ a/b/y ions scored against ppfSparseFastXcorrDataNL
+#define XCORR_BINS_MODNL        2     // fragment neutral loss ions of variable mods
+#define XCORR_BINS_MODNL_NL     3     // 1+ a/b/y fragment neutral loss ions, against the NL data
+#define XCORR_BIN_KINDS         4
+
+// The nonzero fragment bins of one peptide stored contiguously for the xcorr kernels,
+// grouped by kind and within a kind by fragment charge:  the bins of charges 1 to z
+// of a kind are vuiBins[piEnd[kind][0]] up to vuiBins[piEnd[kind][z]].
+struct XcorrBinList
+{
+   vector<unsigned int> vuiBins;
+   int piEnd[XCORR_BIN_KINDS][MAX_FRAGMENT_CHARGE + 1];
+};
 
-   ~SearchThreadData()
+// Xcorr lookup kernels summing the fast xcorr values of a list of fragment bins.
+typedef double (*XcorrSumSparseFn)(float** ppSparse, int iMax, const unsigned int* puiBins, int iNumBins, double dSum);
+typedef double (*XcorrSumDenseFn)(const float* pfDense, int iLimit, const unsigned int* puiBins, int iNumBins, double dSum);
+
+struct XcorrKernels
+{
+   const char* szName;
+   XcorrSumSparseFn pfnSparse;
+   XcorrSumDenseFn pfnDense;
+};
+
+// Kernel sets defined in CometSearch.cpp, scalar first; the first g_iNumXcorrKernels
+// of them run on this CPU.
+extern const XcorrKernels g_pXcorrKernelTable[];
+extern const int g_iNumXcorrKernels;
+
+// ---------------------------------------------------------------------------
+// Per-thread scratch for counting matched fragments in SearchFragmentIndex.
+//
+// g_pFragmentPeptides is sorted by mass so all candidates of a query fall in one
+// contiguous slice [iSliceStart, iSliceStart + slice size).  Matches are counted in a
+// dense array indexed by offset into that slice.  Each entry carries the generation
+// (query) that last wrote it so the array never needs to be cleared between queries;
+// vTouched lists the entries written for the current query.
+//
+// Lifecycle: grown on demand up to FRAGINDEX_MAX_DENSE_SLICE entries, so at most
+// 8 MB per thread; wider windows are counted in a map instead.  Freed when the
+// thread exits.
+// ---------------------------------------------------------------------------
+struct FragmentIndexScratch
+{
+   struct Counter
    {
-      if (pbSearchMemoryPool)
+      unsigned int uiGeneration;
+      int iCount;
+   };
+
+   vector<Counter> vCounters;
+   vector<unsigned int> vTouched;   // slice offsets counted for the current query
+   unsigned int uiGeneration;
+#ifdef FRAGINDEX_BENCH
+   vector<unsigned int> vAdded;     // every Add() of the current query, in order
+#endif
+
+   FragmentIndexScratch() : uiGeneration(0)
+   {}
+
+   // Start a new query over a slice of iSliceSize peptides.
+   void Reset(size_t iSliceSize)
+   {
+      if (vCounters.size() < iSliceSize)
+         vCounters.resize(iSliceSize, Counter{0, 0});
+
+      vTouched.clear();
+#ifdef FRAGINDEX_BENCH
+      vAdded.clear();
+#endif
+
+      if (++uiGeneration == 0)  // wrapped; clear stale stamps
+      {
+         for (auto& c : vCounters)
+            c.uiGeneration = 0;
+         uiGeneration = 1;
+      }
+   }
+
+   // Count one match of the peptide at slice offset uiOffset.
+   inline void Count(unsigned int uiOffset)
+   {
+      Counter& c = vCounters[uiOffset];
+      if (c.uiGeneration != uiGeneration)
       {
-         *pbSearchMemoryPool = false;
-         pbSearchMemoryPool = nullptr;
+         c.uiGeneration = uiGeneration;
+         c.iCount = 1;
+         vTouched.push_back(uiOffset);
       }
-      dbEntry.vectorPeffMod.clear();
-      dbEntry.vectorPeffVariantSimple.clear();
+      else
+         c.iCount++;
+   }
+
+   // Count() that is also recorded for the benchmark with -DFRAGINDEX_BENCH.
+   inline void Add(unsigned int uiOffset)
+   {
+#ifdef FRAGINDEX_BENCH
+      vAdded.push_back(uiOffset);
+#endif
+      Count(uiOffset);
    }
 };
 
@@ -74,6 +186,9 @@ public:
                          ThreadPool* tp);
    static bool RunSearch(ThreadPool* tp);
 
+   // Releases the peptide list built by a peptide_centric_search run.
+   static void DeletePeptideCentricList();
+
    // Task 1.3: Thread-local overload: searches a caller-owned Query* without
    // touching g_pvQuery.  Allocates its own pbDuplFragment scratch buffer.
    static bool RunSearch(Query* pQuery);
@@ -100,7 +215,11 @@ public:
    static void SearchThreadProc(SearchThreadData* pSearchThreadData,
                                 ThreadPool* tp);
 
-   bool DoSearch(sDBEntry dbe, bool* pbDuplFragment);
+   // Builds the heap and empty sequence hash of a freshly initialized results array.
+   static void InitStoredOrder(StoredResultsOrder* pOrder,
+                               Results* pResults);
+
+   bool DoSearch(sDBEntry& dbe, bool* pbDuplFragment);
 
    // Performance: Mark as const where possible
    bool CheckEnzymeTermini(const char* szProteinSeq,
@@ -111,9 +230,16 @@ public:
    bool CheckEnzymeEndTermini(const char* szProteinSeq,
                               int iEndPos) const;
 
-   int BinarySearchMass(int start,
-                        int end,
-                        double dCalcPepMass) const;
+   // Precursor bucket table mapping candidate peptide masses to g_pvQuery entries;
+   // rebuilt for each batch once g_pvQuery is sorted.
+   static void BuildPrecursorBuckets();
+   static int FirstMassMatch(double dCalcPepMass,
+                             int iFromQuery,
+                             MassMatchCursor* pCursor);
+   static int NextMassMatch(double dCalcPepMass,
+                            MassMatchCursor* pCursor);
+   static int FirstCheckedMassMatch(double dCalcPepMass);
+   static int PrecursorIsotopeShifts(double* pdIsotopes);
    static bool CheckMassMatch(size_t iWhichQuery,
                               double dCalcPepMass);
    // Task 1.2: Thread-local overload accepting Query* directly.
@@ -122,6 +248,19 @@ public:
 
    bool SearchPeptideIndex(ThreadPool* tp);
 
+#ifdef XCORR_BENCH
+   // Times the xcorr lookups of the batch just searched with every kernel set.
+   static void RunXcorrBenchmark();
+#endif
+#ifdef FRAGINDEX_BENCH
+   // Times the counting of fragment index matches of the batch just searched.
+   static void RunFragmentIndexBenchmark();
+#endif
+#ifdef PEPTIDE_CENTRIC_BENCH
+   // Prints the search, digest and sweep times of the batch just searched.
+   static void RunPeptideCentricBenchmark();
+#endif
+
    struct ProteinInfo
    {
        int  iProteinSeqLength;                    // length of sequence
@@ -136,6 +275,8 @@ public:
        int    iPeffNewResidueCount;               // number of new residue(s) being substituted/added in PEFF variant
        char cPrevAA;  // hack for indexdb realtime search
        char cNextAA;  // hack for indexdb realtime search
+       bool bClippedNtermMet;                     // sequence searched starts after a clipped N-term Met
+       int  iPeptideStartResidue;                 // peptide_centric_search: start of the peptide in its protein; -1 otherwise
    };
 
    ProteinInfo _proteinInfo;
@@ -174,6 +315,12 @@ private:
                                 vector<PeffPositionStruct>* vPeffArray,
                                 int iStartPos,
                                 int iEndPos);
+   // 1-based start residue stored for a protein; iStartResidue is the start in
+   // szProteinSeq unless that holds only the peptide (peptide_centric_search).
+   int StoredStartResidue(int iStartResidue) const
+   {
+      return (_proteinInfo.iPeptideStartResidue >= 0 ? _proteinInfo.iPeptideStartResidue : iStartResidue) + 1;
+   }
    void XcorrScore(char *szProteinSeq,
                    int iStartResidue,
                    int iEndResidue,
@@ -217,6 +364,35 @@ private:
                       bool bDecoyResults,
                       int *piVarModSites,
                       struct sDBEntry *dbe);
+   static void TallyXcorr(Query* pQuery,
+                          bool bSeparateDecoy,
+                          double dXcorr,
+                          char cFirstResidue);
+   static double LowestXcorrScore(Query* pQuery,
+                                  bool bSeparateDecoy);
+   static void BuildXcorrBinList(XcorrBinList* pBinList,
+                                 unsigned int uiBinnedIonMasses[MAX_FRAGMENT_CHARGE + 1][NUM_ION_SERIES][MAX_PEPTIDE_LEN][VMODS + 2],
+                                 int iLenPeptide,
+                                 int iMaxFragCharge,
+                                 bool bUseNLData,
+                                 int iNumModNL);
+   static double XcorrSumBinList(const XcorrBinList* pBinList,
+                                 Query* pQuery,
+                                 bool bUseModNL);
+   static bool ReplaceBefore(Results* pResults,
+                             int iA,
+                             int iB);
+   static void SiftStoredEntry(StoredResultsOrder* pOrder,
+                               Results* pResults,
+                               int iEntry);
+   static unsigned int StoredPeptideHash(const char* szPeptide,
+                                         int iLenPeptide);
+   static void LinkStoredEntry(StoredResultsOrder* pOrder,
+                               Results* pResults,
+                               int iEntry);
+   static void UnlinkStoredEntry(StoredResultsOrder* pOrder,
+                                 Results* pResults,
+                                 int iEntry);
    void StorePeptide(size_t iWhichQuery,
                      int iStartResidue,
                      int iStartPos,
@@ -275,25 +451,25 @@ private:
                                    bool* pbDuplFragment);
 
    // Thread-local overload: searches a caller-owned Query* against the
-   // read-only g_pvDBIndex. Does not access g_pvQuery.
+   // read-only peptide index records. Does not access g_pvQuery.
    static void SearchPeptideIndex(Query* pQuery, bool* pbDuplFragment);
 
    void AnalyzePeptideIndex(int iWhichQuery,
-                            DBIndex sDBI,
+                            const DBIndex& sDBI,
                             bool *pbDuplFragment,
                             struct sDBEntry *dbe);
 
    // Thread-local overload accepting Query* directly.
    static void AnalyzePeptideIndex(Query* pQuery,
-                                   DBIndex sDBI,
+                                   const DBIndex& sDBI,
                                    bool* pbDuplFragment,
                                    struct sDBEntry* dbe);
 
-   bool SearchForPeptides(struct sDBEntry dbe,
+   bool SearchForPeptides(struct sDBEntry& dbe,
                           char* szProteinSeq,
                           int iNtermPeptideOnly,  // used in clipped methionine sequence
                           bool* pbDuplFragment);
-   void SearchForVariants(struct sDBEntry dbe,
+   void SearchForVariants(struct sDBEntry& dbe,
                           char* szProteinSeq,
                           bool* pbDuplFragment);
    void CompoundModSearch(char *szProteinSeq,
@@ -369,11 +545,41 @@ private:
    unsigned int       _uiBinnedIonMassesDecoy[MAX_FRAGMENT_CHARGE + 1][NUM_ION_SERIES][MAX_PEPTIDE_LEN][VMODS + 2];
    unsigned int       _uiBinnedPrecursorNL[MAX_PRECURSOR_NL_SIZE][MAX_PRECURSOR_CHARGE];
    unsigned int       _uiBinnedPrecursorNLDecoy[MAX_PRECURSOR_NL_SIZE][MAX_PRECURSOR_CHARGE];
+   XcorrBinList       _xcorrBinList[2];          // target, decoy bins of _uiBinnedIonMasses[Decoy]
+   bool               _bXcorrBinListStale[2];    // set when _uiBinnedIonMasses[Decoy] is rebuilt
+
+   static int  AcquirePoolSlot();       // Pop a free slot; returns index or -1 on timeout
+   static void ReleasePoolSlot(int iSlot);
+
+   static bool RunSearchMappedFasta(int iPercentStart,
+                                    int iPercentEnd,
+                                    ThreadPool* tp,
+                                    bool& bSucceeded);
+   static void SearchFastaChunk(FastaChunkShared* pShared,
+                                size_t tBegin,
+                                size_t tEnd);
+
+   static bool UsePeptideCentricSearch();
+   static bool BuildPeptideCentricList(ThreadPool* tp);
+   static bool RunPeptideCentricSearch(int iPercentStart,
+                                       int iPercentEnd,
+                                       ThreadPool* tp);
+   static void SearchPeptideCentricRange(size_t tBegin,
+                                         size_t tEnd);
+
+   static CometSlotPool _searchSlotPool;  // Free slots of the memory shared by search threads
+   static bool **_ppbDuplFragmentArr;   // Number of arrays equals number of threads
+   static CometSearch **_ppSearchContext;  // Search object owned by each pool slot, reused for every protein
 
-   static int  AcquirePoolSlot();       // Spin-wait for a free slot; returns index or -1 on timeout
+   static vector<PrecursorBucketEntry> _vPrecursorBuckets;  // entries of all bins, ascending query order within a bin
+   static vector<size_t> _vtPrecursorBucketStart;           // first entry of each bin plus one past the last
+   static double _dPrecursorBucketLow;                      // mass at the start of the first bin
+   static double _dPrecursorBucketInvWidth;
 
-   static bool *_pbSearchMemoryPool;    // Pool of memory to be shared by search threads
-   static bool **_ppbDuplFragmentArr;   // Number of arrays equals number of threads
+   static vector<DBIndex> _vPeptideCentricList;  // peptides digested for peptide_centric_search, in mass order
+   static bool _bPeptideCentricListBuilt;
+   static double _dPeptideCentricLow;            // mass range digested into _vPeptideCentricList
+   static double _dPeptideCentricHigh;
 };
 
 #endif // _COMETSEARCH_H_
\ No newline at end of file
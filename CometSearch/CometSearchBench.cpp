@@ -0,0 +1,375 @@
+// Copyright 2023 Jimmy Eng
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Common.h"
+#include "CometSearch.h"
+#include "CometSearchBench.h"
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+
+
+#ifdef FRAGINDEX_BENCH
+// With -DFRAGINDEX_BENCH the matches counted for each fragment index query of a
+// batch are recorded and RunFragmentIndexBenchmark() replays them through the
+// previous unordered_map counter plus full sort and through FragmentIndexScratch
+// plus partial_sort.
+#define FRAGINDEX_BENCH_MAX_ADDS  (1 << 26)   // stop recording past this many matches
+#define FRAGINDEX_BENCH_REPEAT    5
+
+struct FragmentIndexBenchQuery
+{
+   size_t tFirstAdd;       // index into g_vuiFragmentIndexBenchAdds
+   size_t tNumAdds;
+   size_t tSliceSize;
+};
+
+static std::mutex g_fragmentIndexBenchMutex;
+static vector<FragmentIndexBenchQuery> g_vFragmentIndexBenchQueries;
+static vector<unsigned int> g_vuiFragmentIndexBenchAdds;
+
+void RecordFragmentIndexBenchQuery(const FragmentIndexScratch& scratch,
+                                   size_t tSliceSize)
+{
+   std::lock_guard<std::mutex> lock(g_fragmentIndexBenchMutex);
+
+   if (g_vuiFragmentIndexBenchAdds.size() + scratch.vAdded.size() > FRAGINDEX_BENCH_MAX_ADDS)
+      return;
+
+   FragmentIndexBenchQuery query = { g_vuiFragmentIndexBenchAdds.size(), scratch.vAdded.size(), tSliceSize };
+   g_vFragmentIndexBenchQueries.push_back(query);
+   g_vuiFragmentIndexBenchAdds.insert(g_vuiFragmentIndexBenchAdds.end(), scratch.vAdded.begin(), scratch.vAdded.end());
+}
+
+
+// Replays the matches recorded for the batch just searched, counting and ranking the
+// candidates of each query both ways, and prints the time per query.
+void CometSearch::RunFragmentIndexBenchmark()
+{
+   if (g_vFragmentIndexBenchQueries.empty())
+      return;
+
+   auto RankByCount = [](const std::pair<unsigned int, int>& a, const std::pair<unsigned int, int>& b)
+   {
+      if (a.second != b.second) return a.second > b.second;
+      return a.first < b.first;
+   };
+
+   size_t tNumQueries = g_vFragmentIndexBenchQueries.size();
+   size_t tNumCandidates = 0;
+   size_t tChecksumMap = 0;
+   size_t tChecksumDense = 0;
+   std::vector<std::pair<unsigned int, int>> vPeptides;
+
+   // previous version: per-query unordered_map, then a full sort
+   auto tStart = std::chrono::high_resolution_clock::now();
+   for (int iRepeat = 0; iRepeat < FRAGINDEX_BENCH_REPEAT; ++iRepeat)
+   {
+      tChecksumMap = 0;
+
+      for (auto it = g_vFragmentIndexBenchQueries.begin(); it != g_vFragmentIndexBenchQueries.end(); ++it)
+      {
+         std::unordered_map<unsigned int, int> mPeptides;
+         const unsigned int* puiAdds = g_vuiFragmentIndexBenchAdds.data() + it->tFirstAdd;
+
+         for (size_t i = 0; i < it->tNumAdds; ++i)
+            mPeptides[puiAdds[i]] += 1;
+
+         vPeptides.clear();
+         for (auto ix = mPeptides.begin(); ix != mPeptides.end(); ++ix)
+         {
+            if (ix->second >= g_staticParams.options.iFragIndexMinIonsScore)
+               vPeptides.push_back(*ix);
+         }
+
+         sort(vPeptides.begin(), vPeptides.end(), RankByCount);
+         if (vPeptides.size() > FRAGINDEX_MAX_NUMSCORED)
+            vPeptides.resize(FRAGINDEX_MAX_NUMSCORED);
+
+         for (auto ix = vPeptides.begin(); ix != vPeptides.end(); ++ix)
+            tChecksumMap = tChecksumMap * 31 + ix->first * 7 + ix->second;
+      }
+   }
+   auto tMapNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - tStart).count();
+
+   // FragmentIndexScratch as used by SearchFragmentIndex, then a partial_sort
+   FragmentIndexScratch scratch;
+   tStart = std::chrono::high_resolution_clock::now();
+   for (int iRepeat = 0; iRepeat < FRAGINDEX_BENCH_REPEAT; ++iRepeat)
+   {
+      tChecksumDense = 0;
+      tNumCandidates = 0;
+
+      for (auto it = g_vFragmentIndexBenchQueries.begin(); it != g_vFragmentIndexBenchQueries.end(); ++it)
+      {
+         const unsigned int* puiAdds = g_vuiFragmentIndexBenchAdds.data() + it->tFirstAdd;
+
+         scratch.Reset(it->tSliceSize);
+         for (size_t i = 0; i < it->tNumAdds; ++i)
+            scratch.Count(puiAdds[i]);
+
+         vPeptides.clear();
+         for (auto uiOffset : scratch.vTouched)
+         {
+            int iCount = scratch.vCounters[uiOffset].iCount;
+            if (iCount >= g_staticParams.options.iFragIndexMinIonsScore)
+               vPeptides.push_back(std::make_pair(uiOffset, iCount));
+         }
+         tNumCandidates += scratch.vTouched.size();
+
+         auto itScoreEnd = vPeptides.size() > FRAGINDEX_MAX_NUMSCORED ? vPeptides.begin() + FRAGINDEX_MAX_NUMSCORED : vPeptides.end();
+         partial_sort(vPeptides.begin(), itScoreEnd, vPeptides.end(), RankByCount);
+         vPeptides.erase(itScoreEnd, vPeptides.end());
+
+         for (auto ix = vPeptides.begin(); ix != vPeptides.end(); ++ix)
+            tChecksumDense = tChecksumDense * 31 + ix->first * 7 + ix->second;
+      }
+   }
+   auto tDenseNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - tStart).count();
+
+   double dMapUs = tMapNs / (1000.0 * FRAGINDEX_BENCH_REPEAT * tNumQueries);
+   double dDenseUs = tDenseNs / (1000.0 * FRAGINDEX_BENCH_REPEAT * tNumQueries);
+
+   char szOut[SIZE_BUF];
+   sprintf(szOut, "     - fragment index counting: %zu queries, %.0f matches and %.0f candidates per query\n",
+      tNumQueries, (double)g_vuiFragmentIndexBenchAdds.size() / tNumQueries, (double)tNumCandidates / tNumQueries);
+   logout(szOut);
+   sprintf(szOut, "       unordered_map + sort %.2f us/query, dense + partial_sort %.2f us/query (%.1fx), same top %d: %s\n",
+      dMapUs, dDenseUs, dMapUs / dDenseUs, FRAGINDEX_MAX_NUMSCORED, (tChecksumMap == tChecksumDense ? "yes" : "NO"));
+   logout(szOut);
+
+   g_vFragmentIndexBenchQueries.clear();
+   g_vuiFragmentIndexBenchAdds.clear();
+}
+#endif
+
+
+#ifdef XCORR_BENCH
+// With -DXCORR_BENCH every lookup made by XcorrSumBinList during a batch is
+// recorded and replayed through each kernel set by RunXcorrBenchmark().
+#define XCORR_BENCH_MAX_BINS  (1 << 24)   // stop recording past this many bins
+#define XCORR_BENCH_REPEAT    5
+
+struct XcorrBenchCall
+{
+   Query* pQuery;
+   bool bNLData;
+   size_t tFirstBin;       // index into g_vuiXcorrBenchBins
+   int iNumBins;
+};
+
+static std::mutex g_xcorrBenchMutex;
+static vector<XcorrBenchCall> g_vXcorrBenchCalls;
+static vector<unsigned int> g_vuiXcorrBenchBins;
+
+void RecordXcorrBenchCall(Query* pQuery,
+                          bool bNLData,
+                          const unsigned int* puiBins,
+                          int iNumBins)
+{
+   std::lock_guard<std::mutex> lock(g_xcorrBenchMutex);
+
+   if (g_vuiXcorrBenchBins.size() + iNumBins > XCORR_BENCH_MAX_BINS)
+      return;
+
+   XcorrBenchCall call = { pQuery, bNLData, g_vuiXcorrBenchBins.size(), iNumBins };
+   g_vXcorrBenchCalls.push_back(call);
+   g_vuiXcorrBenchBins.insert(g_vuiXcorrBenchBins.end(), puiBins, puiBins + iNumBins);
+}
+
+
+// Sums every recorded lookup with one kernel set, on the dense array where the query
+// has one if bUseDense, else on the sparse rows.  Returns the checksum; *pdNs gets the
+// time per bin in nanoseconds.
+static double ReplayXcorrBenchCalls(const XcorrKernels& kernels,
+                                    bool bUseDense,
+                                    double* pdNs)
+{
+   double dChecksum = 0.0;
+
+   auto tStart = std::chrono::high_resolution_clock::now();
+
+   for (int iRepeat = 0; iRepeat < XCORR_BENCH_REPEAT; ++iRepeat)
+   {
+      dChecksum = 0.0;
+
+      for (auto it = g_vXcorrBenchCalls.begin(); it != g_vXcorrBenchCalls.end(); ++it)
+      {
+         Query* pQuery = it->pQuery;
+         int iMax = pQuery->_spectrumInfoInternal.iArraySize / SPARSE_MATRIX_SIZE;
+         const unsigned int* puiBins = g_vuiXcorrBenchBins.data() + it->tFirstBin;
+         const float* pfDense = (it->bNLData ? pQuery->pfDenseFastXcorrDataNL : pQuery->pfDenseFastXcorrData);
+
+         if (bUseDense && pfDense != NULL)
+            dChecksum += kernels.pfnDense(pfDense, (iMax + 1) * SPARSE_MATRIX_SIZE, puiBins, it->iNumBins, 0.0);
+         else
+            dChecksum += kernels.pfnSparse((it->bNLData ? pQuery->ppfSparseFastXcorrDataNL : pQuery->ppfSparseFastXcorrData),
+               iMax, puiBins, it->iNumBins, 0.0);
+      }
+   }
+
+   auto tElapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - tStart).count();
+   *pdNs = (double)tElapsed / ((double)XCORR_BENCH_REPEAT * (double)g_vuiXcorrBenchBins.size());
+
+   return dChecksum;
+}
+
+
+void CometSearch::RunXcorrBenchmark()
+{
+   if (g_vXcorrBenchCalls.empty())
+      return;
+
+   size_t tDenseBins = 0;
+   for (auto it = g_vXcorrBenchCalls.begin(); it != g_vXcorrBenchCalls.end(); ++it)
+   {
+      if ((it->bNLData ? it->pQuery->pfDenseFastXcorrDataNL : it->pQuery->pfDenseFastXcorrData) != NULL)
+         tDenseBins += it->iNumBins;
+   }
+
+   char szOut[SIZE_BUF];
+   sprintf(szOut, "     - xcorr kernels: %zu lookups, %zu bins, %.1f%% of bins on dense arrays\n",
+      g_vXcorrBenchCalls.size(), g_vuiXcorrBenchBins.size(), 100.0 * tDenseBins / g_vuiXcorrBenchBins.size());
+   logout(szOut);
+
+   double dReference = 0.0;
+   for (int i = 0; i < g_iNumXcorrKernels; ++i)
+   {
+      double dSparseNs;
+      double dSearchNs;
+      double dSparse = ReplayXcorrBenchCalls(g_pXcorrKernelTable[i], false, &dSparseNs);
+      double dSearch = ReplayXcorrBenchCalls(g_pXcorrKernelTable[i], true, &dSearchNs);
+
+      if (i == 0)
+         dReference = dSparse;
+
+      sprintf(szOut, "       %-8s sparse %.2f ns/bin, dense where set %.2f ns/bin, checksum diff %.3g\n",
+         g_pXcorrKernelTable[i].szName, dSparseNs, dSearchNs, std::max(fabs(dSparse - dReference), fabs(dSearch - dReference)));
+      logout(szOut);
+   }
+
+   g_vXcorrBenchCalls.clear();
+   g_vuiXcorrBenchBins.clear();
+}
+#endif
+
+
+#ifdef FRAGINDEX_BENCH
+// With -DFRAGINDEX_BENCH, time a full scan of every posting list in the plain and the
+// packed layout and report the packed bits per entry.
+#define FRAGINDEX_BENCH_SCANS  5
+
+void BenchPackedDecode(size_t iNumLists)
+{
+   unsigned int puiBlock[FRAGINDEX_PACK_BLOCK];
+   unsigned long long ullSumPlain = 0;
+   unsigned long long ullSumPacked = 0;
+   size_t tEntries = g_iFragmentIndexOffset[iNumLists];
+
+   auto tStart = std::chrono::steady_clock::now();
+   for (int iRepeat = 0; iRepeat < FRAGINDEX_BENCH_SCANS; ++iRepeat)
+   {
+      for (size_t i = 0; i < tEntries; ++i)
+         ullSumPlain += g_iFragmentIndex[i];
+   }
+   auto tPlainNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - tStart).count();
+
+   tStart = std::chrono::steady_clock::now();
+   for (int iRepeat = 0; iRepeat < FRAGINDEX_BENCH_SCANS; ++iRepeat)
+   {
+      for (size_t i = 0; i < iNumLists; ++i)
+      {
+         const unsigned char* pBlock = g_ucFragmentIndexPacked + g_ullFragmentIndexPackedOffset[i];
+         size_t tCount = g_iFragmentIndexOffset[i + 1] - g_iFragmentIndexOffset[i];
+
+         for (size_t j = 0; j < tCount; j += FRAGINDEX_PACK_BLOCK)
+         {
+            unsigned int uiBlock = (unsigned int)(std::min)((size_t)FRAGINDEX_PACK_BLOCK, tCount - j);
+            CometFragmentIndex::UnpackBlock(pBlock, uiBlock, puiBlock);
+            for (unsigned int k = 0; k < uiBlock; ++k)
+               ullSumPacked += puiBlock[k];
+            pBlock = CometFragmentIndex::PackedBlockNext(pBlock, uiBlock);
+         }
+      }
+   }
+   auto tPackedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - tStart).count();
+
+   double dScale = 1.0 / ((double)FRAGINDEX_BENCH_SCANS * (tEntries > 0 ? tEntries : 1));
+   printf("\n   - fragment index bench: %zu entries, %0.2f bits/entry packed, scan plain %0.3f ns/entry, packed %0.3f ns/entry%s\n",
+      tEntries, 8.0 * g_ullFragmentIndexPackedOffset[iNumLists] / (tEntries > 0 ? tEntries : 1),
+      tPlainNs * dScale, tPackedNs * dScale, ullSumPlain == ullSumPacked ? "" : " MISMATCH");
+}
+#endif
+
+
+#ifdef PEPTIDE_CENTRIC_BENCH
+// With -DPEPTIDE_CENTRIC_BENCH the time of each batch's database search is printed
+// after the batch, split into the digest and the sweep when peptide_centric_search
+// is set, along with the totals of the run so far.  Running the same input with
+// peptide_centric_search 0 and 1 compares the protein-centric and merge-join sweeps.
+static double g_pdPeptideCentricBenchSeconds[3];
+static size_t g_ptPeptideCentricBenchPeptides[3];
+static bool g_pbPeptideCentricBenchRecorded[3];
+static double g_pdPeptideCentricBenchTotal[3];
+
+void RecordPeptideCentricBenchStep(int iStep,
+                                   double dSeconds,
+                                   size_t tNumPeptides)
+{
+   g_pdPeptideCentricBenchSeconds[iStep] += dSeconds;
+   g_ptPeptideCentricBenchPeptides[iStep] += tNumPeptides;
+   g_pbPeptideCentricBenchRecorded[iStep] = true;
+   g_pdPeptideCentricBenchTotal[iStep] += dSeconds;
+}
+
+
+void CometSearch::RunPeptideCentricBenchmark()
+{
+   if (!g_pbPeptideCentricBenchRecorded[PEPTIDE_CENTRIC_BENCH_SEARCH])
+      return;
+
+   char szOut[SIZE_BUF];
+
+   if (g_staticParams.options.iPeptideCentricSearch)
+   {
+      sprintf(szOut, "     - peptide-centric search: %.3f s", g_pdPeptideCentricBenchSeconds[PEPTIDE_CENTRIC_BENCH_SEARCH]);
+      logout(szOut);
+
+      if (g_pbPeptideCentricBenchRecorded[PEPTIDE_CENTRIC_BENCH_DIGEST])
+      {
+         sprintf(szOut, ", digest %.3f s (%zu peptides)", g_pdPeptideCentricBenchSeconds[PEPTIDE_CENTRIC_BENCH_DIGEST],
+            g_ptPeptideCentricBenchPeptides[PEPTIDE_CENTRIC_BENCH_DIGEST]);
+         logout(szOut);
+      }
+
+      sprintf(szOut, ", sweep %.3f s (%zu peptides); run total %.3f s (digest %.3f s)\n",
+         g_pdPeptideCentricBenchSeconds[PEPTIDE_CENTRIC_BENCH_SWEEP], g_ptPeptideCentricBenchPeptides[PEPTIDE_CENTRIC_BENCH_SWEEP],
+         g_pdPeptideCentricBenchTotal[PEPTIDE_CENTRIC_BENCH_SEARCH], g_pdPeptideCentricBenchTotal[PEPTIDE_CENTRIC_BENCH_DIGEST]);
+      logout(szOut);
+   }
+   else
+   {
+      sprintf(szOut, "     - protein-centric search: %.3f s; run total %.3f s\n",
+         g_pdPeptideCentricBenchSeconds[PEPTIDE_CENTRIC_BENCH_SEARCH], g_pdPeptideCentricBenchTotal[PEPTIDE_CENTRIC_BENCH_SEARCH]);
+      logout(szOut);
+   }
+
+   for (int i = 0; i < 3; ++i)
+   {
+      g_pdPeptideCentricBenchSeconds[i] = 0.0;
+      g_ptPeptideCentricBenchPeptides[i] = 0;
+      g_pbPeptideCentricBenchRecorded[i] = false;
+   }
+}
+#endif
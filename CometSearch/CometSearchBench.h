@@ -0,0 +1,59 @@
+// Copyright 2023 Jimmy Eng
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _COMETSEARCHBENCH_H_
+#define _COMETSEARCHBENCH_H_
+
+#include "Common.h"
+#include "CometSearch.h"
+
+// Benchmarks built in with -DFRAGINDEX_BENCH, -DXCORR_BENCH or -DPEPTIDE_CENTRIC_BENCH.
+// The search records the work of each batch through the functions below;
+// CometSearchManager replays or prints it after the batch with
+// CometSearch::RunFragmentIndexBenchmark(), RunXcorrBenchmark() and
+// RunPeptideCentricBenchmark().
+
+#ifdef FRAGINDEX_BENCH
+// Records the matches counted in scratch for one fragment index query.
+void RecordFragmentIndexBenchQuery(const FragmentIndexScratch& scratch,
+                                   size_t tSliceSize);
+
+// Times a scan of the first iNumLists posting lists, plain and compressed, while
+// both g_iFragmentIndex and g_ucFragmentIndexPacked are set.
+void BenchPackedDecode(size_t iNumLists);
+#endif
+
+#ifdef XCORR_BENCH
+// Records one XcorrSumBinList lookup of iNumBins fragment bins.
+void RecordXcorrBenchCall(Query* pQuery,
+                          bool bNLData,
+                          const unsigned int* puiBins,
+                          int iNumBins);
+#endif
+
+#ifdef PEPTIDE_CENTRIC_BENCH
+enum PeptideCentricBenchStep
+{
+   PEPTIDE_CENTRIC_BENCH_SEARCH,    // RunSearch() of a batch, in either mode
+   PEPTIDE_CENTRIC_BENCH_DIGEST,    // digest into the peptide-centric list
+   PEPTIDE_CENTRIC_BENCH_SWEEP      // scoring of the batch's mass range of the list
+};
+
+// Records the time of one step of a batch and the number of peptides it handled.
+void RecordPeptideCentricBenchStep(int iStep,
+                                   double dSeconds,
+                                   size_t tNumPeptides);
+#endif
+
+#endif // _COMETSEARCHBENCH_H_
@@ -30,10 +30,14 @@
 #include "CometPeptideIndex.h"
 #include "CometSpecLib.h"
 #include "CometAlignment.h"
+#ifdef PEPTIDE_CENTRIC_BENCH
+#include "CometSearchBench.h"
+#endif
 #include "AScoreOptions.h"
 #include "AScoreFactory.h"
 
 #include <sstream>
+#include <thread>
 #include <cstdio>
 
 #ifdef _WIN32
@@ -65,6 +69,7 @@ static size_t GetPeakMemoryKB()
 extern comet_fileoffset_t clSizeCometFileOffset;
 
 std::vector<Query*>           g_pvQuery;
+CometArena                    g_batchArena(32 * 1024 * 1024, true);
 
 // g_pvQueryMS1: BATCH PATH ONLY - used by RunMS1Search(ThreadPool*,...) and
 // PreprocessMS1SingleSpectrum(). The single-spectrum MS1 search path
@@ -78,8 +83,6 @@ vector<DBIndex>               g_pvDBIndex;
 MassRange                     g_massRange;
 Mutex                         g_pvQueryMutex;
 Mutex                         g_pvDBIndexMutex;
-Mutex                         g_preprocessMemoryPoolMutex;
-Mutex                         g_searchMemoryPoolMutex;
 Mutex                         g_ms1AlignerMutex;
 CometStatus                   g_cometStatus;
 string                        g_sCometVersion;
@@ -95,12 +98,20 @@ AScoreProCpp::AScoreOptions   g_AScoreOptions;  // AScore options
 AScoreProCpp::AScoreDllInterface* g_AScoreInterface;
 
 vector<vector<comet_fileoffset_t>> g_pvProteinsList;
+const unsigned long long* g_pullMappedProteinListOffset = NULL;  // set when the fragment index is mapped from a .fidx file
+const comet_fileoffset_t* g_plMappedProteinList = NULL;
 
 // Fragment index globals - INITIALIZED ONCE, READ-ONLY DURING SEARCH
 unsigned int* g_iFragmentIndex;                             // CSR flat data: concatenated posting lists
-unsigned int* g_iFragmentIndexOffset;                       // CSR offsets [uiMaxFragmentArrayIndex+1]
+unsigned int* g_iFragmentIndexOffset;                       // CSR offsets [g_uiNumFragmentSlabs*uiMaxFragmentArrayIndex+1]
+unsigned int g_uiNumFragmentSlabs = 1;                      // number of precursor mass slabs
+unsigned int* g_uiFragmentSlabPeptide;                      // first g_vFragmentPeptides entry of each slab [g_uiNumFragmentSlabs+1]
+unsigned char* g_ucFragmentIndexPacked;                     // compressed posting lists; NULL unless fragindex_compress
+unsigned long long* g_ullFragmentIndexPackedOffset;         // byte offset of each posting list in g_ucFragmentIndexPacked
 bool* g_bIndexPrecursors;                                   // array for BIN(precursors), set to true if precursor present in file
 vector<struct FragmentPeptidesStruct> g_vFragmentPeptides;  // each peptide is represented here iWhichPeptide, which mod if any, calculated mass
+const FragmentPeptidesStruct* g_pFragmentPeptides = NULL;   // g_vFragmentPeptides.data() or the mapped .fidx peptide table
+size_t g_tNumFragmentPeptides = 0;
 vector<PlainPeptideIndexStruct> g_vRawPeptides;             // list of unmodified peptides and their proteins as file pointers
 vector<vector<unsigned int>> g_vulSpecLibPrecursorIndex;    // mass index for SpecLib
 vector<SpecLibStruct> g_vSpecLib;                           // stores the SpecLib
@@ -258,18 +269,30 @@ static bool UpdateInputFile(InputFileInfo *pFileInfo)
    return true;
 }
 
-static void SetMSLevelFilter(MSReader &mstReader)
+// Queries built by the batch preprocessor live in g_batchArena; so do their results.
+static Results* NewResultsArray(Query* pQuery)
 {
-   vector<MSSpectrumType> msLevel;
+   if (!pQuery->bInBatchArena)
+      return new Results[g_staticParams.options.iNumStored];
+
+   Results *pResults = g_batchArena.AllocateArray<Results>(g_staticParams.options.iNumStored);
+   for (int i = 0; i < g_staticParams.options.iNumStored; ++i)
+      new (pResults + i) Results;
+   return pResults;
+}
 
-   if (g_staticParams.options.iMSLevel == 3)
-      msLevel.push_back(MS3);
-   else if (g_staticParams.options.iMSLevel == 2)
-      msLevel.push_back(MS2);
-   else if (g_staticParams.options.iMSLevel == 1)
-      msLevel.push_back(MS1);
+// Heap and sequence hash tables for one results array, from the same storage as the results.
+static void NewStoredOrder(Query* pQuery,
+                           StoredResultsOrder* pOrder)
+{
+   int iNumStored = g_staticParams.options.iNumStored;
+   int iNumBuckets;
+   size_t tSize = StoredResultsOrder::BlockSize(iNumStored, &iNumBuckets);
 
-   mstReader.setFilter(msLevel);
+   if (pQuery->bInBatchArena)
+      pOrder->SetBlock(g_batchArena.AllocateArray<int>(tSize), iNumStored, iNumBuckets);
+   else
+      pOrder->SetBlock(new int[tSize], iNumStored, iNumBuckets);
 }
 
 // Allocate memory for the _pResults struct for each g_pvQuery entry.
@@ -281,7 +304,8 @@ static bool AllocateResultsMem()
 
       try
       {
-         pQuery->_pResults = new Results[g_staticParams.options.iNumStored];
+         pQuery->_pResults = NewResultsArray(pQuery);
+         NewStoredOrder(pQuery, &pQuery->_resultsOrder);
       }
       catch (std::bad_alloc& ba)
       {
@@ -295,7 +319,8 @@ static bool AllocateResultsMem()
       {
          try
          {
-            pQuery->_pDecoys = new Results[g_staticParams.options.iNumStored];
+            pQuery->_pDecoys = NewResultsArray(pQuery);
+            NewStoredOrder(pQuery, &pQuery->_decoysOrder);
          }
          catch (std::bad_alloc& ba)
          {
@@ -348,6 +373,10 @@ static bool AllocateResultsMem()
             pQuery->_pDecoys[j].iPeffOrigResiduePosition = -9;
          }
       }
+
+      CometSearch::InitStoredOrder(&pQuery->_resultsOrder, pQuery->_pResults);
+      if (g_staticParams.options.iDecoySearch==2)
+         CometSearch::InitStoredOrder(&pQuery->_decoysOrder, pQuery->_pDecoys);
    }
 
    return true;
@@ -594,12 +623,6 @@ CometSearchManager::CometSearchManager() :
    // Initialize the mutexes we'll use to protect DBIndex.
    Threading::InitMutex(&g_pvDBIndexMutex);
 
-   // Initialize the mutex we'll use to protect the preprocess memory pool
-   Threading::InitMutex(&g_preprocessMemoryPoolMutex);
-
-   // Initialize the mutex we'll use to protect the search memory pool
-   Threading::InitMutex(&g_searchMemoryPoolMutex);
-
    // Initialize the mutex we'll use to protect the MS1 RT aligner
    Threading::InitMutex(&g_ms1AlignerMutex);
 
@@ -622,12 +645,6 @@ CometSearchManager::~CometSearchManager()
    // Destroy the mutex we used to protect g_pvDBIndex.
    Threading::DestroyMutex(g_pvDBIndexMutex);
 
-   // Destroy the mutex we used to protect the preprocess memory pool
-   Threading::DestroyMutex(g_preprocessMemoryPoolMutex);
-
-   // Destroy the mutex we used to protect the search memory pool
-   Threading::DestroyMutex(g_searchMemoryPoolMutex);
-
    // Destroy the mutex we used to protect the MS1 RT aligner
    Threading::DestroyMutex(g_ms1AlignerMutex);
 
@@ -1227,6 +1244,13 @@ bool CometSearchManager::InitializeStaticParams()
    GetParamValue("fragindex_min_ions_score", g_staticParams.options.iFragIndexMinIonsScore);
    GetParamValue("fragindex_min_ions_report", g_staticParams.options.iFragIndexMinIonsReport);
    GetParamValue("fragindex_skipreadprecursors", g_staticParams.options.iFragIndexSkipReadPrecursors);
+   GetParamValue("fragindex_cache", g_staticParams.options.iFragIndexCache);
+   GetParamValue("fragindex_compress", g_staticParams.options.iFragIndexCompress);
+   if (GetParamValue("fragindex_slab_width", dDoubleData))
+   {
+      if (dDoubleData >= 0.0)
+         g_staticParams.options.dFragIndexSlabWidth = dDoubleData;
+   }
 
    GetParamValue("num_enzyme_termini", g_staticParams.options.iEnzymeTermini);
    if ((g_staticParams.options.iEnzymeTermini != 1)
@@ -1266,6 +1290,18 @@ bool CometSearchManager::InitializeStaticParams()
          g_staticParams.options.iSpectrumBatchSize = iIntData;
    }
 
+   GetParamValue("spectrum_batch_pipeline", g_staticParams.options.iSpectrumBatchPipeline);
+
+   if (GetParamValue("spectrum_batch_files", iIntData))
+   {
+      if (iIntData >= 1)
+         g_staticParams.options.iSpectrumBatchFiles = iIntData;
+   }
+
+   GetParamValue("peptide_centric_search", g_staticParams.options.iPeptideCentricSearch);
+
+   GetParamValue("gzindex_cache", g_staticParams.options.iGZIndexCache);
+
    if (GetParamValue("minimum_peaks", iIntData))
    {
       if (iIntData >= 0)
@@ -2188,562 +2224,1367 @@ bool CometSearchManager::CreatePeptideIndex()
    return DoSearch();
 }
 
-bool CometSearchManager::DoSearch()
+// Output files of one input file.  They are opened before the file's first batch
+// is searched and closed once its last batch is written.
+struct OutputFiles
+{
+   FILE *fpout_sqt;
+   FILE *fpoutd_sqt;
+   FILE *fpout_pepxml;
+   FILE *fpoutd_pepxml;
+   FILE *fpout_mzidentml;
+   FILE *fpoutd_mzidentml;
+   FILE *fpout_mzidentmltmp;
+   FILE *fpoutd_mzidentmltmp;
+   FILE *fpout_percolator;
+   FILE *fpout_txt;
+   FILE *fpoutd_txt;
+
+   std::string sOutputSQT;
+   std::string sOutputDecoySQT;
+   std::string sOutputPepXML;
+   std::string sOutputDecoyPepXML;
+   std::string sOutputMzIdentML;
+   std::string sOutputDecoyMzIdentML;
+   std::string sOutputMzIdentMLtmp;         // temporary file used to hold mzIdentML output before finalizing
+   std::string sOutputDecoyMzIdentMLtmp;    // temporary file used to hold decoy mzIdentML output before finalizing
+   std::string sOutputPercolator;
+   std::string sOutputTxt;
+   std::string sOutputDecoyTxt;
+
+   OutputFiles()
+      : fpout_sqt(NULL), fpoutd_sqt(NULL), fpout_pepxml(NULL), fpoutd_pepxml(NULL),
+        fpout_mzidentml(NULL), fpoutd_mzidentml(NULL), fpout_mzidentmltmp(NULL), fpoutd_mzidentmltmp(NULL),
+        fpout_percolator(NULL), fpout_txt(NULL), fpoutd_txt(NULL)
+   {
+   }
+};
+
+
+// Open the requested output files for g_staticParams.inputFile and write their headers.
+static bool OpenOutputFiles(OutputFiles &out,
+                            int iAnalysisType,
+                            int iFirstScan,
+                            int iLastScan,
+                            CometSearchManager &searchMgr)
 {
-   string strOut;
-
-   ThreadPool *tp = _tp;
-
-   auto tGlobalStartTime = chrono::steady_clock::now();
-
-   if (!InitializeStaticParams())
-      return false;
-
-   if (!ValidateOutputFormat())
-      return false;
-
-   if (strlen(g_staticParams.databaseInfo.szDatabase) == 0 || !ValidateSequenceDatabaseFile())
-      g_bPerformDatabaseSearch = false;
-   else
-      g_bPerformDatabaseSearch = true;
-
-   if (g_staticParams.speclibInfo.strSpecLibFile.size() == 0 || !ValidateSpecLibFile())
-      g_bPerformSpecLibSearch = false;
-   else
-      g_bPerformSpecLibSearch = true;
-
-   if (g_bPerformDatabaseSearch == false && g_bPerformSpecLibSearch == false)
-      return false;
-
-   if (!ValidateScanRange())
-      return false;
-
-   if (!ValidatePeptideLengthRange())
-      return false;
-
    bool bSucceeded = true;
 
-   // add git hash to version string if present
-   // repeated here from Comet main() as main() is skipped when search invoked via DLL
-   if (strlen(GITHUBSHA) > 0)
+   if (g_staticParams.options.bOutputSqtFile)
    {
-      string sTmp = std::string(GITHUBSHA);
-      if (sTmp.size() > 7)
-         sTmp.resize(7);
-      g_sCometVersion = std::string(comet_version) + " (" + sTmp + ")";
-   }
-   else
-      g_sCometVersion = std::string(comet_version);
+      if (iAnalysisType == AnalysisType_EntireFile)
+      {
+         out.sOutputSQT = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix + ".sqt";
 
-   if (!g_staticParams.options.bOutputSqtStream)
-   {
-      strOut = "\n Comet version \"" + g_sCometVersion + "\"\n\n";
-      logout(strOut);
-      fflush(stdout);
-   }
+#ifdef CRUX
+         if (g_staticParams.options.iDecoySearch == 2)
+         {
+            out.sOutputSQT = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix + ".target.sqt";
+         }
+#endif
+      }
+      else
+      {
+         out.sOutputSQT = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix +
+            "." + std::to_string(iFirstScan) + "-" + std::to_string(iLastScan) + ".sqt";
+#ifdef CRUX
+         if (g_staticParams.options.iDecoySearch == 2)
+            out.sOutputSQT = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix +
+            "." + std::to_string(iFirstScan) + "-" + std::to_string(iLastScan) + ".target.sqt";
+#endif
+      }
 
-   try
-   {
-      tp->fillPool(g_staticParams.options.iNumThreads);
-   }
-   catch (const std::exception& e)
-   {
-      string strErrorMsg = " Error - thread pool initialization failed: " + std::string(e.what()) + "\n";
-      g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
-      logerr(strErrorMsg);
-      return false;
-   }
+      if ((out.fpout_sqt = fopen(out.sOutputSQT.c_str(), "w")) == NULL)
+      {
+         string strErrorMsg = " Error - cannot write to file \"" + out.sOutputSQT + "\".\n";
+         g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
+         logerr(strErrorMsg);
+         bSucceeded = false;
+      }
 
-   if (g_staticParams.options.bCreatePeptideIndex && g_staticParams.iDbType == DbType::FASTA_DB)
-   {
-      // WritePeptideIndex calls RunSearch just to query fasta and generate unique peptide list
-      bSucceeded = CometPeptideIndex::WritePeptideIndex(tp);
-      return bSucceeded;
-   }
+      CometWriteSqt::PrintSqtHeader(out.fpout_sqt, searchMgr);
 
-   if (g_staticParams.options.bCreateFragmentIndex || g_staticParams.iDbType == DbType::FASTA_DB)
-   {
-      // If specified, read in the protein variable mod filter file content.
-      // Do this here only for classic search or if creating the plain peptide index.
-      if (g_staticParams.variableModParameters.sProteinLModsListFile.length() > 0)
+      if (bSucceeded && (g_staticParams.options.iDecoySearch == 2))
       {
-         bool bVarModUsed = false;
+         if (iAnalysisType == AnalysisType_EntireFile)
+            out.sOutputDecoySQT = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix + ".decoy.sqt";
+         else
+            out.sOutputDecoySQT = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix +
+            "." + std::to_string(iFirstScan) + "-" + std::to_string(iLastScan) + ".decoy.sqt";
 
-         // Do a quick check to confirm there's a variable mod specified,
-         // otherwise there's no point in parsing the file.
-         for (int iMod = 0; iMod < VMODS; ++iMod)
+         if ((out.fpoutd_sqt = fopen(out.sOutputDecoySQT.c_str(), "w")) == NULL)
          {
-            if (g_staticParams.variableModParameters.varModList[iMod].dVarModMass != 0.0)
-            {
-               bVarModUsed = true;
-               break;
-            }
+            string strErrorMsg = " Error - cannot write to decoy file \"" + out.sOutputDecoySQT + "\".\n";
+            g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
+            logerr(strErrorMsg);
+            bSucceeded = false;
          }
 
-         if (bVarModUsed)
-         {
-            bSucceeded = ReadProteinVarModFilterFile();
-            if (!bSucceeded)
-               return bSucceeded;
-         }
+         CometWriteSqt::PrintSqtHeader(out.fpoutd_sqt, searchMgr);
       }
    }
 
-   // Load compound mods mass file if specified (B4 fix: only if parameter is explicitly set)
-   if (g_staticParams.variableModParameters.sCompoundModsFile.length() > 0)
+   if (bSucceeded && g_staticParams.options.bOutputTxtFile)
    {
-      FILE *fpCM;
-      if ((fpCM = fopen(g_staticParams.variableModParameters.sCompoundModsFile.c_str(), "r")) != NULL)
+      if (iAnalysisType == AnalysisType_EntireFile)
       {
-         char szBuf[512];
-         double dTmp;
-
-         printf(" Parsing compoundmods file: %s\n", g_staticParams.variableModParameters.sCompoundModsFile.c_str());
-
-         while (fgets(szBuf, sizeof(szBuf), fpCM))
-         {
-            if (sscanf(szBuf, "%lf", &dTmp) == 1)
-               g_staticParams.variableModParameters.vdCompoundMasses.push_back(dTmp);
-         }
-         fclose(fpCM);
-
-         sort(g_staticParams.variableModParameters.vdCompoundMasses.begin(),
-              g_staticParams.variableModParameters.vdCompoundMasses.end());
-         g_staticParams.variableModParameters.vdCompoundMasses.erase(
-            unique(g_staticParams.variableModParameters.vdCompoundMasses.begin(),
-                   g_staticParams.variableModParameters.vdCompoundMasses.end()),
-            g_staticParams.variableModParameters.vdCompoundMasses.end());
-
-         g_staticParams.variableModParameters.uiNumCompoundMasses = (unsigned int)g_staticParams.variableModParameters.vdCompoundMasses.size();
-
-         if (g_staticParams.variableModParameters.uiNumCompoundMasses > 0)
-            g_staticParams.variableModParameters.bVarModSearch = true;  // B6: drives WithVariableMods path; see docs for trade-off
+         out.sOutputTxt = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix + "." + g_staticParams.szTxtFileExt;
+#ifdef CRUX
+         if (g_staticParams.options.iDecoySearch == 2)
+            out.sOutputTxt = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix + ".target." + g_staticParams.szTxtFileExt;
+#endif
       }
       else
       {
-         string strErrorMsg = " Error - could not open compoundmods_file \"" + g_staticParams.variableModParameters.sCompoundModsFile + "\"\n";
+         out.sOutputTxt = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix +
+            "." + std::to_string(iFirstScan) + "-" + std::to_string(iLastScan) + "." + g_staticParams.szTxtFileExt;
+#ifdef CRUX
+         if (g_staticParams.options.iDecoySearch == 2)
+            out.sOutputTxt = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix +
+            "." + std::to_string(iFirstScan) + "-" + std::to_string(iLastScan) + ".target." + g_staticParams.szTxtFileExt;
+#endif
+      }
+
+      if ((out.fpout_txt = fopen(out.sOutputTxt.c_str(), "w")) == NULL)
+      {
+         string strErrorMsg = " Error - cannot write to file \"" + out.sOutputTxt + "\".\n";
          g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
          logerr(strErrorMsg);
-         return false;
+         bSucceeded = false;
       }
-   }
 
-   g_staticParams.precalcMasses.iMinus17 = BIN(g_staticParams.massUtility.dH2O);
-   g_staticParams.precalcMasses.iMinus18 = BIN(g_staticParams.massUtility.dNH3);
-   g_massRange.dMinMass = g_staticParams.options.dPeptideMassLow;
-   g_massRange.dMaxMass = g_staticParams.options.dPeptideMassHigh;
+      CometWriteTxt::PrintTxtHeader(out.fpout_txt);
+      fflush(out.fpout_txt);
 
-   if (g_bPerformDatabaseSearch && g_staticParams.options.bCreateFragmentIndex) //index
-   {
-       // write out .idx file containing unmodified peptides and protein refs;
-       // this calls RunSearch just to query fasta and generate uniq peptide list
-       bSucceeded = CometFragmentIndex::WriteFIPlainPeptideIndex(tp);
-       if (!bSucceeded)
-          return bSucceeded;
+      if (bSucceeded && (g_staticParams.options.iDecoySearch == 2))
+      {
+         if (iAnalysisType == AnalysisType_EntireFile)
+            out.sOutputDecoyTxt = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix + ".decoy." + g_staticParams.szTxtFileExt;
+         else
+            out.sOutputDecoyTxt = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix +
+            "." + std::to_string(iFirstScan) + "-" + std::to_string(iLastScan) + ".decoy." + g_staticParams.szTxtFileExt;
 
-       CometSearch::DeallocateMemory(g_staticParams.options.iNumThreads);
+         out.fpoutd_txt = fopen(out.sOutputDecoyTxt.c_str(), "w");
+         if (!out.fpoutd_txt)
+         {
+            string strErrorMsg = " Error - cannot write to decoy file \"" + out.sOutputDecoyTxt + "\".\n";
+            g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
+            logerr(strErrorMsg);
+            bSucceeded = false;
+         }
 
-       if (g_pvInputFiles.size() == 0)
-          return bSucceeded;
+         CometWriteTxt::PrintTxtHeader(out.fpoutd_txt);
+      }
    }
 
-   bool bBlankSearchFile = false;
-
-   if (g_bPerformDatabaseSearch && g_staticParams.iDbType == DbType::FI_DB)
+   if (bSucceeded && g_staticParams.options.bOutputPepXMLFile)
    {
-      if (!g_staticParams.options.iFragIndexSkipReadPrecursors)
+      if (iAnalysisType == AnalysisType_EntireFile)
       {
-         // read precursors before creating fragment index
-         auto tTime1 = chrono::steady_clock::now();
-         if (!g_staticParams.options.bOutputSqtStream)
-         {
-            cout << " - read precursors ... ";
-            fflush(stdout);
-         }
-
-         for (int i = 0; i < (int)g_pvInputFiles.size(); ++i)
-         {
-            bSucceeded = UpdateInputFile(g_pvInputFiles.at(i));
-            if (!bSucceeded)
-               break;
+         out.sOutputPepXML = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix + ".pep.xml";
+#ifdef CRUX
+         if (g_staticParams.options.iDecoySearch == 2)
+            out.sOutputPepXML = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix + ".target.pep.xml";
+#endif
+      }
+      else
+      {
+         out.sOutputPepXML = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix +
+            "." + std::to_string(iFirstScan) + "-" + std::to_string(iLastScan) + ".pep.xml";
+#ifdef CRUX
+         if (g_staticParams.options.iDecoySearch == 2)
+            out.sOutputPepXML = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix +
+            "." + std::to_string(iFirstScan) + "-" + std::to_string(iLastScan) + ".target.pep.xml";
+#endif
+      }
 
-            // For file access using MSToolkit.
-            MSReader mstReader;
+      out.fpout_pepxml = fopen(out.sOutputPepXML.c_str(), "w");
+      if (!out.fpout_pepxml)
+      {
+         string strErrorMsg = " Error - cannot write to file \"" + out.sOutputPepXML + "\".\n";
+         g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
+         logerr(strErrorMsg);
+         bSucceeded = false;
+      }
 
-            // We want to read only MS2/MS3 scans.
-            SetMSLevelFilter(mstReader);
+      if (bSucceeded)
+         bSucceeded = CometWritePepXML::WritePepXMLHeader(out.fpout_pepxml, searchMgr);
 
-            CometPreprocess::Reset();
+      if (bSucceeded && (g_staticParams.options.iDecoySearch == 2))
+      {
+         if (iAnalysisType == AnalysisType_EntireFile)
+            out.sOutputDecoyPepXML = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix + ".decoy.pep.xml";
+         else
+            out.sOutputDecoyPepXML = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix +
+            "." + std::to_string(iFirstScan) + "-" + std::to_string(iLastScan) + ".decoy.pep.xml";
 
-            bSucceeded = CometPreprocess::ReadPrecursors(mstReader);
+         out.fpoutd_pepxml = fopen(out.sOutputDecoyPepXML.c_str(), "w");
+         if (!out.fpoutd_pepxml)
+         {
+            string strErrorMsg = " Error - cannot write to decoy file \"" + out.sOutputDecoyPepXML + "\".\n";
+            g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
+            logerr(strErrorMsg);
+            bSucceeded = false;
          }
 
-         if (!g_staticParams.options.bOutputSqtStream)
-            cout << CometMassSpecUtils::ElapsedTime(tTime1) << endl;
+         if (bSucceeded)
+            bSucceeded = CometWritePepXML::WritePepXMLHeader(out.fpoutd_pepxml, searchMgr);
       }
    }
 
-   if (g_bPerformSpecLibSearch)
-   {
-      CometSpecLib::LoadSpecLib(g_staticParams.speclibInfo.strSpecLibFile);
-   }
-
-   bool bPerformAScoreInitialization = true;
-
-   for (int i = 0; i < (int)g_pvInputFiles.size(); ++i)
+   if (bSucceeded && g_staticParams.options.iOutputMzIdentMLFile)
    {
-      bSucceeded = UpdateInputFile(g_pvInputFiles.at(i));
-      if (!bSucceeded)
-         break;
-
-      time_t tStartTime;
-      time(&tStartTime);
-      strftime(g_staticParams.szDate, 26, "%Y/%m/%d, %I:%M:%S %p", localtime(&tStartTime));
-
-      if (!g_staticParams.options.bOutputSqtStream && g_staticParams.iDbType == DbType::FASTA_DB)
+      if (iAnalysisType == AnalysisType_EntireFile)
       {
-         strOut = " Search start:  " + string(g_staticParams.szDate) + "\n";
-         strOut += " - Input file: " + string(g_staticParams.inputFile.szFileName) + "\n";
-         logout(strOut);
-         fflush(stdout);
+         out.sOutputMzIdentML = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix + ".mzid";
+#ifdef CRUX
+         if (g_staticParams.options.iDecoySearch == 2)
+            out.sOutputMzIdentML = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix + ".target.mzid";
+#endif
       }
-
-      int iFirstScan = g_staticParams.inputFile.iFirstScan;             // First scan to search specified by user.
-      int iLastScan = g_staticParams.inputFile.iLastScan;               // Last scan to search specified by user.
-      int iPercentStart = 0;                                            // percentage within input file for start scan of batch
-      int iPercentEnd = 0;                                              // percentage within input file for end scan of batch
-      int iAnalysisType = g_staticParams.inputFile.iAnalysisType;       // 1=dta (retired),
-                                                                        // 2=specific scan,
-                                                                        // 3=specific scan + charge,
-                                                                        // 4=scan range,
-                                                                        // 5=entire file
-
-      // For SQT & pepXML output file, check if they can be written to before doing anything else.
-      FILE *fpout_sqt=NULL;
-      FILE *fpoutd_sqt=NULL;
-      FILE *fpout_pepxml=NULL;
-      FILE *fpoutd_pepxml=NULL;
-      FILE *fpout_mzidentml=NULL;
-      FILE *fpoutd_mzidentml=NULL;
-      FILE *fpout_mzidentmltmp=NULL;
-      FILE *fpoutd_mzidentmltmp=NULL;
-      FILE *fpout_percolator=NULL;
-      FILE *fpout_txt=NULL;
-      FILE *fpoutd_txt=NULL;
-
-      std::string sOutputSQT;
-      std::string sOutputDecoySQT;
-      std::string sOutputPepXML;
-      std::string sOutputDecoyPepXML;
-      std::string sOutputMzIdentML;
-      std::string sOutputDecoyMzIdentML;
-      std::string sOutputMzIdentMLtmp;         // temporary file used to hold mzIdentML output before finalizing
-      std::string sOutputDecoyMzIdentMLtmp;    // temporary file used to hold decoy mzIdentML output before finalizing
-      std::string sOutputPercolator;
-      std::string sOutputTxt;
-      std::string sOutputDecoyTxt;
-
-      if (g_staticParams.options.bOutputSqtFile)
+      else
       {
-         if (iAnalysisType == AnalysisType_EntireFile)
-         {
-            sOutputSQT = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix + ".sqt";
-
-#ifdef CRUX
-            if (g_staticParams.options.iDecoySearch == 2)
-            {
-               sOutputSQT = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix + ".target.sqt";
-            }
-#endif
-         }
-         else
-         {
-            sOutputSQT = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix +
-               "." + std::to_string(iFirstScan) + "-" + std::to_string(iLastScan) + ".sqt";
+         out.sOutputMzIdentML = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix +
+            "." + std::to_string(iFirstScan) + "-" + std::to_string(iLastScan) + ".mzid";
 #ifdef CRUX
-            if (g_staticParams.options.iDecoySearch == 2)
-               sOutputSQT = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix +
-               "." + std::to_string(iFirstScan) + "-" + std::to_string(iLastScan) + ".target.sqt";
+         if (g_staticParams.options.iDecoySearch == 2)
+            out.sOutputMzIdentML = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix +
+            "." + std::to_string(iFirstScan) + "-" + std::to_string(iLastScan) + ".target.mzid";
 #endif
-         }
-
-         if ((fpout_sqt = fopen(sOutputSQT.c_str(), "w")) == NULL)
-         {
-            string strErrorMsg = " Error - cannot write to file \"" + sOutputSQT + "\".\n";
-            g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
-            logerr(strErrorMsg);
-            bSucceeded = false;
-         }
-
-         CometWriteSqt::PrintSqtHeader(fpout_sqt, *this);
-
-         if (bSucceeded && (g_staticParams.options.iDecoySearch == 2))
-         {
-            if (iAnalysisType == AnalysisType_EntireFile)
-               sOutputDecoySQT = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix + ".decoy.sqt";
-            else
-               sOutputDecoySQT = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix +
-               "." + std::to_string(iFirstScan) + "-" + std::to_string(iLastScan) + ".decoy.sqt";
-
-            if ((fpoutd_sqt = fopen(sOutputDecoySQT.c_str(), "w")) == NULL)
-            {
-               string strErrorMsg = " Error - cannot write to decoy file \"" + sOutputDecoySQT + "\".\n";
-               g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
-               logerr(strErrorMsg);
-               bSucceeded = false;
-            }
-
-            CometWriteSqt::PrintSqtHeader(fpoutd_sqt, *this);
-         }
       }
 
-      if (bSucceeded && g_staticParams.options.bOutputTxtFile)
+      out.fpout_mzidentml = fopen(out.sOutputMzIdentML.c_str(), "w");
+      if (!out.fpout_mzidentml)
       {
-         if (iAnalysisType == AnalysisType_EntireFile)
-         {
-            sOutputTxt = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix + "." + g_staticParams.szTxtFileExt;
-#ifdef CRUX
-            if (g_staticParams.options.iDecoySearch == 2)
-               sOutputTxt = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix + ".target." + g_staticParams.szTxtFileExt;
-#endif
-         }
-         else
-         {
-            sOutputTxt = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix +
-               "." + std::to_string(iFirstScan) + "-" + std::to_string(iLastScan) + "." + g_staticParams.szTxtFileExt;
-#ifdef CRUX
-            if (g_staticParams.options.iDecoySearch == 2)
-               sOutputTxt = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix +
-               "." + std::to_string(iFirstScan) + "-" + std::to_string(iLastScan) + ".target." + g_staticParams.szTxtFileExt;
-#endif
-         }
-
-         if ((fpout_txt = fopen(sOutputTxt.c_str(), "w")) == NULL)
-         {
-            string strErrorMsg = " Error - cannot write to file \"" + sOutputTxt + "\".\n";
-            g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
-            logerr(strErrorMsg);
-            bSucceeded = false;
-         }
-
-         CometWriteTxt::PrintTxtHeader(fpout_txt);
-         fflush(fpout_txt);
-
-         if (bSucceeded && (g_staticParams.options.iDecoySearch == 2))
-         {
-            if (iAnalysisType == AnalysisType_EntireFile)
-               sOutputDecoyTxt = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix + ".decoy." + g_staticParams.szTxtFileExt;
-            else
-               sOutputDecoyTxt = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix +
-               "." + std::to_string(iFirstScan) + "-" + std::to_string(iLastScan) + ".decoy." + g_staticParams.szTxtFileExt;
-
-            fpoutd_txt = fopen(sOutputDecoyTxt.c_str(), "w");
-            if (!fpoutd_txt)
-            {
-               string strErrorMsg = " Error - cannot write to decoy file \"" + sOutputDecoyTxt + "\".\n";
-               g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
-               logerr(strErrorMsg);
-               bSucceeded = false;
-            }
-
-            CometWriteTxt::PrintTxtHeader(fpoutd_txt);
-         }
+         string strErrorMsg = " Error - cannot write to file \"" + out.sOutputMzIdentML + "\".\n";
+         g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
+         logerr(strErrorMsg);
+         bSucceeded = false;
       }
 
-      if (bSucceeded && g_staticParams.options.bOutputPepXMLFile)
+      out.sOutputMzIdentMLtmp = out.sOutputMzIdentML + ".XXXXXX";
+#ifdef _WIN32
+      errno_t err = _mktemp_s(&out.sOutputMzIdentMLtmp[0], out.sOutputMzIdentMLtmp.size() + 1);
+      if (err != 0)
       {
-         if (iAnalysisType == AnalysisType_EntireFile)
-         {
-            sOutputPepXML = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix + ".pep.xml";
-#ifdef CRUX
-            if (g_staticParams.options.iDecoySearch == 2)
-               sOutputPepXML = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix + ".target.pep.xml";
-#endif
-         }
-         else
-         {
-            sOutputPepXML = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix +
-               "." + std::to_string(iFirstScan) + "-" + std::to_string(iLastScan) + ".pep.xml";
-#ifdef CRUX
-            if (g_staticParams.options.iDecoySearch == 2)
-               sOutputPepXML = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix +
-               "." + std::to_string(iFirstScan) + "-" + std::to_string(iLastScan) + ".target.pep.xml";
+         string strErrorMsg = " Error - cannot create temporary file \"" + out.sOutputMzIdentMLtmp + "\".\n";
+         g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
+         logerr(strErrorMsg);
+         bSucceeded = false;
+      }
+#else
+      int iRet = mkstemp(&out.sOutputMzIdentMLtmp[0]);
+      if (iRet == -1)
+      {
+         string strErrorMsg = " Error - cannot create temporary file \"" + out.sOutputMzIdentMLtmp + "\".\n";
+         g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
+         logerr(strErrorMsg);
+         bSucceeded = false;
+      }
 #endif
-         }
-
-         fpout_pepxml = fopen(sOutputPepXML.c_str(), "w");
-         if (!fpout_pepxml)
-         {
-            string strErrorMsg = " Error - cannot write to file \"" + sOutputPepXML + "\".\n";
-            g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
-            logerr(strErrorMsg);
-            bSucceeded = false;
-         }
-
-         if (bSucceeded)
-            bSucceeded = CometWritePepXML::WritePepXMLHeader(fpout_pepxml, *this);
-
-         if (bSucceeded && (g_staticParams.options.iDecoySearch == 2))
-         {
-            if (iAnalysisType == AnalysisType_EntireFile)
-               sOutputDecoyPepXML = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix + ".decoy.pep.xml";
-            else
-               sOutputDecoyPepXML = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix +
-               "." + std::to_string(iFirstScan) + "-" + std::to_string(iLastScan) + ".decoy.pep.xml";
-
-            fpoutd_pepxml = fopen(sOutputDecoyPepXML.c_str(), "w");
-            if (!fpoutd_pepxml)
-            {
-               string strErrorMsg = " Error - cannot write to decoy file \"" + sOutputDecoyPepXML + "\".\n";
-               g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
-               logerr(strErrorMsg);
-               bSucceeded = false;
-            }
 
-            if (bSucceeded)
-               bSucceeded = CometWritePepXML::WritePepXMLHeader(fpoutd_pepxml, *this);
-         }
+      out.fpout_mzidentmltmp = fopen(out.sOutputMzIdentMLtmp.c_str(), "w");
+      if (!out.fpout_mzidentmltmp)
+      {
+         string strErrorMsg = " Error - cannot write to file \"" + out.sOutputMzIdentMLtmp + "\".\n";
+         g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
+         logerr(strErrorMsg);
+         bSucceeded = false;
       }
 
-      if (bSucceeded && g_staticParams.options.iOutputMzIdentMLFile)
+      if (bSucceeded && (g_staticParams.options.iDecoySearch == 2))
       {
          if (iAnalysisType == AnalysisType_EntireFile)
-         {
-            sOutputMzIdentML = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix + ".mzid";
-#ifdef CRUX
-            if (g_staticParams.options.iDecoySearch == 2)
-               sOutputMzIdentML = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix + ".target.mzid";
-#endif
-         }
+            out.sOutputDecoyMzIdentML = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix + ".decoy.mzid";
          else
-         {
-            sOutputMzIdentML = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix +
-               "." + std::to_string(iFirstScan) + "-" + std::to_string(iLastScan) + ".mzid";
-#ifdef CRUX
-            if (g_staticParams.options.iDecoySearch == 2)
-               sOutputMzIdentML = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix +
-               "." + std::to_string(iFirstScan) + "-" + std::to_string(iLastScan) + ".target.mzid";
-#endif
-         }
+            out.sOutputDecoyMzIdentML = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix +
+            "." + std::to_string(iFirstScan) + "-" + std::to_string(iLastScan) + ".decoy.mzid";
 
-         fpout_mzidentml = fopen(sOutputMzIdentML.c_str(), "w");
-         if (!fpout_mzidentml)
+         out.fpoutd_mzidentml = fopen(out.sOutputDecoyMzIdentML.c_str(), "w");
+         if (!out.fpoutd_mzidentml)
          {
-            string strErrorMsg = " Error - cannot write to file \"" + sOutputMzIdentML + "\".\n";
+            string strErrorMsg = " Error - cannot write to decoy file \"" + out.sOutputDecoyMzIdentML + "\".\n";
             g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
             logerr(strErrorMsg);
             bSucceeded = false;
          }
 
-         sOutputMzIdentMLtmp = sOutputMzIdentML + ".XXXXXX";
+         out.sOutputDecoyMzIdentMLtmp = out.sOutputDecoyMzIdentML + ".XXXXXX";
 #ifdef _WIN32
-         errno_t err = _mktemp_s(&sOutputMzIdentMLtmp[0], sOutputMzIdentMLtmp.size() + 1);
+         errno_t err = _mktemp_s(&out.sOutputDecoyMzIdentMLtmp[0], out.sOutputDecoyMzIdentMLtmp.size() + 1);
          if (err != 0)
          {
-            string strErrorMsg = " Error - cannot create temporary file \"" + sOutputMzIdentMLtmp + "\".\n";
+            string strErrorMsg = " Error - cannot create temporary file \"" + out.sOutputDecoyMzIdentMLtmp + "\".\n";
             g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
             logerr(strErrorMsg);
             bSucceeded = false;
          }
 #else
-         int iRet = mkstemp(&sOutputMzIdentMLtmp[0]);
+         int iRet = mkstemp(&out.sOutputDecoyMzIdentMLtmp[0]);
          if (iRet == -1)
          {
-            string strErrorMsg = " Error - cannot create temporary file \"" + sOutputMzIdentMLtmp + "\".\n";
+            string strErrorMsg = " Error - cannot create temporary file \"" + out.sOutputDecoyMzIdentMLtmp + "\".\n";
             g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
             logerr(strErrorMsg);
             bSucceeded = false;
          }
 #endif
-
-         fpout_mzidentmltmp = fopen(sOutputMzIdentMLtmp.c_str(), "w");
-         if (!fpout_mzidentmltmp)
+         out.fpoutd_mzidentmltmp = fopen(out.sOutputDecoyMzIdentMLtmp.c_str(), "w");
+         if (!out.fpoutd_mzidentmltmp)
          {
-            string strErrorMsg = " Error - cannot write to file \"" + sOutputMzIdentMLtmp + "\".\n";
+            string strErrorMsg = " Error - cannot write to decoy file \"" + out.sOutputDecoyMzIdentMLtmp + "\".\n";
             g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
             logerr(strErrorMsg);
             bSucceeded = false;
          }
+      }
+   }
 
-         if (bSucceeded && (g_staticParams.options.iDecoySearch == 2))
-         {
-            if (iAnalysisType == AnalysisType_EntireFile)
-               sOutputDecoyMzIdentML = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix + ".decoy.mzid";
-            else
-               sOutputDecoyMzIdentML = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix +
-               "." + std::to_string(iFirstScan) + "-" + std::to_string(iLastScan) + ".decoy.mzid";
+   if (bSucceeded && g_staticParams.options.bOutputPercolatorFile)
+   {
+      if (iAnalysisType == AnalysisType_EntireFile)
+         out.sOutputPercolator = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix + ".pin";
+      else
+         out.sOutputPercolator = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix +
+         "." + std::to_string(iFirstScan) + "-" + std::to_string(iLastScan) + ".pin";
 
-            fpoutd_mzidentml = fopen(sOutputDecoyMzIdentML.c_str(), "w");
-            if (!fpoutd_mzidentml)
-            {
-               string strErrorMsg = " Error - cannot write to decoy file \"" + sOutputDecoyMzIdentML + "\".\n";
-               g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
-               logerr(strErrorMsg);
-               bSucceeded = false;
-            }
+      out.fpout_percolator = fopen(out.sOutputPercolator.c_str(), "w");
+      if (!out.fpout_percolator)
+      {
+         string strErrorMsg = " Error - cannot write to file \"" + out.sOutputPercolator + "\".\n";
+         g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
+         logerr(strErrorMsg);
+         bSucceeded = false;
+      }
 
-            sOutputDecoyMzIdentMLtmp = sOutputDecoyMzIdentML + ".XXXXXX";
-#ifdef _WIN32
-            errno_t err = _mktemp_s(&sOutputDecoyMzIdentMLtmp[0], sOutputDecoyMzIdentMLtmp.size() + 1);
-            if (err != 0)
-            {
-               string strErrorMsg = " Error - cannot create temporary file \"" + sOutputDecoyMzIdentMLtmp + "\".\n";
-               g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
-               logerr(strErrorMsg);
-               bSucceeded = false;
-            }
-#else
-            int iRet = mkstemp(&sOutputDecoyMzIdentMLtmp[0]);
-            if (iRet == -1)
-            {
-               string strErrorMsg = " Error - cannot create temporary file \"" + sOutputDecoyMzIdentMLtmp + "\".\n";
-               g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
-               logerr(strErrorMsg);
-               bSucceeded = false;
-            }
-#endif
-            fpoutd_mzidentmltmp = fopen(sOutputDecoyMzIdentMLtmp.c_str(), "w");
-            if (!fpoutd_mzidentmltmp)
-            {
-               string strErrorMsg = " Error - cannot write to decoy file \"" + sOutputDecoyMzIdentMLtmp + "\".\n";
-               g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
-               logerr(strErrorMsg);
-               bSucceeded = false;
-            }
-         }
+      if (bSucceeded)
+         CometWritePercolator::WritePercolatorHeader(out.fpout_percolator);
+   }
+
+   return bSucceeded;
+}
+
+
+// Writes the results of one batch to every requested output format.
+static bool WriteOutputBatch(OutputFiles &out,
+                             vector<Query*>& vQuery,
+                             FILE *fpdb,
+                             int iNumSpectraSearched,
+                             int iWhichBatch)
+{
+   if (g_staticParams.options.bOutputPepXMLFile)
+      CometWritePepXML::WritePepXML(vQuery, out.fpout_pepxml, out.fpoutd_pepxml, fpdb, iNumSpectraSearched);
+
+   // For mzid output, dump psms as tab-delimited text first then collate results to
+   // mzid file at very end due to requirements of this format.
+   if (g_staticParams.options.iOutputMzIdentMLFile)
+      CometWriteMzIdentML::WriteMzIdentMLTmp(vQuery, out.fpout_mzidentmltmp, out.fpoutd_mzidentmltmp, iWhichBatch);
+
+   if (g_staticParams.options.bOutputPercolatorFile)
+   {
+      if (!CometWritePercolator::WritePercolator(vQuery, out.fpout_percolator, fpdb))
+         return false;
+   }
+
+   if (g_staticParams.options.bOutputTxtFile)
+   {
+      CometWriteTxt::WriteTxt(vQuery, out.fpout_txt, out.fpoutd_txt, fpdb);
+   }
+
+   if (g_staticParams.options.bOutputSqtStream || g_staticParams.options.bOutputSqtFile)
+      CometWriteSqt::WriteSqt(vQuery, out.fpout_sqt, out.fpoutd_sqt, fpdb);
+
+   return true;
+}
+
+
+// Write the closing tags of the output files; mzIdentML output is collated here
+// from its temporary file.
+static bool FinishOutputFiles(OutputFiles &out,
+                              FILE *fpdb,
+                              CometSearchManager &searchMgr)
+{
+   bool bSucceeded = true;
+
+   if (NULL != out.fpout_pepxml)
+      CometWritePepXML::WritePepXMLEndTags(out.fpout_pepxml);
+
+   if (NULL != out.fpoutd_pepxml)
+      CometWritePepXML::WritePepXMLEndTags(out.fpoutd_pepxml);
+
+   if (NULL != out.fpout_mzidentml)
+   {
+      fclose(out.fpout_mzidentmltmp); // close for writing and re-open for reading
+
+      if ((out.fpout_mzidentmltmp = fopen(out.sOutputMzIdentMLtmp.c_str(), "r")) == NULL)
+      {
+         string strErrorMsg = " Error - cannot read temporary file \"" + out.sOutputMzIdentMLtmp + "\".\n";
+         g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
+         logerr(strErrorMsg);
+         bSucceeded = false;
+      }
+
+      // now read tmp file and write mzIdentML
+      CometWriteMzIdentML::WriteMzIdentML(out.fpout_mzidentml, fpdb, out.sOutputMzIdentMLtmp.c_str(), searchMgr);
+
+      fclose(out.fpout_mzidentmltmp);
+      remove(out.sOutputMzIdentMLtmp.c_str());
+   }
+
+   if (NULL != out.fpoutd_mzidentml)
+   {
+      fclose(out.fpoutd_mzidentmltmp); // close for writing and re-open for reading
+
+      if ((out.fpoutd_mzidentmltmp = fopen(out.sOutputDecoyMzIdentMLtmp.c_str(), "r")) == NULL)
+      {
+         string strErrorMsg = " Error - cannot read temporary file \"" + out.sOutputDecoyMzIdentMLtmp + "\".\n";
+         g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
+         logerr(strErrorMsg);
+         bSucceeded = false;
+      }
+
+      // now read tmp file and write mzIdentML
+      CometWriteMzIdentML::WriteMzIdentML(out.fpoutd_mzidentml, fpdb, out.sOutputDecoyMzIdentMLtmp.c_str(), searchMgr);
+
+      fclose(out.fpoutd_mzidentmltmp);
+      remove(out.sOutputDecoyMzIdentMLtmp.c_str());
+   }
+
+   return bSucceeded;
+}
+
+
+// Close the output files; files of an input file without searched spectra are removed.
+static void CloseOutputFiles(OutputFiles &out,
+                             int iTotalSpectraSearched)
+{
+   if (NULL != out.fpout_pepxml)
+   {
+      fclose(out.fpout_pepxml);
+      out.fpout_pepxml = NULL;
+      if (iTotalSpectraSearched == 0)
+         remove(out.sOutputPepXML.c_str());
+   }
+
+   if (NULL != out.fpoutd_pepxml)
+   {
+      fclose(out.fpoutd_pepxml);
+      out.fpoutd_pepxml = NULL;
+      if (iTotalSpectraSearched == 0)
+         remove(out.sOutputDecoyPepXML.c_str());
+   }
+
+   if (NULL != out.fpout_mzidentml)
+   {
+      fclose(out.fpout_mzidentml);
+      out.fpout_mzidentml = NULL;
+      if (iTotalSpectraSearched == 0)
+      {
+         remove(out.sOutputMzIdentML.c_str());
+         remove(out.sOutputMzIdentMLtmp.c_str());
+      }
+   }
+
+   if (NULL != out.fpoutd_mzidentml)
+   {
+      fclose(out.fpoutd_mzidentml);
+      out.fpoutd_mzidentml = NULL;
+      if (iTotalSpectraSearched == 0)
+      {
+         remove(out.sOutputDecoyMzIdentML.c_str());
+         remove(out.sOutputDecoyMzIdentMLtmp.c_str());
+      }
+   }
+
+   if (NULL != out.fpout_percolator)
+   {
+      fclose(out.fpout_percolator);
+      out.fpout_percolator = NULL;
+      if (iTotalSpectraSearched == 0)
+         remove(out.sOutputPercolator.c_str());
+   }
+
+   if (NULL != out.fpout_sqt)
+   {
+      fclose(out.fpout_sqt);
+      out.fpout_sqt = NULL;
+      if (iTotalSpectraSearched == 0)
+         remove(out.sOutputSQT.c_str());
+   }
+
+   if (NULL != out.fpoutd_sqt)
+   {
+      fclose(out.fpoutd_sqt);
+      out.fpoutd_sqt = NULL;
+      if (iTotalSpectraSearched == 0)
+         remove(out.sOutputDecoySQT.c_str());
+   }
+
+   if (NULL != out.fpoutd_sqt)
+   {
+      fclose(out.fpoutd_sqt);
+      out.fpoutd_sqt = NULL;
+      if (iTotalSpectraSearched == 0)
+         remove(out.sOutputDecoySQT.c_str());
+   }
+
+   if (NULL != out.fpout_txt)
+   {
+      fclose(out.fpout_txt);
+      out.fpout_txt = NULL;
+      if (iTotalSpectraSearched == 0)
+         remove(out.sOutputTxt.c_str());
+   }
+
+   if (NULL != out.fpoutd_txt)
+   {
+      fclose(out.fpoutd_txt);
+      out.fpoutd_txt = NULL;
+      if (iTotalSpectraSearched == 0)
+         remove(out.sOutputDecoyTxt.c_str());
+   }
+}
+
+
+// Search the batch of spectra in g_pvQuery and run the post-search analysis.  The
+// queries are left sorted by scan number for the output writers.
+static bool SearchBatch(ThreadPool *tp,
+                        int iPercentStart,
+                        int iPercentEnd)
+{
+   bool bSucceeded = AllocateResultsMem();
+
+   if (!bSucceeded)
+      return false;
+
+   {
+      string strStatusMsg = " " + std::to_string(g_pvQuery.size()) + string("\n");
+      if (!g_staticParams.options.bOutputSqtStream && g_staticParams.iDbType == DbType::FASTA_DB)
+      {
+         logout(strStatusMsg);
       }
+      g_cometStatus.SetStatusMsg(strStatusMsg);
+   }
+
+   if (g_staticParams.options.bMango)
+   {
+      int iCurrentScanNumber = 0;       // used to track multiple Mango precursors from same scan number
+      int iMangoIndex=0;
+
+      // sort back to original spectrum order in MS2 scan in order to associate pairs
+      // based on sequential order of precursors for each scan
+      std::sort(g_pvQuery.begin(), g_pvQuery.end(), compareByMangoIndex);
+
+      for (std::vector<Query*>::iterator it = g_pvQuery.begin(); it != g_pvQuery.end(); ++it)
+      {
+         if ((*it)->_spectrumInfoInternal.iScanNumber != iCurrentScanNumber)
+         {
+            iCurrentScanNumber = (*it)->_spectrumInfoInternal.iScanNumber;
+            iMangoIndex = 0;
+         }
+         else
+            iMangoIndex++;
+
+         sprintf((*it)->_spectrumInfoInternal.szMango, "%03d_%c", (int)iMangoIndex/2, (iMangoIndex % 2)?'B':'A');
+      }
+   }
+
+   // Sort g_pvQuery vector by dExpPepMass.
+   std::sort(g_pvQuery.begin(), g_pvQuery.end(), compareByPeptideMass);
+
+   g_massRange.dMinMass = g_pvQuery.at(0)->_pepMassInfo.dPeptideMassToleranceMinus;
+   g_massRange.dMaxMass = g_pvQuery.at(g_pvQuery.size()-1)->_pepMassInfo.dPeptideMassTolerancePlus;
+
+   if (g_massRange.dMaxMass - g_massRange.dMinMass > g_massRange.dMinMass)
+      g_massRange.bNarrowMassRange = true;
+   else
+      g_massRange.bNarrowMassRange = false;
+
+   bSucceeded = !g_cometStatus.IsError() && !g_cometStatus.IsCancel();
+   if (!bSucceeded)
+      return false;
+
+   g_cometStatus.SetStatusMsg(string("Running search..."));
+
+   // Now that spectra are loaded to memory and sorted, do search.
+#ifdef PEPTIDE_CENTRIC_BENCH
+   auto tBenchStart = chrono::steady_clock::now();
+#endif
+   if (g_bPerformDatabaseSearch)
+      bSucceeded = CometSearch::RunSearch(iPercentStart, iPercentEnd, tp);
+#ifdef PEPTIDE_CENTRIC_BENCH
+   if (g_bPerformDatabaseSearch && g_staticParams.iDbType == DbType::FASTA_DB)
+      RecordPeptideCentricBenchStep(PEPTIDE_CENTRIC_BENCH_SEARCH, chrono::duration<double>(chrono::steady_clock::now() - tBenchStart).count(), 0);
+#endif
+   if (g_bPerformSpecLibSearch)
+      bSucceeded = CometSearch::RunSpecLibSearch(iPercentStart, iPercentEnd, tp);
+
+#ifdef XCORR_BENCH
+   CometSearch::RunXcorrBenchmark();
+#endif
+#ifdef FRAGINDEX_BENCH
+   CometSearch::RunFragmentIndexBenchmark();
+#endif
+#ifdef PEPTIDE_CENTRIC_BENCH
+   CometSearch::RunPeptideCentricBenchmark();
+#endif
+
+   if (!bSucceeded)
+      return false;
+
+   bSucceeded = !g_cometStatus.IsError() && !g_cometStatus.IsCancel();
+   if (!bSucceeded)
+      return false;
+
+   if (!g_staticParams.options.bOutputSqtStream && g_staticParams.iDbType == DbType::FASTA_DB)
+   {
+      logout("     - Post analysis:");
+      fflush(stdout);
+   }
+
+   if (g_bPerformDatabaseSearch)
+   {
+      g_cometStatus.SetStatusMsg(string("Performing post-search analysis ..."));
+
+      // Sort each entry by xcorr, calculate E-values, etc.
+      bSucceeded = CometPostAnalysis::PostAnalysis(tp);
+   }
+
+   if (!bSucceeded)
+      return false;
+
+   // Sort g_pvQuery vector by scan.
+   std::sort(g_pvQuery.begin(), g_pvQuery.end(), compareByScanNumber);
+
+   if (!g_staticParams.options.bOutputSqtStream && g_staticParams.iDbType == DbType::FASTA_DB)
+   {
+      logout("  done\n");
+      fflush(stdout);
+   }
+
+   return true;
+}
+
+
+// Allocate the memory shared by the search threads, open the sequence database
+// and build the fragment ion index if it is not in memory yet.  Called for each
+// input file; only the first call does any allocating or index building.
+static bool PrepareSearch(ThreadPool *tp,
+                          FILE *&fpfasta,
+                          FILE *&fpidx,
+                          bool &bPerformAScoreInitialization,
+                          CometSearchManager &searchMgr)
+{
+   //MH: Allocate memory shared by threads during spectral processing.
+   // Only the first input file allocates; the pools are sized by the search
+   // parameters alone so they are reused by every subsequent file.
+   bool bSucceeded = CometPreprocess::AllocateMemory(g_staticParams.options.iNumThreads);
+   if (!bSucceeded)
+      return false;
+
+   // Allocate memory shared by threads during search
+   bSucceeded = CometSearch::AllocateMemory(g_staticParams.options.iNumThreads);
+   if (!bSucceeded)
+      return false;
+
+   if (g_bPerformDatabaseSearch)
+   {
+      string sTmpDB = g_staticParams.databaseInfo.szDatabase;
+
+      if (g_staticParams.iDbType != DbType::FASTA_DB)
+      {
+         // .idx db so first open .idx file
+         if ((fpidx = fopen(sTmpDB.c_str(), "r")) == NULL)
+         {
+            string strErrorMsg = " Error (1a) - cannot read .idx file \"" + sTmpDB + "\".\n";
+            g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
+            logerr(strErrorMsg);
+            return false;
+         }
+
+         // .idx db so next check if FASTA is present (not required)
+         sTmpDB = sTmpDB.erase(sTmpDB.size() - 4); // need plain fasta if indexdb input
+         if ((fpfasta = fopen(sTmpDB.c_str(), "r")) == NULL)
+         {
+            g_bIdxNoFasta = true;
+            fpfasta = NULL;
+         }
+      }
+      else
+      {
+         // FASTA search only
+         fpidx = NULL;
+
+         if ((fpfasta = fopen(sTmpDB.c_str(), "r")) == NULL)
+         {
+            string strErrorMsg = " Error (1b) - cannot read sequence database file \"" + sTmpDB + "\".\n";
+            g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
+            logerr(strErrorMsg);
+            return false;
+         }
+      }
+   }
+
+   CometFragmentIndex sqSearch;
+
+   if (g_bPerformDatabaseSearch && g_staticParams.iDbType == DbType::FI_DB)
+   {
+      if (!g_bPlainPeptideIndexRead)
+         sqSearch.CreateFragmentIndex(tp);
+   }
+
+   if (g_staticParams.options.iPrintAScoreProScore && bPerformAScoreInitialization)
+   {
+      searchMgr.SetAScoreOptions(g_AScoreOptions);
+//    PrintAScoreOptions(g_AScoreOptions);
+
+      // Create the AScoreDllInterface using the factory function
+      g_AScoreInterface = CreateAScoreDllInterface();
+      if (!g_AScoreInterface)
+      {
+         std::cerr << "Failed to create AScore interface." << std::endl;
+         exit(1);
+      }
+
+      bPerformAScoreInitialization = false;
+   }
+
+   return true;
+}
+
+
+// Log the end of a search:  elapsed time, spectra searched, rate and peak memory.
+static void PrintSearchEnd(chrono::steady_clock::time_point tBeginTime,
+                           int iTotalSpectraSearched)
+{
+   string strOut;
+
+   if (!g_staticParams.options.bOutputSqtStream && g_staticParams.iDbType == DbType::FASTA_DB)
+   {
+      time_t tEndTime;
+
+      time(&tEndTime);
+
+      strftime(g_staticParams.szDate, 26, "%Y/%m/%d, %I:%M:%S %p", localtime(&tEndTime));
+      strOut = " Search end:    " + string(g_staticParams.szDate);
+      logout(strOut);
+   }
+
+   if (!g_staticParams.options.bOutputSqtStream)
+   {
+      const auto duration = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - tBeginTime);
+      double dTimePerSpectra = (double)duration.count() / (double)iTotalSpectraSearched;
+
+      if (g_staticParams.iDbType == DbType::FASTA_DB)
+         strOut = ", ";
+      else
+         strOut = "";
+
+      char buf[128];
+
+      std::snprintf(buf, sizeof(buf), "%.2f", dTimePerSpectra);
+      strOut += CometMassSpecUtils::ElapsedTime(tBeginTime) + ", " + std::to_string(iTotalSpectraSearched) + " spectra, "
+         + std::string(buf) + " ms/spec (";
+
+      std::snprintf(buf, sizeof(buf), "%.0f", 1000.0 / dTimePerSpectra);
+      strOut += std::string(buf) + " Hz)";
+
+      size_t peakKB = GetPeakMemoryKB();
+      if (peakKB > 0)
+      {
+         if (peakKB >= 1024 * 1024)
+         {
+            std::snprintf(buf, sizeof(buf), "%.1f", (peakKB / (1024.0 * 1024.0)));
+            strOut += ", " + std::string(buf) + "GB peak";
+         }
+         else
+         {
+            std::snprintf(buf, sizeof(buf), "%.1f", (peakKB / 1024.0));
+            strOut += ", " + std::string(buf) + "MB peak";
+         }
+      }
+      strOut += "\n";
+      logout(strOut);
+   }
+}
+
+
+// Per input file state when spectra of several input files share a batch.
+struct InputFileContext
+{
+   int iWhichInputFile;          // index into g_pvInputFiles
+   InputFileInfo inputFile;      // copied back to g_staticParams.inputFile to load or write this file
+   char szDate[32];              // search start time written to the output file headers
+   OutputFiles out;
+   chrono::steady_clock::time_point tBeginTime;
+   int iNumSpectraSearched;      // spectra of this file written so far
+   int iNumBatches;              // batches that held spectra of this file
+   bool bDoneReading;
+
+   InputFileContext()
+      : iWhichInputFile(0), iNumSpectraSearched(0), iNumBatches(0), bDoneReading(false)
+   {
+      szDate[0] = '\0';
+   }
+};
+
+
+static void SetInputFileContext(InputFileContext *pFile)
+{
+   g_staticParams.inputFile = pFile->inputFile;
+   strcpy(g_staticParams.szDate, pFile->szDate);
+}
+
+
+// Write the end of one input file's output files once all its spectra are written.
+static bool FinishInputFile(InputFileContext *pFile,
+                            FILE *fpdb,
+                            int &iRunSpectraSearched,
+                            int &iRunFilesSearched,
+                            bool &bBlankSearchFile,
+                            CometSearchManager &searchMgr)
+{
+   bool bSucceeded = true;
+
+   SetInputFileContext(pFile);
+
+   if (pFile->iNumSpectraSearched == 0)
+      logout(" Warning - no spectra searched.\n");
+
+   if (!FinishOutputFiles(pFile->out, fpdb, searchMgr))
+      bSucceeded = false;
+
+   if (g_staticParams.iDbType == DbType::FASTA_DB)
+   {
+      logout(" - Finished input file: " + string(g_staticParams.inputFile.szFileName) + "\n");
+   }
+   else
+   {
+      printf(" - searched \"%s\" ... ", g_staticParams.inputFile.szBaseName);
+      fflush(stdout);
+   }
+
+   PrintSearchEnd(pFile->tBeginTime, pFile->iNumSpectraSearched);
+
+   iRunSpectraSearched += pFile->iNumSpectraSearched;
+   iRunFilesSearched++;
+
+   CloseOutputFiles(pFile->out, pFile->iNumSpectraSearched);
+
+   if (pFile->iNumSpectraSearched == 0)
+      bBlankSearchFile = true;
+
+   return bSucceeded;
+}
+
+
+// Search all input files with spectrum_batch_files > 1.  When the spectra of one
+// file run out before a batch is full, the batch is topped up from the next file,
+// up to spectrum_batch_files files per batch, so the thread pool is not left idle
+// on a short last batch of every file.  Each file has its own output files and
+// spectrum and batch counters; after the search the batch is split by file and
+// each part is written to that file's output.  Files are read one after another,
+// never concurrently: a batch only moves on to the next file once the current one
+// has no spectra left.
+// As in the serial loop, the first file's output files are opened before
+// PrepareSearch reads the database so that their headers match a serial run.
+static bool SearchInputFilesTogether(ThreadPool *tp,
+                                     bool &bPerformAScoreInitialization,
+                                     long long &llRunSearchMs,
+                                     int &iRunSpectraSearched,
+                                     int &iRunFilesSearched,
+                                     bool &bBlankSearchFile,
+                                     CometSearchManager &searchMgr)
+{
+   int iNumInputFiles = (int)g_pvInputFiles.size();
+   int iNextInputFile = 0;
+   vector<InputFileContext*> vFiles;    // input files with output still open, in input order
+   MSReader *pReader = NULL;            // reader of the last file in vFiles while it has spectra left
+   int iPercentStart = 0;
+   int iPercentEnd = 0;
+   int iBatchNum = 0;
+   bool bSucceeded = true;
+
+   FILE *fpfasta = NULL;                // opened by PrepareSearch
+   FILE *fpidx = NULL;
+   FILE *fpdb = NULL;
+   bool bPrepared = false;
+   auto tBeginTime = chrono::steady_clock::now();
+
+   while (bSucceeded && (pReader != NULL || iNextInputFile < iNumInputFiles))
+   {
+      int iFilesInBatch = (pReader != NULL ? 1 : 0);
+      unsigned short usiBatchMaxFragmentCharge = 0;
+
+      iBatchNum++;
+      iPercentStart = iPercentEnd;
+
+      g_cometStatus.SetStatusMsg(string("Loading and processing input spectra"));
+
+      // Fill the batch, moving on to the next input file when one runs out of spectra.
+      while (g_staticParams.options.iSpectrumBatchSize == 0
+            || (int)g_pvQuery.size() < g_staticParams.options.iSpectrumBatchSize)
+      {
+         if (pReader == NULL)
+         {
+            if (iNextInputFile == iNumInputFiles || iFilesInBatch == g_staticParams.options.iSpectrumBatchFiles)
+               break;
+
+            bSucceeded = UpdateInputFile(g_pvInputFiles.at(iNextInputFile));
+            if (!bSucceeded)
+               break;
+
+            InputFileContext *pFile = new InputFileContext();
+            vFiles.push_back(pFile);
+
+            pFile->iWhichInputFile = iNextInputFile++;
+            pFile->inputFile = g_staticParams.inputFile;
+            pFile->tBeginTime = chrono::steady_clock::now();
+
+            time_t tStartTime;
+            time(&tStartTime);
+            strftime(pFile->szDate, 26, "%Y/%m/%d, %I:%M:%S %p", localtime(&tStartTime));
+            strcpy(g_staticParams.szDate, pFile->szDate);
+
+            if (g_staticParams.iDbType == DbType::FASTA_DB)
+            {
+               string strOut = " Search start:  " + string(g_staticParams.szDate) + "\n";
+               strOut += " - Input file: " + string(g_staticParams.inputFile.szFileName) + "\n";
+               logout(strOut);
+               fflush(stdout);
+            }
+
+            bSucceeded = OpenOutputFiles(pFile->out, pFile->inputFile.iAnalysisType,
+                  pFile->inputFile.iFirstScan, pFile->inputFile.iLastScan, searchMgr);
+            if (!bSucceeded)
+               break;
+
+            if (!bPrepared)
+            {
+               bSucceeded = PrepareSearch(tp, fpfasta, fpidx, bPerformAScoreInitialization, searchMgr);
+               if (!bSucceeded)
+                  break;
+
+               bPrepared = true;
+               fpdb = (g_staticParams.iDbType != DbType::FASTA_DB ? fpidx : fpfasta);
+
+               if (g_staticParams.options.iSpectrumBatchSize == 0 && g_staticParams.iDbType == DbType::FASTA_DB)
+               {
+                  logout("   - Reading all spectra into memory; set \"spectrum_batch_size\" if search terminates here.\n");
+                  fflush(stdout);
+               }
+
+               // The files overlap, so the run total is the elapsed time rather than the per-file sum.
+               tBeginTime = chrono::steady_clock::now();
+               pFile->tBeginTime = tBeginTime;
+            }
+
+            pReader = new MSReader();
+
+            // We want to read only MS2/MS3 scans.
+            CometPreprocess::SetMSLevelFilter(*pReader);
+            pReader->setGZIndexSave(g_staticParams.options.iGZIndexCache != 0);
+
+            // We need to reset some of the static variables in-between input files
+            CometPreprocess::Reset();
+
+            iFilesInBatch++;
+            iPercentStart = 0;
+         }
+
+         InputFileContext *pFile = vFiles.back();
+         SetInputFileContext(pFile);    // writing the previous batch may have switched it
+
+         size_t tFirstQuery = g_pvQuery.size();
+         unsigned short usiMaxFragmentCharge = 0;
+
+         bSucceeded = CometPreprocess::LoadAndPreprocessSpectra(*pReader, pFile->inputFile.iFirstScan, pFile->inputFile.iLastScan,
+               pFile->inputFile.iAnalysisType, tp, g_pvQuery, g_batchArena, usiMaxFragmentCharge);
+         iPercentEnd = CometPreprocess::GetReadPercent(*pReader);
+
+         for (size_t i = tFirstQuery; i < g_pvQuery.size(); ++i)
+            g_pvQuery.at(i)->iWhichInputFile = pFile->iWhichInputFile;
+
+         if (usiMaxFragmentCharge > usiBatchMaxFragmentCharge)
+            usiBatchMaxFragmentCharge = usiMaxFragmentCharge;
+
+         if (!bSucceeded)
+            break;
+
+         if (CometPreprocess::DoneProcessingAllSpectra())
+         {
+            pFile->bDoneReading = true;
+            delete pReader;
+            pReader = NULL;
+         }
+      }
+
+      if (bSucceeded && !g_pvQuery.empty())
+      {
+         if (g_staticParams.iDbType == DbType::FASTA_DB)
+         {
+            logout("   - Load spectra:");
+            fflush(stdout);
+         }
+         else
+         {
+            printf(" - searching batch %d ... ", iBatchNum);
+            fflush(stdout);
+         }
+
+         g_massRange.usiMaxFragmentCharge = usiBatchMaxFragmentCharge;
+
+         bSucceeded = SearchBatch(tp, iPercentStart, iPercentEnd);
+
+         if (g_staticParams.iDbType != DbType::FASTA_DB)
+            printf("\n");
+      }
+
+      if (bSucceeded && !g_pvQuery.empty())
+      {
+         // g_pvQuery is sorted by scan number so each file's part stays in scan order.
+         vector<Query*> vFileQuery;
+
+         for (auto itFile = vFiles.begin(); itFile != vFiles.end(); ++itFile)
+         {
+            InputFileContext *pFile = *itFile;
+
+            vFileQuery.clear();
+            for (auto it = g_pvQuery.begin(); it != g_pvQuery.end(); ++it)
+            {
+               if ((*it)->iWhichInputFile == pFile->iWhichInputFile)
+                  vFileQuery.push_back(*it);
+            }
+
+            if (vFileQuery.empty())
+               continue;
+
+            SetInputFileContext(pFile);
+
+            pFile->iNumBatches++;
+            bSucceeded = WriteOutputBatch(pFile->out, vFileQuery, fpdb, pFile->iNumSpectraSearched, pFile->iNumBatches);
+            pFile->iNumSpectraSearched += (int)vFileQuery.size();
+
+            if (!bSucceeded)
+               break;
+         }
+      }
+
+      // Destroying each Query object in the vector calls its destructor, which
+      // frees the spectral memory; g_batchArena is then reclaimed in one step.
+      for (auto it = g_pvQuery.begin(); it != g_pvQuery.end(); ++it)
+         DestroyQuery(*it);
+
+      g_pvQuery.clear();
+      g_batchArena.Reset();
+
+      // Every spectrum of a file that has been read to the end is now written.
+      for (auto itFile = vFiles.begin(); itFile != vFiles.end(); )
+      {
+         if (bSucceeded && (*itFile)->bDoneReading)
+         {
+            bSucceeded = FinishInputFile(*itFile, fpdb, iRunSpectraSearched, iRunFilesSearched,
+                  bBlankSearchFile, searchMgr);
+            delete *itFile;
+            itFile = vFiles.erase(itFile);
+         }
+         else
+            ++itFile;
+      }
+   }
+
+   // Only left over after an error.
+   for (auto itFile = vFiles.begin(); itFile != vFiles.end(); ++itFile)
+   {
+      CloseOutputFiles((*itFile)->out, (*itFile)->iNumSpectraSearched);
+      delete *itFile;
+   }
+
+   if (pReader != NULL)
+      delete pReader;
+
+   if (fpidx != NULL)
+      fclose(fpidx);
+   if (fpfasta != NULL)
+      fclose(fpfasta);
+
+   if (bPrepared)
+      llRunSearchMs = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - tBeginTime).count();
+
+   g_staticParams.inputFile.szBaseName[0] = '\0';
+
+   return bSucceeded;
+}
+
+
+bool CometSearchManager::DoSearch()
+{
+   string strOut;
+
+   ThreadPool *tp = _tp;
+
+   auto tGlobalStartTime = chrono::steady_clock::now();
+
+   if (!InitializeStaticParams())
+      return false;
+
+   if (!ValidateOutputFormat())
+      return false;
+
+   if (strlen(g_staticParams.databaseInfo.szDatabase) == 0 || !ValidateSequenceDatabaseFile())
+      g_bPerformDatabaseSearch = false;
+   else
+      g_bPerformDatabaseSearch = true;
+
+   if (g_staticParams.speclibInfo.strSpecLibFile.size() == 0 || !ValidateSpecLibFile())
+      g_bPerformSpecLibSearch = false;
+   else
+      g_bPerformSpecLibSearch = true;
+
+   if (g_bPerformDatabaseSearch == false && g_bPerformSpecLibSearch == false)
+      return false;
+
+   if (!ValidateScanRange())
+      return false;
+
+   if (!ValidatePeptideLengthRange())
+      return false;
+
+   bool bSucceeded = true;
+
+   // add git hash to version string if present
+   // repeated here from Comet main() as main() is skipped when search invoked via DLL
+   if (strlen(GITHUBSHA) > 0)
+   {
+      string sTmp = std::string(GITHUBSHA);
+      if (sTmp.size() > 7)
+         sTmp.resize(7);
+      g_sCometVersion = std::string(comet_version) + " (" + sTmp + ")";
+   }
+   else
+      g_sCometVersion = std::string(comet_version);
+
+   if (!g_staticParams.options.bOutputSqtStream)
+   {
+      strOut = "\n Comet version \"" + g_sCometVersion + "\"\n\n";
+      logout(strOut);
+      fflush(stdout);
+   }
+
+   try
+   {
+      tp->fillPool(g_staticParams.options.iNumThreads);
+   }
+   catch (const std::exception& e)
+   {
+      string strErrorMsg = " Error - thread pool initialization failed: " + std::string(e.what()) + "\n";
+      g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
+      logerr(strErrorMsg);
+      return false;
+   }
+
+   if (g_staticParams.options.bCreatePeptideIndex && g_staticParams.iDbType == DbType::FASTA_DB)
+   {
+      // WritePeptideIndex calls RunSearch just to query fasta and generate unique peptide list
+      bSucceeded = CometPeptideIndex::WritePeptideIndex(tp);
+      return bSucceeded;
+   }
+
+   if (g_staticParams.options.bCreateFragmentIndex || g_staticParams.iDbType == DbType::FASTA_DB)
+   {
+      // If specified, read in the protein variable mod filter file content.
+      // Do this here only for classic search or if creating the plain peptide index.
+      if (g_staticParams.variableModParameters.sProteinLModsListFile.length() > 0)
+      {
+         bool bVarModUsed = false;
+
+         // Do a quick check to confirm there's a variable mod specified,
+         // otherwise there's no point in parsing the file.
+         for (int iMod = 0; iMod < VMODS; ++iMod)
+         {
+            if (g_staticParams.variableModParameters.varModList[iMod].dVarModMass != 0.0)
+            {
+               bVarModUsed = true;
+               break;
+            }
+         }
+
+         if (bVarModUsed)
+         {
+            bSucceeded = ReadProteinVarModFilterFile();
+            if (!bSucceeded)
+               return bSucceeded;
+         }
+      }
+   }
+
+   // Load compound mods mass file if specified (B4 fix: only if parameter is explicitly set)
+   if (g_staticParams.variableModParameters.sCompoundModsFile.length() > 0)
+   {
+      FILE *fpCM;
+      if ((fpCM = fopen(g_staticParams.variableModParameters.sCompoundModsFile.c_str(), "r")) != NULL)
+      {
+         char szBuf[512];
+         double dTmp;
+
+         printf(" Parsing compoundmods file: %s\n", g_staticParams.variableModParameters.sCompoundModsFile.c_str());
+
+         while (fgets(szBuf, sizeof(szBuf), fpCM))
+         {
+            if (sscanf(szBuf, "%lf", &dTmp) == 1)
+               g_staticParams.variableModParameters.vdCompoundMasses.push_back(dTmp);
+         }
+         fclose(fpCM);
+
+         sort(g_staticParams.variableModParameters.vdCompoundMasses.begin(),
+              g_staticParams.variableModParameters.vdCompoundMasses.end());
+         g_staticParams.variableModParameters.vdCompoundMasses.erase(
+            unique(g_staticParams.variableModParameters.vdCompoundMasses.begin(),
+                   g_staticParams.variableModParameters.vdCompoundMasses.end()),
+            g_staticParams.variableModParameters.vdCompoundMasses.end());
+
+         g_staticParams.variableModParameters.uiNumCompoundMasses = (unsigned int)g_staticParams.variableModParameters.vdCompoundMasses.size();
+
+         if (g_staticParams.variableModParameters.uiNumCompoundMasses > 0)
+            g_staticParams.variableModParameters.bVarModSearch = true;  // B6: drives WithVariableMods path; see docs for trade-off
+      }
+      else
+      {
+         string strErrorMsg = " Error - could not open compoundmods_file \"" + g_staticParams.variableModParameters.sCompoundModsFile + "\"\n";
+         g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
+         logerr(strErrorMsg);
+         return false;
+      }
+   }
+
+   g_staticParams.precalcMasses.iMinus17 = BIN(g_staticParams.massUtility.dH2O);
+   g_staticParams.precalcMasses.iMinus18 = BIN(g_staticParams.massUtility.dNH3);
+   g_massRange.dMinMass = g_staticParams.options.dPeptideMassLow;
+   g_massRange.dMaxMass = g_staticParams.options.dPeptideMassHigh;
+
+   if (g_bPerformDatabaseSearch && g_staticParams.options.bCreateFragmentIndex) //index
+   {
+       // write out .idx file containing unmodified peptides and protein refs;
+       // this calls RunSearch just to query fasta and generate uniq peptide list
+       bSucceeded = CometFragmentIndex::WriteFIPlainPeptideIndex(tp);
+       if (!bSucceeded)
+          return bSucceeded;
+
+       CometSearch::DeallocateMemory(g_staticParams.options.iNumThreads);
+
+       if (g_pvInputFiles.size() == 0)
+          return bSucceeded;
+   }
+
+   bool bBlankSearchFile = false;
+
+   if (g_bPerformDatabaseSearch && g_staticParams.iDbType == DbType::FI_DB)
+   {
+      if (!g_staticParams.options.iFragIndexSkipReadPrecursors)
+      {
+         // read precursors before creating fragment index
+         auto tTime1 = chrono::steady_clock::now();
+         if (!g_staticParams.options.bOutputSqtStream)
+         {
+            cout << " - read precursors ... ";
+            fflush(stdout);
+         }
+
+         for (int i = 0; i < (int)g_pvInputFiles.size(); ++i)
+         {
+            bSucceeded = UpdateInputFile(g_pvInputFiles.at(i));
+            if (!bSucceeded)
+               break;
+
+            // For file access using MSToolkit.
+            MSReader mstReader;
+
+            // We want to read only MS2/MS3 scans.
+            CometPreprocess::SetMSLevelFilter(mstReader);
+            mstReader.setGZIndexSave(g_staticParams.options.iGZIndexCache != 0);
+
+            CometPreprocess::Reset();
+
+            bSucceeded = CometPreprocess::ReadPrecursors(mstReader);
+         }
+
+         if (!g_staticParams.options.bOutputSqtStream)
+            cout << CometMassSpecUtils::ElapsedTime(tTime1) << endl;
+      }
+   }
+
+   if (g_bPerformSpecLibSearch)
+   {
+      CometSpecLib::LoadSpecLib(g_staticParams.speclibInfo.strSpecLibFile);
+   }
+
+   bool bPerformAScoreInitialization = true;
+
+   // Search time and spectra summed across all input files for the run summary.
+   long long llRunSearchMs = 0;
+   int iRunSpectraSearched = 0;
+   int iRunFilesSearched = 0;
+
+   // With spectrum_batch_files > 1, batches can hold the spectra of several input
+   // files.  Only for a database search with its output written to files; Mango
+   // runs keep one file per batch.
+   bool bBatchFiles = (g_staticParams.options.iSpectrumBatchFiles > 1
+         && g_pvInputFiles.size() > 1
+         && g_bPerformDatabaseSearch
+         && !g_bPerformSpecLibSearch
+         && !g_staticParams.options.bOutputSqtStream
+         && !g_staticParams.options.bMango);
+
+   if (bBatchFiles)
+   {
+      // Batches holding several files are loaded, searched and written in turn.
+      if (g_staticParams.options.iSpectrumBatchPipeline)
+         logout(" Warning - spectrum_batch_pipeline is ignored when spectrum_batch_files > 1.\n");
+
+      bSucceeded = SearchInputFilesTogether(tp, bPerformAScoreInitialization, llRunSearchMs,
+            iRunSpectraSearched, iRunFilesSearched, bBlankSearchFile, *this);
+   }
+
+   for (int i = 0; !bBatchFiles && i < (int)g_pvInputFiles.size(); ++i)
+   {
+      bSucceeded = UpdateInputFile(g_pvInputFiles.at(i));
+      if (!bSucceeded)
+         break;
 
-      if (bSucceeded && g_staticParams.options.bOutputPercolatorFile)
+      time_t tStartTime;
+      time(&tStartTime);
+      strftime(g_staticParams.szDate, 26, "%Y/%m/%d, %I:%M:%S %p", localtime(&tStartTime));
+
+      if (!g_staticParams.options.bOutputSqtStream && g_staticParams.iDbType == DbType::FASTA_DB)
       {
-         if (iAnalysisType == AnalysisType_EntireFile)
-            sOutputPercolator = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix + ".pin";
-         else
-            sOutputPercolator = std::string(g_staticParams.inputFile.szBaseName) + g_staticParams.szOutputSuffix +
-            "." + std::to_string(iFirstScan) + "-" + std::to_string(iLastScan) + ".pin";
+         strOut = " Search start:  " + string(g_staticParams.szDate) + "\n";
+         strOut += " - Input file: " + string(g_staticParams.inputFile.szFileName) + "\n";
+         logout(strOut);
+         fflush(stdout);
+      }
 
-         fpout_percolator = fopen(sOutputPercolator.c_str(), "w");
-         if (!fpout_percolator)
-         {
-            string strErrorMsg = " Error - cannot write to file \"" + sOutputPercolator + "\".\n";
-            g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
-            logerr(strErrorMsg);
-            bSucceeded = false;
-         }
+      int iFirstScan = g_staticParams.inputFile.iFirstScan;             // First scan to search specified by user.
+      int iLastScan = g_staticParams.inputFile.iLastScan;               // Last scan to search specified by user.
+      int iPercentStart = 0;                                            // percentage within input file for start scan of batch
+      int iPercentEnd = 0;                                              // percentage within input file for end scan of batch
+      int iAnalysisType = g_staticParams.inputFile.iAnalysisType;       // 1=dta (retired),
+                                                                        // 2=specific scan,
+                                                                        // 3=specific scan + charge,
+                                                                        // 4=scan range,
+                                                                        // 5=entire file
 
-         if (bSucceeded)
-            CometWritePercolator::WritePercolatorHeader(fpout_percolator);
-      }
+      // For SQT & pepXML output file, check if they can be written to before doing anything else.
+      OutputFiles out;
+
+      bSucceeded = OpenOutputFiles(out, iAnalysisType, iFirstScan, iLastScan, *this);
 
       int iTotalSpectraSearched = 0;
       if (bSucceeded)
       {
-         //MH: Allocate memory shared by threads during spectral processing.
-         bSucceeded = CometPreprocess::AllocateMemory(g_staticParams.options.iNumThreads);
-         if (!bSucceeded)
-            break;
+         FILE* fpfasta = NULL;  // pointer to FASTA file; if .idx search, FASTA is used to retrieve sequences (mzid output)
+         FILE* fpidx = NULL;    // pointer to .idx file if used
 
-         // Allocate memory shared by threads during search
-         bSucceeded = CometSearch::AllocateMemory(g_staticParams.options.iNumThreads);
+         bSucceeded = PrepareSearch(tp, fpfasta, fpidx, bPerformAScoreInitialization, *this);
          if (!bSucceeded)
             break;
 
@@ -2751,116 +3592,117 @@ bool CometSearchManager::DoSearch()
          MSReader mstReader;
 
          // We want to read only MS2/MS3 scans.
-         SetMSLevelFilter(mstReader);
+         CometPreprocess::SetMSLevelFilter(mstReader);
+         mstReader.setGZIndexSave(g_staticParams.options.iGZIndexCache != 0);
 
          // We need to reset some of the static variables in-between input files
          CometPreprocess::Reset();
 
-         FILE* fpfasta = NULL;  // pointer to FASTA file; if .idx search, FASTA is used to retrieve sequences (mzid output)
-         FILE* fpidx = NULL;    // pointer to .idx file if used
+         if (g_staticParams.options.iSpectrumBatchSize == 0 && g_staticParams.iDbType == DbType::FASTA_DB)
+         {
+            logout("   - Reading all spectra into memory; set \"spectrum_batch_size\" if search terminates here.\n");
+            fflush(stdout);
+         }
 
-         if (g_bPerformDatabaseSearch)
+         auto tBeginTime = chrono::steady_clock::now();
+         if (g_staticParams.iDbType != DbType::FASTA_DB)
          {
-            string sTmpDB = g_staticParams.databaseInfo.szDatabase;
+            printf(" - searching \"%s\" ... ", g_staticParams.inputFile.szBaseName);
+            fflush(stdout);
+         }
 
+         FILE* fpdb = NULL;
+         if (g_bPerformDatabaseSearch)
+         {
             if (g_staticParams.iDbType != DbType::FASTA_DB)
-            {
-               // .idx db so first open .idx file
-               if ((fpidx = fopen(sTmpDB.c_str(), "r")) == NULL)
-               {
-                  string strErrorMsg = " Error (1a) - cannot read .idx file \"" + sTmpDB + "\".\n";
-                  g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
-                  logerr(strErrorMsg);
-                  return false;
-               }
-
-               // .idx db so next check if FASTA is present (not required)
-               sTmpDB = sTmpDB.erase(sTmpDB.size() - 4); // need plain fasta if indexdb input
-               if ((fpfasta = fopen(sTmpDB.c_str(), "r")) == NULL)
-               {
-                  g_bIdxNoFasta = true;
-                  fpfasta = NULL;
-               }
-            }
+               fpdb = fpidx;
             else
-            {
-               // FASTA search only
-               fpidx = NULL;
-
-               if ((fpfasta = fopen(sTmpDB.c_str(), "r")) == NULL)
-               {
-                  string strErrorMsg = " Error (1b) - cannot read sequence database file \"" + sTmpDB + "\".\n";
-                  g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
-                  logerr(strErrorMsg);
-                  return false;
-               }
-            }
+               fpdb = fpfasta;
          }
 
-         if (g_staticParams.options.iSpectrumBatchSize == 0 && g_staticParams.iDbType == DbType::FASTA_DB)
+         // Writes the results of one batch to every requested output format.
+         auto WriteBatch = [&](vector<Query*>& vQuery, int iNumSpectraSearched, int iWhichBatch) -> bool
          {
-            logout("   - Reading all spectra into memory; set \"spectrum_batch_size\" if search terminates here.\n");
-            fflush(stdout);
-         }
-
-         CometFragmentIndex sqSearch;
+            return WriteOutputBatch(out, vQuery, fpdb, iNumSpectraSearched, iWhichBatch);
+         };
 
-         if (g_bPerformDatabaseSearch && g_staticParams.iDbType == DbType::FI_DB)
+         // With spectrum_batch_pipeline, each batch is handed to an output thread
+         // and written while the next batch is searched.  For database searches the
+         // batch after that is also loaded and preprocessed on a loader thread with
+         // its own thread pool.  At most three batches are in memory: the one in
+         // vLoadQuery/loadArena being loaded, the one in g_pvQuery/g_batchArena being
+         // searched and the one in vOutputQuery/outputArena being written.  Not used
+         // for SQT to stdout since the output would interleave with the progress messages.
+         bool bPipelineOutput = (g_staticParams.options.iSpectrumBatchPipeline
+               && !g_staticParams.options.bOutputSqtStream);
+         bool bPipelineLoad = (bPipelineOutput && g_bPerformDatabaseSearch && !g_bPerformSpecLibSearch);
+         vector<Query*> vOutputQuery;
+         CometArena outputArena(32 * 1024 * 1024, true);
+         std::thread outputThread;
+         bool bOutputSucceeded = true;
+
+         // Waits for the output thread and frees the batch it was writing.
+         auto FinishOutputBatch = [&]() -> bool
          {
-            if (!g_bPlainPeptideIndexRead)
-            {
-               auto tStartTime = chrono::steady_clock::now();
-               if (!g_staticParams.options.bOutputSqtStream)
-               {
-                  cout <<  " - read .idx ... ";
-                  fflush(stdout);
-               }
+            if (outputThread.joinable())
+               outputThread.join();
 
-               sqSearch.ReadPlainPeptideIndex();
+            for (auto it = vOutputQuery.begin(); it != vOutputQuery.end(); ++it)
+               DestroyQuery(*it);
 
-               if (!g_staticParams.options.bOutputSqtStream)
-               {
-                  cout << CometMassSpecUtils::ElapsedTime(tStartTime) << endl;
-               }
+            vOutputQuery.clear();
+            outputArena.Reset();
 
-               sqSearch.CreateFragmentIndex(tp);
-            }
-         }
+            return bOutputSucceeded;
+         };
 
-         if (g_staticParams.options.iPrintAScoreProScore && bPerformAScoreInitialization)
+         vector<Query*> vLoadQuery;
+         CometArena loadArena(32 * 1024 * 1024, true);
+         unsigned short usiLoadMaxFragmentCharge = 0;
+         ThreadPool loadPool;
+         std::thread loadThread;
+         bool bLoadSucceeded = true;
+         int iLoadPercent = 0;
+
+         // The loader only has to stay ahead of the search, which keeps all
+         // num_threads threads, so it gets half of them.  Every batch of the file is
+         // loaded with this pool since the mzML/mzXML reader threads started with the
+         // first batch are sized from the pool that loads it.
+         if (bPipelineLoad)
          {
-            SetAScoreOptions(g_AScoreOptions);
-//          PrintAScoreOptions(g_AScoreOptions);
+            int iNumLoadThreads = g_staticParams.options.iNumThreads / 2;
+            if (iNumLoadThreads < 1)
+               iNumLoadThreads = 1;
 
-            // Create the AScoreDllInterface using the factory function
-            g_AScoreInterface = CreateAScoreDllInterface();
-            if (!g_AScoreInterface)
+            try
             {
-               std::cerr << "Failed to create AScore interface." << std::endl;
-               exit(1);
+               loadPool.fillPool(iNumLoadThreads);
+               loadPool.setErrorHandler([](const std::string& strErrorMsg) {
+                  g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
+                  });
+            }
+            catch (const std::exception&)
+            {
+               bPipelineLoad = false;   // fall back to loading each batch in turn
             }
-
-            bPerformAScoreInitialization = false;
          }
 
-         auto tBeginTime = chrono::steady_clock::now();
-         if (g_staticParams.iDbType != DbType::FASTA_DB)
+         // Waits for the loader thread and frees the batch it was loading.
+         auto FinishLoadBatch = [&]()
          {
-            printf(" - searching \"%s\" ... ", g_staticParams.inputFile.szBaseName);
-            fflush(stdout);
-         }
+            if (loadThread.joinable())
+               loadThread.join();
 
-         FILE* fpdb = NULL;
-         if (g_bPerformDatabaseSearch)
-         {
-            if (g_staticParams.iDbType != DbType::FASTA_DB)
-               fpdb = fpidx;
-            else
-               fpdb = fpfasta;
-         }
+            for (auto it = vLoadQuery.begin(); it != vLoadQuery.end(); ++it)
+               DestroyQuery(*it);
+
+            vLoadQuery.clear();
+            loadArena.Reset();
+         };
 
          int iBatchNum = 0;
-         while (!CometPreprocess::DoneProcessingAllSpectra()) // Loop through iMaxSpectraPerSearch
+         // DoneProcessingAllSpectra() is only read while no loader thread is running.
+         while (loadThread.joinable() || !CometPreprocess::DoneProcessingAllSpectra()) // Loop through iMaxSpectraPerSearch
          {
             iBatchNum++;
 
@@ -2877,247 +3719,103 @@ bool CometSearchManager::DoSearch()
             // spectra, we MUST "goto cleanup_results" before exiting the loop,
             // or we will create a memory leak!
 
-            bSucceeded = CometPreprocess::LoadAndPreprocessSpectra(mstReader, iFirstScan, iLastScan, iAnalysisType, tp);
-
-            if (!bSucceeded)
-               goto cleanup_results;
-
-            iPercentStart = iPercentEnd;
-            iPercentEnd = mstReader.getPercent();
-
-            if (g_pvQuery.empty())
-               continue;    //FIX make sure continue instead of break makes sense
-            else            // possible no spectrum in batch passes filters; do not want to break in that case;
-               iTotalSpectraSearched += (int)g_pvQuery.size();
-
-            bSucceeded = AllocateResultsMem();
-
-            if (!bSucceeded)
-               goto cleanup_results;
-
-            { // need strStatusMsg in it's own scope due to goto statement above
-               string strStatusMsg = " " + std::to_string(g_pvQuery.size()) + string("\n");
-               if (!g_staticParams.options.bOutputSqtStream && g_staticParams.iDbType == DbType::FASTA_DB)
-               {
-                  logout(strStatusMsg);
-               }
-               g_cometStatus.SetStatusMsg(strStatusMsg);
-            }
-
-            if (g_staticParams.options.bMango)
+            if (loadThread.joinable())
             {
-               int iCurrentScanNumber = 0;       // used to track multiple Mango precursors from same scan number
-               int iMangoIndex=0;
-
-               // sort back to original spectrum order in MS2 scan in order to associate pairs
-               // based on sequential order of precursors for each scan
-               std::sort(g_pvQuery.begin(), g_pvQuery.end(), compareByMangoIndex);
-
-               for (std::vector<Query*>::iterator it = g_pvQuery.begin(); it != g_pvQuery.end(); ++it)
-               {
-                  if ((*it)->_spectrumInfoInternal.iScanNumber != iCurrentScanNumber)
-                  {
-                     iCurrentScanNumber = (*it)->_spectrumInfoInternal.iScanNumber;
-                     iMangoIndex = 0;
-                  }
-                  else
-                     iMangoIndex++;
+               // take over the batch that was loaded while the previous one was searched
+               loadThread.join();
+               bSucceeded = bLoadSucceeded;
 
-                  sprintf((*it)->_spectrumInfoInternal.szMango, "%03d_%c", (int)iMangoIndex/2, (iMangoIndex % 2)?'B':'A');
-               }
+               g_pvQuery.swap(vLoadQuery);
+               g_batchArena.Swap(loadArena);
+               g_massRange.usiMaxFragmentCharge = usiLoadMaxFragmentCharge;
             }
-
-            // Sort g_pvQuery vector by dExpPepMass.
-            std::sort(g_pvQuery.begin(), g_pvQuery.end(), compareByPeptideMass);
-
-            g_massRange.dMinMass = g_pvQuery.at(0)->_pepMassInfo.dPeptideMassToleranceMinus;
-            g_massRange.dMaxMass = g_pvQuery.at(g_pvQuery.size()-1)->_pepMassInfo.dPeptideMassTolerancePlus;
-
-            if (g_massRange.dMaxMass - g_massRange.dMinMass > g_massRange.dMinMass)
-               g_massRange.bNarrowMassRange = true;
             else
-               g_massRange.bNarrowMassRange = false;
-
-            bSucceeded = !g_cometStatus.IsError() && !g_cometStatus.IsCancel();
-            if (!bSucceeded)
-               goto cleanup_results;
-
-            g_cometStatus.SetStatusMsg(string("Running search..."));
-
-            // Now that spectra are loaded to memory and sorted, do search.
-            if (g_bPerformDatabaseSearch)
-               bSucceeded = CometSearch::RunSearch(iPercentStart, iPercentEnd, tp);
-            if (g_bPerformSpecLibSearch)
-               bSucceeded = CometSearch::RunSpecLibSearch(iPercentStart, iPercentEnd, tp);
-
-            if (!bSucceeded)
-               goto cleanup_results;
-
-            bSucceeded = !g_cometStatus.IsError() && !g_cometStatus.IsCancel();
-            if (!bSucceeded)
-               goto cleanup_results;
-
-            if (!g_staticParams.options.bOutputSqtStream && g_staticParams.iDbType == DbType::FASTA_DB)
-            {
-               logout("     - Post analysis:");
-               fflush(stdout);
-            }
-
-            if (g_bPerformDatabaseSearch)
             {
-               g_cometStatus.SetStatusMsg(string("Performing post-search analysis ..."));
-
-               // Sort each entry by xcorr, calculate E-values, etc.
-               bSucceeded = CometPostAnalysis::PostAnalysis(tp);
+               bSucceeded = CometPreprocess::LoadAndPreprocessSpectra(mstReader, iFirstScan, iLastScan, iAnalysisType,
+                     (bPipelineLoad ? &loadPool : tp));
+               iLoadPercent = CometPreprocess::GetReadPercent(mstReader);
             }
 
             if (!bSucceeded)
                goto cleanup_results;
 
-            // Sort g_pvQuery vector by scan.
-            std::sort(g_pvQuery.begin(), g_pvQuery.end(), compareByScanNumber);
+            iPercentStart = iPercentEnd;
+            iPercentEnd = iLoadPercent;
 
-            if (!g_staticParams.options.bOutputSqtStream && g_staticParams.iDbType == DbType::FASTA_DB)
+            // Start loading the next batch; it is picked up at the top of the next iteration.
+            if (bPipelineLoad && !CometPreprocess::DoneProcessingAllSpectra())
             {
-               logout("  done\n");
-               fflush(stdout);
+               loadArena.Reset();
+
+               loadThread = std::thread([&]()
+                  {
+                     bLoadSucceeded = CometPreprocess::LoadAndPreprocessSpectra(mstReader, iFirstScan, iLastScan, iAnalysisType,
+                        &loadPool, vLoadQuery, loadArena, usiLoadMaxFragmentCharge);
+                     iLoadPercent = CometPreprocess::GetReadPercent(mstReader);
+                  });
             }
 
-            if (g_staticParams.options.bOutputPepXMLFile)
-               CometWritePepXML::WritePepXML(fpout_pepxml, fpoutd_pepxml, fpdb, iTotalSpectraSearched - (int)g_pvQuery.size());
+            if (g_pvQuery.empty())
+               continue;    //FIX make sure continue instead of break makes sense
+            else            // possible no spectrum in batch passes filters; do not want to break in that case;
+               iTotalSpectraSearched += (int)g_pvQuery.size();
 
-            // For mzid output, dump psms as tab-delimited text first then collate results to
-            // mzid file at very end due to requirements of this format.
-            if (g_staticParams.options.iOutputMzIdentMLFile)
-               CometWriteMzIdentML::WriteMzIdentMLTmp(fpout_mzidentmltmp, fpoutd_mzidentmltmp, iBatchNum);
+            bSucceeded = SearchBatch(tp, iPercentStart, iPercentEnd);
+            if (!bSucceeded)
+               goto cleanup_results;
 
-            if (g_staticParams.options.bOutputPercolatorFile)
+            if (bPipelineOutput)
             {
-               bSucceeded = CometWritePercolator::WritePercolator(fpout_percolator, fpdb);
+               // Hand this batch over once the output thread is done with the previous one.
+               bSucceeded = FinishOutputBatch();
                if (!bSucceeded)
                   goto cleanup_results;
-            }
 
-            if (g_staticParams.options.bOutputTxtFile)
-            {
-               CometWriteTxt::WriteTxt(fpout_txt, fpoutd_txt, fpdb);
-            }
+               vOutputQuery.swap(g_pvQuery);
+               outputArena.Swap(g_batchArena);
 
-            // Write SQT last as I destroy the g_staticParams.szMod string during that process
-            if (g_staticParams.options.bOutputSqtStream || g_staticParams.options.bOutputSqtFile)
-               CometWriteSqt::WriteSqt(fpout_sqt, fpoutd_sqt, fpdb);
+               outputThread = std::thread([&, iNumSpectraSearched = iTotalSpectraSearched - (int)vOutputQuery.size(), iBatchNum]()
+                  {
+                     bOutputSucceeded = WriteBatch(vOutputQuery, iNumSpectraSearched, iBatchNum);
+                  });
+            }
+            else
+               bSucceeded = WriteBatch(g_pvQuery, iTotalSpectraSearched - (int)g_pvQuery.size(), iBatchNum);
 
 cleanup_results:
 
-            // Deleting each Query object in the vector calls its destructor, which
+            // Destroying each Query object in the vector calls its destructor, which
             // frees the spectral memory (see definition for Query in CometDataInternal.h).
+            // Whatever lives in g_batchArena is then reclaimed in one step.
             for (auto it = g_pvQuery.begin(); it != g_pvQuery.end(); ++it)
-               delete (*it);
+               DestroyQuery(*it);
 
             g_pvQuery.clear();
+            g_batchArena.Reset();
 
             if (!bSucceeded)
                break;
          }
 
+         FinishLoadBatch();
+
+         if (!FinishOutputBatch())
+            bSucceeded = false;
+
          if (bSucceeded)
          {
             if (iTotalSpectraSearched == 0)
                logout(" Warning - no spectra searched.\n");
 
-            if (NULL != fpout_pepxml)
-               CometWritePepXML::WritePepXMLEndTags(fpout_pepxml);
-
-            if (NULL != fpoutd_pepxml)
-               CometWritePepXML::WritePepXMLEndTags(fpoutd_pepxml);
-
-            if (NULL != fpout_mzidentml)
-            {
-               fclose(fpout_mzidentmltmp); // close for writing and re-open for reading
-
-               if ((fpout_mzidentmltmp = fopen(sOutputMzIdentMLtmp.c_str(), "r")) == NULL)
-               {
-                  string strErrorMsg = " Error - cannot read temporary file \"" + sOutputMzIdentMLtmp + "\".\n";
-                  g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
-                  logerr(strErrorMsg);
-                  bSucceeded = false;
-               }
-
-               // now read tmp file and write mzIdentML
-               CometWriteMzIdentML::WriteMzIdentML(fpout_mzidentml, fpdb, sOutputMzIdentMLtmp.c_str(), *this);
-
-               fclose(fpout_mzidentmltmp);
-               remove(sOutputMzIdentMLtmp.c_str());
-            }
-
-            if (NULL != fpoutd_mzidentml)
-            {
-               fclose(fpoutd_mzidentmltmp); // close for writing and re-open for reading
-
-               if ((fpoutd_mzidentmltmp = fopen(sOutputDecoyMzIdentMLtmp.c_str(), "r")) == NULL)
-               {
-                  string strErrorMsg = " Error - cannot read temporary file \"" + sOutputDecoyMzIdentMLtmp + "\".\n";
-                  g_cometStatus.SetStatus(CometResult_Failed, strErrorMsg);
-                  logerr(strErrorMsg);
-                  bSucceeded = false;
-               }
-
-               // now read tmp file and write mzIdentML
-               CometWriteMzIdentML::WriteMzIdentML(fpoutd_mzidentml, fpdb, sOutputDecoyMzIdentMLtmp.c_str(), *this);
-
-               fclose(fpoutd_mzidentmltmp);
-               remove(sOutputDecoyMzIdentMLtmp.c_str());
-            }
-
-            if (!g_staticParams.options.bOutputSqtStream && g_staticParams.iDbType == DbType::FASTA_DB)
-            {
-               time_t tEndTime;
-
-               time(&tEndTime);
-               int iElapsedTime = (int)difftime(tEndTime, tStartTime);
-
-               strftime(g_staticParams.szDate, 26, "%Y/%m/%d, %I:%M:%S %p", localtime(&tEndTime));
-               strOut = " Search end:    " + string(g_staticParams.szDate);
-               logout(strOut);
-            }
-
-            if (!g_staticParams.options.bOutputSqtStream)
-            {
-               const auto duration = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - tBeginTime);
-               double dTimePerSpectra = (double)duration.count() / (double)iTotalSpectraSearched;
-
-               if (g_staticParams.iDbType == DbType::FASTA_DB)
-                  strOut = ", ";
-               else
-                  strOut = "";
-
-               char buf[128];
-
-               std::snprintf(buf, sizeof(buf), "%.2f", dTimePerSpectra);
-               strOut += CometMassSpecUtils::ElapsedTime(tBeginTime) + ", " + std::to_string(iTotalSpectraSearched) + " spectra, "
-                  + std::string(buf) + " ms/spec (";
+            if (!FinishOutputFiles(out, fpdb, *this))
+               bSucceeded = false;
 
-               std::snprintf(buf, sizeof(buf), "%.0f", 1000.0 / dTimePerSpectra);
-               strOut += std::string(buf) + " Hz)";
+            PrintSearchEnd(tBeginTime, iTotalSpectraSearched);
 
-               size_t peakKB = GetPeakMemoryKB();
-               if (peakKB > 0)
-               {
-                  if (peakKB >= 1024 * 1024)
-                  {
-                     std::snprintf(buf, sizeof(buf), "%.1f", (peakKB / (1024.0 * 1024.0)));
-                     strOut += ", " + std::string(buf) + "GB peak";
-                  }
-                  else
-                  {
-                     std::snprintf(buf, sizeof(buf), "%.1f", (peakKB / 1024.0));
-                     strOut += ", " + std::string(buf) + "MB peak";
-                  }
-               }
-               strOut += "\n";
-               logout(strOut);
-            }
 
+            llRunSearchMs += chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - tBeginTime).count();
+            iRunSpectraSearched += iTotalSpectraSearched;
+            iRunFilesSearched++;
          }
 
          if (fpidx != NULL)
@@ -3126,97 +3824,7 @@ cleanup_results:
             fclose(fpfasta);
       }
 
-      //MH: Deallocate spectral processing memory.
-      CometPreprocess::DeallocateMemory(g_staticParams.options.iNumThreads);
-
-      // Deallocate search memory
-      CometSearch::DeallocateMemory(g_staticParams.options.iNumThreads);
-
-      if (NULL != fpout_pepxml)
-      {
-         fclose(fpout_pepxml);
-         fpout_pepxml = NULL;
-         if (iTotalSpectraSearched == 0)
-            remove(sOutputPepXML.c_str());
-      }
-
-      if (NULL != fpoutd_pepxml)
-      {
-         fclose(fpoutd_pepxml);
-         fpoutd_pepxml = NULL;
-         if (iTotalSpectraSearched == 0)
-            remove(sOutputDecoyPepXML.c_str());
-      }
-
-      if (NULL != fpout_mzidentml)
-      {
-         fclose(fpout_mzidentml);
-         fpout_mzidentml = NULL;
-         if (iTotalSpectraSearched == 0)
-         {
-            remove(sOutputMzIdentML.c_str());
-            remove(sOutputMzIdentMLtmp.c_str());
-         }
-      }
-
-      if (NULL != fpoutd_mzidentml)
-      {
-         fclose(fpoutd_mzidentml);
-         fpoutd_mzidentml = NULL;
-         if (iTotalSpectraSearched == 0)
-         {
-            remove(sOutputDecoyMzIdentML.c_str());
-            remove(sOutputDecoyMzIdentMLtmp.c_str());
-         }
-      }
-
-      if (NULL != fpout_percolator)
-      {
-         fclose(fpout_percolator);
-         fpout_percolator = NULL;
-         if (iTotalSpectraSearched == 0)
-            remove(sOutputPercolator.c_str());
-      }
-
-      if (NULL != fpout_sqt)
-      {
-         fclose(fpout_sqt);
-         fpout_sqt = NULL;
-         if (iTotalSpectraSearched == 0)
-            remove(sOutputSQT.c_str());
-      }
-
-      if (NULL != fpoutd_sqt)
-      {
-         fclose(fpoutd_sqt);
-         fpoutd_sqt = NULL;
-         if (iTotalSpectraSearched == 0)
-            remove(sOutputDecoySQT.c_str());
-      }
-
-      if (NULL != fpoutd_sqt)
-      {
-         fclose(fpoutd_sqt);
-         fpoutd_sqt = NULL;
-         if (iTotalSpectraSearched == 0)
-            remove(sOutputDecoySQT.c_str());
-      }
-
-      if (NULL != fpout_txt)
-      {
-         fclose(fpout_txt);
-         fpout_txt = NULL;
-         if (iTotalSpectraSearched == 0)
-            remove(sOutputTxt.c_str());
-      }
-
-      if (NULL != fpoutd_txt)
-      {
-         fclose(fpoutd_txt);
-         fpoutd_txt = NULL;
-         if (iTotalSpectraSearched == 0)
-            remove(sOutputDecoyTxt.c_str());
-      }
+      CloseOutputFiles(out, iTotalSpectraSearched);
 
       if (iTotalSpectraSearched == 0)
          bBlankSearchFile = true;
@@ -3227,13 +3835,35 @@ cleanup_results:
          break;
    }
 
+   //MH: Deallocate spectral processing memory.
+   g_batchArena.Release();
+   CometPreprocess::DeallocateMemory(g_staticParams.options.iNumThreads);
+
+   // Deallocate search memory
+   CometSearch::DeallocateMemory(g_staticParams.options.iNumThreads);
+
+   // Aggregate throughput when several input files were searched in this run.
+   if (iRunFilesSearched > 1 && iRunSpectraSearched > 0 && !g_staticParams.options.bOutputSqtStream)
+   {
+      char buf[128];
+      double dTimePerSpectra = (double)llRunSearchMs / (double)iRunSpectraSearched;
+
+      std::snprintf(buf, sizeof(buf), " Total:  %d files, %.1f sec, %d spectra, %.2f ms/spec (%.0f Hz)\n",
+         iRunFilesSearched, llRunSearchMs / 1000.0, iRunSpectraSearched, dTimePerSpectra,
+         (dTimePerSpectra > 0.0 ? 1000.0 / dTimePerSpectra : 0.0));
+      logout(buf);
+   }
+
    if (g_staticParams.iDbType == DbType::FI_DB) // clean fragment ion index
    {
       free(g_bIndexPrecursors);       // allocated in InitializeStaticParams
 
-      delete[] g_iFragmentIndex;
-      delete[] g_iFragmentIndexOffset;
+      CometFragmentIndex::DeleteFragmentIndex();
    }
+   else if (g_staticParams.iDbType == DbType::PI_DB) // unmap peptide index
+      CometPeptideIndex::DeletePeptideIndex();
+   else // peptide_centric_search list
+      CometSearch::DeletePeptideCentricList();
 
    if (g_staticParams.iDbType != DbType::FASTA_DB) // for either index search
       std::cout << " - done. (" << CometMassSpecUtils::ElapsedTime(tGlobalStartTime) << ")" << endl << endl;
@@ -3350,13 +3980,12 @@ bool CometSearchManager::InitializeSingleSpectrumSearch()
 
       if (g_staticParams.iDbType == DbType::FI_DB && !g_bPlainPeptideIndexRead)
       {
-         sqSearch.ReadPlainPeptideIndex();
          sqSearch.CreateFragmentIndex(tp);
 
          if (g_staticParams.options.iPrintAScoreProScore)
          {
             // normally set at end of InitializeStaticParams; must do here again after
-            // ReadPlainPeptideIndex for single spectrum search
+            // reading the .idx header for single spectrum search
             SetAScoreOptions(g_AScoreOptions);
             //       PrintAScoreOptions(g_AScoreOptions);
 
@@ -3429,6 +4058,9 @@ void CometSearchManager::FinalizeSingleSpectrumSearch()
       // Deallocate search memory
       CometSearch::DeallocateMemory(g_staticParams.options.iNumThreads);
 
+      if (g_staticParams.iDbType == DbType::PI_DB)
+         CometPeptideIndex::DeletePeptideIndex();
+
       if (g_staticParams.options.iPrintAScoreProScore)
          DeleteAScoreDllInterface(g_AScoreInterface);
 
@@ -3772,8 +4404,7 @@ bool CometSearchManager::DoSingleSpectrumSearchMultiResults(const int topN,
          }
          eachStrReturnPeptide += "." + std::string(1, pOutput[iWhichResult].cNextAA);
 
-         // Protein name retrieval - done inline using pOutput directly instead of
-         // calling GetProteinNameString which indexes into g_pvQuery.
+         // Protein name retrieval - done inline using pOutput directly.
          // This replicates the indexed-db path from GetProteinNameString.
          char szProteinName[512];
          int iLenDecoyPrefix = (int)strlen(g_staticParams.szDecoyPrefix);
@@ -3786,7 +4417,9 @@ bool CometSearchManager::DoSingleSpectrumSearchMultiResults(const int topN,
             comet_fileoffset_t lEntry = pOutput[iWhichResult].lProteinFilePosition;
             int iPrintDuplicateProteinCt = 0;
 
-            for (auto itProt = g_pvProteinsList.at(lEntry).begin(); itProt != g_pvProteinsList.at(lEntry).end(); ++itProt)
+            ProteinListView proteinList = GetIndexProteinList(lEntry);
+
+            for (auto itProt = proteinList.begin(); itProt != proteinList.end(); ++itProt)
             {
                comet_fseek(fp, *itProt, SEEK_SET);
                if (fgets(szProteinName, 511, fp) == NULL)
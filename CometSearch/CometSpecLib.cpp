@@ -509,6 +509,8 @@ bool CometSpecLib::LoadSpecLibMS1Raw(ThreadPool* tp,
    msLevel.push_back(MS2);
    msLevel.push_back(MS3);  // need all levels to get last scan RT
    mstReader2.setFilter(msLevel);
+   mstReader.setGZIndexSave(g_staticParams.options.iGZIndexCache != 0);
+   mstReader2.setGZIndexSave(g_staticParams.options.iGZIndexCache != 0);
 
    int iAnalysisType = AnalysisType_EntireFile;
 
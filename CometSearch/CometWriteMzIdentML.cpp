@@ -38,7 +38,8 @@ CometWriteMzIdentML::~CometWriteMzIdentML()
 }
 
 
-void CometWriteMzIdentML::WriteMzIdentMLTmp(FILE *fpout,
+void CometWriteMzIdentML::WriteMzIdentMLTmp(vector<Query*> &vQuery,
+                                            FILE *fpout,
                                             FILE *fpoutd,
                                             int iBatchNum)
 {
@@ -47,15 +48,15 @@ void CometWriteMzIdentML::WriteMzIdentMLTmp(FILE *fpout,
    // Print temporary results in tab-delimited file
    if (g_staticParams.options.iDecoySearch == 2)
    {
-      for (i=0; i<(int)g_pvQuery.size(); ++i)
-         PrintTmpPSM(i, 1, iBatchNum, fpout);
-      for (i=0; i<(int)g_pvQuery.size(); ++i)
-         PrintTmpPSM(i, 2, iBatchNum, fpoutd);
+      for (i=0; i<(int)vQuery.size(); ++i)
+         PrintTmpPSM(vQuery, i, 1, iBatchNum, fpout);
+      for (i=0; i<(int)vQuery.size(); ++i)
+         PrintTmpPSM(vQuery, i, 2, iBatchNum, fpoutd);
    }
    else
    {
-      for (i=0; i<(int)g_pvQuery.size(); ++i)
-         PrintTmpPSM(i, 0, iBatchNum, fpout);
+      for (i=0; i<(int)vQuery.size(); ++i)
+         PrintTmpPSM(vQuery, i, 0, iBatchNum, fpout);
    }
 }
 
@@ -1370,15 +1371,16 @@ void CometWriteMzIdentML::WriteSpectrumIdentificationList(FILE* fpout,
 }
 
 
-void CometWriteMzIdentML::PrintTmpPSM(int iWhichQuery,
+void CometWriteMzIdentML::PrintTmpPSM(vector<Query*> &vQuery,
+                                      int iWhichQuery,
                                       int iPrintTargetDecoy,
                                       int iBatchNum,
                                       FILE *fpout)
 {
-   if ((iPrintTargetDecoy != 2 && g_pvQuery.at(iWhichQuery)->_pResults[0].fXcorr > g_staticParams.options.dMinimumXcorr)
-         || (iPrintTargetDecoy == 2 && g_pvQuery.at(iWhichQuery)->_pDecoys[0].fXcorr > g_staticParams.options.dMinimumXcorr))
+   if ((iPrintTargetDecoy != 2 && vQuery.at(iWhichQuery)->_pResults[0].fXcorr > g_staticParams.options.dMinimumXcorr)
+         || (iPrintTargetDecoy == 2 && vQuery.at(iWhichQuery)->_pDecoys[0].fXcorr > g_staticParams.options.dMinimumXcorr))
    {
-      Query* pQuery = g_pvQuery.at(iWhichQuery);
+      Query* pQuery = vQuery.at(iWhichQuery);
 
       Results *pOutput;
       int iNumPrintLines;
@@ -1465,7 +1467,9 @@ void CometWriteMzIdentML::PrintTmpPSM(int iWhichQuery,
             {
                comet_fileoffset_t lEntry = pOutput[iWhichResult].lProteinFilePosition;
 
-               for (auto it = g_pvProteinsList.at(lEntry).begin(); it != g_pvProteinsList.at(lEntry).end(); ++it)
+               ProteinListView proteinList = GetIndexProteinList(lEntry);
+
+               for (auto it = proteinList.begin(); it != proteinList.end(); ++it)
                {
 #ifdef _WIN32
                   fprintf(fpout, "%I64d:%d;", *it, 0);
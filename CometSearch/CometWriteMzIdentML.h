@@ -51,7 +51,8 @@ public:
    ~CometWriteMzIdentML();
 
 
-   static void WriteMzIdentMLTmp(FILE *fpout,
+   static void WriteMzIdentMLTmp(vector<Query*> &vQuery,
+                                 FILE *fpout,
                                  FILE *fpoutd,
                                  int iBatchNum);
 
@@ -64,7 +65,8 @@ private:
 
    static bool WriteMzIdentMLHeader(FILE *fpout);
 
-   static void PrintTmpPSM(int iWhichQuery,
+   static void PrintTmpPSM(vector<Query*> &vQuery,
+                           int iWhichQuery,
                            int iPrintTargetDecoy,
                            int iBatchNum,
                            FILE *fpOut);
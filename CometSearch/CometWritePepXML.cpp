@@ -34,7 +34,8 @@ CometWritePepXML::~CometWritePepXML()
 }
 
 
-void CometWritePepXML::WritePepXML(FILE *fpout,
+void CometWritePepXML::WritePepXML(vector<Query*> &vQuery,
+                                   FILE *fpout,
                                    FILE *fpoutd,
                                    FILE *fpdb,
                                    int iNumSpectraSearched)
@@ -44,15 +45,15 @@ void CometWritePepXML::WritePepXML(FILE *fpout,
    // Print out the separate decoy hits.
    if (g_staticParams.options.iDecoySearch == 2)
    {
-      for (i = 0; i < (int)g_pvQuery.size(); ++i)
-         PrintResults(i, 1, fpout, fpdb, iNumSpectraSearched);
-      for (i = 0; i < (int)g_pvQuery.size(); ++i)
-         PrintResults(i, 2, fpoutd, fpdb, iNumSpectraSearched);
+      for (i = 0; i < (int)vQuery.size(); ++i)
+         PrintResults(vQuery, i, 1, fpout, fpdb, iNumSpectraSearched);
+      for (i = 0; i < (int)vQuery.size(); ++i)
+         PrintResults(vQuery, i, 2, fpoutd, fpdb, iNumSpectraSearched);
    }
    else
    {
-      for (i = 0; i < (int)g_pvQuery.size(); ++i)
-         PrintResults(i, 0, fpout, fpdb, iNumSpectraSearched);
+      for (i = 0; i < (int)vQuery.size(); ++i)
+         PrintResults(vQuery, i, 0, fpout, fpdb, iNumSpectraSearched);
    }
 }
 
@@ -412,7 +413,8 @@ void CometWritePepXML::WritePepXMLEndTags(FILE *fpout)
    fprintf(fpout, "</msms_pipeline_analysis>\n");
 }
 
-void CometWritePepXML::PrintResults(int iWhichQuery,
+void CometWritePepXML::PrintResults(vector<Query*> &vQuery,
+                                    int iWhichQuery,
                                     int iPrintTargetDecoy,
                                     FILE *fpout,
                                     FILE *fpdb,
@@ -423,7 +425,7 @@ void CometWritePepXML::PrintResults(int iWhichQuery,
         iMinLength;
    char *pStr;
 
-   Query* pQuery = g_pvQuery.at(iWhichQuery);
+   Query* pQuery = vQuery.at(iWhichQuery);
 
    // look for either \ or / separator so valid for Windows or Linux
    if ((pStr = strrchr(g_staticParams.inputFile.szBaseName, '\\')) == NULL
@@ -500,7 +502,7 @@ void CometWritePepXML::PrintResults(int iWhichQuery,
    for (int iWhichResult=0; iWhichResult<iNumPrintLines; ++iWhichResult)
    {
       if (pOutput[iWhichResult].fXcorr > g_staticParams.options.dMinimumXcorr)
-         PrintPepXMLSearchHit(iWhichQuery, iWhichResult, iPrintTargetDecoy, pOutput, fpout, fpdb);
+         PrintPepXMLSearchHit(vQuery, iWhichQuery, iWhichResult, iPrintTargetDecoy, pOutput, fpout, fpdb);
    }
 
    fprintf(fpout, "  </search_result>\n");
@@ -508,7 +510,8 @@ void CometWritePepXML::PrintResults(int iWhichQuery,
 }
 
 
-void CometWritePepXML::PrintPepXMLSearchHit(int iWhichQuery,
+void CometWritePepXML::PrintPepXMLSearchHit(vector<Query*> &vQuery,
+                                            int iWhichQuery,
                                             int iWhichResult,
                                             int iPrintTargetDecoy,
                                             Results *pOutput,
@@ -520,7 +523,7 @@ void CometWritePepXML::PrintPepXMLSearchHit(int iWhichQuery,
    int iNMC;
    unsigned int uiNumTotProteins = 0;
 
-   Query* pQuery = g_pvQuery.at(iWhichQuery);
+   Query* pQuery = vQuery.at(iWhichQuery);
 
    CalcNTTNMC(pOutput, iWhichResult, &iNTT, &iNMC);
 
@@ -529,7 +532,7 @@ void CometWritePepXML::PrintPepXMLSearchHit(int iWhichQuery,
    std::vector<string>::iterator it;
 
    bool bReturnFulProteinString = false;
-   CometMassSpecUtils::GetProteinNameString(fpdb, iWhichQuery, iWhichResult, iPrintTargetDecoy, bReturnFulProteinString, &uiNumTotProteins, vProteinTargets, vProteinDecoys);
+   CometMassSpecUtils::GetProteinNameString(fpdb, pQuery, iWhichResult, iPrintTargetDecoy, bReturnFulProteinString, &uiNumTotProteins, vProteinTargets, vProteinDecoys);
 
    fprintf(fpout, "   <search_hit hit_rank=\"%d\"", pOutput[iWhichResult].usiRankXcorr);
    fprintf(fpout, " peptide=\"%s\"", pOutput[iWhichResult].szPeptide);
@@ -754,7 +757,7 @@ void CometWritePepXML::PrintPepXMLSearchHit(int iWhichQuery,
 
             if (pOutput[iWhichResult].piVarModSites[i] < 0)
             {
-               fprintf(fpout, " source=\"peff\" id=\"%s\"/>\n", pOutput[iWhichResult].pszMod[i]);
+               fprintf(fpout, " source=\"peff\" id=\"%s\"/>\n", pOutput[iWhichResult].PeffMod(i));
             }
             else if (pOutput[iWhichResult].piVarModSites[i] > 0)
                fprintf(fpout, " source=\"param\"/>\n");
@@ -26,7 +26,8 @@ public:
    static bool WritePepXMLHeader(FILE *fpout,
                                  CometSearchManager &searchMgr);
 
-   static void WritePepXML(FILE *fpout,
+   static void WritePepXML(vector<Query*> &vQuery,
+                           FILE *fpout,
                            FILE *fpoutd,
                            FILE *fpdb,
                            int iNumSpectraSearched);
@@ -43,13 +44,15 @@ public:
 
 
 private:
-   static void PrintResults(int iWhichQuery,
+   static void PrintResults(vector<Query*> &vQuery,
+                            int iWhichQuery,
                             int iPrintTargetDecoy,
                             FILE *fpOut,
                             FILE *fpdb,
                             int iNumSpectraSearched);
 
-   static void PrintPepXMLSearchHit(int iWhichQuery,
+   static void PrintPepXMLSearchHit(vector<Query*> &vQuery,
+                                    int iWhichQuery,
                                     int iWhichResult,
                                     int iPrintTargetDecoy,
                                     Results *pOutput,
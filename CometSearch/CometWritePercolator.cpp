@@ -31,23 +31,24 @@ CometWritePercolator::~CometWritePercolator()
 }
 
 
-bool CometWritePercolator::WritePercolator(FILE *fpout,
+bool CometWritePercolator::WritePercolator(vector<Query*> &vQuery,
+                                           FILE *fpout,
                                            FILE *fpdb)
 {
    int i;
    int iLenDecoyPrefix = (int)strlen(g_staticParams.szDecoyPrefix);
 
    // Print results.
-   for (i=0; i<(int)g_pvQuery.size(); ++i)
+   for (i=0; i<(int)vQuery.size(); ++i)
    {
-      if (g_pvQuery.at(i)->_pResults[0].fXcorr > g_staticParams.options.dMinimumXcorr)
+      if (vQuery.at(i)->_pResults[0].fXcorr > g_staticParams.options.dMinimumXcorr)
       {
-         PrintResults(i, fpout, fpdb, 0, iLenDecoyPrefix);  // print search hit (could be decoy if g_staticParams.options.iDecoySearch=1)
+         PrintResults(vQuery, i, fpout, fpdb, 0, iLenDecoyPrefix);  // print search hit (could be decoy if g_staticParams.options.iDecoySearch=1)
       }
 
-      if (g_staticParams.options.iDecoySearch == 2 && g_pvQuery.at(i)->_pDecoys[0].fXcorr > g_staticParams.options.dMinimumXcorr)
+      if (g_staticParams.options.iDecoySearch == 2 && vQuery.at(i)->_pDecoys[0].fXcorr > g_staticParams.options.dMinimumXcorr)
       {
-         PrintResults(i, fpout, fpdb, 2, iLenDecoyPrefix);  // print decoy hit
+         PrintResults(vQuery, i, fpout, fpdb, 2, iLenDecoyPrefix);  // print decoy hit
       }
    }
 
@@ -85,7 +86,8 @@ void CometWritePercolator::WritePercolatorHeader(FILE *fpout)
 }
 
 
-bool CometWritePercolator::PrintResults(int iWhichQuery,
+bool CometWritePercolator::PrintResults(vector<Query*> &vQuery,
+                                        int iWhichQuery,
                                         FILE *fpout,
                                         FILE *fpdb,
                                         int iPrintTargetDecoy,
@@ -93,7 +95,7 @@ bool CometWritePercolator::PrintResults(int iWhichQuery,
 {
    int  iNumPrintLines;
 
-   Query* pQuery = g_pvQuery.at(iWhichQuery);
+   Query* pQuery = vQuery.at(iWhichQuery);
 
    Results *pOutput;
 
@@ -127,7 +129,7 @@ bool CometWritePercolator::PrintResults(int iWhichQuery,
 
       unsigned int uiNumTotProteins = 0;  // unused in pin
       bool bReturnFulProteinString = false;
-      CometMassSpecUtils::GetProteinNameString(fpdb, iWhichQuery, iWhichResult, iPrintTargetDecoy, bReturnFulProteinString, &uiNumTotProteins, vProteinTargets, vProteinDecoys);
+      CometMassSpecUtils::GetProteinNameString(fpdb, pQuery, iWhichResult, iPrintTargetDecoy, bReturnFulProteinString, &uiNumTotProteins, vProteinTargets, vProteinDecoys);
 
       if (g_staticParams.options.iDecoySearch) // using Comet's internal decoys
       {
@@ -164,14 +166,15 @@ bool CometWritePercolator::PrintResults(int iWhichQuery,
       fprintf(fpout, "%0.6f\t", pQuery->_pepMassInfo.dExpPepMass);  //ExpMass
       fprintf(fpout, "%0.6f\t", pOutput[iWhichResult].dPepMass);  //CalcMass
 
-      PrintPercolatorSearchHit(iWhichQuery, iWhichResult, iPrintTargetDecoy, pOutput, fpout, vProteinTargets, vProteinDecoys);
+      PrintPercolatorSearchHit(vQuery, iWhichQuery, iWhichResult, iPrintTargetDecoy, pOutput, fpout, vProteinTargets, vProteinDecoys);
    }
 
    return true;
 }
 
 
-void CometWritePercolator::PrintPercolatorSearchHit(int iWhichQuery,
+void CometWritePercolator::PrintPercolatorSearchHit(vector<Query*> &vQuery,
+                                                    int iWhichQuery,
                                                     int iWhichResult,
                                                     int iPrintTargetDecoy,
                                                     Results *pOutput,
@@ -184,7 +187,7 @@ void CometWritePercolator::PrintPercolatorSearchHit(int iWhichQuery,
    int iCterm;
    int iNMC;
 
-   Query* pQuery = g_pvQuery.at(iWhichQuery);
+   Query* pQuery = vQuery.at(iWhichQuery);
 
    CalcNTTNMC(pOutput, iWhichResult, &iNterm, &iCterm, &iNMC);
 
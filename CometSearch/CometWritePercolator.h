@@ -23,17 +23,20 @@ public:
    CometWritePercolator();
    ~CometWritePercolator();
    static void WritePercolatorHeader(FILE *fpout);
-   static bool WritePercolator(FILE *fpout,
+   static bool WritePercolator(vector<Query*> &vQuery,
+                               FILE *fpout,
                                FILE *fpdb);
 
 
 private:
-   static bool PrintResults(int iWhichQuery,
+   static bool PrintResults(vector<Query*> &vQuery,
+                            int iWhichQuery,
                             FILE *fpOut,
                             FILE *fpdb,
                             int iPrintTargetDecoy,
                             int iLenDecoyPrefix);
-   static void PrintPercolatorSearchHit(int iWhichQuery,
+   static void PrintPercolatorSearchHit(vector<Query*> &vQuery,
+                                        int iWhichQuery,
                                     int iWhichResult,
                                     int iPrintTargetDecoy,
                                     Results *pOutput,
@@ -29,7 +29,8 @@ CometWriteSqt::~CometWriteSqt()
 }
 
 
-void CometWriteSqt::WriteSqt(FILE *fpout,
+void CometWriteSqt::WriteSqt(vector<Query*> &vQuery,
+                             FILE *fpout,
                              FILE *fpoutd,
                              FILE *fpdb)
 {
@@ -38,15 +39,15 @@ void CometWriteSqt::WriteSqt(FILE *fpout,
    // Print out the separate decoy hits.
    if (g_staticParams.options.iDecoySearch == 2)
    {
-      for (i=0; i<(int)g_pvQuery.size(); ++i)
-         PrintResults(i, 1, fpout, fpdb);
-      for (i=0; i<(int)g_pvQuery.size(); ++i)
-         PrintResults(i, 2, fpoutd, fpdb);
+      for (i=0; i<(int)vQuery.size(); ++i)
+         PrintResults(vQuery, i, 1, fpout, fpdb);
+      for (i=0; i<(int)vQuery.size(); ++i)
+         PrintResults(vQuery, i, 2, fpoutd, fpdb);
    }
    else
    {
-      for (i=0; i<(int)g_pvQuery.size(); ++i)
-         PrintResults(i, 0, fpout, fpdb);
+      for (i=0; i<(int)vQuery.size(); ++i)
+         PrintResults(vQuery, i, 0, fpout, fpdb);
    }
 }
 
@@ -161,7 +162,8 @@ void CometWriteSqt::PrintSqtHeader(FILE *fpout,
 }
 
 
-void CometWriteSqt::PrintResults(int iWhichQuery,
+void CometWriteSqt::PrintResults(vector<Query*> &vQuery,
+                                 int iWhichQuery,
                                  int iPrintTargetDecoy,
                                  FILE *fpout,
                                  FILE *fpdb)
@@ -170,7 +172,7 @@ void CometWriteSqt::PrintResults(int iWhichQuery,
         iNumPrintLines;
    std::ostringstream oss;
 
-   Query* pQuery = g_pvQuery.at(iWhichQuery);
+   Query* pQuery = vQuery.at(iWhichQuery);
 
    Results *pOutput;
 
@@ -212,12 +214,13 @@ void CometWriteSqt::PrintResults(int iWhichQuery,
    for (i=0; i<iNumPrintLines; ++i)
    {
       if (pOutput[i].fXcorr > g_staticParams.options.dMinimumXcorr)
-         PrintSqtLine(iWhichQuery, i, pOutput, fpout, fpdb, iPrintTargetDecoy);
+         PrintSqtLine(vQuery, iWhichQuery, i, pOutput, fpout, fpdb, iPrintTargetDecoy);
    }
 }
 
 
-void CometWriteSqt::PrintSqtLine(int iWhichQuery,
+void CometWriteSqt::PrintSqtLine(vector<Query*> &vQuery,
+                                 int iWhichQuery,
                                  int iWhichResult,
                                  Results *pOutput,
                                  FILE *fpout,
@@ -324,7 +327,7 @@ void CometWriteSqt::PrintSqtLine(int iWhichQuery,
    unsigned int uiNumTotProteins = 0;  // unused in sqt
    bool bReturnFulProteinString = false;
 
-   CometMassSpecUtils::GetProteinNameString(fpdb, iWhichQuery, iWhichResult, iPrintTargetDecoy,
+   CometMassSpecUtils::GetProteinNameString(fpdb, vQuery.at(iWhichQuery), iWhichResult, iPrintTargetDecoy,
       bReturnFulProteinString, &uiNumTotProteins, vProteinTargets, vProteinDecoys);
 
    if (iPrintTargetDecoy != 2)  // if not decoy only, print target proteins
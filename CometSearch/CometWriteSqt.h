@@ -23,7 +23,8 @@ public:
    CometWriteSqt();
    ~CometWriteSqt();
 
-   static void WriteSqt(FILE *fpout,
+   static void WriteSqt(vector<Query*> &vQuery,
+                        FILE *fpout,
                         FILE *fpoutd,
                         FILE *fpdb);
 
@@ -31,11 +32,13 @@ public:
                               CometSearchManager &searchMgr);
 
 private:
-   static void PrintResults(int iWhichQuery,
+   static void PrintResults(vector<Query*> &vQuery,
+                            int iWhichQuery,
                             int iPrintTargetDecoy,
                             FILE *fpOut,
                             FILE *fpdb);
-   static void PrintSqtLine(int iWhichQuery,
+   static void PrintSqtLine(vector<Query*> &vQuery,
+                            int iWhichQuery,
                             int iWhichResult,
                             Results *pOutput,
                             FILE *fpOut,
@@ -29,7 +29,8 @@ CometWriteTxt::~CometWriteTxt()
 }
 
 
-void CometWriteTxt::WriteTxt(FILE *fpout,
+void CometWriteTxt::WriteTxt(vector<Query*> &vQuery,
+                             FILE *fpout,
                              FILE *fpoutd,
                              FILE *fpdb)
 {
@@ -38,15 +39,15 @@ void CometWriteTxt::WriteTxt(FILE *fpout,
    // Print out the separate decoy hits.
    if (g_staticParams.options.iDecoySearch == 2)
    {
-      for (i=0; i<(int)g_pvQuery.size(); ++i)
-         PrintResults(i, 1, fpout, fpdb);
-      for (i=0; i<(int)g_pvQuery.size(); ++i)
-         PrintResults(i, 2, fpoutd, fpdb);
+      for (i=0; i<(int)vQuery.size(); ++i)
+         PrintResults(vQuery, i, 1, fpout, fpdb);
+      for (i=0; i<(int)vQuery.size(); ++i)
+         PrintResults(vQuery, i, 2, fpoutd, fpdb);
    }
    else
    {
-      for (i=0; i<(int)g_pvQuery.size(); ++i)
-         PrintResults(i, 0, fpout, fpdb);
+      for (i=0; i<(int)vQuery.size(); ++i)
+         PrintResults(vQuery, i, 0, fpout, fpdb);
    }
 }
 
@@ -112,16 +113,17 @@ void CometWriteTxt::PrintTxtHeader(FILE *fpout)
 }
 
 
-void CometWriteTxt::PrintResults(int iWhichQuery,
+void CometWriteTxt::PrintResults(vector<Query*> &vQuery,
+                                 int iWhichQuery,
                                  int iPrintTargetDecoy,
                                  FILE *fpout,
                                  FILE *fpdb)  //fpdb is file pointer for either FASTA or .idx file
 {
 #ifdef CRUX
-   if ((iPrintTargetDecoy != 2 && g_pvQuery.at(iWhichQuery)->_pResults[0].fXcorr > g_staticParams.options.dMinimumXcorr)
-         || (iPrintTargetDecoy == 2 && g_pvQuery.at(iWhichQuery)->_pDecoys[0].fXcorr > g_staticParams.options.dMinimumXcorr))
+   if ((iPrintTargetDecoy != 2 && vQuery.at(iWhichQuery)->_pResults[0].fXcorr > g_staticParams.options.dMinimumXcorr)
+         || (iPrintTargetDecoy == 2 && vQuery.at(iWhichQuery)->_pDecoys[0].fXcorr > g_staticParams.options.dMinimumXcorr))
    {
-      Query* pQuery = g_pvQuery.at(iWhichQuery);
+      Query* pQuery = vQuery.at(iWhichQuery);
 
       int charge = pQuery->_spectrumInfoInternal.usiChargeState;
       double spectrum_neutral_mass = pQuery->_pepMassInfo.dExpPepMass - PROTON_MASS;
@@ -211,7 +213,7 @@ void CometWriteTxt::PrintResults(int iWhichQuery,
 
          unsigned int uiNumTotProteins = 0;
          // print protein list
-         PrintProteins(fpout, fpdb, iWhichQuery, iWhichResult, iPrintTargetDecoy, &uiNumTotProteins);
+         PrintProteins(fpout, fpdb, pQuery, iWhichResult, iPrintTargetDecoy, &uiNumTotProteins);
 
          // Cleavage type
          fprintf(fpout, "\t%c%c\t", pOutput[iWhichResult].cPrevAA, pOutput[iWhichResult].cNextAA);
@@ -227,10 +229,10 @@ void CometWriteTxt::PrintResults(int iWhichQuery,
    }
 
 #else
-   if ((iPrintTargetDecoy != 2 && g_pvQuery.at(iWhichQuery)->_pResults[0].fXcorr > g_staticParams.options.dMinimumXcorr)
-         || (iPrintTargetDecoy == 2 && g_pvQuery.at(iWhichQuery)->_pDecoys[0].fXcorr > g_staticParams.options.dMinimumXcorr))
+   if ((iPrintTargetDecoy != 2 && vQuery.at(iWhichQuery)->_pResults[0].fXcorr > g_staticParams.options.dMinimumXcorr)
+         || (iPrintTargetDecoy == 2 && vQuery.at(iWhichQuery)->_pDecoys[0].fXcorr > g_staticParams.options.dMinimumXcorr))
    {
-      Query* pQuery = g_pvQuery.at(iWhichQuery);
+      Query* pQuery = vQuery.at(iWhichQuery);
 
       Results *pOutput;
       int iNumPrintLines;
@@ -361,7 +363,7 @@ void CometWriteTxt::PrintResults(int iWhichQuery,
                fprintf(fpout, "%c", pOutput[iWhichResult].szPeptide[i]);
             
                if (pOutput[iWhichResult].piVarModSites[i] < 0)
-                  fprintf(fpout, "[%s]", pOutput[iWhichResult].pszMod[i]);
+                  fprintf(fpout, "[%s]", pOutput[iWhichResult].PeffMod(i));
                else if (pOutput[iWhichResult].piVarModSites[i] > 0)
                   fprintf(fpout, "[%0.4f]", pOutput[iWhichResult].pdVarModSites[i]);
             }
@@ -377,7 +379,7 @@ void CometWriteTxt::PrintResults(int iWhichQuery,
          unsigned int uiNumTotProteins = 0;
 
          // print protein list
-         PrintProteins(fpout, fpdb, iWhichQuery, iWhichResult, iPrintTargetDecoy, &uiNumTotProteins);
+         PrintProteins(fpout, fpdb, pQuery, iWhichResult, iPrintTargetDecoy, &uiNumTotProteins);
 
          fprintf(fpout, "\t%u\t", uiNumTotProteins);
 
@@ -406,7 +408,7 @@ void CometWriteTxt::PrintResults(int iWhichQuery,
 // print out a comma separate list of protein refereces/accessions
 void CometWriteTxt::PrintProteins(FILE *fpout,
                                   FILE *fpdb,
-                                  int iWhichQuery,
+                                  Query *pQuery,
                                   int iWhichResult,
                                   int iPrintTargetDecoy,
                                   unsigned int *uiNumTotProteins)
@@ -417,7 +419,7 @@ void CometWriteTxt::PrintProteins(FILE *fpout,
 
    bool bReturnFulProteinString = false;
 
-   CometMassSpecUtils::GetProteinNameString(fpdb, iWhichQuery, iWhichResult, iPrintTargetDecoy, bReturnFulProteinString, uiNumTotProteins, vProteinTargets, vProteinDecoys);
+   CometMassSpecUtils::GetProteinNameString(fpdb, pQuery, iWhichResult, iPrintTargetDecoy, bReturnFulProteinString, uiNumTotProteins, vProteinTargets, vProteinDecoys);
 
    bool bPrintComma = false;
 
@@ -22,7 +22,8 @@ class CometWriteTxt
 public:
    CometWriteTxt();
    ~CometWriteTxt();
-   static void WriteTxt(FILE *fpout,
+   static void WriteTxt(vector<Query*> &vQuery,
+                        FILE *fpout,
                         FILE *fpoutd,
                         FILE *fpdb);
 
@@ -32,13 +33,14 @@ public:
                                   int iWhichResult);
    static void PrintProteins(FILE *fpout,
                              FILE *fpdb,
-                             int iWhichQuery,
+                             Query *pQuery,
                              int iWhichResult,
                              int iPrintTargetDecoy,
                              unsigned int *uiNumTotProteins);
 
 private:
-   static void PrintResults(int iWhichQuery,
+   static void PrintResults(vector<Query*> &vQuery,
+                            int iWhichQuery,
                             int iPrintTargetDecoy,
                             FILE *fpOut,
                             FILE *fpdb);
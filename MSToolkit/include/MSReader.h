@@ -78,6 +78,7 @@ class MSReader {
   //void            getInstrument(char* str);
   void            getInstrument(std::string& str);
   int             getLastScan();
+  bool            getIndexedScans(std::vector<int>& v, int firstScan=0); //scan numbers in the random-access index, ascending
   //void            getManufacturer(char* str);
   void            getManufacturer(std::string& str);
   int             getPercent();
@@ -115,6 +116,7 @@ class MSReader {
 
   //File compression
   void setCompression(bool b);
+  void setGZIndexSave(bool b);  //save the access point index of .gz input next to the file (default true)
 
   //for Sqlite
   void createIndex(); 
@@ -147,6 +149,7 @@ class MSReader {
   mzParser::ramp_fileoffset_t  *pScanIndex;
   mzParser::RAMPFILE  *rampFileIn;
   bool rampFileOpen;
+  bool rampGZIndexSave;
   int rampLastScan;
   int rampIndex;
   std::vector<MSSpectrumType> filter;
@@ -417,6 +417,7 @@ protected:
 #define WINSIZE 32768U      // sliding window size
 #define CHUNK 32768         // file input buffer size
 #define READCHUNK 16384
+#define GZINDEX_EXT ".gzidx"   // saved access point index, next to the .gz file
 
 // access point entry 
 typedef struct point {
@@ -446,6 +447,9 @@ public:
   int extract(FILE *in, f_off offset, unsigned char *buf, int len);
   int extract(FILE *in, f_off offset);
   f_off getfilesize();
+  bool read_index(const char* fileName, f_off span);
+  bool write_index(const char* fileName, f_off span);
+  static bool has_saved_index(const char* fileName, f_off span);
 
 protected:
 private:
@@ -497,6 +501,7 @@ public:
   bool parseOffset(f_off offset);
   void parserReset();
   void setGZCompression(bool b);
+  void setGZIndexSave(bool b);    // save a built .gz index next to the file (default true)
 
   inline void setFileName(const char* fileName) {
     m_strFileName = fileName;
@@ -526,6 +531,7 @@ protected:
   std::string  m_strFileName;
   bool m_bStopParse;
   bool m_bGZCompression;
+  bool m_bGZIndexSave;
   bool m_bionMobility;
 
   FILE* fptr;
@@ -1468,7 +1474,7 @@ std::string         rampConstructInputFileName(const std::string &basename);
 char*               rampConstructInputFileName(char *buf,int buflen,const char *basename);
 char*               rampConstructInputPath(char *buf, int inbuflen, const char *dir_in, const char *basename);
 const char**        rampListSupportedFileTypes();
-RAMPFILE*           rampOpenFile(const char *filename);
+RAMPFILE*           rampOpenFile(const char *filename, bool bSaveGZIndex=true);
 char*               rampValidFileType(const char *buf);
 void                readHeader(RAMPFILE *pFI, ramp_fileoffset_t lScanIndex, struct ScanHeaderStruct *scanHeader, int iIndex=-1, BasicSpectrum **bs=NULL);
 ramp_fileoffset_t*  readIndex(RAMPFILE *pFI, ramp_fileoffset_t indexOffset, int *iLastScan);
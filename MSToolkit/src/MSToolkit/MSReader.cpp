@@ -24,6 +24,7 @@ MSReader::MSReader(){
   iIntensityPrecision=1;
   iMZPrecision=4;
   rampFileOpen=false;
+  rampGZIndexSave=true;
   compressMe=false;
   rawFileOpen=false;
   exportMGF=false;
@@ -256,6 +257,26 @@ void MSReader::getInstrument(string& str) {
   str=sInstrument;
 }
 
+//Fills v with the scan numbers above firstScan that have an entry in the index of
+//the open mzML/mzXML file. Returns false if no such file is open.
+bool MSReader::getIndexedScans(vector<int>& v, int firstScan){
+  v.clear();
+  switch (lastFileFormat){
+  case mzXML:
+  case mzML:
+  case mzXMLgz:
+  case mzMLgz:
+    if (rampFileIn == NULL || pScanIndex == NULL) return false;
+    for (int i = firstScan + 1; i <= rampLastScan; i++){
+      if (pScanIndex[i] >= 0) v.push_back(i);
+    }
+    return true;
+  default:
+    break;
+  }
+  return false;
+}
+
 int MSReader::getLastScan(){
   switch (lastFileFormat){
   case mzXML:
@@ -1308,7 +1329,7 @@ bool MSReader::readMZPFile(const char* c, Spectrum& s, int scNum){
 	if(c!=NULL) {
 		//open the file if new file was requested
 		if(rampFileOpen) closeFile();
-		rampFileIn = mzParser::rampOpenFile(c);
+		rampFileIn = mzParser::rampOpenFile(c, rampGZIndexSave);
 		if (rampFileIn == NULL) {
       //silence errors. TODO: put in error code for user to lookup
       //cerr << "ERROR: Failure reading input file " << c << endl;
@@ -1529,6 +1550,10 @@ void MSReader::setOnePlusMGF(bool b){
   mgfOnePlus=b;
 }
 
+void MSReader::setGZIndexSave(bool b){
+  rampGZIndexSave=b;
+}
+
 void MSReader::writeCompressSpec(FILE* fileOut, Spectrum& s){
 
 	int j;
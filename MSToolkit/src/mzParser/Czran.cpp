@@ -48,9 +48,68 @@
  */
 
 #include "mzParser.h"
+#include <stdint.h>
+#include <atomic>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
 
 using namespace mzParser;
 
+/* Layout of the saved index: the header below, then for each access point
+   its out and in offsets (8 bytes each), bits (4 bytes) and 32K window.  The
+   size and modification time of the .gz file tie the index to that file. */
+#define GZINDEX_MAGIC "MZPGZIX1"
+
+typedef struct gz_index_header {
+  char magic[8];
+  int64_t gzSize;       // size of the .gz file
+  int64_t gzTime;       // modification time of the .gz file
+  int64_t span;         // span used to build the index
+  int64_t outSize;      // uncompressed size
+  int64_t have;         // number of access points
+} gz_index_header;
+
+static bool stat_gz(const char* fileName, int64_t& size, int64_t& mtime){
+#ifdef _WIN32
+  struct _stat64 st;
+  if (_stat64(fileName, &st) != 0) return false;
+#else
+  struct stat st;
+  if (stat(fileName, &st) != 0) return false;
+#endif
+  size = (int64_t)st.st_size;
+  mtime = (int64_t)st.st_mtime;
+  return true;
+}
+
+/* Opens the saved index of fileName and reads its header; returns NULL unless
+   the header matches the current .gz file and span. */
+static FILE* open_saved_index(const char* fileName, f_off span, gz_index_header& hdr){
+  int64_t size, mtime;
+  if (!stat_gz(fileName, size, mtime)) return NULL;
+
+  std::string strIdx = std::string(fileName) + GZINDEX_EXT;
+  FILE* f = fopen(strIdx.c_str(), "rb");
+  if (f == NULL) return NULL;
+
+  if (fread(&hdr, sizeof(hdr), 1, f) != 1
+      || memcmp(hdr.magic, GZINDEX_MAGIC, sizeof(hdr.magic))
+      || hdr.gzSize != size
+      || hdr.gzTime != mtime
+      || hdr.span != (int64_t)span
+      || hdr.have < 1 || hdr.have > INT32_MAX) {
+    fclose(f);
+    return NULL;
+  }
+  return f;
+}
+
 Czran::Czran(){
 	index=NULL;
 	buffer=NULL;
@@ -393,3 +452,102 @@ f_off Czran::getfilesize(){
 	return fileSize;
 }
 
+/* Replaces the current index with the one saved next to fileName by
+   write_index().  Returns false, leaving no index, if there is no saved index
+   or it does not belong to the current version of the file. */
+bool Czran::read_index(const char* fileName, f_off span){
+  gz_index_header hdr;
+  FILE* f = open_saved_index(fileName, span, hdr);
+  if (f == NULL) return false;
+
+  free_index();
+  index = (gz_access*)malloc(sizeof(gz_access));
+  if (index != NULL) index->list = (point*)malloc(sizeof(point) * (size_t)hdr.have);
+  if (index == NULL || index->list == NULL) {
+    if (index != NULL) free(index);
+    index = NULL;
+    fclose(f);
+    return false;
+  }
+  index->have = index->size = (int)hdr.have;
+
+  bool ok = true;
+  for (int i = 0; ok && i < index->have; i++) {
+    point* p = index->list + i;
+    int64_t out, in;
+    int32_t bits;
+    ok = fread(&out, sizeof(out), 1, f) == 1
+      && fread(&in, sizeof(in), 1, f) == 1
+      && fread(&bits, sizeof(bits), 1, f) == 1
+      && fread(p->window, WINSIZE, 1, f) == 1
+      && bits >= 0 && bits < 8;
+    p->out = (f_off)out;
+    p->in = (f_off)in;
+    p->bits = bits;
+  }
+  fclose(f);
+
+  if (!ok) {
+    free_index();
+    return false;
+  }
+  fileSize = (f_off)hdr.outSize;
+  return true;
+}
+
+/* Saves the index built by build_index() next to fileName so later opens of an
+   unchanged file can skip the full decompression pass.  The index is written
+   to a temporary file named for this process and write, then renamed into
+   place, so other processes never read a partial index and writers of the
+   same file do not share a temporary file.  Failure (e.g. a read-only
+   directory) is not an error; the index is simply rebuilt next time. */
+bool Czran::write_index(const char* fileName, f_off span){
+  if (index == NULL) return false;
+
+  gz_index_header hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, GZINDEX_MAGIC, sizeof(hdr.magic));
+  if (!stat_gz(fileName, hdr.gzSize, hdr.gzTime)) return false;
+  hdr.span = (int64_t)span;
+  hdr.outSize = (int64_t)fileSize;
+  hdr.have = index->have;
+
+  std::string strIdx = std::string(fileName) + GZINDEX_EXT;
+  static std::atomic<unsigned int> uiNumWrites(0);
+  std::string strTmp = strIdx + "." + std::to_string((long long)getpid())
+    + "." + std::to_string(uiNumWrites++) + ".tmp";
+  FILE* f = fopen(strTmp.c_str(), "wb");
+  if (f == NULL) return false;
+
+  bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+  for (int i = 0; ok && i < index->have; i++) {
+    point* p = index->list + i;
+    int64_t out = (int64_t)p->out;
+    int64_t in = (int64_t)p->in;
+    int32_t bits = p->bits;
+    ok = fwrite(&out, sizeof(out), 1, f) == 1
+      && fwrite(&in, sizeof(in), 1, f) == 1
+      && fwrite(&bits, sizeof(bits), 1, f) == 1
+      && fwrite(p->window, WINSIZE, 1, f) == 1;
+  }
+  if (fclose(f) != 0) ok = false;
+
+#ifdef _WIN32
+  if (ok) remove(strIdx.c_str());   // rename() does not replace on Windows
+#endif
+  if (!ok || rename(strTmp.c_str(), strIdx.c_str()) != 0) {
+    remove(strTmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+/* True if fileName has a saved index that read_index() would accept. */
+bool Czran::has_saved_index(const char* fileName, f_off span){
+  gz_index_header hdr;
+  FILE* f = open_saved_index(fileName, span, hdr);
+  if (f == NULL) return false;
+  fclose(f);
+  return true;
+}
+
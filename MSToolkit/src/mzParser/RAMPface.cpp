@@ -375,7 +375,7 @@ const char** mzParser::rampListSupportedFileTypes(){
   return &(data_Ext[0]);
 }
 
-RAMPFILE* mzParser::rampOpenFile(const char* filename){
+RAMPFILE* mzParser::rampOpenFile(const char* filename, bool bSaveGZIndex){
   int i=mzParser::checkFileType(filename);
   if(i==0){
     return NULL;
@@ -391,6 +391,7 @@ RAMPFILE* mzParser::rampOpenFile(const char* filename){
         r->mzML=new mzpSAXMzmlHandler(r->bs);
         if(i==3)r->mzML->setGZCompression(true);
         else r->mzML->setGZCompression(false);
+        r->mzML->setGZIndexSave(bSaveGZIndex);
         if(i==6) r->mzML->setMZMLB(true);
         else r->mzML->setMZMLB(false);
         if(!r->mzML->load(filename)){
@@ -404,6 +405,7 @@ RAMPFILE* mzParser::rampOpenFile(const char* filename){
         r->mzXML=new mzpSAXMzxmlHandler(r->bs);
         if(i==4) r->mzXML->setGZCompression(true);
         else r->mzXML->setGZCompression(false);
+        r->mzXML->setGZIndexSave(bSaveGZIndex);
         if(!r->mzXML->load(filename)){
           delete r;
           return NULL;
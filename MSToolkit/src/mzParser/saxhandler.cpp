@@ -152,6 +152,7 @@ mzpSAXHandler::mzpSAXHandler()
 {
 	fptr = NULL;
 	m_bGZCompression = false;
+	m_bGZIndexSave = true;
 	m_bionMobility = false;
 	fptr = NULL;
 	m_parser = XML_ParserCreate(NULL);
@@ -191,9 +192,10 @@ bool mzpSAXHandler::open(const char* fileName){
 	}
 	setFileName(fileName);
 
-	//Build the index if gz compressed
+	//Build the index if gz compressed, unless one was saved for this file
 	if(m_bGZCompression){
 		gzObj.free_index();
+		if(gzObj.read_index(fileName, SPAN)) return true;
 
 		int len;
 		len = gzObj.build_index(fptr, SPAN);
@@ -216,6 +218,7 @@ bool mzpSAXHandler::open(const char* fileName){
 				fptr=NULL;
         return false;
     }
+		if(m_bGZIndexSave) gzObj.write_index(fileName, SPAN);
 	}
 
 	return true;
@@ -345,3 +348,7 @@ void mzpSAXHandler::parserReset(){
 void mzpSAXHandler::setGZCompression(bool b){
 	m_bGZCompression=b;
 }
+
+void mzpSAXHandler::setGZIndexSave(bool b){
+	m_bGZIndexSave=b;
+}